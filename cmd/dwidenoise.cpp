@@ -17,13 +17,12 @@
 
 #include "command.h"
 #include "image.h"
-
-#include <Eigen/Dense>
-#include <Eigen/Eigenvalues>
+#include "dwi/denoise.h"
 
 
 using namespace MR;
 using namespace App;
+using namespace MR::DWI;
 
 const char* const dtypes[] = { "float32", "float64", NULL };
 
@@ -120,130 +119,6 @@ void usage ()
 using real_type = float;
 
 
-template <typename F = float>
-class DenoisingFunctor {
-  MEMALIGN(DenoisingFunctor)
-
-public:
-
-  using MatrixType = Eigen::Matrix<F, Eigen::Dynamic, Eigen::Dynamic>;
-  using SValsType = Eigen::VectorXd;
-
-  DenoisingFunctor (int ndwi, const vector<uint32_t>& extent,
-                    Image<bool>& mask, Image<real_type>& noise, bool exp1)
-    : extent {{extent[0]/2, extent[1]/2, extent[2]/2}},
-      m (ndwi), n (extent[0]*extent[1]*extent[2]),
-      r (std::min(m,n)), q (std::max(m,n)), exp1(exp1),
-      X (m,n), pos {{0, 0, 0}},
-      mask (mask), noise (noise)
-  { }
-
-  template <typename ImageType>
-  void operator () (ImageType& dwi, ImageType& out)
-  {
-    // Process voxels in mask only
-    if (mask.valid()) {
-      assign_pos_of (dwi, 0, 3).to (mask);
-      if (!mask.value())
-        return;
-    }
-
-    // Load data in local window
-    load_data (dwi);
-
-    // Compute Eigendecomposition:
-    MatrixType XtX (r,r);
-    if (m <= n)
-      XtX.template triangularView<Eigen::Lower>() = X * X.adjoint();
-    else
-      XtX.template triangularView<Eigen::Lower>() = X.adjoint() * X;
-    Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
-    // eigenvalues sorted in increasing order:
-    SValsType s = eig.eigenvalues().template cast<double>();
-
-    // Marchenko-Pastur optimal threshold
-    const double lam_r = std::max(s[0], 0.0) / q;
-    double clam = 0.0;
-    sigma2 = 0.0;
-    ssize_t cutoff_p = 0;
-    for (ssize_t p = 0; p < r; ++p)     // p+1 is the number of noise components
-    {                                   // (as opposed to the paper where p is defined as the number of signal components)
-      double lam = std::max(s[p], 0.0) / q;
-      clam += lam;
-      double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
-      double sigsq1 = clam / double(p+1);
-      double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
-      // sigsq2 > sigsq1 if signal else noise
-      if (sigsq2 < sigsq1) {
-        sigma2 = sigsq1;
-        cutoff_p = p+1;
-      }
-    }
-
-    if (cutoff_p > 0) {
-      // recombine data using only eigenvectors above threshold:
-      s.head (cutoff_p).setZero();
-      s.tail (r-cutoff_p).setOnes();
-      if (m <= n)
-        X.col (n/2) = eig.eigenvectors() * ( s.cast<F>().asDiagonal() * ( eig.eigenvectors().adjoint() * X.col(n/2) ));
-      else
-        X.col (n/2) = X * ( eig.eigenvectors() * ( s.cast<F>().asDiagonal() * eig.eigenvectors().adjoint().col(n/2) ));
-    }
-
-    // Store output
-    assign_pos_of(dwi).to(out);
-    out.row(3) = X.col(n/2);
-
-    // store noise map if requested:
-    if (noise.valid()) {
-      assign_pos_of(dwi, 0, 3).to(noise);
-      noise.value() = real_type (std::sqrt(sigma2));
-    }
-  }
-
-private:
-  const std::array<ssize_t, 3> extent;
-  const ssize_t m, n, r, q;
-  const bool exp1;
-  MatrixType X;
-  std::array<ssize_t, 3> pos;
-  double sigma2;
-  Image<bool> mask;
-  Image<real_type> noise;
-
-  template <typename ImageType>
-  void load_data (ImageType& dwi) {
-    pos[0] = dwi.index(0); pos[1] = dwi.index(1); pos[2] = dwi.index(2);
-    // fill patch
-    X.setZero();
-    size_t k = 0;
-    for (int z = -extent[2]; z <= extent[2]; z++) {
-      dwi.index(2) = wrapindex(z, 2, dwi.size(2));
-      for (int y = -extent[1]; y <= extent[1]; y++) {
-        dwi.index(1) = wrapindex(y, 1, dwi.size(1));
-        for (int x = -extent[0]; x <= extent[0]; x++, k++) {
-          dwi.index(0) = wrapindex(x, 0, dwi.size(0));
-          X.col(k) = dwi.row(3);
-        }
-      }
-    }
-    // reset image position
-    dwi.index(0) = pos[0];
-    dwi.index(1) = pos[1];
-    dwi.index(2) = pos[2];
-  }
-
-  inline size_t wrapindex(int r, int axis, int max) const {
-    // patch handling at image edges
-    int rr = pos[axis] + r;
-    if (rr < 0)    rr = extent[axis] - r;
-    if (rr >= max) rr = (max-1) - extent[axis] - r;
-    return rr;
-  }
-
-};
-
-
 template <typename T>
 void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
                     const std::string& output_name, const vector<uint32_t>& extent, bool exp1)
@@ -254,8 +129,15 @@ void process_image (Header& data, Image<bool>& mask, Image<real_type> noise,
     header.datatype() = DataType::from<T>();
     auto output = Image<T>::create (output_name, header);
     // run
-    DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1);
-    ThreadedLoop ("running MP-PCA denoising", data, 0, 3).run (func, input, output);
+    if (data.size(3) <= ssize_t (extent[0]*extent[1]*extent[2])) {
+      auto loop = ThreadedLoop ("running MP-PCA denoising", data, 0, 3);
+      SlidingDenoisingFunctor<T> func (data.size(3), extent, loop.inner_axes[0], input, output, mask, noise, exp1);
+      loop.run_outer (func);
+    }
+    else {
+      DenoisingFunctor<T> func (data.size(3), extent, mask, noise, exp1);
+      ThreadedLoop ("running MP-PCA denoising", data, 0, 3).run (func, input, output);
+    }
   }
 
 
@@ -93,14 +93,12 @@ void run()
       fixel_mask.value() = true;
   }
 
-  auto connectivity_matrix = Fixel::Matrix::generate (argument[1],
-                                                      index_image,
-                                                      fixel_mask,
-                                                      angular_threshold);
-
-  Fixel::Matrix::normalise_and_write (connectivity_matrix,
-                                      connectivity_threshold,
-                                      argument[2]);
+  Fixel::Matrix::generate_and_write (argument[1],
+                                     index_image,
+                                     fixel_mask,
+                                     angular_threshold,
+                                     connectivity_threshold,
+                                     argument[2]);
 
 }
 
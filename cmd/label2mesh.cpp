@@ -125,10 +125,12 @@ void run ()
       for (auto i = Loop (subset) (subset, scratch); i; ++i)
         scratch.value() = (subset.value() == in);
 
+      // Labels are already processed concurrently, so each individual
+      //   Marching Cubes invocation need not spawn its own threads
       if (blocky)
         MR::Surface::Algo::image2mesh_blocky (scratch, meshes[in]);
       else
-        MR::Surface::Algo::image2mesh_mc (scratch, meshes[in], 0.5);
+        MR::Surface::Algo::image2mesh_mc (scratch, meshes[in], 0.5, 1);
       std::lock_guard<std::mutex> lock (mutex);
       ++progress;
       return true;
@@ -296,27 +296,32 @@ class ThreadLocalStorageItem { NOMEMALIGN
     copy_ptr<Image<complex_type>> image;
 };
 
+// load the values of image over the two inner axes from the current position,
+// replicating the image along any axis where it has size one
+template <class ImageType, class ChunkType>
+void load_chunk (ChunkType& chunk, ImageType& image, const Iterator& iter, const vector<size_t>& axes, const vector<size_t>& size)
+{
+  for (size_t n = 0; n < image.ndim(); ++n)
+    if (image.size(n) > 1)
+      image.index(n) = iter.index(n);
+
+  size_t n = 0;
+  for (size_t y = 0; y < size[1]; ++y) {
+    if (axes[1] < image.ndim()) if (image.size (axes[1]) > 1) image.index(axes[1]) = y;
+    for (size_t x = 0; x < size[0]; ++x) {
+      if (axes[0] < image.ndim()) if (image.size (axes[0]) > 1) image.index(axes[0]) = x;
+      chunk[n++] = image.value();
+    }
+  }
+}
+
+
 class ThreadLocalStorage : public vector<ThreadLocalStorageItem> { NOMEMALIGN
   public:
 
-      void load (Chunk& chunk, Image<complex_type>& image) {
-        for (size_t n = 0; n < image.ndim(); ++n)
-          if (image.size(n) > 1)
-            image.index(n) = iter->index(n);
-
-        size_t n = 0;
-        for (size_t y = 0; y < size[1]; ++y) {
-          if (axes[1] < image.ndim()) if (image.size (axes[1]) > 1) image.index(axes[1]) = y;
-          for (size_t x = 0; x < size[0]; ++x) {
-            if (axes[0] < image.ndim()) if (image.size (axes[0]) > 1) image.index(axes[0]) = x;
-            chunk[n++] = image.value();
-          }
-        }
-      }
-
     Chunk& next () {
       ThreadLocalStorageItem& item ((*this)[current++]);
-      if (item.image) load (item.chunk, *item.image);
+      if (item.image) load_chunk (item.chunk, *item.image, *iter, axes, size);
       return item.chunk;
     }
 
@@ -332,13 +337,30 @@ class ThreadLocalStorage : public vector<ThreadLocalStorageItem> { NOMEMALIGN
 
 
 
-class LoadedImage { NOMEMALIGN
+// An input image, opened only once however many times it appears on the
+// command-line. Access to its data is deferred until it is known whether the
+// expression will be evaluated in real or complex arithmetic.
+class LoadedImage : public Header { NOMEMALIGN
   public:
-    LoadedImage (std::shared_ptr<Image<complex_type>>& i, const bool c) :
-        image (i),
-        image_is_complex (c) { }
-    std::shared_ptr<Image<complex_type>> image;
-    bool image_is_complex;
+    LoadedImage (Header&& H) :
+        Header (std::move (H)),
+        image_is_complex (datatype().is_complex()) { }
+    const bool image_is_complex;
+
+    Image<complex_type> get_complex () {
+      if (!complex_image.valid())
+        complex_image = get_image<complex_type>();
+      return complex_image;
+    }
+    Image<real_type> get_real () {
+      if (!real_image.valid())
+        real_image = get_image<real_type>();
+      return real_image;
+    }
+
+  private:
+    Image<complex_type> complex_image;
+    Image<real_type> real_image;
 };
 
 
@@ -364,15 +386,14 @@ class StackEntry { NOMEMALIGN
       auto search = image_list.find (arg);
       if (search != image_list.end()) {
         DEBUG (std::string ("image \"") + arg + "\" already loaded - re-using exising image");
-        image = search->second.image;
-        image_is_complex = search->second.image_is_complex;
+        image = search->second;
+        image_is_complex = image->image_is_complex;
       }
       else {
         try {
-          auto header = Header::open (arg);
-          image_is_complex = header.datatype().is_complex();
-          image.reset (new Image<complex_type> (header.get_image<complex_type>()));
-          image_list.insert (std::make_pair (arg, LoadedImage (image, image_is_complex)));
+          image = std::make_shared<LoadedImage> (Header::open (arg));
+          image_is_complex = image->image_is_complex;
+          image_list.insert (std::make_pair (arg, image));
         }
         catch (Exception& e_image) {
           try {
@@ -399,7 +420,7 @@ class StackEntry { NOMEMALIGN
 
     const char* arg;
     std::shared_ptr<Evaluator> evaluator;
-    std::shared_ptr<Image<complex_type>> image;
+    std::shared_ptr<LoadedImage> image;
     copy_ptr<Math::RNG> rng;
     complex_type value;
     bool rng_gaussian;
@@ -407,12 +428,12 @@ class StackEntry { NOMEMALIGN
 
     bool is_complex () const;
 
-    static std::map<std::string, LoadedImage> image_list;
+    static std::map<std::string, std::shared_ptr<LoadedImage>> image_list;
 
     Chunk& evaluate (ThreadLocalStorage& storage) const;
 };
 
-std::map<std::string, LoadedImage> StackEntry::image_list;
+std::map<std::string, std::shared_ptr<LoadedImage>> StackEntry::image_list;
 
 
 class Evaluator { NOMEMALIGN
@@ -439,6 +460,8 @@ class Evaluator { NOMEMALIGN
     virtual Chunk& evaluate (Chunk& in) const { throw Exception ("operation \"" + id + "\" not supported!"); return in; }
     virtual Chunk& evaluate (Chunk& a, Chunk& b) const { throw Exception ("operation \"" + id + "\" not supported!"); return a; }
     virtual Chunk& evaluate (Chunk& a, Chunk& b, Chunk& c) const { throw Exception ("operation \"" + id + "\" not supported!"); return a; }
+    // evaluate size values in real arithmetic, with the operands at in[0..num_args()-1]; out may alias any of them
+    virtual void evaluate_real (real_type* out, const real_type* const* in, size_t size) const { throw Exception ("operation \"" + id + "\" not supported!"); }
 
     virtual bool is_complex () const {
       for (size_t n = 0; n < operands.size(); ++n)
@@ -547,6 +570,12 @@ class UnaryEvaluator : public Evaluator { NOMEMALIGN
 
       return in;
     }
+
+    virtual void evaluate_real (real_type* out, const real_type* const* in, size_t size) const {
+      const real_type* a = in[0];
+      for (size_t n = 0; n < size; ++n)
+        out[n] = op.R (a[n]).real();
+    }
 };
 
 
@@ -583,6 +612,13 @@ class BinaryEvaluator : public Evaluator { NOMEMALIGN
       return out;
     }
 
+    virtual void evaluate_real (real_type* out, const real_type* const* in, size_t size) const {
+      const real_type* a = in[0];
+      const real_type* b = in[1];
+      for (size_t n = 0; n < size; ++n)
+        out[n] = op.R (a[n], b[n]).real();
+    }
+
 };
 
 
@@ -619,6 +655,14 @@ class TernaryEvaluator : public Evaluator { NOMEMALIGN
       return out;
     }
 
+    virtual void evaluate_real (real_type* out, const real_type* const* in, size_t size) const {
+      const real_type* a = in[0];
+      const real_type* b = in[1];
+      const real_type* c = in[2];
+      for (size_t n = 0; n < size; ++n)
+        out[n] = op.R (a[n], b[n], c[n]).real();
+    }
+
 };
 
 
@@ -721,26 +765,27 @@ void get_header (const StackEntry& entry, Header& header)
   if (!entry.image)
     return;
 
+  const Header& image (*entry.image);
   if (header.ndim() == 0) {
-    header = *entry.image;
+    header = image;
     return;
   }
 
-  if (header.ndim() < entry.image->ndim())
-    header.ndim() = entry.image->ndim();
-  for (size_t n = 0; n < std::min<size_t> (header.ndim(), entry.image->ndim()); ++n) {
-    if (header.size(n) > 1 && entry.image->size(n) > 1 && header.size(n) != entry.image->size(n))
+  if (header.ndim() < image.ndim())
+    header.ndim() = image.ndim();
+  for (size_t n = 0; n < std::min<size_t> (header.ndim(), image.ndim()); ++n) {
+    if (header.size(n) > 1 && image.size(n) > 1 && header.size(n) != image.size(n))
       throw Exception ("dimensions of input images do not match - aborting");
-    if (!voxel_grids_match_in_scanner_space (header, *(entry.image), 1.0e-4) && !transform_mis_match_reported) {
+    if (!voxel_grids_match_in_scanner_space (header, image, 1.0e-4) && !transform_mis_match_reported) {
       WARN ("header transformations of input images do not match");
       transform_mis_match_reported = true;
     }
-    header.size(n) = std::max (header.size(n), entry.image->size(n));
+    header.size(n) = std::max (header.size(n), image.size(n));
     if (!std::isfinite (header.spacing(n)))
-      header.spacing(n) = entry.image->spacing(n);
+      header.spacing(n) = image.spacing(n);
   }
 
-  header.merge_keyval (entry.image->keyval());
+  header.merge_keyval (image.keyval());
 }
 
 
@@ -773,7 +818,7 @@ class ThreadFunctor { NOMEMALIGN
 
       storage.push_back (ThreadLocalStorageItem());
       if (entry.image) {
-        storage.back().image.reset (new Image<complex_type> (*entry.image));
+        storage.back().image.reset (new Image<complex_type> (entry.image->get_complex()));
         storage.back().chunk.resize (chunk_size);
         return;
       }
@@ -808,6 +853,211 @@ class ThreadFunctor { NOMEMALIGN
 
 
 
+/**********************************************************************
+   COMPILED EVALUATION OF REAL-VALUED EXPRESSIONS:
+ **********************************************************************/
+
+// If no complex values are involved anywhere in the expression, the operator
+// tree is instead compiled into a flat list of instructions operating on
+// blocks of MRCALC_REGISTER_SIZE real values (registers). Input images and
+// random numbers are still loaded one chunk at a time, but intermediate
+// results are only ever held in registers, which are re-used as soon as
+// their contents are no longer needed and so remain in cache. The loop over
+// each register within each operation is simple enough to be vectorised by
+// the compiler.
+
+#define MRCALC_REGISTER_SIZE 256
+
+
+bool is_real (const StackEntry& entry)
+{
+  if (entry.evaluator) {
+    if (entry.evaluator->is_complex())
+      return false;
+    for (const auto& operand : entry.evaluator->operands)
+      if (!is_real (operand))
+        return false;
+    return true;
+  }
+  return !entry.is_complex();
+}
+
+
+
+class Program { NOMEMALIGN
+  public:
+    Program (const StackEntry& top_of_stack) {
+      result = compile (top_of_stack);
+    }
+
+    class Instruction { NOMEMALIGN
+      public:
+        const Evaluator* evaluator;
+        vector<size_t> operands;
+        size_t output;
+    };
+
+    // registers either hold temporary results, a constant value, or point
+    // into the chunk of an input (image or random numbers):
+    class Register { NOMEMALIGN
+      public:
+        Register () : is_temp (true), input (-1), value (0.0) { }
+        bool is_temp;
+        ssize_t input;
+        real_type value;
+    };
+
+    class Input { NOMEMALIGN
+      public:
+        std::shared_ptr<LoadedImage> image;
+        bool rng, rng_gaussian;
+    };
+
+    vector<Instruction> instructions;
+    vector<Register> registers;
+    vector<Input> inputs;
+    size_t result;
+
+  private:
+    vector<size_t> free_registers;
+
+    size_t compile (const StackEntry& entry) {
+      if (entry.evaluator) {
+        Instruction instruction;
+        instruction.evaluator = entry.evaluator.get();
+        for (const auto& operand : entry.evaluator->operands)
+          instruction.operands.push_back (compile (operand));
+        // operands can be overwritten by the output of the same instruction:
+        for (auto r : instruction.operands)
+          if (registers[r].is_temp)
+            free_registers.push_back (r);
+        instruction.output = allocate();
+        instructions.push_back (instruction);
+        return instruction.output;
+      }
+
+      Register reg;
+      reg.is_temp = false;
+      if (entry.image || entry.rng) {
+        reg.input = inputs.size();
+        inputs.push_back ({ entry.image, bool(entry.rng), entry.rng_gaussian });
+      }
+      else
+        reg.value = entry.value.real();
+      registers.push_back (reg);
+      return registers.size() - 1;
+    }
+
+    size_t allocate () {
+      if (free_registers.size()) {
+        const size_t r = free_registers.back();
+        free_registers.pop_back();
+        return r;
+      }
+      registers.push_back (Register());
+      return registers.size() - 1;
+    }
+};
+
+
+
+class CompiledThreadFunctor { NOMEMALIGN
+  public:
+    CompiledThreadFunctor (
+        const vector<size_t>& inner_axes,
+        const Program& compiled_program,
+        Image<real_type>& output_image) :
+      program (compiled_program),
+      image (output_image),
+      loop (Loop (inner_axes)),
+      axes (loop.axes),
+      size ({ size_t (image.size (axes[0])), size_t (image.size (axes[1])) }),
+      output (size[0] * size[1]),
+      registers (program.registers.size() * MRCALC_REGISTER_SIZE),
+      pointers (program.registers.size()) {
+        for (const auto& input : program.inputs) {
+          inputs.push_back (InputData());
+          if (input.image)
+            inputs.back().image.reset (new Image<real_type> (input.image->get_real()));
+          else
+            inputs.back().rng.reset (new Math::RNG());
+          inputs.back().chunk.resize (output.size());
+        }
+        for (size_t r = 0; r < program.registers.size(); ++r) {
+          const auto& reg (program.registers[r]);
+          if (!reg.is_temp && reg.input < 0)
+            std::fill_n (registers.begin() + r*MRCALC_REGISTER_SIZE, MRCALC_REGISTER_SIZE, reg.value);
+        }
+      }
+
+
+    void operator() (const Iterator& iter) {
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        auto& input (inputs[i]);
+        if (input.image)
+          load_chunk (input.chunk, *input.image, iter, axes, size);
+        else if (program.inputs[i].rng_gaussian) {
+          std::normal_distribution<real_type> dis (0.0, 1.0);
+          for (auto& v : input.chunk)
+            v = dis (*input.rng);
+        }
+        else {
+          std::uniform_real_distribution<real_type> dis (0.0, 1.0);
+          for (auto& v : input.chunk)
+            v = dis (*input.rng);
+        }
+      }
+
+      for (size_t offset = 0; offset < output.size(); offset += MRCALC_REGISTER_SIZE) {
+        const size_t count = std::min (output.size() - offset, size_t (MRCALC_REGISTER_SIZE));
+        for (size_t r = 0; r < pointers.size(); ++r) {
+          const auto& reg (program.registers[r]);
+          pointers[r] = reg.input < 0 ?
+              &registers[r*MRCALC_REGISTER_SIZE] :
+              &inputs[reg.input].chunk[offset];
+        }
+        if (program.instructions.empty()) {
+          std::copy_n (pointers[program.result], count, &output[offset]);
+          continue;
+        }
+        // final instruction writes straight into the output chunk:
+        pointers[program.result] = &output[offset];
+        for (const auto& instruction : program.instructions) {
+          const real_type* in[3];
+          for (size_t n = 0; n < instruction.operands.size(); ++n)
+            in[n] = pointers[instruction.operands[n]];
+          instruction.evaluator->evaluate_real (pointers[instruction.output], in, count);
+        }
+      }
+
+      assign_pos_of (iter).to (image);
+      auto value = output.cbegin();
+      for (auto l = loop (image); l; ++l)
+        image.value() = *(value++);
+    }
+
+
+  private:
+    class InputData { NOMEMALIGN
+      public:
+        copy_ptr<Image<real_type>> image;
+        copy_ptr<Math::RNG> rng;
+        vector<real_type> chunk;
+    };
+
+    const Program& program;
+    Image<real_type> image;
+    decltype (Loop (vector<size_t>())) loop;
+    const vector<size_t> axes, size;
+    vector<InputData> inputs;
+    vector<real_type> output, registers;
+    vector<real_type*> pointers;
+};
+
+
+
+
+
 void run_operations (const vector<StackEntry>& stack)
 {
   Header header;
@@ -841,6 +1091,16 @@ void run_operations (const vector<StackEntry>& stack)
   }
   else header.datatype() = DataType::from_command_line (DataType::Float32);
 
+  if (is_real (stack[0]) && !header.datatype().is_complex()) {
+    DEBUG ("expression is real-valued - using compiled evaluation");
+    auto output = Header::create (stack[1].arg, header).get_image<real_type>();
+    auto loop = ThreadedLoop ("computing: " + operation_string(stack[0]), output, 0, output.ndim(), 2);
+    const Program program (stack[0]);
+    CompiledThreadFunctor functor (loop.inner_axes, program, output);
+    loop.run_outer (functor);
+    return;
+  }
+
   auto output = Header::create (stack[1].arg, header).get_image<complex_type>();
 
   auto loop = ThreadedLoop ("computing: " + operation_string(stack[0]), output, 0, output.ndim(), 2);
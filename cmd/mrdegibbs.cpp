@@ -14,14 +14,13 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
-#include <unsupported/Eigen/FFT>
-
 #include "axes.h"
 #include "command.h"
 #include "image.h"
 #include "progressbar.h"
 #include "types.h"
 #include "algo/threaded_loop.h"
+#include "math/fft.h"
 #include "metadata/bids.h"
 #include <numeric>
 
@@ -103,9 +102,8 @@ class ComputeSlice
       maxW (maxW),
       in (in),
       out (out),
-      im1 (in.size(slice_axes[0]), in.size(slice_axes[1])),
-      im2 (im1.rows(), im1.cols()) {
-        prealloc_FFT();
+      im (in.size(slice_axes[0]), in.size(slice_axes[1])) {
+        init_shifts();
       }
 
     ComputeSlice (const ComputeSlice& other) :
@@ -116,11 +114,9 @@ class ComputeSlice
       maxW (other.maxW),
       in (other.in),
       out (other.out),
-      fft (),
-      im1 (in.size(slice_axes[0]), in.size(slice_axes[1])),
-      im2 (im1.rows(), im1.cols()) {
-        prealloc_FFT();
-      }
+      im (other.im.rows(), other.im.cols()),
+      shifts (other.shifts),
+      phases { other.phases[0], other.phases[1] } { }
 
 
     void operator() (const Iterator& pos)
@@ -130,12 +126,12 @@ class ComputeSlice
       assign_pos_of (pos, outer_axes).to (in, out);
 
       for (auto l = Loop (slice_axes) (in); l; ++l)
-        im1 (ssize_t(in.index(X)), ssize_t(in.index(Y))) = cdouble (in.value(), 0.0);
+        im (ssize_t(in.index(X)), ssize_t(in.index(Y))) = in.value();
 
       unring_2d ();
 
       for (auto l = Loop (slice_axes) (out); l; ++l)
-        out.value() = im1 (ssize_t(out.index(X)), ssize_t(out.index(Y))).real();
+        out.value() = im (ssize_t(out.index(X)), ssize_t(out.index(Y)));
     }
 
   private:
@@ -143,161 +139,155 @@ class ComputeSlice
     const vector<size_t>& slice_axes;
     const int nsh, minW, maxW;
     Image<value_type> in, out;
-    Eigen::FFT<double> fft;
-    Eigen::MatrixXcd im1, im2, shifted;
-    Eigen::VectorXcd v;
-
-    void prealloc_FFT () {
-      // needed to avoid within-thread allocations,
-      // which aren't thread-safe in FFTW:
-#ifdef EIGEN_FFTW_DEFAULT
-      Eigen::VectorXcd tmp (im1.rows());
-      FFT (tmp);
-      iFFT (tmp);
-      tmp.resize (im1.cols());
-      FFT (tmp);
-      iFFT (tmp);
-#endif
-    }
-
-    template <typename Derived> FORCE_INLINE void FFT      (Eigen::MatrixBase<Derived>&& vec) { fft.fwd (v, vec); vec = v; }
-    template <typename Derived> FORCE_INLINE void FFT      (Eigen::MatrixBase<Derived>& vec) { FFT (std::move (vec)); }
-    template <typename Derived> FORCE_INLINE void iFFT     (Eigen::MatrixBase<Derived>&& vec) { fft.inv (v, vec); vec = v; }
-    template <typename Derived> FORCE_INLINE void iFFT     (Eigen::MatrixBase<Derived>& vec) { iFFT (std::move (vec)); }
-    template <typename Derived> FORCE_INLINE void row_FFT  (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.rows(); ++n)  FFT (mat.row(n)); }
-    template <typename Derived> FORCE_INLINE void row_iFFT (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.rows(); ++n) iFFT (mat.row(n)); }
-    template <typename Derived> FORCE_INLINE void col_FFT  (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.cols(); ++n)  FFT (mat.col(n)); }
-    template <typename Derived> FORCE_INLINE void col_iFFT (Eigen::MatrixBase<Derived>& mat) { for (auto n = 0; n < mat.cols(); ++n) iFFT (mat.col(n)); }
+    Math::FFT<double> fft;
+    Eigen::MatrixXd im, unrung, shifted, diffs;
+    Eigen::VectorXd TV1, TV2;
+    Eigen::MatrixXcd kspace, kspace1, kspace2, shifted_k;
+    Eigen::VectorXcd line;
+    vector<int> shifts;
+    Eigen::MatrixXcd phases[2];
 
 
 
-    FORCE_INLINE void unring_2d ()
+    // The subvoxel shifts considered, and the corresponding phase ramps to
+    // apply to the non-redundant half of the spectrum along each slice axis
+    void init_shifts ()
     {
-      row_FFT (im1);
-      col_FFT (im1);
+      shifts.resize (2*nsh+1);
+      shifts[0] = 0;
+      for (int j = 0; j < nsh; j++) {
+        shifts[j+1] = j+1;
+        shifts[1+nsh+j] = -(j+1);
+      }
+
+      for (size_t axis = 0; axis != 2; ++axis) {
+        const int n = axis ? im.cols() : im.rows();
+        const int maxn = (n&1) ? (n-1)/2 : n/2-1;
+        // for even n, the Nyquist frequency is removed from all shifted lines
+        phases[axis].setZero (n/2+1, 2*nsh+1);
+        phases[axis].col(0).setOnes();
+        for (int j = 1; j < 2*nsh+1; j++) {
+          double phi = Math::pi*double(shifts[j])/double(n*nsh);
+          cdouble u (std::cos(phi), std::sin(phi));
+          cdouble e (1.0, 0.0);
+          phases[axis](0,j) = e;
+          for (int l = 0; l < maxn; l++) {
+            e = u*e;
+            phases[axis](l+1,j) = e;
+          }
+        }
+      }
+    }
 
-      for (int k = 0; k < im1.cols(); k++) {
-        double ck = (1.0+cos(2.0*Math::pi*(double(k)/im1.cols())))*0.5;
-        for (int j = 0 ; j < im1.rows(); j++) {
-          double cj = (1.0+cos(2.0*Math::pi*(double(j)/im1.rows())))*0.5;
 
+
+    // Since the image is real, its spectrum is conjugate-symmetric; only the
+    // non-redundant half of the spectrum is computed along one of the axes.
+    // Each of the two filtered images is then transformed back along the
+    // axis not being unrung, and remains conjugate-symmetric along the other,
+    // so that all subsequent transforms are complex-to-real.
+    FORCE_INLINE void unring_2d ()
+    {
+      const ssize_t rows = im.rows(), cols = im.cols();
+
+      fft.forward (im, kspace, 1);
+      fft.forward (kspace, kspace, 0);
+
+      // kspace only holds frequencies 0 to cols/2 along the second axis; kspace1
+      // requires all of them (the remainder follow from conjugate symmetry),
+      // but only frequencies 0 to rows/2 along the first axis
+      kspace1.resize (rows/2+1, cols);
+      kspace2.resize (rows, kspace.cols());
+      for (ssize_t c = 0; c < cols; c++) {
+        const bool mirror = c >= kspace.cols();
+        double ck = (1.0+cos(2.0*Math::pi*(double(c)/cols)))*0.5;
+        for (ssize_t j = 0; j < rows; j++) {
+          if (mirror && j > rows/2)
+            continue;
+          double cj = (1.0+cos(2.0*Math::pi*(double(j)/rows)))*0.5;
+          const cdouble value = mirror ? std::conj (kspace ((rows-j)%rows, cols-c)) : kspace (j,c);
+
+          cdouble v1 (0.0, 0.0), v2 (0.0, 0.0);
           if (ck+cj != 0.0) {
-            im2(j,k) = im1(j,k) * cj / (ck+cj);
-            im1(j,k) *= ck / (ck+cj);
+            v1 = value * ck / (ck+cj);
+            v2 = value * cj / (ck+cj);
           }
-          else
-            im1(j,k) = im2(j,k) = cdouble(0.0, 0.0);
+          if (j <= rows/2)
+            kspace1(j,c) = v1;
+          if (!mirror)
+            kspace2(j,c) = v2;
         }
       }
 
-      row_iFFT (im1);
-      col_iFFT (im2);
+      fft.inverse (kspace1, kspace1, 1);
+      fft.inverse (kspace2, kspace2, 0);
 
-      unring_1d (im1);
-      unring_1d (im2.transpose());
+      unring_1d (kspace1, 0, im);
+      unring_1d (kspace2, 1, unrung);
 
-      im1 += im2;
+      im += unrung;
     }
 
 
 
 
 
-    template <typename Derived>
-      FORCE_INLINE void unring_1d (Eigen::MatrixBase<Derived>&& eig)
-      {
-        const int n = eig.rows();
-        const int numlines = eig.cols();
-        shifted.resize (n, 2*nsh+1);
-
-        vector<int> shifts(2*nsh+1);
-        shifts[0] = 0;
-        for (int j = 0; j < nsh; j++) {
-          shifts[j+1] = j+1;
-          shifts[1+nsh+j] = -(j+1);
-        }
-
-        vector<double> TV1arr(2*nsh+1);
-        vector<double> TV2arr(2*nsh+1);
+    // Remove ringing along each line (along the given axis) of an image
+    // provided as the non-redundant half of its spectrum along that axis
+    FORCE_INLINE void unring_1d (const Eigen::MatrixXcd& eig, const size_t axis, Eigen::MatrixXd& result)
+    {
+      const int n = axis ? im.cols() : im.rows();
+      const int numlines = axis ? eig.rows() : eig.cols();
+      if (axis)
+        result.resize (numlines, n);
+      else
+        result.resize (n, numlines);
 
-        for (int k = 0; k < numlines; k++) {
-          shifted.col(0) = eig.col(k);
+      for (int k = 0; k < numlines; k++) {
+        if (axis)
+          line = eig.row(k).transpose();
+        else
+          line = eig.col(k);
 
-          const int maxn = (n&1) ? (n-1)/2 : n/2-1;
+        shifted_k = phases[axis].array().colwise() * line.array();
 
-          for (int j = 1; j < 2*nsh+1; j++) {
-            double phi = Math::pi*double(shifts[j])/double(n*nsh);
-            cdouble u (std::cos(phi), std::sin(phi));
-            cdouble e (1.0, 0.0);
-            shifted(0,j) = shifted(0,0);
+        fft.inverse (shifted_k, shifted, 0, n);
 
-            if (!(n&1))
-              shifted(n/2,j) = cdouble(0.0, 0.0);
+        // absolute differences between neighbouring samples, for all shifts at once:
+        //   column i holds |shifted(i+1) - shifted(i)| (cyclically)
+        diffs.resize (2*nsh+1, n);
+        diffs.leftCols (n-1) = (shifted.bottomRows (n-1) - shifted.topRows (n-1)).cwiseAbs().transpose();
+        diffs.col (n-1) = (shifted.row (0) - shifted.row (n-1)).cwiseAbs().transpose();
 
-            for (int l = 0; l < maxn; l++) {
-              e = u*e;
-              int L = l+1; shifted(L,j) = e * shifted(L,0);
-              L = n-1-l;   shifted(L,j) = std::conj(e) * shifted(L,0);
-            }
-          }
+        TV1.setZero (2*nsh+1);
+        TV2.setZero (2*nsh+1);
+        for (int t = minW; t <= maxW; t++) {
+          TV1 += diffs.col ((n-t-1)%n);
+          TV2 += diffs.col ((n+t)%n);
+        }
 
+        for (int l = 0; l < n; ++l) {
+          ssize_t minidx = 0;
+          TV1.cwiseMin (TV2).minCoeff (&minidx);
 
-          col_iFFT (shifted);
+          TV1 += diffs.col ((l-minW+n)%n);
+          TV1 -= diffs.col ((l-maxW-1+n)%n);
+          TV2 += diffs.col ((l+maxW+1+n)%n);
+          TV2 -= diffs.col ((l+minW+n)%n);
 
-          for (int j = 0; j < 2*nsh+1; ++j) {
-            TV1arr[j] = 0.0;
-            TV2arr[j] = 0.0;
-            for (int t = minW; t <= maxW; t++) {
-              TV1arr[j] += abs (shifted((n-t)%n,j).real() - shifted((n-t-1)%n,j).real());
-              TV1arr[j] += abs (shifted((n-t)%n,j).imag() - shifted((n-t-1)%n,j).imag());
-              TV2arr[j] += abs (shifted((n+t)%n,j).real() - shifted((n+t+1)%n,j).real());
-              TV2arr[j] += abs (shifted((n+t)%n,j).imag() - shifted((n+t+1)%n,j).imag());
-            }
-          }
+          double a0 = shifted((l-1+n)%n,minidx);
+          double a1 = shifted(l,minidx);
+          double a2 = shifted((l+1+n)%n,minidx);
+          double s = double(shifts[minidx])/(2.0*nsh);
 
-          for (int l = 0; l < n; ++l) {
-            double minTV = std::numeric_limits<double>::max();
-            int minidx = 0;
-            for (int j = 0; j < 2*nsh+1; ++j) {
-
-              if (TV1arr[j] < minTV) {
-                minTV = TV1arr[j];
-                minidx = j;
-              }
-              if (TV2arr[j] < minTV) {
-                minTV = TV2arr[j];
-                minidx = j;
-              }
-
-              TV1arr[j] += abs (shifted((l-minW+1+n)%n,j).real() - shifted((l-(minW  )+n)%n,j).real());
-              TV1arr[j] -= abs (shifted((l-maxW  +n)%n,j).real() - shifted((l-(maxW+1)+n)%n,j).real());
-              TV2arr[j] += abs (shifted((l+maxW+1+n)%n,j).real() - shifted((l+(maxW+2)+n)%n,j).real());
-              TV2arr[j] -= abs (shifted((l+minW  +n)%n,j).real() - shifted((l+(minW+1)+n)%n,j).real());
-
-              TV1arr[j] += abs (shifted((l-minW+1+n)%n,j).imag() - shifted((l-(minW  )+n)%n,j).imag());
-              TV1arr[j] -= abs (shifted((l-maxW  +n)%n,j).imag() - shifted((l-(maxW+1)+n)%n,j).imag());
-              TV2arr[j] += abs (shifted((l+maxW+1+n)%n,j).imag() - shifted((l+(maxW+2)+n)%n,j).imag());
-              TV2arr[j] -= abs (shifted((l+minW  +n)%n,j).imag() - shifted((l+(minW+1)+n)%n,j).imag());
-            }
-
-            double a0r = shifted((l-1+n)%n,minidx).real();
-            double a1r = shifted(l,minidx).real();
-            double a2r = shifted((l+1+n)%n,minidx).real();
-            double a0i = shifted((l-1+n)%n,minidx).imag();
-            double a1i = shifted(l,minidx).imag();
-            double a2i = shifted((l+1+n)%n,minidx).imag();
-            double s = double(shifts[minidx])/(2.0*nsh);
-
-            if (s > 0.0)
-              eig(l,k) = cdouble (a1r*(1.0-s) + a0r*s, a1i*(1.0-s) + a0i*s);
-            else
-              eig(l,k) = cdouble (a1r*(1.0+s) - a2r*s, a1i*(1.0+s) - a2i*s);
-          }
+          double& value = axis ? result(k,l) : result(l,k);
+          if (s > 0.0)
+            value = a1*(1.0-s) + a0*s;
+          else
+            value = a1*(1.0+s) - a2*s;
         }
       }
-
-    template <typename Derived>
-      FORCE_INLINE void unring_1d (Eigen::MatrixBase<Derived>& eig) { unring_1d (std::move (eig)); }
+    }
 
 };
 
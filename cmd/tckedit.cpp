@@ -216,9 +216,20 @@ void run ()
   const size_t number = get_option_value ("number", size_t(0));
   const size_t skip   = get_option_value ("skip",   size_t(0));
 
-  Loader loader (input_file_list);
+  // If no streamline can be rejected, the streamlines to be skipped can be
+  //   bypassed directly by the loader, rather than read and discarded; note
+  //   that input weights are always subject to an implicit minimum of zero
+  const bool select_all = !inverse && !get_options ("tck_weights_in").size() &&
+                          !properties.include.size() && !properties.ordered_include.size() &&
+                          !properties.exclude.size() && !properties.mask.size() &&
+                          properties.find ("min_dist") == properties.end() &&
+                          properties.find ("max_dist") == properties.end() &&
+                          properties.find ("min_weight") == properties.end() &&
+                          properties.find ("max_weight") == properties.end();
+
+  Loader loader (input_file_list, select_all ? skip : 0);
   Worker worker (properties, inverse, ends_only);
-  Receiver receiver (output_path, properties, number, skip);
+  Receiver receiver (output_path, properties, number, select_all ? 0 : skip);
 
   Thread::run_ordered_queue (
       loader,
@@ -244,6 +244,18 @@ MapWriterBase* make_writer (Header& H, const std::string& name, const vox_stat_t
 
 
 
+template <class MapperType, class Cont>
+void map_tracks (TrackLoader& loader, MapperType& mapper, MapWriterBase& writer)
+{
+  if (writer.use_private_buffers (Thread::threads_to_execute()))
+    Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (MapAccumulator<MapperType, Cont> (mapper, writer)));
+  else
+    Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (mapper), Thread::batch (Cont()), writer);
+}
+
+
+
+
 
 
 
@@ -611,18 +623,18 @@ void run () {
     mapper_ptr->set_gaussian_FWHM (gaussian_fwhm_tck);
     switch (writer_type) {
       case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
-      case GREYSCALE: Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxel()),    *writer); break;
-      case DEC:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelDEC()), *writer); break;
-      case DIXEL:     Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetDixel()),    *writer); break;
-      case TOD:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper_ptr), Thread::batch (Gaussian::SetVoxelTOD()), *writer); break;
+      case GREYSCALE: map_tracks<Gaussian::TrackMapper, Gaussian::SetVoxel>    (loader, *mapper_ptr, *writer); break;
+      case DEC:       map_tracks<Gaussian::TrackMapper, Gaussian::SetVoxelDEC> (loader, *mapper_ptr, *writer); break;
+      case DIXEL:     map_tracks<Gaussian::TrackMapper, Gaussian::SetDixel>    (loader, *mapper_ptr, *writer); break;
+      case TOD:       map_tracks<Gaussian::TrackMapper, Gaussian::SetVoxelTOD> (loader, *mapper_ptr, *writer); break;
     }
   } else {
     switch (writer_type) {
       case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
-      case GREYSCALE: Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper), Thread::batch (SetVoxel()),    *writer); break;
-      case DEC:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper), Thread::batch (SetVoxelDEC()), *writer); break;
-      case DIXEL:     Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper), Thread::batch (SetDixel()),    *writer); break;
-      case TOD:       Thread::run_queue (loader, Thread::batch (Tractography::Streamline<float>()), Thread::multi (*mapper), Thread::batch (SetVoxelTOD()), *writer); break;
+      case GREYSCALE: map_tracks<TrackMapperTWI, SetVoxel>    (loader, *mapper, *writer); break;
+      case DEC:       map_tracks<TrackMapperTWI, SetVoxelDEC> (loader, *mapper, *writer); break;
+      case DIXEL:     map_tracks<TrackMapperTWI, SetDixel>    (loader, *mapper, *writer); break;
+      case TOD:       map_tracks<TrackMapperTWI, SetVoxelTOD> (loader, *mapper, *writer); break;
     }
   }
 
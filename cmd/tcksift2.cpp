@@ -128,7 +128,9 @@ void usage ()
   ARGUMENTS
   + Argument ("in_tracks",   "the input track file").type_tracks_in()
   + Argument ("in_fod",      "input image containing the spherical harmonics of the fibre orientation distributions").type_image_in()
-  + Argument ("out_weights", "output text file containing the weighting factor for each streamline").type_file_out();
+  + Argument ("out_weights", "output file containing the weighting factor for each streamline; "
+                             "this will be written in binary form if the path has the .tsw suffix, "
+                             "and as a text file otherwise").type_file_out();
 
   OPTIONS
 
@@ -83,6 +83,20 @@ namespace MR
             else parent().index (a) += increment;
           }
 
+          //! row access, available if supported by the parent image
+          /*! Rows along non-existent axes contain a single voxel, in which
+           * case the axis passed to the parent is irrelevant. */
+          template <class T = ImageType>
+            auto get_values (size_t axis, size_t count, value_type* dest) const
+            -> decltype (std::declval<const T&>().get_values (axis, count, dest)) {
+              parent().get_values (std::max (axes_[axis], 0), count, dest);
+            }
+          template <class T = ImageType>
+            auto set_values (size_t axis, size_t count, const value_type* src)
+            -> decltype (std::declval<T&>().set_values (axis, count, src)) {
+              parent().set_values (std::max (axes_[axis], 0), count, src);
+            }
+
         private:
           vector<int> axes_;
           vector<size_t> non_existent_axes;
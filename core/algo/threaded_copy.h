@@ -32,6 +32,109 @@ namespace MR
         }
     };
 
+
+
+    // images providing get_values() / set_values() can be copied a row at a time:
+    template <class ImageType>
+      struct __has_row_access { NOMEMALIGN
+        template <class T>
+          static auto check (T* image) -> decltype (image->get_values (size_t(), size_t(), (typename T::value_type*) nullptr),
+                                                    image->set_values (size_t(), size_t(), (const typename T::value_type*) nullptr),
+                                                    std::true_type());
+        template <class T>
+          static std::false_type check (...);
+        static constexpr bool value = decltype (check<ImageType> (nullptr))::value && is_data_type<typename ImageType::value_type>::value;
+      };
+
+    // per-thread scratch space for a single row:
+    template <typename ValueType>
+      class __row_buffer { NOMEMALIGN
+        public:
+          __row_buffer () : size (0) { }
+          __row_buffer (const __row_buffer&) : size (0) { }
+          ValueType* operator() (size_t count) {
+            if (count > size) {
+              data.reset (new ValueType [count]);
+              size = count;
+            }
+            return data.get();
+          }
+        private:
+          std::unique_ptr<ValueType[]> data;
+          size_t size;
+      };
+
+    template <class InputImageType, class OutputImageType>
+      class __copy_row_func { NOMEMALIGN
+        public:
+          using input_value_type = typename InputImageType::value_type;
+          using output_value_type = typename OutputImageType::value_type;
+
+          __copy_row_func (const vector<size_t>& outer_axes, const vector<size_t>& inner_axes,
+              const InputImageType& in, const OutputImageType& out) :
+            in (in), out (out),
+            outer_axes (outer_axes),
+            remaining_axes (inner_axes.begin()+1, inner_axes.end()),
+            axis (inner_axes[0]) { }
+
+          void operator() (const Iterator& pos) {
+            assign_pos_of (pos, outer_axes).to (in, out);
+            in.index (axis) = 0;
+            out.index (axis) = 0;
+            if (remaining_axes.empty())
+              copy_row();
+            else {
+              for (auto l = Loop (remaining_axes) (in, out); l; ++l)
+                copy_row();
+            }
+          }
+
+        private:
+          InputImageType in;
+          OutputImageType out;
+          const vector<size_t>& outer_axes;
+          const vector<size_t> remaining_axes;
+          const size_t axis;
+          __row_buffer<input_value_type> in_row;
+          __row_buffer<output_value_type> out_row;
+
+          template <class T = output_value_type>
+            typename std::enable_if<std::is_same<input_value_type, T>::value, void>::type copy_row () {
+              const size_t count = in.size (axis);
+              T* row = out_row (count);
+              in.get_values (axis, count, row);
+              out.set_values (axis, count, row);
+            }
+
+          template <class T = output_value_type>
+            typename std::enable_if<!std::is_same<input_value_type, T>::value, void>::type copy_row () {
+              const size_t count = in.size (axis);
+              input_value_type* src = in_row (count);
+              T* dest = out_row (count);
+              in.get_values (axis, count, src);
+              for (size_t n = 0; n < count; ++n)
+                dest[n] = src[n];
+              out.set_values (axis, count, dest);
+            }
+      };
+
+
+
+    template <class LoopType, class InputImageType, class OutputImageType>
+      inline typename std::enable_if<__has_row_access<InputImageType>::value && __has_row_access<OutputImageType>::value, void>::type
+      __run_copy (LoopType&& loop, InputImageType& source, OutputImageType& destination)
+      {
+        loop.run_outer (__copy_row_func<InputImageType,OutputImageType> (loop.outer_loop.axes, loop.inner_axes, source, destination));
+        check_app_exit_code();
+      }
+
+    template <class LoopType, class InputImageType, class OutputImageType>
+      inline typename std::enable_if<!(__has_row_access<InputImageType>::value && __has_row_access<OutputImageType>::value), void>::type
+      __run_copy (LoopType&& loop, InputImageType& source, OutputImageType& destination)
+      {
+        loop.run (__copy_func(), source, destination);
+      }
+
   }
 
   //! \endcond
@@ -46,8 +149,7 @@ namespace MR
         const vector<size_t>& axes,
         size_t num_axes_in_thread = 1) 
     {
-      ThreadedLoop (source, axes, num_axes_in_thread)
-        .run (__copy_func(), source, destination);
+      __run_copy (ThreadedLoop (source, axes, num_axes_in_thread), source, destination);
     }
 
   template <class InputImageType, class OutputImageType>
@@ -58,8 +160,7 @@ namespace MR
         size_t to_axis = std::numeric_limits<size_t>::max(),
         size_t num_axes_in_thread = 1)
     {
-      ThreadedLoop (source, from_axis, to_axis, num_axes_in_thread)
-        .run (__copy_func(), source, destination);
+      __run_copy (ThreadedLoop (source, from_axis, to_axis, num_axes_in_thread), source, destination);
     }
 
 
@@ -73,8 +174,7 @@ namespace MR
         const vector<size_t>& axes,
         size_t num_axes_in_thread = 1)
     {
-      ThreadedLoop (message, source, axes, num_axes_in_thread)
-        .run (__copy_func(), source, destination);
+      __run_copy (ThreadedLoop (message, source, axes, num_axes_in_thread), source, destination);
     }
 
   template <class InputImageType, class OutputImageType>
@@ -86,8 +186,7 @@ namespace MR
         size_t to_axis = std::numeric_limits<size_t>::max(), 
         size_t num_axes_in_thread = 1)
     {
-      ThreadedLoop (message, source, from_axis, to_axis, num_axes_in_thread)
-        .run (__copy_func(), source, destination);
+      __run_copy (ThreadedLoop (message, source, from_axis, to_axis, num_axes_in_thread), source, destination);
     }
 
 
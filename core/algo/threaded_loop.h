@@ -20,6 +20,7 @@
 #include "debug.h"
 #include "algo/loop.h"
 #include "algo/iterator.h"
+#include "algo/threaded_loop_scheduler.h"
 #include "thread.h"
 
 namespace MR
@@ -59,11 +60,13 @@ namespace MR
    * been set to the z and volume axes (i.e. axes 2 & 3). Each thread will do
    * the following:
    *
-   * 1. lock the loop mutex, obtain a new set of z & volume coordinates, then
-   *    release the mutex so other threads can obtain their own unique set of
-   *    coordinates to process;
-   * 2. set the position of all `ImageType` classes to be processed according
-   *    to these coordinates;
+   * 1. obtain a new chunk of z & volume coordinates to process from the
+   *    ThreadedLoopScheduler. Each thread is initially assigned its own
+   *    contiguous block of coordinates, from which it claims chunks without
+   *    locking; once this is exhausted, it steals part of the remaining block
+   *    of another thread;
+   * 2. for each set of coordinates in the chunk, set the position of all
+   *    `ImageType` classes to be processed according to these coordinates;
    * 3. iterate over the x & y axes, invoking the user-supplied functor each
    *    time;
    * 4. repeat from step 1 until all the data have been processed.
@@ -312,6 +315,15 @@ namespace MR
         loop->progress.run_update_thread (*threads);
       }
 
+      inline void __update_progress (...) { }
+      template <class LoopType>
+        inline auto __update_progress (LoopType* loop, size_t count)
+        -> decltype((void) (&loop->progress), void())
+      {
+        while (count--)
+          ++loop->progress;
+      }
+
 
     template <class OuterLoopType>
       struct ThreadedLoopRunOuter { MEMALIGN(ThreadedLoopRunOuter<OuterLoopType>)
@@ -329,6 +341,7 @@ namespace MR
               return;
             }
 
+            const size_t num_threads = Thread::threads_to_execute();
             std::mutex mutex;
             ProgressBar::SwitchToMultiThreaded progress_functions;
 
@@ -336,28 +349,50 @@ namespace MR
               Iterator& iterator;
               decltype (outer_loop (iterator)) loop;
               std::mutex& mutex;
-              FORCE_INLINE bool next (Iterator& pos) {
+              ThreadedLoopScheduler scheduler;
+              FORCE_INLINE void done (size_t count) {
                 std::lock_guard<std::mutex> lock (mutex);
-                if (loop) {
-                  assign_pos_of (iterator, loop.axes).to (pos);
-                  ++loop;
-                  return true;
-                }
-                else return false;
+                __update_progress (&loop, count);
               }
-            } shared = { iterator, outer_loop (iterator), mutex };
+            } shared = { iterator, outer_loop (iterator), mutex,
+              { size_t (voxel_count (iterator, outer_loop.axes)), num_threads } };
 
             struct PerThread { MEMALIGN(PerThread)
               Shared& shared;
               Iterator pos;
               typename std::remove_reference<Functor>::type func;
               void execute () {
-                while (shared.next (pos))
-                  func (pos);
+                const vector<size_t>& axes (shared.loop.axes);
+                const size_t worker = shared.scheduler.register_worker();
+                size_t begin, end;
+                while (shared.scheduler.next (worker, begin, end)) {
+                  set_position (axes, begin);
+                  for (size_t n = begin; n < end; ++n) {
+                    func (pos);
+                    increment (axes);
+                  }
+                  shared.done (end - begin);
+                }
+              }
+
+              // convert linear index into position along outer axes:
+              FORCE_INLINE void set_position (const vector<size_t>& axes, size_t index) {
+                for (auto axis : axes) {
+                  pos.index (axis) = index % pos.size (axis);
+                  index /= pos.size (axis);
+                }
+              }
+
+              FORCE_INLINE void increment (const vector<size_t>& axes) {
+                for (auto axis : axes) {
+                  if (++pos.index (axis) < pos.size (axis))
+                    return;
+                  pos.index (axis) = 0;
+                }
               }
             } loop_thread = { shared, shared.iterator, functor };
 
-            auto threads = Thread::run (Thread::multi (loop_thread), "loop threads");
+            auto threads = Thread::run (Thread::multi (loop_thread, num_threads), "loop threads");
 
             __manage_progress (&shared.loop, &threads);
             threads.wait();
@@ -0,0 +1,184 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __algo_threaded_loop_scheduler_h__
+#define __algo_threaded_loop_scheduler_h__
+
+#include <atomic>
+
+#include "types.h"
+#include "spinlock.h"
+
+namespace MR
+{
+
+  /** \addtogroup thread_classes
+   * @{ */
+
+  //! distribute a linear range of indices over a set of worker threads
+  /*! This class hands out contiguous chunks of the index range [0, \a total)
+   * to \a num_workers threads, using a work-stealing scheme:
+   *
+   * - the range is initially split into one contiguous block per worker;
+   *
+   * - each worker claims chunks from the front of its own block using a
+   *   single atomic operation, with no locking in the common case. The size of
+   *   each chunk is proportional to the amount of work remaining in the
+   *   block, so chunks are large at the start and shrink towards the end;
+   *
+   * - once its own block is exhausted, a worker steals the back half of the
+   *   remaining range of another worker, and carries on from there.
+   *
+   * The only lock involved (a spinlock per worker) is taken when stealing, or
+   * when the owner of a block races with a thief for the last few indices.
+   *
+   * This is used by ThreadedLoop() to dispatch outer-axis positions to its
+   * threads. Each worker must be identified by a unique index in
+   * [0, num_workers), and that index must only be used by one thread at a
+   * time. */
+  class ThreadedLoopScheduler { NOMEMALIGN
+    public:
+      ThreadedLoopScheduler (size_t total, size_t num_workers) :
+        slots (std::max (num_workers, size_t(1))),
+        max_chunk (std::max (total / 100, size_t(1))),
+        next_worker (0)
+      {
+        const size_t N = slots.size();
+        for (size_t n = 0; n < N; ++n) {
+          slots[n].head.store ((total * n) / N, std::memory_order_relaxed);
+          slots[n].tail.store ((total * (n+1)) / N, std::memory_order_relaxed);
+        }
+      }
+
+      //! obtain a unique worker index for the calling thread
+      size_t register_worker () {
+        const size_t worker = next_worker++;
+        assert (worker < slots.size());
+        return worker;
+      }
+
+      //! claim the next chunk of indices [\a begin, \a end) for \a worker
+      /*! \returns false once no more work is available. */
+      bool next (size_t worker, size_t& begin, size_t& end)
+      {
+        Slot& own (slots[worker]);
+        if (take (own, begin, end))
+          return true;
+
+        // own block exhausted: steal from other workers until none are left
+        // with any remaining work
+        bool contended = true;
+        while (contended) {
+          contended = false;
+          for (size_t n = 1; n < slots.size(); ++n) {
+            size_t from, to;
+            switch (steal (slots[(worker+n) % slots.size()], from, to)) {
+              case steal_result::empty: break;
+              case steal_result::contended: contended = true; break;
+              case steal_result::success:
+                {
+                  std::lock_guard<SpinLock> lock (own.lock);
+                  own.head.store (from);
+                  own.tail.store (to);
+                }
+                if (take (own, begin, end))
+                  return true;
+                contended = true;
+                break;
+            }
+          }
+        }
+        return false;
+      }
+
+    protected:
+      enum class steal_result { empty, contended, success };
+
+      struct Slot { NOMEMALIGN
+        std::atomic<size_t> head, tail;
+        SpinLock lock;
+        // avoid false sharing between the slots of different workers:
+        char padding[64];
+      };
+
+      vector<Slot> slots;
+      const size_t max_chunk;
+      std::atomic<size_t> next_worker;
+
+
+      size_t chunk_size (const Slot& slot) const
+      {
+        const size_t head = slot.head.load (std::memory_order_relaxed);
+        const size_t tail = slot.tail.load (std::memory_order_relaxed);
+        if (head >= tail)
+          return 1;
+        return std::min (std::max ((tail - head) / 4, size_t(1)), max_chunk);
+      }
+
+
+      // owner side: claim chunk from the front of its own block
+      bool take (Slot& slot, size_t& begin, size_t& end)
+      {
+        const size_t chunk = chunk_size (slot);
+        const size_t head = slot.head.fetch_add (chunk);
+        const size_t tail = slot.tail.load();
+        if (head + chunk <= tail) {
+          begin = head;
+          end = head + chunk;
+          return true;
+        }
+
+        // potential race with a thief: resolve under lock
+        std::lock_guard<SpinLock> lock (slot.lock);
+        const size_t current_tail = slot.tail.load();
+        if (head >= current_tail) {
+          slot.head.store (current_tail);
+          return false;
+        }
+        begin = head;
+        end = std::min (head + chunk, current_tail);
+        slot.head.store (end);
+        return true;
+      }
+
+
+      // thief side: claim back half of the remaining range of another worker
+      steal_result steal (Slot& victim, size_t& begin, size_t& end)
+      {
+        std::lock_guard<SpinLock> lock (victim.lock);
+        const size_t tail = victim.tail.load();
+        size_t head = victim.head.load();
+        if (head >= tail)
+          return steal_result::empty;
+        const size_t new_tail = tail - (tail - head + 1) / 2;
+        victim.tail.store (new_tail);
+        head = victim.head.load();
+        if (head > new_tail) {
+          // owner has claimed part of that range in the meantime:
+          victim.tail.store (tail);
+          return steal_result::contended;
+        }
+        begin = new_tail;
+        end = tail;
+        return steal_result::success;
+      }
+  };
+
+  //! @}
+}
+
+#endif
+
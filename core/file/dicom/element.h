@@ -17,6 +17,7 @@
 #ifndef __file_dicom_element_h__
 #define __file_dicom_element_h__
 
+#include <mutex>
 #include <unordered_map>
 
 #include "memory.h"
@@ -123,9 +124,10 @@ namespace MR {
           }
 
           std::string tag_name () const {
-            if (dict.empty()) init_dict();
-            const char* s = dict[tag()];
-            return (s ? s : "");
+            // DICOM files may be scanned concurrently (see Tree::read):
+            std::call_once (dict_initialised, init_dict);
+            const auto entry = dict.find (tag());
+            return (entry != dict.end() && entry->second ? entry->second : "");
           }
 
           uint32_t tag () const {
@@ -206,6 +208,7 @@ namespace MR {
           }
 
           static std::unordered_map<uint32_t, const char*> dict;
+          static std::once_flag dict_initialised;
           static void init_dict();
 
           bool check_get (size_t idx, size_t size) const { if (idx >= size) { error_in_get (idx); return false; } return true; }
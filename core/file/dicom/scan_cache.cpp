@@ -0,0 +1,265 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "raw.h"
+#include "file/config.h"
+#include "file/path.h"
+#include "file/dicom/scan_cache.h"
+
+#define MRTRIX_DICOM_SCAN_CACHE_MAGIC "mrtrix DICOM scan cache\n"
+#define MRTRIX_DICOM_SCAN_CACHE_VERSION 2
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      namespace {
+
+        template <typename ValueType>
+          inline void write_value (std::ostream& out, ValueType value)
+          {
+            value = ByteOrder::LE (value);
+            out.write (reinterpret_cast<const char*> (&value), sizeof (ValueType));
+          }
+
+        inline void write_string (std::ostream& out, const std::string& value)
+        {
+          write_value<uint32_t> (out, value.size());
+          out.write (value.data(), value.size());
+        }
+
+        template <typename ValueType>
+          inline ValueType read_value (std::istream& in)
+          {
+            ValueType value;
+            if (!in.read (reinterpret_cast<char*> (&value), sizeof (ValueType)))
+              throw Exception ("unexpected end of file");
+            return ByteOrder::LE (value);
+          }
+
+        inline std::string read_string (std::istream& in)
+        {
+          std::string value (read_value<uint32_t> (in), '\0');
+          if (!in.read (&value[0], value.size()))
+            throw Exception ("unexpected end of file");
+          return value;
+        }
+
+
+
+        void write_entry (std::ostream& out, const std::string& path, const ScanCache::Entry& entry)
+        {
+          write_string (out, path);
+          write_value<int64_t> (out, entry.mtime);
+          write_value<int64_t> (out, entry.size);
+          write_value<uint8_t> (out, entry.is_image);
+          if (!entry.is_image)
+            return;
+
+          // patient identifiers are deliberately not stored (see Tree::read_dir())
+          const QuickScan& scan (entry.scan);
+          for (const auto* value : { &scan.modality,
+              &scan.study, &scan.study_ID, &scan.study_UID, &scan.study_date, &scan.study_time,
+              &scan.series, &scan.series_ref_UID, &scan.series_date, &scan.series_time, &scan.sequence })
+            write_string (out, *value);
+          write_value<uint32_t> (out, scan.image_type.size());
+          for (const auto& type : scan.image_type) {
+            write_string (out, type.first);
+            write_value<uint64_t> (out, type.second);
+          }
+          for (const auto value : { scan.series_number, scan.bits_alloc, scan.dim[0], scan.dim[1], scan.data })
+            write_value<uint64_t> (out, value);
+          write_value<uint8_t> (out, scan.transfer_syntax_supported);
+        }
+
+
+
+        std::string read_entry (std::istream& in, ScanCache::Entry& entry)
+        {
+          std::string path = read_string (in);
+          entry.mtime = read_value<int64_t> (in);
+          entry.size = read_value<int64_t> (in);
+          entry.is_image = read_value<uint8_t> (in);
+          if (!entry.is_image)
+            return path;
+
+          QuickScan& scan (entry.scan);
+          scan.filename = path;
+          for (auto* value : { &scan.modality,
+              &scan.study, &scan.study_ID, &scan.study_UID, &scan.study_date, &scan.study_time,
+              &scan.series, &scan.series_ref_UID, &scan.series_date, &scan.series_time, &scan.sequence })
+            *value = read_string (in);
+          for (uint32_t n = read_value<uint32_t> (in); n > 0; --n) {
+            const std::string type = read_string (in);
+            scan.image_type[type] = read_value<uint64_t> (in);
+          }
+          for (auto* value : { &scan.series_number, &scan.bits_alloc, &scan.dim[0], &scan.dim[1], &scan.data })
+            *value = read_value<uint64_t> (in);
+          scan.transfer_syntax_supported = read_value<uint8_t> (in);
+          return path;
+        }
+
+      }
+
+
+
+
+      //CONF option: DicomScanCache
+      //CONF default: (none)
+      //CONF The path to a file in which to store the results of scanning
+      //CONF DICOM files, so that subsequent scans of the same files
+      //CONF (e.g. when repeatedly accessing the same DICOM folder) can skip
+      //CONF parsing their headers. Cached entries are invalidated if the
+      //CONF size or modification time of the corresponding file changes.
+      //CONF If not set, no cache is used. Patient names, IDs and dates of
+      //CONF birth are not stored in the cache (they are read afresh from one
+      //CONF file of each study); it does however hold the full path of each
+      //CONF file, along with study & series descriptions, dates, times and
+      //CONF UIDs, and so should be protected accordingly.
+      ScanCache::ScanCache () :
+        filename (File::Config::get ("DicomScanCache")),
+        modified (false)
+      {
+        if (enabled())
+          load();
+      }
+
+
+
+      void ScanCache::load ()
+      {
+        std::ifstream in (filename, std::ios_base::in | std::ios_base::binary);
+        if (!in)
+          return;
+
+        try {
+          std::string magic (strlen (MRTRIX_DICOM_SCAN_CACHE_MAGIC), '\0');
+          in.read (&magic[0], magic.size());
+          if (magic != MRTRIX_DICOM_SCAN_CACHE_MAGIC)
+            throw Exception ("invalid header");
+          if (read_value<uint32_t> (in) != MRTRIX_DICOM_SCAN_CACHE_VERSION)
+            throw Exception ("unsupported version");
+
+          for (uint64_t n = read_value<uint64_t> (in); n > 0; --n) {
+            Entry entry;
+            const std::string path = read_entry (in, entry);
+            previous[path] = std::move (entry);
+          }
+          DEBUG ("loaded " + str(previous.size()) + " entries from DICOM scan cache \"" + filename + "\"");
+        }
+        catch (Exception& E) {
+          WARN ("error reading DICOM scan cache \"" + filename + "\" (" + E[0] + ") - cache will be regenerated");
+          previous.clear();
+          modified = true;
+        }
+      }
+
+
+
+      bool ScanCache::stat (const std::string& path, Entry& entry)
+      {
+        struct stat buf;
+        if (::stat (path.c_str(), &buf))
+          return false;
+        entry.mtime = buf.st_mtime;
+        entry.size = buf.st_size;
+        return true;
+      }
+
+
+
+      bool ScanCache::find (const std::string& path, Entry& entry) const
+      {
+        const auto cached = previous.find (path);
+        if (cached == previous.end() ||
+            cached->second.mtime != entry.mtime ||
+            cached->second.size != entry.size)
+          return false;
+        entry = cached->second;
+        return true;
+      }
+
+
+
+      void ScanCache::insert (const std::string& path, Entry&& entry)
+      {
+        if (!modified) {
+          const auto cached = previous.find (path);
+          if (cached == previous.end() ||
+              cached->second.mtime != entry.mtime ||
+              cached->second.size != entry.size)
+            modified = true;
+        }
+        current[path] = std::move (entry);
+      }
+
+
+
+      void ScanCache::save (const std::string& root)
+      {
+        if (!enabled())
+          return;
+
+        // retain entries from outside the folder scanned; drop any others
+        // that were not encountered during this scan:
+        const std::string prefix = Path::join (root, "");
+        for (auto& entry : previous) {
+          if (current.find (entry.first) != current.end())
+            continue;
+          if (entry.first.compare (0, prefix.size(), prefix) == 0 || entry.first == root)
+            modified = true;
+          else
+            current.insert (std::move (entry));
+        }
+        previous.clear();
+
+        if (!modified)
+          return;
+
+        // write to a temporary file, then move it into place, so that
+        // concurrent invocations never encounter a partially written cache:
+        const std::string temp_filename = filename + "." + str(getpid()) + ".tmp";
+        {
+          std::ofstream out (temp_filename, std::ios_base::out | std::ios_base::binary);
+          out.write (MRTRIX_DICOM_SCAN_CACHE_MAGIC, strlen (MRTRIX_DICOM_SCAN_CACHE_MAGIC));
+          write_value<uint32_t> (out, MRTRIX_DICOM_SCAN_CACHE_VERSION);
+          write_value<uint64_t> (out, current.size());
+          for (const auto& entry : current)
+            write_entry (out, entry.first, entry.second);
+          if (!out) {
+            WARN ("error writing DICOM scan cache \"" + filename + "\": " + strerror (errno));
+            out.close();
+            std::remove (temp_filename.c_str());
+            return;
+          }
+        }
+        if (std::rename (temp_filename.c_str(), filename.c_str())) {
+          WARN ("error updating DICOM scan cache \"" + filename + "\": " + strerror (errno));
+          std::remove (temp_filename.c_str());
+          return;
+        }
+        modified = false;
+        DEBUG ("saved " + str(current.size()) + " entries to DICOM scan cache \"" + filename + "\"");
+      }
+
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_dicom_scan_cache_h__
+#define __file_dicom_scan_cache_h__
+
+#include <map>
+
+#include "types.h"
+#include "file/dicom/quick_scan.h"
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      //! a persistent record of the results of QuickScan::read()
+      /*! If the DicomScanCache config file option is set, the results of
+       * scanning each DICOM file are stored in the file it specifies, keyed
+       * by the full path of the DICOM file along with its size and
+       * modification time. Subsequent scans of the same files can then skip
+       * parsing their headers altogether, as long as the files have not been
+       * modified in the meantime. Patient identifiers (name, ID and date of
+       * birth) are not stored; Tree::read_dir() recovers these by scanning
+       * one file of each study. */
+      class ScanCache { NOMEMALIGN
+        public:
+          class Entry { NOMEMALIGN
+            public:
+              Entry () : mtime (0), size (0), is_image (false) { }
+              int64_t mtime, size;
+              bool is_image;
+              QuickScan scan;
+          };
+
+          //! load the cache file, if one is specified in the config file
+          ScanCache ();
+
+          bool enabled () const { return filename.size(); }
+
+          //! the current modification time and size of the file at \a path
+          /*! returns false if the file could not be queried. */
+          static bool stat (const std::string& path, Entry& entry);
+
+          //! retrieve the scan results for \a path
+          /*! On input, \a entry should hold the current modification time and
+           * size of the file (as obtained from stat()); returns true and fills
+           * in the scan results if they are held in the cache and are still
+           * valid. This does not modify the cache, and so can be called
+           * concurrently from multiple threads. */
+          bool find (const std::string& path, Entry& entry) const;
+
+          //! record the scan results for \a path
+          void insert (const std::string& path, Entry&& entry);
+
+          //! write the cache back to file if it has been modified
+          /*! Any previously cached entries for files within the folder \a
+           * root that have not been inserted since construction are assumed to
+           * refer to files that no longer exist, and are discarded. */
+          void save (const std::string& root);
+
+        protected:
+          std::string filename;
+          std::map<std::string, Entry> previous, current;
+          bool modified;
+
+          void load ();
+      };
+
+    }
+  }
+}
+
+#endif
+
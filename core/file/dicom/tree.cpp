@@ -14,9 +14,11 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include "thread_queue.h"
 #include "file/path.h"
 #include "file/dicom/element.h"
 #include "file/dicom/quick_scan.h"
+#include "file/dicom/scan_cache.h"
 #include "file/dicom/image.h"
 #include "file/dicom/series.h"
 #include "file/dicom/study.h"
@@ -54,7 +56,79 @@ namespace MR {
 
 
 
-      void Tree::read_dir (const std::string& filename, ProgressBar& progress)
+      namespace {
+
+        // returns true if the file contains image data that can be
+        // added to the tree:
+        bool scan_file (const std::string& filename, QuickScan& reader)
+        {
+          if (reader.read (filename)) {
+            INFO ("error reading file \"" + filename + "\" - ignored");
+            return false;
+          }
+
+          if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
+            INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored");
+            return false;
+          }
+
+          return true;
+        }
+
+
+
+        class Scanner { NOMEMALIGN
+          public:
+            enum Status : uint8_t { Failed, Scanned, Cached };
+
+            Scanner (const vector<std::string>& files, const std::string& cache_prefix, const ScanCache& cache,
+                vector<ScanCache::Entry>& entries, vector<uint8_t>& status) :
+              files (files),
+              cache_prefix (cache_prefix),
+              cache (cache),
+              entries (entries),
+              status (status) { }
+
+            std::string cache_key (size_t n) const {
+              return cache_prefix.size() ? Path::join (cache_prefix, files[n]) : files[n];
+            }
+
+            bool operator() (const size_t& n) {
+              ScanCache::Entry& entry (entries[n]);
+              if (cache.enabled()) {
+                const std::string key = cache_key (n);
+                if (!ScanCache::stat (key, entry))
+                  return true;
+                if (cache.find (key, entry)) {
+                  entry.scan.filename = files[n];
+                  status[n] = Cached;
+                  return true;
+                }
+              }
+              try {
+                entry.is_image = scan_file (files[n], entry.scan);
+                status[n] = Scanned;
+              }
+              catch (Exception& E) {
+                E.display (3);
+              }
+              return true;
+            }
+
+          protected:
+            const vector<std::string>& files;
+            const std::string& cache_prefix;
+            const ScanCache& cache;
+            vector<ScanCache::Entry>& entries;
+            vector<uint8_t>& status;
+        };
+
+      }
+
+
+
+
+      void Tree::list_dir (const std::string& filename, vector<std::string>& files, ProgressBar& progress)
       {
         try {
           Path::Dir folder (filename);
@@ -62,15 +136,9 @@ namespace MR {
           while ((entry = folder.read_name()).size()) {
             std::string name (Path::join (filename, entry));
             if (Path::is_dir (name))
-              read_dir (name, progress);
-            else {
-              try {
-                read_file (name);
-              }
-              catch (Exception& E) {
-                E.display (3);
-              }
-            }
+              list_dir (name, files, progress);
+            else
+              files.push_back (name);
             ++progress;
           }
         }
@@ -83,19 +151,96 @@ namespace MR {
 
 
 
-      void Tree::read_file (const std::string& filename)
+      void Tree::read_dir (const std::string& filename)
       {
-        QuickScan reader;
-        if (reader.read (filename)) {
-          INFO ("error reading file \"" + filename + "\" - ignored");
-          return;
+        vector<std::string> files;
+        {
+          ProgressBar progress ("scanning folder \"" + shorten (filename) + "\" for DICOM data", 0);
+          list_dir (filename, files, progress);
+        }
+
+        // the cache is keyed by absolute path:
+        ScanCache cache;
+        const std::string cache_prefix = cache.enabled() && !Path::is_absolute (filename) ? Path::cwd() : std::string();
+
+        // parse the headers of all files concurrently:
+        vector<ScanCache::Entry> entries (files.size());
+        vector<uint8_t> status (files.size(), Scanner::Failed);
+        Scanner scanner (files, cache_prefix, cache, entries, status);
+        {
+          ProgressBar progress ("reading DICOM headers", files.size());
+          size_t next = 0;
+          auto source = [&] (size_t& n) {
+            if (next >= files.size())
+              return false;
+            n = next++;
+            ++progress;
+            return true;
+          };
+          Thread::run_queue (source, Thread::batch (size_t()), Thread::multi (scanner));
         }
 
-        if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
-          INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored");
-          return;
+        // the cache holds no patient identifiers: take these from a file
+        // of the same study that has just been scanned if there is one,
+        // or otherwise scan the first cached file of that study afresh:
+        std::map<std::string, const QuickScan*> identified;
+        for (size_t n = 0; n < files.size(); ++n)
+          if (status[n] == Scanner::Scanned && entries[n].is_image && entries[n].scan.study_UID.size())
+            identified.insert ({ entries[n].scan.study_UID, &entries[n].scan });
+        for (size_t n = 0; n < files.size(); ++n) {
+          QuickScan& scan (entries[n].scan);
+          if (status[n] != Scanner::Cached || !entries[n].is_image)
+            continue;
+          const auto study = scan.study_UID.size() ? identified.find (scan.study_UID) : identified.end();
+          if (study != identified.end()) {
+            scan.patient = study->second->patient;
+            scan.patient_ID = study->second->patient_ID;
+            scan.patient_DOB = study->second->patient_DOB;
+            continue;
+          }
+          try {
+            scan = QuickScan();
+            entries[n].is_image = scan_file (files[n], scan);
+            status[n] = Scanner::Scanned;
+            if (entries[n].is_image && scan.study_UID.size())
+              identified[scan.study_UID] = &scan;
+          }
+          catch (Exception& E) {
+            E.display (3);
+            entries[n].is_image = false;
+            status[n] = Scanner::Failed;
+          }
         }
 
+        // then merge the results in their original order, so that the
+        // tree is identical to that obtained by a serial scan:
+        for (size_t n = 0; n < files.size(); ++n) {
+          if (entries[n].is_image)
+            add (entries[n].scan);
+          if (status[n] != Scanner::Failed && cache.enabled())
+            cache.insert (scanner.cache_key (n), std::move (entries[n]));
+        }
+
+        cache.save (cache_prefix.size() ? Path::join (cache_prefix, filename) : filename);
+      }
+
+
+
+
+
+      void Tree::read_file (const std::string& filename)
+      {
+        QuickScan reader;
+        if (scan_file (filename, reader))
+          add (reader);
+      }
+
+
+
+
+
+      void Tree::add (const QuickScan& reader)
+      {
         std::shared_ptr<Patient> patient = find (reader.patient, reader.patient_ID, reader.patient_DOB);
         std::shared_ptr<Study> study = patient->find (reader.study, reader.study_ID, reader.study_UID, reader.study_date, reader.study_time);
         for (const auto& image_type : reader.image_type) {
@@ -103,7 +248,7 @@ namespace MR {
               reader.series_ref_UID,  reader.modality, reader.series_date, reader.series_time);
 
           std::shared_ptr<Image> image (new Image);
-          image->filename = filename;
+          image->filename = reader.filename;
           image->series = series.get();
           image->sequence_name = reader.sequence;
           image->image_type = image_type.first;
@@ -120,8 +265,7 @@ namespace MR {
       {
         description = filename;
         if (Path::is_dir (filename)) {
-          ProgressBar progress ("scanning folder \"" + shorten (filename) + "\" for DICOM data", 0);
-          read_dir (filename, progress);
+          read_dir (filename);
         } else {
           try {
             read_file (filename);
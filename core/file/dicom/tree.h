@@ -26,6 +26,7 @@ namespace MR {
 
       class Series;
       class Patient;
+      class QuickScan;
 
       class Tree : public vector<std::shared_ptr<Patient>> { NOMEMALIGN
         public:
@@ -44,8 +45,10 @@ namespace MR {
           }
 
         protected:
-          void read_dir (const std::string& filename, ProgressBar& progress);
+          void list_dir (const std::string& filename, vector<std::string>& files, ProgressBar& progress);
+          void read_dir (const std::string& filename);
           void read_file (const std::string& filename);
+          void add (const QuickScan& reader);
       };
 
       std::ostream& operator<< (std::ostream& stream, const Tree& item);
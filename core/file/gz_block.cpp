@@ -0,0 +1,378 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <atomic>
+#include <zlib.h>
+
+#include "app.h"
+#include "progressbar.h"
+#include "raw.h"
+#include "thread.h"
+#include "file/config.h"
+#include "file/gz_block.h"
+
+// size of the GZip member header written by GZBlockWriter, including the
+// 'MB' extra subfield:
+#define GZ_BLOCK_HEADER_SIZE 20
+// size of the GZip member trailer (CRC32 + ISIZE):
+#define GZ_BLOCK_TAILER_SIZE 8
+
+namespace MR
+{
+  namespace File
+  {
+
+
+
+    GZBlockWriter::GZBlockWriter (const std::string& filename, size_t block_size, int level) :
+      out (filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc),
+      filename (filename),
+      block_size (block_size),
+      level (level)
+    {
+      if (!out)
+        throw Exception ("error opening output file \"" + filename + "\": " + std::strerror (errno));
+      buffer.reserve (block_size);
+    }
+
+
+
+    GZBlockWriter::~GZBlockWriter ()
+    {
+      try {
+        close();
+      } catch (Exception& e) {
+        e.display();
+        App::exit_error_code = 1;
+      }
+    }
+
+
+
+    int GZBlockWriter::default_level ()
+    {
+      //CONF option: GZipCompressionLevel
+      //CONF default: 6
+      //CONF The compression level (between 0 and 9) to use when writing
+      //CONF GZip-compressed images (e.g. .mif.gz, .nii.gz). Lower values
+      //CONF are faster, higher values produce smaller files; 0 stores the
+      //CONF data uncompressed within the GZip container.
+      static const int level = [] {
+        const int value = File::Config::get_int ("GZipCompressionLevel", 6);
+        if (value < 0 || value > 9) {
+          WARN ("invalid value for config file entry \"GZipCompressionLevel\" (" + str(value) + "); using default (6)");
+          return 6;
+        }
+        return value;
+      }();
+      return level;
+    }
+
+
+
+    size_t GZBlockWriter::batch_size (size_t block_size)
+    {
+      return block_size * std::max (Thread::number_of_threads(), size_t(1));
+    }
+
+
+
+    void GZBlockWriter::write (const uint8_t* data, size_t size)
+    {
+      vector<std::pair<const uint8_t*, size_t>> blocks;
+
+      // complete any partially filled block from a previous call:
+      if (buffer.size()) {
+        const size_t n = std::min (size, block_size - buffer.size());
+        buffer.insert (buffer.end(), data, data+n);
+        data += n;
+        size -= n;
+        if (buffer.size() < block_size)
+          return;
+        blocks.push_back ({ buffer.data(), buffer.size() });
+      }
+
+      // compress complete blocks directly from the input:
+      while (size >= block_size) {
+        blocks.push_back ({ data, block_size });
+        data += block_size;
+        size -= block_size;
+      }
+
+      write_members (blocks);
+      buffer.assign (data, data+size);
+    }
+
+
+
+    void GZBlockWriter::close ()
+    {
+      if (!out.is_open())
+        return;
+      // an empty file is not valid GZip: write at least one (empty) member
+      if (buffer.size() || out.tellp() == 0)
+        write_members ({ { buffer.data(), buffer.size() } });
+      buffer.clear();
+      out.close();
+      if (!out)
+        throw Exception ("error writing GZip file \"" + filename + "\": " + std::strerror (errno));
+    }
+
+
+
+    void GZBlockWriter::write_members (const vector<std::pair<const uint8_t*, size_t>>& blocks)
+    {
+      if (blocks.empty())
+        return;
+
+      vector<vector<uint8_t>> members (blocks.size());
+
+      struct Shared { NOMEMALIGN
+        const vector<std::pair<const uint8_t*, size_t>>& blocks;
+        vector<vector<uint8_t>>& members;
+        const int level;
+        std::atomic<size_t> next;
+      } shared = { blocks, members, level, { 0 } };
+
+      struct Worker { NOMEMALIGN
+        Shared& shared;
+        void execute () {
+          size_t n;
+          while ((n = shared.next++) < shared.blocks.size())
+            shared.members[n] = compress_member (shared.blocks[n].first, shared.blocks[n].second, shared.level);
+        }
+      } worker = { shared };
+
+      const size_t num_threads = std::min (Thread::threads_to_execute(), blocks.size());
+      if (num_threads < 2)
+        worker.execute();
+      else
+        Thread::run (Thread::multi (worker, num_threads), "GZip compression threads").wait();
+
+      for (const auto& member : members) {
+        out.write (reinterpret_cast<const char*> (member.data()), member.size());
+        if (!out)
+          throw Exception ("error writing GZip file \"" + filename + "\": " + std::strerror (errno));
+      }
+    }
+
+
+
+    vector<uint8_t> GZBlockWriter::compress_member (const uint8_t* data, size_t size, int level)
+    {
+      z_stream zs;
+      zs.zalloc = Z_NULL;
+      zs.zfree = Z_NULL;
+      zs.opaque = Z_NULL;
+      // negative window bits: raw deflate stream, GZip wrapper is written here
+      if (deflateInit2 (&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw Exception ("error initialising GZip compression: " + std::string (zs.msg ? zs.msg : "unknown error"));
+
+      vector<uint8_t> member (GZ_BLOCK_HEADER_SIZE + deflateBound (&zs, size) + GZ_BLOCK_TAILER_SIZE);
+      zs.next_in = const_cast<Bytef*> (data);
+      zs.avail_in = size;
+      zs.next_out = member.data() + GZ_BLOCK_HEADER_SIZE;
+      zs.avail_out = member.size() - GZ_BLOCK_HEADER_SIZE - GZ_BLOCK_TAILER_SIZE;
+      const int status = deflate (&zs, Z_FINISH);
+      const size_t compressed_size = zs.total_out;
+      deflateEnd (&zs);
+      if (status != Z_STREAM_END)
+        throw Exception ("error compressing GZip member");
+
+      const uint32_t member_size = GZ_BLOCK_HEADER_SIZE + compressed_size + GZ_BLOCK_TAILER_SIZE;
+      member.resize (member_size);
+
+      uint8_t* header = member.data();
+      header[0] = 0x1f; header[1] = 0x8b;          // magic number
+      header[2] = 8;                               // compression method: deflate
+      header[3] = 4;                               // flags: FEXTRA
+      Raw::store_LE<uint32_t> (0, header+4);       // modification time: not available
+      header[8] = 0;                               // extra flags
+      header[9] = 255;                             // operating system: unknown
+      Raw::store_LE<uint16_t> (8, header+10);      // total size of extra field
+      header[12] = 'M'; header[13] = 'B';          // subfield identifier
+      Raw::store_LE<uint16_t> (4, header+14);      // subfield size
+      Raw::store_LE<uint32_t> (member_size, header+16);
+
+      uint8_t* tailer = member.data() + member_size - GZ_BLOCK_TAILER_SIZE;
+      Raw::store_LE<uint32_t> (crc32 (crc32 (0L, Z_NULL, 0), data, size), tailer);
+      Raw::store_LE<uint32_t> (size, tailer+4);
+
+      return member;
+    }
+
+
+
+
+
+
+
+
+    GZBlockIndex::GZBlockIndex (const std::string& filename) :
+      filename (filename),
+      is_valid (false)
+    {
+      std::ifstream in (filename, std::ios_base::in | std::ios_base::binary);
+      if (!in)
+        throw Exception ("error opening file \"" + filename + "\": " + std::strerror (errno));
+      in.seekg (0, std::ios_base::end);
+      const int64_t file_size = in.tellg();
+
+      int64_t offset = 0, data_offset = 0;
+      uint8_t header[12];
+      vector<uint8_t> extra;
+      while (offset < file_size) {
+        in.seekg (offset);
+        in.read (reinterpret_cast<char*> (header), sizeof(header));
+        if (!in || header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !(header[3] & 4))
+          return;
+
+        extra.resize (Raw::fetch_LE<uint16_t> (header+10));
+        in.read (reinterpret_cast<char*> (extra.data()), extra.size());
+        if (!in)
+          return;
+
+        uint32_t member_size = 0;
+        for (size_t n = 0; n+4 <= extra.size(); ) {
+          const size_t subfield_size = Raw::fetch_LE<uint16_t> (extra.data()+n+2);
+          if (n + 4 + subfield_size > extra.size())
+            return;
+          if (extra[n] == 'M' && extra[n+1] == 'B' && subfield_size == 4)
+            member_size = Raw::fetch_LE<uint32_t> (extra.data()+n+4);
+          else if (extra[n] == 'B' && extra[n+1] == 'C' && subfield_size == 2)
+            member_size = uint32_t (Raw::fetch_LE<uint16_t> (extra.data()+n+4)) + 1;
+          n += 4 + subfield_size;
+        }
+        if (member_size < sizeof(header) + extra.size() + GZ_BLOCK_TAILER_SIZE || offset + member_size > file_size)
+          return;
+
+        in.seekg (offset + member_size - 4);
+        uint8_t isize[4];
+        in.read (reinterpret_cast<char*> (isize), 4);
+        if (!in)
+          return;
+
+        members.push_back ({ offset, data_offset, member_size, Raw::fetch_LE<uint32_t> (isize) });
+        offset += member_size;
+        data_offset += members.back().data_size;
+      }
+
+      is_valid = members.size();
+      DEBUG ("found " + str(members.size()) + " indexed members in GZip file \"" + filename + "\"");
+    }
+
+
+
+
+    void GZBlockIndex::inflate_member (std::ifstream& in, const Member& member, vector<uint8_t>& compressed, uint8_t* destination) const
+    {
+      compressed.resize (member.size);
+      in.seekg (member.offset);
+      in.read (reinterpret_cast<char*> (compressed.data()), member.size);
+      if (!in)
+        throw Exception ("error reading GZip file \"" + filename + "\": " + std::strerror (errno));
+
+      z_stream zs;
+      zs.zalloc = Z_NULL;
+      zs.zfree = Z_NULL;
+      zs.opaque = Z_NULL;
+      zs.next_in = compressed.data();
+      zs.avail_in = member.size;
+      // window bits + 16: expect GZip header & tailer (including CRC check)
+      if (inflateInit2 (&zs, MAX_WBITS + 16) != Z_OK)
+        throw Exception ("error initialising GZip decompression for file \"" + filename + "\"");
+      zs.next_out = destination;
+      zs.avail_out = member.data_size;
+      const int status = inflate (&zs, Z_FINISH);
+      const size_t uncompressed_size = zs.total_out;
+      inflateEnd (&zs);
+      if (status != Z_STREAM_END || uncompressed_size != member.data_size)
+        throw Exception ("error uncompressing GZip file \"" + filename + "\": "
+            + (zs.msg ? std::string (zs.msg) : std::string ("unexpected member size")));
+    }
+
+
+
+
+    void GZBlockIndex::read (int64_t offset, uint8_t* destination, size_t size, const std::string& progress_message) const
+    {
+      assert (valid());
+      if (offset + int64_t(size) > this->size())
+        throw Exception ("unexpected end of file in GZip file \"" + filename + "\"");
+      if (!size)
+        return;
+
+      size_t first = 0;
+      while (first < members.size() && members[first].data_offset + members[first].data_size <= offset)
+        ++first;
+      size_t last = first;
+      while (last < members.size() && members[last].data_offset < offset + int64_t(size))
+        ++last;
+
+      struct Shared { NOMEMALIGN
+        const GZBlockIndex& index;
+        const int64_t offset;
+        uint8_t* const destination;
+        const size_t size;
+        const size_t last;
+        std::atomic<size_t> next;
+        std::mutex mutex;
+        ProgressBar progress;
+      } shared = { *this, offset, destination, size, last, { first }, { }, { progress_message, last - first } };
+
+      struct Worker { NOMEMALIGN
+        Shared& shared;
+        void execute () {
+          std::ifstream in (shared.index.filename, std::ios_base::in | std::ios_base::binary);
+          if (!in)
+            throw Exception ("error opening file \"" + shared.index.filename + "\": " + std::strerror (errno));
+          vector<uint8_t> compressed, uncompressed;
+          size_t n;
+          while ((n = shared.next++) < shared.last) {
+            const Member& member (shared.index.members[n]);
+            const int64_t from = std::max (member.data_offset, shared.offset);
+            const int64_t to = std::min (member.data_offset + member.data_size, shared.offset + int64_t(shared.size));
+            if (from == member.data_offset && to == member.data_offset + member.data_size) {
+              shared.index.inflate_member (in, member, compressed, shared.destination + (from - shared.offset));
+            }
+            else {
+              // member only partially overlaps requested region:
+              uncompressed.resize (member.data_size);
+              shared.index.inflate_member (in, member, compressed, uncompressed.data());
+              memcpy (shared.destination + (from - shared.offset), uncompressed.data() + (from - member.data_offset), to - from);
+            }
+            std::lock_guard<std::mutex> lock (shared.mutex);
+            ++shared.progress;
+          }
+        }
+      } worker = { shared };
+
+      const size_t num_threads = std::min (Thread::threads_to_execute(), last - first);
+      if (num_threads < 2) {
+        worker.execute();
+        return;
+      }
+
+      ProgressBar::SwitchToMultiThreaded progress_functions;
+      auto threads = Thread::run (Thread::multi (worker, num_threads), "GZip decompression threads");
+      shared.progress.run_update_thread (threads);
+      threads.wait();
+    }
+
+
+  }
+}
+
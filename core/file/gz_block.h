@@ -0,0 +1,127 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_gz_block_h__
+#define __file_gz_block_h__
+
+#include <fstream>
+
+#include "types.h"
+
+#define MRTRIX_GZ_BLOCK_SIZE 1048576
+
+namespace MR
+{
+  namespace File
+  {
+
+    /*! \defgroup gz_block Block-indexed GZip files
+     *
+     * These classes handle GZip files stored as a concatenation of
+     * independently compressed members, each of which records its own
+     * compressed size in an extra field of its GZip header. This is the same
+     * idea as the BGZF format used in genomics: since RFC 1952 explicitly
+     * allows multiple members in a single file, such files remain readable
+     * by any standard GZip decompressor; but a reader that is aware of the
+     * layout can locate each member by skipping from one header to the next,
+     * without having to decompress anything, and then decompress the members
+     * concurrently.
+     *
+     * Members written by GZBlockWriter carry an extra subfield with
+     * identifier 'MB' holding the total size of the member as a 32-bit
+     * little-endian integer. GZBlockIndex also recognises the 'BC' subfield
+     * used by BGZF (as written by \c bgzip), so that such files can be read
+     * in parallel too.
+     * @{ */
+
+
+    //! write data to a block-indexed GZip file
+    /*! Data passed to write() are accumulated into blocks of \a block_size
+     * bytes, and each block is compressed into a separate GZip member. Since
+     * the blocks are independent, all complete blocks available in a single
+     * call to write() are compressed concurrently using up to
+     * Thread::number_of_threads() threads; batch_size() provides the amount
+     * of data to pass to write() to keep all threads busy.
+     *
+     * The compression level defaults to the value of the GZipCompressionLevel
+     * config file option (see default_level()). */
+    class GZBlockWriter { NOMEMALIGN
+      public:
+        GZBlockWriter (const std::string& filename, size_t block_size = MRTRIX_GZ_BLOCK_SIZE, int level = default_level());
+        ~GZBlockWriter ();
+
+        void write (const uint8_t* data, size_t size);
+        //! the amount of data per call to write() that will occupy all threads
+        static size_t batch_size (size_t block_size = MRTRIX_GZ_BLOCK_SIZE);
+        //! flush any outstanding data and close the file
+        void close ();
+
+        //! compress \a size bytes at \a data into a single GZip member
+        static vector<uint8_t> compress_member (const uint8_t* data, size_t size, int level);
+        //! the default compression level, as set in the config file
+        static int default_level ();
+
+      protected:
+        std::ofstream out;
+        const std::string filename;
+        const size_t block_size;
+        const int level;
+        vector<uint8_t> buffer;
+
+        void write_members (const vector<std::pair<const uint8_t*, size_t>>& blocks);
+    };
+
+
+
+    //! locate and decompress the members of a block-indexed GZip file
+    /*! On construction, the headers of all members in the file are scanned.
+     * If any member does not carry its own size, valid() will return false,
+     * and the file must instead be decompressed serially (e.g. using
+     * File::GZ). */
+    class GZBlockIndex { NOMEMALIGN
+      public:
+        GZBlockIndex (const std::string& filename);
+
+        bool valid () const { return is_valid; }
+        //! the total uncompressed size of the file
+        int64_t size () const { return members.size() ? members.back().data_offset + members.back().data_size : 0; }
+
+        //! decompress \a size bytes from uncompressed offset \a offset into \a destination
+        /*! Members are decompressed concurrently using up to
+         * Thread::number_of_threads() threads. If \a progress_message is
+         * non-empty, a progress bar will be displayed. */
+        void read (int64_t offset, uint8_t* destination, size_t size, const std::string& progress_message = std::string()) const;
+
+      protected:
+        struct Member { NOMEMALIGN
+          int64_t offset, data_offset;
+          uint32_t size, data_size;
+        };
+
+        const std::string filename;
+        vector<Member> members;
+        bool is_valid;
+
+        void inflate_member (std::ifstream& in, const Member& member, vector<uint8_t>& compressed, uint8_t* destination) const;
+    };
+
+    /** @} */
+
+  }
+}
+
+#endif
+
@@ -85,6 +85,16 @@ namespace MR
     }
 
 
+    inline bool is_absolute (const std::string& path)
+    {
+#ifdef MRTRIX_WINDOWS
+      return (path.size() && strchr (PATH_SEPARATORS, path[0])) || (path.size() > 1 && path[1] == ':');
+#else
+      return path.size() && path[0] == PATH_SEPARATORS[0];
+#endif
+    }
+
+
     inline bool exists (const std::string& path)
     {
       struct stat buf;
@@ -158,13 +168,14 @@ namespace MR
       std::string path;
       size_t buf_size = 32;
       while (true) {
-        path.reserve (buf_size);
+        path.resize (buf_size);
         if (getcwd (&path[0], buf_size))
           break;
         if (errno != ERANGE)
           throw Exception ("failed to get current working directory!");
         buf_size *= 2;
       }
+      path.resize (strlen (path.c_str()));
       return path;
     }
 
@@ -21,6 +21,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifndef MRTRIX_WINDOWS
+# include <unistd.h>
+# include <sys/statvfs.h>
+#endif
 
 #include "debug.h"
 #include "app.h"
@@ -119,6 +123,42 @@ namespace MR
         return __tmpfile_prefix;
       }
 
+      //CONF option: PipedImageSharedMemory
+      //CONF default: 1 (true)
+      //CONF A boolean value to indicate whether images passed between
+      //CONF commands using Unix pipes should be created in shared memory
+      //CONF (/dev/shm) where available. The receiving command then maps the
+      //CONF image data directly, without any data being written to or read
+      //CONF from the file system. This is not used if the location of
+      //CONF temporary files has been set explicitly, using either the
+      //CONF :option:`TmpFileDir` config file entry, the
+      //CONF :envvar:`MRTRIX_TMPFILE_DIR` environment variable, or the TMPDIR
+      //CONF environment variable, or if there is insufficient shared memory
+      //CONF available to hold the image; piped images are then written to the
+      //CONF temporary file location as usual. Note that the space available
+      //CONF is only checked when the image is created: if other processes
+      //CONF consume the shared memory while the image is being written, the
+      //CONF command will still be terminated with a bus error (SIGBUS).
+      const std::string __get_shared_memory_dir () {
+#ifdef MRTRIX_WINDOWS
+        return "";
+#else
+        if (getenv ("MRTRIX_TMPFILE_DIR") || getenv ("TMPDIR") || File::Config::get ("TmpFileDir").size() ||
+            !File::Config::get_bool ("PipedImageSharedMemory", true))
+          return "";
+        const char* shm_dir = "/dev/shm";
+        struct stat info;
+        if (stat (shm_dir, &info) || !S_ISDIR (info.st_mode) || access (shm_dir, W_OK | X_OK))
+          return "";
+        return shm_dir;
+#endif
+      }
+
+      const std::string& shared_memory_dir () {
+        static const std::string __shared_memory_dir = __get_shared_memory_dir();
+        return __shared_memory_dir;
+      }
+
 
       /* Config file options listed here so that they can be scraped by
        * generate_user_docs.sh and added to the list of config file options in
@@ -213,11 +253,38 @@ namespace MR
 
 
 
-    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL)
+    //! the directory in which to create a piped image of \a size bytes
+    /*! This is the shared memory file system wherever possible (see the
+     * PipedImageSharedMemory config file option), and the usual location
+     * for temporary files otherwise. Since pages of a memory-mapped file in
+     * shared memory are only allocated when first written to, the space
+     * currently available must be checked beforehand: exhausting it would
+     * otherwise only manifest as a bus error while writing the image. This
+     * check is inherently racy: space consumed by other processes between
+     * the check and the writing of the image can still lead to a bus error. */
+    inline const std::string& piped_image_dir (int64_t size)
+    {
+#ifndef MRTRIX_WINDOWS
+      const std::string& shm_dir (shared_memory_dir());
+      if (shm_dir.size()) {
+        struct statvfs info;
+        // leave room for the image header
+        if (!statvfs (shm_dir.c_str(), &info) && int64_t (info.f_bavail) * int64_t (info.f_frsize) > size + (1<<20))
+          return shm_dir;
+        DEBUG ("insufficient shared memory available for piped image of size " + str (size) + " - using temporary file directory");
+      }
+#endif
+      return tmpfile_dir();
+    }
+
+
+
+
+    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL, const std::string& dir = tmpfile_dir())
     {
-      DEBUG ("creating temporary file of size " + str (size));
+      DEBUG ("creating temporary file of size " + str (size) + " in directory \"" + dir + "\"");
 
-      std::string filename (Path::join (tmpfile_dir(), tmpfile_prefix()) + "XXXXXX.");
+      std::string filename (Path::join (dir, tmpfile_prefix()) + "XXXXXX.");
       int rand_index = filename.size() - 7;
       if (suffix) filename += suffix;
 
@@ -229,7 +296,7 @@ namespace MR
       } while (fid < 0 && errno == EEXIST);
 
       if (fid < 0)
-        throw Exception (std::string ("error creating temporary file in directory \"" + tmpfile_dir() + "\": ") + strerror (errno));
+        throw Exception (std::string ("error creating temporary file in directory \"" + dir + "\": ") + strerror (errno));
 
       int status = size ? ftruncate (fid, size) : 0;
       close (fid);
@@ -19,14 +19,13 @@
 
 #include <complex>
 
-#include <unsupported/Eigen/FFT>
-
 #include "datatype.h"
 #include "memory.h"
 #include "image.h"
 #include "algo/copy.h"
 #include "algo/threaded_copy.h"
 #include "filter/base.h"
+#include "math/fft.h"
 
 namespace MR
 {
@@ -36,6 +35,43 @@ namespace MR
     /** \addtogroup Filters
       @{ */
 
+
+
+    // Transforms all lines along the FFT axis within a slab of the image,
+    //   spanning the batch axis, in a single call
+    template <class ComplexImageType>
+    class __FFTKernel { MEMALIGN(__FFTKernel<ComplexImageType>)
+      public:
+        __FFTKernel (const ComplexImageType& voxel, const size_t FFT_axis, const size_t batch_axis, const bool inverse_FFT) :
+            vox (voxel),
+            data (vox.size (FFT_axis), vox.size (batch_axis)),
+            axis (FFT_axis),
+            batch_axis (batch_axis),
+            inverse (inverse_FFT) { }
+
+        void operator () (const Iterator& pos) {
+          assign_pos_of (pos).to (vox);
+          for (vox.index(batch_axis) = 0; vox.index(batch_axis) < vox.size(batch_axis); ++vox.index(batch_axis))
+            for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
+              data (ssize_t(vox.index(axis)), ssize_t(vox.index(batch_axis))) = cdouble (vox.value());
+          if (inverse)
+            fft.inverse (data, data, 0);
+          else
+            fft.forward (data, data, 0);
+          for (vox.index(batch_axis) = 0; vox.index(batch_axis) < vox.size(batch_axis); ++vox.index(batch_axis))
+            for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
+              vox.value() = typename ComplexImageType::value_type (data (ssize_t(vox.index(axis)), ssize_t(vox.index(batch_axis))));
+        }
+
+      protected:
+        ComplexImageType vox;
+        Math::FFT<double>::complex_matrix_type data;
+        Math::FFT<double> fft;
+        const size_t axis, batch_axis;
+        const bool inverse;
+    };
+
+
     //! a filter to perform an FFT on an image
     /*!
      * Typical usage:
@@ -99,8 +135,8 @@ namespace MR
                   break;
                 }
               }
-              FFTKernel<decltype(temp)> kernel (temp, *axis, inverse);
-              ThreadedLoop (temp, axes, 1).run (kernel);
+              __FFTKernel<decltype(temp)> kernel (temp, *axis, axes[0], inverse);
+              ThreadedLoop (temp, axes, 1).run_outer (kernel);
               if (progress) ++(*progress);
             }
 
@@ -125,36 +161,6 @@ namespace MR
         vector<size_t> axes_to_process;
         bool centre_zero_;
 
-        template <class ComplexImageType>
-        class FFTKernel { MEMALIGN(FFTKernel)
-          public:
-            FFTKernel (const ComplexImageType& voxel, const size_t FFT_axis, const bool inverse_FFT) :
-                vox (voxel),
-                data_in (vox.size (FFT_axis)),
-                data_out (data_in.size()),
-                axis (FFT_axis),
-                inverse (inverse_FFT) { }
-
-            void operator () (const Iterator& pos) {
-              assign_pos_of (pos).to (vox);
-              for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
-                data_in[vox.index(axis)] = cdouble (vox.value());
-              if (inverse)
-                fft.inv (data_out, data_in);
-              else
-                fft.fwd (data_out, data_in);
-              for (vox.index(axis) = 0; vox.index(axis) < vox.size(axis); ++vox.index(axis))
-                vox.value() = typename ComplexImageType::value_type (data_out[vox.index(axis)]);
-            }
-
-          protected:
-            ComplexImageType vox;
-            Eigen::Matrix<cdouble, Eigen::Dynamic, 1> data_in, data_out;
-            Eigen::FFT<double> fft;
-            size_t axis;
-            bool inverse;
-        };
-
     };
 
 
@@ -166,28 +172,9 @@ namespace MR
           if (axis == axes[n])
             axes.erase (axes.begin() + n);
 
-        struct Kernel { MEMALIGN(Kernel)
-          Kernel (const ImageType& v, size_t axis, bool inverse) :
-            data_in (v.size (axis)), data_out (data_in.size()), axis (axis), inverse (inverse) { }
-
-          void operator ()(ImageType& v) {
-            for (auto l = Loop (axis, axis+1) (v); l; ++l)
-              data_in[v[axis]] = cdouble (v.value());
-            if (inverse)
-              fft.inv (data_out, data_in);
-            else
-              fft.fwd (data_out, data_in);
-            for (auto l = Loop (axis, axis+1) (v); l; ++l)
-              v.value() = typename std::remove_reference<ImageType>::type::value_type (data_out[v[axis]]);
-          }
-          Eigen::FFT<double> fft;
-          Eigen::Matrix<cdouble, Eigen::Dynamic, 1> data_in, data_out;
-          const size_t axis;
-          const bool inverse;
-        } kernel (vox, axis, inverse);
-
-        ThreadedLoop ("performing in-place FFT", vox, axes)
-          .run (kernel, vox);
+        using image_type = typename std::remove_reference<ImageType>::type;
+        ThreadedLoop ("performing in-place FFT", vox, axes, 1)
+          .run_outer (__FFTKernel<image_type> (vox, axis, axes[0], inverse));
       }
 
 
@@ -19,6 +19,7 @@
 
 #include "memory.h"
 #include "image.h"
+#include "file/config.h"
 #include "algo/copy.h"
 #include "algo/threaded_copy.h"
 #include "adapter/gaussian1D.h"
@@ -31,7 +32,22 @@ namespace MR
     /** \addtogroup Filters
     @{ */
 
+    //CONF option: SmoothRecursiveThreshold
+    //CONF default: 3.0
+    //CONF The standard deviation (in voxels) above which Gaussian smoothing
+    //CONF is performed using a recursive (IIR) approximation to the
+    //CONF Gaussian, whose cost per voxel does not depend on the extent of
+    //CONF the kernel, rather than by explicit convolution with a truncated
+    //CONF kernel. This applies to any axis for which the kernel extent has
+    //CONF not been set explicitly. Set to zero to always use explicit
+    //CONF convolution.
+
     /*! Smooth images using a Gaussian kernel.
+     *
+     * Along axes where the standard deviation exceeds a threshold (see
+     * set_recursive_threshold()), and no kernel extent has been set
+     * explicitly, a recursive approximation to the Gaussian is used in
+     * place of explicit convolution.
      *
      * Typical usage:
      * \code
@@ -54,7 +70,8 @@ namespace MR
             extent (3, 0),
             stdev (3, 0.0),
             stride_order (Stride::order (in)),
-            zero_boundary (false)
+            zero_boundary (false),
+            recursive_threshold (File::Config::get_float ("SmoothRecursiveThreshold", 3.0))
         {
           for (int i = 0; i < 3; i++)
             stdev[i] = in.spacing(i);
@@ -66,7 +83,9 @@ namespace MR
             Base (in),
             extent (3, 0),
             stdev (3, 0.0),
-            stride_order (Stride::order (in))
+            stride_order (Stride::order (in)),
+            zero_boundary (false),
+            recursive_threshold (File::Config::get_float ("SmoothRecursiveThreshold", 3.0))
         {
           set_stdev (stdev_in);
           datatype() = DataType::Float32;
@@ -94,6 +113,13 @@ namespace MR
           set_stdev (vector<default_type> (3, stdev_in));
         }
 
+        //! Set the standard deviation (in voxels) above which the recursive implementation is used.
+        //! A value of zero disables the recursive implementation. (Default: 3 voxels, or as per
+        //! the SmoothRecursiveThreshold config file entry)
+        void set_recursive_threshold (default_type threshold_in_voxels) {
+          recursive_threshold = threshold_in_voxels;
+        }
+
         //! ensure the image boundary remains zero. Used to constrain displacement fields during image registration
         void set_zero_boundary (bool do_zero_boundary) {
           zero_boundary = do_zero_boundary;
@@ -136,7 +162,13 @@ namespace MR
           }
 
           for (size_t dim = 0; dim < 3; dim++) {
-            if (stdev[dim] > 0) {
+            if (use_recursive (dim)) {
+              DEBUG ("smoothing image along dimension " + str(dim) + " using recursive filter");
+              smooth_recursive (*in, dim);
+              if (progress)
+                ++(*progress);
+            }
+            else if (stdev[dim] > 0) {
               DEBUG ("creating scratch image for smoothing image along dimension " + str(dim));
               out = make_shared<Image<ValueType> > (Image<ValueType>::scratch (input));
               Adapter::Gaussian1D<Image<ValueType> > gaussian (*in, stdev[dim], dim, extent[dim], zero_boundary);
@@ -171,9 +203,15 @@ namespace MR
                   continue;
                 axes[axdim++] = stride_order[i];
               }
-              DEBUG ("smoothing dimension " + str(dim) + " in place with stride order: " + str(axes));
-              SmoothFunctor1D<ImageType> smooth (in_and_output, stdev[dim], dim, extent[dim], zero_boundary);
-              ThreadedLoop (in_and_output, axes, 1).run (smooth, in_and_output);
+              if (use_recursive (dim)) {
+                DEBUG ("smoothing dimension " + str(dim) + " in place using recursive filter");
+                smooth_recursive (in_and_output, dim);
+              }
+              else {
+                DEBUG ("smoothing dimension " + str(dim) + " in place with stride order: " + str(axes));
+                SmoothFunctor1D<ImageType> smooth (in_and_output, stdev[dim], dim, extent[dim], zero_boundary);
+                ThreadedLoop (in_and_output, axes, 1).run (smooth, in_and_output);
+              }
               if (progress)
                 ++(*progress);
             }
@@ -185,6 +223,25 @@ namespace MR
         vector<default_type> stdev;
         const vector<size_t> stride_order;
         bool zero_boundary;
+        default_type recursive_threshold;
+
+        bool use_recursive (size_t dim) const {
+          return !extent[dim] && recursive_threshold > 0.0 && stdev[dim] >= recursive_threshold * spacing (dim);
+        }
+
+        // lines along the smoothing axis are processed in batches, taken
+        // along the axis of the image next in the stride order:
+        template <class ImageType>
+          void smooth_recursive (ImageType& image, size_t dim)
+          {
+            vector<size_t> axes (1, dim);
+            for (size_t i = 0; i < image.ndim(); ++i)
+              if (stride_order[i] != dim)
+                axes.push_back (stride_order[i]);
+            auto loop = ThreadedLoop (image, axes, 2);
+            loop.run_outer (RecursiveSmoothFunctor1D<ImageType> (image, loop.outer_loop.axes, axes[0], axes[1],
+                  stdev[dim] / spacing (dim), zero_boundary));
+          }
 
         template <class ImageType>
           class SmoothFunctor1D { MEMALIGN (SmoothFunctor1D)
@@ -284,6 +341,183 @@ namespace MR
             ssize_t buffer_size;
             Eigen::VectorXd buffer;
           };
+
+
+
+        // Gaussian smoothing along a single axis using the fourth-order
+        // recursive approximation of Deriche (INRIA RR-1893, 1993), applied to
+        // a batch of lines at once; the approximation error is below 0.1% of
+        // the kernel peak.
+        //
+        // To match the behaviour of SmoothFunctor1D at the image boundaries
+        // and in the presence of non-finite values, this is computed as a
+        // normalised convolution: the data are filtered with non-finite
+        // values and everything beyond the image boundaries set to zero, and
+        // divided by the result of filtering the corresponding mask. As for
+        // SmoothFunctor1D, the output is NaN wherever there is no finite
+        // value within 2 standard deviations.
+        template <class ImageType>
+          class RecursiveSmoothFunctor1D { MEMALIGN (RecursiveSmoothFunctor1D)
+          public:
+            RecursiveSmoothFunctor1D (const ImageType& image,
+                                      const vector<size_t>& outer_axes,
+                                      size_t axis_in,
+                                      size_t line_axis_in,
+                                      default_type stdev_in_voxels,
+                                      bool zero_boundary_in) :
+                image (image),
+                outer_axes (outer_axes),
+                axis (axis_in),
+                line_axis (line_axis_in),
+                zero_boundary (zero_boundary_in),
+                radius (std::ceil (2.0 * stdev_in_voxels)),
+                lines (weights_type::Zero (image.size (axis_in) + 2*padding, image.size (line_axis_in)))
+            {
+              compute_coefficients (stdev_in_voxels);
+              // the normalisation is the same for all lines without non-finite values:
+              weights_type ones = weights_type::Zero (lines.rows(), 1);
+              ones.middleRows (padding, image.size (axis)).setOnes();
+              filter (ones);
+              norm = ones.middleRows (padding, image.size (axis)).col (0);
+            }
+
+            void operator() (const Iterator& pos)
+            {
+              assign_pos_of (pos, outer_axes).to (image);
+              const ssize_t N = image.size (axis);
+              const ssize_t L = image.size (line_axis);
+
+              bool all_finite = true;
+              for (auto l = Loop (line_axis) (image); l; ++l) {
+                for (auto n = Loop (axis) (image); n; ++n) {
+                  const default_type value = image.value();
+                  lines (ssize_t (image.index (axis)) + padding, ssize_t (image.index (line_axis))) = value;
+                  if (!std::isfinite (value))
+                    all_finite = false;
+                }
+              }
+
+              if (all_finite) {
+                filter (lines);
+                lines.middleRows (padding, N).colwise() /= norm;
+              }
+              else {
+                weights = weights_type::Zero (lines.rows(), L);
+                weights.middleRows (padding, N) = lines.middleRows (padding, N).isFinite().template cast<default_type>();
+                lines.middleRows (padding, N) = (weights.middleRows (padding, N) > 0.0).select (lines.middleRows (padding, N), 0.0);
+                // number of finite values within the (truncated) kernel of
+                //   SmoothFunctor1D; where there are none, the output is NaN
+                support.setZero (N+1, L);
+                for (ssize_t i = 0; i < N; ++i)
+                  support.row (i+1) = support.row (i) + weights.row (i + padding);
+                filter (lines);
+                filter (weights);
+                lines.middleRows (padding, N) /= weights.middleRows (padding, N);
+                // the tails of the recursive filters never vanish, so the
+                //   filtered mask is non-zero even far from any finite value
+                for (ssize_t i = 0; i < N; ++i) {
+                  const ssize_t from = std::max (i - radius, ssize_t(0)), to = std::min (i + radius + 1, N);
+                  for (ssize_t l = 0; l < L; ++l)
+                    if (support (to, l) == support (from, l) || !(weights (i + padding, l) > 0.0))
+                      lines (i + padding, l) = NaN;
+                }
+              }
+
+              if (zero_boundary) {
+                lines.row (padding).setZero();
+                lines.row (padding + N - 1).setZero();
+              }
+
+              for (auto l = Loop (line_axis) (image); l; ++l)
+                for (auto n = Loop (axis) (image); n; ++n)
+                  image.value() = lines (ssize_t (image.index (axis)) + padding, ssize_t (image.index (line_axis)));
+            }
+
+          private:
+            using weights_type = Eigen::Array<default_type, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+            // each recursion depends on four neighbouring values, held in
+            // zero-valued padding rows at either end
+            static constexpr ssize_t padding = 4;
+
+            ImageType image;
+            const vector<size_t>& outer_axes;
+            const size_t axis, line_axis;
+            const bool zero_boundary;
+            // the radius of the kernel of SmoothFunctor1D
+            const ssize_t radius;
+            // coefficients of the causal (n) and anti-causal (m) filters,
+            // which share the same recursive coefficients (d)
+            default_type n[4], m[4], d[4];
+            Eigen::ArrayXd norm;
+            // each row holds the values at one position along the axis of
+            // smoothing, for all lines in the batch
+            weights_type lines, weights, causal, anticausal, support;
+
+            // The kernel is approximated as a sum of two damped sinusoids on
+            // either side of the origin; each corresponds to a pair of
+            // complex conjugate poles, from which the coefficients of the
+            // equivalent recursive filters are derived
+            void compute_coefficients (default_type sigma)
+            {
+              const cdouble residues[] = { { 1.680/2.0, -3.735/2.0 }, { -0.6803/2.0, 0.2598/2.0 } };
+              const cdouble exponents[] = { { -1.783, 0.6318 }, { -1.723, 1.997 } };
+              cdouble c[4], z[4];
+              for (size_t k = 0; k < 2; ++k) {
+                c[2*k] = residues[k];
+                c[2*k+1] = std::conj (residues[k]);
+                z[2*k] = std::exp (exponents[k] / sigma);
+                z[2*k+1] = std::conj (z[2*k]);
+              }
+
+              // denominator: product of (1 - z_k x), numerator: sum of c_k times product of all other factors
+              auto multiply = [] (cdouble* poly, size_t degree, cdouble root) {
+                for (size_t i = degree+1; i > 0; --i)
+                  poly[i] -= root * poly[i-1];
+              };
+              cdouble den[5] = { 1.0, 0.0, 0.0, 0.0, 0.0 }, num[4] = { 0.0, 0.0, 0.0, 0.0 };
+              for (size_t k = 0; k < 4; ++k) {
+                multiply (den, k, z[k]);
+                cdouble term[4] = { c[k], 0.0, 0.0, 0.0 };
+                for (size_t j = 0, degree = 0; j < 4; ++j)
+                  if (j != k)
+                    multiply (term, degree++, z[j]);
+                for (size_t i = 0; i < 4; ++i)
+                  num[i] += term[i];
+              }
+
+              for (size_t i = 0; i < 4; ++i) {
+                d[i] = den[i+1].real();
+                n[i] = num[i].real();
+              }
+              // the anti-causal filter reproduces the kernel for all negative offsets
+              for (size_t i = 0; i < 3; ++i)
+                m[i] = n[i+1] - d[i]*n[0];
+              m[3] = -d[3]*n[0];
+
+              // normalise to unit gain
+              const default_type gain = (n[0]+n[1]+n[2]+n[3] + m[0]+m[1]+m[2]+m[3]) / (1.0 + d[0]+d[1]+d[2]+d[3]);
+              for (size_t i = 0; i < 4; ++i) {
+                n[i] /= gain;
+                m[i] /= gain;
+              }
+            }
+
+            // filter all columns of data, whose first and last padding rows must be zero
+            void filter (weights_type& data)
+            {
+              const ssize_t end = data.rows() - padding;
+              causal.setZero (data.rows(), data.cols());
+              anticausal.setZero (data.rows(), data.cols());
+              for (ssize_t i = padding; i < end; ++i)
+                causal.row(i) = n[0]*data.row(i) + n[1]*data.row(i-1) + n[2]*data.row(i-2) + n[3]*data.row(i-3)
+                    - d[0]*causal.row(i-1) - d[1]*causal.row(i-2) - d[2]*causal.row(i-3) - d[3]*causal.row(i-4);
+              for (ssize_t i = end-1; i >= padding; --i)
+                anticausal.row(i) = m[0]*data.row(i+1) + m[1]*data.row(i+2) + m[2]*data.row(i+3) + m[3]*data.row(i+4)
+                    - d[0]*anticausal.row(i+1) - d[1]*anticausal.row(i+2) - d[2]*anticausal.row(i+3) - d[3]*anticausal.row(i+4);
+              data.middleRows (padding, end - padding) = causal.middleRows (padding, end - padding) + anticausal.middleRows (padding, end - padding);
+            }
+          };
     };
     //! @}
   }
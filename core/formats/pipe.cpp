@@ -66,7 +66,7 @@ namespace MR
       if (isatty (STDOUT_FILENO))
         throw Exception ("cannot create output piped image: no command connected at other end of pipe to receive that image");
 
-      H.name() = File::create_tempfile (0, "mif");
+      H.name() = File::create_tempfile (0, "mif", File::piped_image_dir (footprint (voxel_count (H, 0, num_axes), H.datatype())));
 
       SignalHandler::mark_file_for_deletion (H.name());
 
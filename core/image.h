@@ -94,6 +94,28 @@ namespace MR
           else buffer->set_value (data_offset, val);
         }
 
+        //! get the values of \a count voxels along \a axis, starting from the current location
+        /*! Any conversion from the datatype on file (including intensity
+         * scaling) is performed for the whole row at once, which is
+         * considerably faster than reading values one voxel at a time. The
+         * current location is not modified. */
+        FORCE_INLINE void get_values (size_t axis, size_t count, ValueType* dest) const {
+          if (data_pointer) {
+            for (size_t n = 0; n < count; ++n)
+              dest[n] = Raw::fetch_native<ValueType> (data_pointer, data_offset + n*stride(axis));
+          }
+          else buffer->get_values (data_offset, stride(axis), count, dest);
+        }
+        //! set the values of \a count voxels along \a axis, starting from the current location
+        /*! \sa get_values() */
+        FORCE_INLINE void set_values (size_t axis, size_t count, const ValueType* src) {
+          if (data_pointer) {
+            for (size_t n = 0; n < count; ++n)
+              Raw::store_native<ValueType> (src[n], data_pointer, data_offset + n*stride(axis));
+          }
+          else buffer->set_values (data_offset, stride(axis), count, src);
+        }
+
         //! use for debugging
         friend std::ostream& operator<< (std::ostream& stream, const Image& V) {
           stream << "\"" << V.name() << "\", datatype " << DataType::from<Image::value_type>().specifier() << ", index [ ";
@@ -226,7 +248,9 @@ namespace MR
         Buffer& operator= (const Buffer&) = delete;
         Buffer& operator= (Buffer&&) = default;
         Buffer (const Buffer& b) :
-          Header (b), fetch_func (b.fetch_func), store_func (b.store_func) { }
+          Header (b), fetch_func (b.fetch_func), store_func (b.store_func),
+          fetch_span (b.fetch_span), store_span (b.store_span),
+          fetch_span_scaled (b.fetch_span_scaled), store_span_scaled (b.store_span_scaled) { }
 
 
         FORCE_INLINE ValueType get_value (size_t offset) const {
@@ -239,6 +263,40 @@ namespace MR
           store_func (val, io->segment (nseg), offset - nseg*io->segment_size(), intensity_offset(), intensity_scale());
         }
 
+        //! get \a count values at \a offset, \a offset + \a stride, ...
+        /*! Spans contained within a single segment are converted in bulk;
+         * those straddling segments (e.g. across files) revert to
+         * per-value access. */
+        FORCE_INLINE void get_values (size_t offset, ssize_t stride, size_t count, ValueType* dest) const {
+          if (!count)
+            return;
+          const ssize_t nseg = offset / io->segment_size();
+          if (ssize_t ((offset + (count-1)*stride) / io->segment_size()) == nseg) {
+            auto fetch = is_scaled() ? fetch_span_scaled : fetch_span;
+            fetch (dest, io->segment (nseg), offset - nseg*io->segment_size(), stride, count, intensity_offset(), intensity_scale());
+          }
+          else {
+            for (size_t n = 0; n < count; ++n)
+              dest[n] = get_value (offset + n*stride);
+          }
+        }
+
+        //! set \a count values at \a offset, \a offset + \a stride, ...
+        /*! \sa get_values() */
+        FORCE_INLINE void set_values (size_t offset, ssize_t stride, size_t count, const ValueType* src) const {
+          if (!count)
+            return;
+          const ssize_t nseg = offset / io->segment_size();
+          if (ssize_t ((offset + (count-1)*stride) / io->segment_size()) == nseg) {
+            auto store = is_scaled() ? store_span_scaled : store_span;
+            store (src, io->segment (nseg), offset - nseg*io->segment_size(), stride, count, intensity_offset(), intensity_scale());
+          }
+          else {
+            for (size_t n = 0; n < count; ++n)
+              set_value (offset + n*stride, src[n]);
+          }
+        }
+
         std::unique_ptr<uint8_t[]> data_buffer;
         void* get_data_pointer ();
 
@@ -247,10 +305,15 @@ namespace MR
       protected:
         std::function<ValueType(const void*,size_t,default_type,default_type)> fetch_func;
         std::function<void(ValueType,void*,size_t,default_type,default_type)> store_func;
+        __fetch_span_func<ValueType> fetch_span, fetch_span_scaled;
+        __store_span_func<ValueType> store_span, store_span_scaled;
 
         void set_fetch_store_functions () {
           __set_fetch_store_functions (fetch_func, store_func, datatype());
+          __set_fetch_store_span_functions (fetch_span, store_span, fetch_span_scaled, store_span_scaled, datatype());
         }
+
+        FORCE_INLINE bool is_scaled () const { return intensity_offset() != 0.0 || intensity_scale() != 1.0; }
     };
 
   CHECK_MEM_ALIGN (Image<float>::Buffer);
@@ -299,6 +362,15 @@ namespace MR
 
       FORCE_INLINE value_type get_value () const { return Raw::fetch_native<ValueType> (data, offset); }
         FORCE_INLINE void set_value (ValueType val) { Raw::store_native<ValueType> (val, data, offset); }
+
+        FORCE_INLINE void get_values (size_t axis, size_t count, ValueType* dest) const {
+          for (size_t n = 0; n < count; ++n)
+            dest[n] = Raw::fetch_native<ValueType> (data, offset + n*stride(axis));
+        }
+        FORCE_INLINE void set_values (size_t axis, size_t count, const ValueType* src) {
+          for (size_t n = 0; n < count; ++n)
+            Raw::store_native<ValueType> (src[n], data, offset + n*stride(axis));
+        }
       };
 
     CHECK_MEM_ALIGN (TmpImage<float>);
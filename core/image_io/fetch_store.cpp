@@ -135,6 +135,74 @@ namespace MR
       }
 
 
+
+
+    // for bulk conversion of spans of values, with the byte order and
+    // application of scaling resolved at compile time:
+
+    struct NativeOrder { NOMEMALIGN
+      template <typename DiskType>
+        static FORCE_INLINE DiskType fetch (const void* data, size_t i) { return Raw::fetch_native<DiskType> (data, i); }
+      template <typename DiskType>
+        static FORCE_INLINE void store (DiskType val, void* data, size_t i) { Raw::store_native<DiskType> (val, data, i); }
+    };
+
+    struct LittleEndian { NOMEMALIGN
+      template <typename DiskType>
+        static FORCE_INLINE DiskType fetch (const void* data, size_t i) { return Raw::fetch_LE<DiskType> (data, i); }
+      template <typename DiskType>
+        static FORCE_INLINE void store (DiskType val, void* data, size_t i) { Raw::store_LE<DiskType> (val, data, i); }
+    };
+
+    struct BigEndian { NOMEMALIGN
+      template <typename DiskType>
+        static FORCE_INLINE DiskType fetch (const void* data, size_t i) { return Raw::fetch_BE<DiskType> (data, i); }
+      template <typename DiskType>
+        static FORCE_INLINE void store (DiskType val, void* data, size_t i) { Raw::store_BE<DiskType> (val, data, i); }
+    };
+
+    // without scaling, values are converted via the same intermediate type
+    // as when scaling is applied, so that the results are identical:
+    template <bool Scaled, typename DiskType>
+      FORCE_INLINE auto from_storage (DiskType val, default_type offset, default_type scale) -> decltype (scale_from_storage (val, offset, scale)) {
+        using IntermediateType = decltype (scale_from_storage (val, offset, scale));
+        return Scaled ? scale_from_storage (val, offset, scale) : IntermediateType (val);
+      }
+
+    template <bool Scaled, typename RAMType>
+      FORCE_INLINE auto to_storage (RAMType val, default_type offset, default_type scale) -> decltype (scale_to_storage (val, offset, scale)) {
+        using IntermediateType = decltype (scale_to_storage (val, offset, scale));
+        return Scaled ? scale_to_storage (val, offset, scale) : IntermediateType (val);
+      }
+
+    // contiguous spans are handled separately to allow the compiler to
+    // vectorise the conversion:
+
+    template <typename RAMType, typename DiskType, class Order, bool Scaled>
+      void __fetch_span (RAMType* dest, const void* data, size_t i, ssize_t stride, size_t count, default_type offset, default_type scale) {
+        if (stride == 1) {
+          for (size_t n = 0; n < count; ++n)
+            dest[n] = round_func<RAMType> (from_storage<Scaled> (Order::template fetch<DiskType> (data, i+n), offset, scale));
+        }
+        else {
+          for (size_t n = 0; n < count; ++n, i += stride)
+            dest[n] = round_func<RAMType> (from_storage<Scaled> (Order::template fetch<DiskType> (data, i), offset, scale));
+        }
+      }
+
+    template <typename RAMType, typename DiskType, class Order, bool Scaled>
+      void __store_span (const RAMType* src, void* data, size_t i, ssize_t stride, size_t count, default_type offset, default_type scale) {
+        if (stride == 1) {
+          for (size_t n = 0; n < count; ++n)
+            Order::template store<DiskType> (round_func<DiskType> (to_storage<Scaled> (src[n], offset, scale)), data, i+n);
+        }
+        else {
+          for (size_t n = 0; n < count; ++n, i += stride)
+            Order::template store<DiskType> (round_func<DiskType> (to_storage<Scaled> (src[n], offset, scale)), data, i);
+        }
+      }
+
+
   }
 
 
@@ -245,11 +313,70 @@ namespace MR
       }
     }
 
+
+
+
+
+#define __SET_SPAN_FUNCTIONS(DiskType, Order) \
+  fetch_span = __fetch_span<ValueType,DiskType,Order,false>; \
+  store_span = __store_span<ValueType,DiskType,Order,false>; \
+  fetch_span_scaled = __fetch_span<ValueType,DiskType,Order,true>; \
+  store_span_scaled = __store_span<ValueType,DiskType,Order,true>; \
+  return
+
+  template <typename ValueType>
+    typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_span_functions (
+        __fetch_span_func<ValueType>& fetch_span,
+        __store_span_func<ValueType>& store_span,
+        __fetch_span_func<ValueType>& fetch_span_scaled,
+        __store_span_func<ValueType>& store_span_scaled,
+        DataType datatype) {
+
+      switch (datatype()) {
+        case DataType::Bit:         __SET_SPAN_FUNCTIONS (bool, NativeOrder);
+        case DataType::Int8:        __SET_SPAN_FUNCTIONS (int8_t, NativeOrder);
+        case DataType::UInt8:       __SET_SPAN_FUNCTIONS (uint8_t, NativeOrder);
+        case DataType::Int16LE:     __SET_SPAN_FUNCTIONS (int16_t, LittleEndian);
+        case DataType::UInt16LE:    __SET_SPAN_FUNCTIONS (uint16_t, LittleEndian);
+        case DataType::Int16BE:     __SET_SPAN_FUNCTIONS (int16_t, BigEndian);
+        case DataType::UInt16BE:    __SET_SPAN_FUNCTIONS (uint16_t, BigEndian);
+        case DataType::Int32LE:     __SET_SPAN_FUNCTIONS (int32_t, LittleEndian);
+        case DataType::UInt32LE:    __SET_SPAN_FUNCTIONS (uint32_t, LittleEndian);
+        case DataType::Int32BE:     __SET_SPAN_FUNCTIONS (int32_t, BigEndian);
+        case DataType::UInt32BE:    __SET_SPAN_FUNCTIONS (uint32_t, BigEndian);
+        case DataType::Int64LE:     __SET_SPAN_FUNCTIONS (int64_t, LittleEndian);
+        case DataType::UInt64LE:    __SET_SPAN_FUNCTIONS (uint64_t, LittleEndian);
+        case DataType::Int64BE:     __SET_SPAN_FUNCTIONS (int64_t, BigEndian);
+        case DataType::UInt64BE:    __SET_SPAN_FUNCTIONS (uint64_t, BigEndian);
+        case DataType::Float32LE:   __SET_SPAN_FUNCTIONS (float, LittleEndian);
+        case DataType::Float32BE:   __SET_SPAN_FUNCTIONS (float, BigEndian);
+        case DataType::Float64LE:   __SET_SPAN_FUNCTIONS (double, LittleEndian);
+        case DataType::Float64BE:   __SET_SPAN_FUNCTIONS (double, BigEndian);
+        case DataType::CFloat32LE:  __SET_SPAN_FUNCTIONS (cfloat, LittleEndian);
+        case DataType::CFloat32BE:  __SET_SPAN_FUNCTIONS (cfloat, BigEndian);
+        case DataType::CFloat64LE:  __SET_SPAN_FUNCTIONS (cdouble, LittleEndian);
+        case DataType::CFloat64BE:  __SET_SPAN_FUNCTIONS (cdouble, BigEndian);
+        default:
+          throw Exception ("invalid data type in image header");
+      }
+    }
+
+#undef __SET_SPAN_FUNCTIONS
+
+
+
+
   // explicit instantiation of fetch/store methods for all types:
 #define __DEFINE_FETCH_STORE_FUNCTION_FOR_TYPE(ValueType) \
   template void __set_fetch_store_functions<ValueType> ( \
       std::function<ValueType(const void*,size_t,default_type,default_type)>& fetch_func, \
       std::function<void(ValueType,void*,size_t,default_type,default_type)>& store_func, \
+      DataType datatype); \
+  template void __set_fetch_store_span_functions<ValueType> ( \
+      __fetch_span_func<ValueType>& fetch_span, \
+      __store_span_func<ValueType>& store_span, \
+      __fetch_span_func<ValueType>& fetch_span_scaled, \
+      __store_span_func<ValueType>& store_span_scaled, \
       DataType datatype)
 
   __DEFINE_FETCH_STORE_FUNCTION_FOR_TYPE(bool);
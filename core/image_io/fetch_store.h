@@ -39,6 +39,43 @@ namespace MR
         DataType datatype);
 
 
+
+
+  //! bulk conversion of \a count values at offsets \a i, \a i + \a stride, ... from storage
+  template <typename ValueType>
+    using __fetch_span_func = void (*) (ValueType* dest, const void* data, size_t i, ssize_t stride, size_t count, default_type offset, default_type scale);
+
+  //! bulk conversion of \a count values at offsets \a i, \a i + \a stride, ... to storage
+  template <typename ValueType>
+    using __store_span_func = void (*) (const ValueType* src, void* data, size_t i, ssize_t stride, size_t count, default_type offset, default_type scale);
+
+
+
+  template <typename ValueType>
+    typename std::enable_if<!is_data_type<ValueType>::value, void>::type __set_fetch_store_span_functions (
+        __fetch_span_func<ValueType>& /*fetch_span*/,
+        __store_span_func<ValueType>& /*store_span*/,
+        __fetch_span_func<ValueType>& /*fetch_span_scaled*/,
+        __store_span_func<ValueType>& /*store_span_scaled*/,
+        DataType /*datatype*/) { }
+
+
+
+  //! select the bulk conversion functions for \a datatype
+  /*! The datatype, byte order and RAM type are resolved once here, so that
+   * the kernels themselves contain no per-value dispatch. The \a
+   * fetch_span & \a store_span functions ignore the intensity scaling
+   * parameters, and should only be used when the offset is zero and the
+   * scale is one; \a fetch_span_scaled & \a store_span_scaled apply them. */
+  template <typename ValueType>
+    typename std::enable_if<is_data_type<ValueType>::value, void>::type __set_fetch_store_span_functions (
+        __fetch_span_func<ValueType>& fetch_span,
+        __store_span_func<ValueType>& store_span,
+        __fetch_span_func<ValueType>& fetch_span_scaled,
+        __store_span_func<ValueType>& store_span_scaled,
+        DataType datatype);
+
+
 }
 
 #endif
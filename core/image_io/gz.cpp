@@ -21,6 +21,7 @@
 #include "header.h"
 #include "image_io/gz.h"
 #include "file/gz.h"
+#include "file/gz_block.h"
 
 #define BYTES_PER_ZCALL 524288
 
@@ -48,20 +49,37 @@ namespace MR
       if (is_new)
         memset (addresses[0].get(), 0, files.size() * bytes_per_segment);
       else {
-        ProgressBar progress ("uncompressing image \"" + header.name() + "\"",
-            files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+        vector<File::GZBlockIndex> indices;
         for (size_t n = 0; n < files.size(); n++) {
-          File::GZ zf (files[n].name, "rb");
-          zf.seek (files[n].start);
-          uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-          uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
-          while (address < last) {
-            zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
-            address += BYTES_PER_ZCALL;
-            ++progress;
+          indices.push_back (File::GZBlockIndex (files[n].name));
+          if (!indices.back().valid()) {
+            indices.clear();
+            break;
+          }
+        }
+
+        if (indices.size()) {
+          // block-indexed GZip: decompress members in parallel
+          for (size_t n = 0; n < files.size(); n++)
+            indices[n].read (files[n].start, addresses[0].get() + n*bytes_per_segment, bytes_per_segment,
+                "uncompressing image \"" + header.name() + "\"");
+        }
+        else {
+          ProgressBar progress ("uncompressing image \"" + header.name() + "\"",
+              files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+          for (size_t n = 0; n < files.size(); n++) {
+            File::GZ zf (files[n].name, "rb");
+            zf.seek (files[n].start);
+            uint8_t* address = addresses[0].get() + n*bytes_per_segment;
+            uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
+            while (address < last) {
+              zf.read (reinterpret_cast<char*> (address), BYTES_PER_ZCALL);
+              address += BYTES_PER_ZCALL;
+              ++progress;
+            }
+            last += BYTES_PER_ZCALL;
+            zf.read (reinterpret_cast<char*> (address), last - address);
           }
-          last += BYTES_PER_ZCALL;
-          zf.read (reinterpret_cast<char*> (address), last - address);
         }
       }
 
@@ -81,24 +99,26 @@ namespace MR
         assert (addresses[0]);
 
         if (writable) {
+          // pass data in batches large enough for all compression threads:
+          const size_t batch_size = File::GZBlockWriter::batch_size();
           ProgressBar progress ("compressing image \"" + header.name() + "\"",
-              files.size() * bytes_per_segment / BYTES_PER_ZCALL);
+              files.size() * ((bytes_per_segment + batch_size - 1) / batch_size));
           for (size_t n = 0; n < files.size(); n++) {
             assert (files[n].start == int64_t (lead_in_size));
-            File::GZ zf (files[n].name, "wb");
+            File::GZBlockWriter zf (files[n].name);
             if (lead_in)
-              zf.write (reinterpret_cast<const char*> (lead_in.get()), lead_in_size);
+              zf.write (lead_in.get(), lead_in_size);
             uint8_t* address = addresses[0].get() + n*bytes_per_segment;
-            uint8_t* last = address + bytes_per_segment - BYTES_PER_ZCALL;
+            uint8_t* const last = address + bytes_per_segment;
             while (address < last) {
-              zf.write (reinterpret_cast<const char*> (address), BYTES_PER_ZCALL);
-              address += BYTES_PER_ZCALL;
+              const size_t size = std::min (size_t (last - address), batch_size);
+              zf.write (address, size);
+              address += size;
               ++progress;
             }
-            last += BYTES_PER_ZCALL;
-            zf.write (reinterpret_cast<const char*> (address), last - address);
             if (lead_out)
-              zf.write (reinterpret_cast<const char*> (lead_out.get()), lead_out_size);
+              zf.write (lead_out.get(), lead_out_size);
+            zf.close();
           }
         }
 
@@ -503,6 +503,115 @@ namespace MR
 
 
 
+      //! evaluate SH series along a batch of directions
+      /*! Rather than evaluating one direction at a time as value() does, the
+       * SH basis is first computed for all directions using set_directions(),
+       * one (l,m) term at a time across all directions; the amplitudes are
+       * then obtained using a single matrix-vector product if all directions
+       * share the same SH coefficients (value()), or a row-wise dot product if
+       * each direction has its own coefficients (paired_value()). All inner
+       * loops operate over contiguous arrays of directions, and are vectorised
+       * by Eigen using whichever SIMD instruction set is enabled at compile time
+       * (e.g. AVX2 or AVX-512 when configured with ARCH=native), falling back
+       * to scalar code otherwise.
+       *
+       * If \a precomputer is provided, the associated Legendre polynomials are
+       * interpolated from its lookup table, as for PrecomputedAL::value();
+       * otherwise they are computed exactly. */
+      template <typename ValueType> class BatchEvaluator
+      { MEMALIGN(BatchEvaluator<ValueType>)
+        public:
+          using value_type = ValueType;
+          using array_type = Eigen::Array<value_type,Eigen::Dynamic,1>;
+          using matrix_type = Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic>;
+
+          BatchEvaluator (int lmax, const PrecomputedAL<value_type>* precomputer = nullptr) :
+            lmax (lmax),
+            precomputer (precomputer && *precomputer ? precomputer : nullptr) { }
+
+          //! compute the SH basis along each of the unit vectors in the columns of \a unit_dirs
+          template <class DirectionsType>
+            void set_directions (const DirectionsType& unit_dirs)
+            {
+              const ssize_t N = unit_dirs.cols();
+              const array_type x = unit_dirs.row(0).transpose().template cast<value_type>().array();
+              const array_type y = unit_dirs.row(1).transpose().template cast<value_type>().array();
+              const array_type rxy = (x.square() + y.square()).sqrt();
+              const array_type cp = (rxy > value_type(0)).select (x / rxy, value_type(1));
+              const array_type sp = (rxy > value_type(0)).select (y / rxy, value_type(0));
+
+              AL.resize (N, NforL_mpos (lmax));
+              if (precomputer) {
+                PrecomputedFraction<value_type> f;
+                for (ssize_t n = 0; n < N; ++n) {
+                  precomputer->set (f, std::acos (value_type (unit_dirs(2,n))));
+                  Eigen::Map<const Eigen::Matrix<value_type,1,Eigen::Dynamic>> p1 (&*f.p1, AL.cols());
+                  if (f.f2) {
+                    Eigen::Map<const Eigen::Matrix<value_type,1,Eigen::Dynamic>> p2 (&*f.p2, AL.cols());
+                    AL.row(n) = f.f1 * p1 + f.f2 * p2;
+                  }
+                  else
+                    AL.row(n) = f.f1 * p1;
+                }
+              }
+              else {
+                Eigen::Matrix<value_type,Eigen::Dynamic,1,0,64> buf (lmax+1);
+                for (ssize_t n = 0; n < N; ++n) {
+                  for (int m = 0; m <= lmax; m++) {
+                    Legendre::Plm_sph (buf, lmax, m, value_type (unit_dirs(2,n)));
+                    for (int l = ( (m&1) ? m+1 : m); l <= lmax; l+=2)
+                      AL(n, index_mpos (l,m)) = buf[l];
+                  }
+                }
+              }
+
+              basis.resize (N, NforL (lmax));
+              for (int l = 0; l <= lmax; l+=2)
+                basis.col (index (l,0)) = AL.col (index_mpos (l,0));
+              array_type c0 (array_type::Ones (N)), s0 (array_type::Zero (N)), c (N), s (N);
+              for (int m = 1; m <= lmax; m++) {
+                c = c0 * cp - s0 * sp;  // cos(m*azimuth)
+                s = s0 * cp + c0 * sp;  // sin(m*azimuth)
+                for (int l = ( (m&1) ? m+1 : m); l <= lmax; l+=2) {
+                  basis.col (index (l,m))  = value_type(Math::sqrt2) * AL.col (index_mpos (l,m)).array() * c;
+                  basis.col (index (l,-m)) = value_type(Math::sqrt2) * AL.col (index_mpos (l,m)).array() * s;
+                }
+                c0.swap (c);
+                s0.swap (s);
+              }
+            }
+
+          //! the number of directions provided to set_directions()
+          ssize_t size () const { return basis.rows(); }
+          //! the SH basis, with one row per direction
+          const matrix_type& get_basis () const { return basis; }
+
+          //! amplitude of the SH series \a coefs along each direction
+          /*! Any coefficients beyond \a lmax are ignored. */
+          template <class VectorType, class ResultType>
+            void value (const VectorType& coefs, ResultType& amplitudes) const
+            {
+              amplitudes.noalias() = basis * coefs.head (basis.cols());
+            }
+
+          //! amplitude of the SH series in row \a n of \a coefs along direction \a n
+          /*! Any coefficients beyond \a lmax are ignored. */
+          template <class MatrixType, class ResultType>
+            void paired_value (const MatrixType& coefs, ResultType& amplitudes) const
+            {
+              assert (coefs.rows() == basis.rows());
+              amplitudes = basis.cwiseProduct (coefs.leftCols (basis.cols())).rowwise().sum();
+            }
+
+        protected:
+          int lmax;
+          const PrecomputedAL<value_type>* precomputer;
+          matrix_type AL, basis;
+      };
+
+
+
+
 
 
       //! estimate direction & amplitude of SH peak
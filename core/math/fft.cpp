@@ -0,0 +1,431 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+
+#include "math/fft.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include <unsupported/Eigen/FFT>
+#ifdef EIGEN_FFTW_DEFAULT
+// Eigen only provides its kissfft implementation if FFTW is not its default
+# include <unsupported/Eigen/src/FFT/ei_kissfft_impl.h>
+#endif
+
+#include "exception.h"
+#include "mrtrix.h"
+
+
+
+
+namespace MR
+{
+  namespace Math
+  {
+
+
+
+    namespace
+    {
+
+
+
+      // Arrangement in memory of a set of lines to be transformed:
+      //   element i of line m is located at offset (m * dist + i * stride)
+      class Layout { NOMEMALIGN
+        public:
+          int n, howmany;
+          int in_stride, in_dist;
+          int out_stride, out_dist;
+      };
+
+      // Lines along axis 0 (columns) or 1 (rows) of column-major matrices;
+      //   the input and output may differ in their number of rows
+      Layout layout (const size_t axis, const ssize_t n, const ssize_t in_rows, const ssize_t in_cols, const ssize_t out_rows)
+      {
+        if (axis > 1)
+          throw Exception ("FFT axis must be either 0 or 1");
+        Layout L;
+        L.n = n;
+        if (axis) {
+          L.howmany = in_rows;
+          L.in_stride = in_rows;
+          L.in_dist = 1;
+          L.out_stride = out_rows;
+          L.out_dist = 1;
+        } else {
+          L.howmany = in_cols;
+          L.in_stride = L.out_stride = 1;
+          L.in_dist = in_rows;
+          L.out_dist = out_rows;
+        }
+        return L;
+      }
+
+
+
+
+      template <typename ValueType>
+        class FFTW { NOMEMALIGN
+          public:
+            static constexpr bool available = false;
+        };
+
+
+
+      // Transforms one line at a time using Eigen's implementation of kissfft,
+      //   via contiguous copies of each line
+      template <typename ValueType, bool use_fftw = FFTW<ValueType>::available>
+        class Engine { MEMALIGN(Engine<ValueType,use_fftw>)
+          public:
+            using complex_type = std::complex<ValueType>;
+
+            Engine () {
+              fft.SetFlag (fft_type::HalfSpectrum);
+              fft.SetFlag (fft_type::Unscaled);
+            }
+
+            void c2c (const complex_type* in, complex_type* out, const Layout& L, const bool inverse)
+            {
+              // kissfft does not handle transforms of length 1 (the identity)
+              if (L.n == 1) {
+                for (int m = 0; m != L.howmany; ++m)
+                  out[m * L.out_dist] = in[m * L.in_dist];
+                return;
+              }
+              line_in.resize (L.n);
+              line_out.resize (L.n);
+              for (int m = 0; m != L.howmany; ++m) {
+                gather (in + m * L.in_dist, L.in_stride, L.n, line_in.data());
+                if (inverse)
+                  fft.inv (line_out.data(), line_in.data(), L.n);
+                else
+                  fft.fwd (line_out.data(), line_in.data(), L.n);
+                scatter (line_out.data(), L.n, out + m * L.out_dist, L.out_stride);
+              }
+            }
+
+            void r2c (const ValueType* in, complex_type* out, const Layout& L)
+            {
+              if (L.n == 1) {
+                for (int m = 0; m != L.howmany; ++m)
+                  out[m * L.out_dist] = in[m * L.in_dist];
+                return;
+              }
+              real_line.resize (L.n);
+              line_out.resize (L.n/2+1);
+              for (int m = 0; m != L.howmany; ++m) {
+                gather (in + m * L.in_dist, L.in_stride, L.n, real_line.data());
+                fft.fwd (line_out.data(), real_line.data(), L.n);
+                scatter (line_out.data(), L.n/2+1, out + m * L.out_dist, L.out_stride);
+              }
+            }
+
+            void c2r (const complex_type* in, ValueType* out, const Layout& L)
+            {
+              if (L.n == 1) {
+                for (int m = 0; m != L.howmany; ++m)
+                  out[m * L.out_dist] = in[m * L.in_dist].real();
+                return;
+              }
+              line_in.resize (L.n/2+1);
+              real_line.resize (L.n);
+              for (int m = 0; m != L.howmany; ++m) {
+                gather (in + m * L.in_dist, L.in_stride, L.n/2+1, line_in.data());
+                fft.inv (real_line.data(), line_in.data(), L.n);
+                scatter (real_line.data(), L.n, out + m * L.out_dist, L.out_stride);
+              }
+            }
+
+          private:
+            using fft_type = Eigen::FFT<ValueType, Eigen::internal::kissfft_impl<ValueType>>;
+            fft_type fft;
+            vector<complex_type> line_in, line_out;
+            vector<ValueType> real_line;
+
+            template <typename T>
+              static void gather (const T* in, const int stride, const int n, T* out) {
+                for (int i = 0; i != n; ++i)
+                  out[i] = in[i*stride];
+              }
+            template <typename T>
+              static void scatter (const T* in, const int n, T* out, const int stride) {
+                for (int i = 0; i != n; ++i)
+                  out[i*stride] = in[i];
+              }
+        };
+
+
+
+
+#ifdef EIGEN_FFTW_DEFAULT
+
+      template <>
+        class FFTW<double> { NOMEMALIGN
+          public:
+            static constexpr bool available = true;
+            using real = double;
+            using complex = fftw_complex;
+            using plan = fftw_plan;
+
+            static plan plan_c2c (const Layout& L, complex* in, complex* out, const int sign) {
+              return fftw_plan_many_dft (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                         out, nullptr, L.out_stride, L.out_dist, sign, FFTW_ESTIMATE);
+            }
+            static plan plan_r2c (const Layout& L, real* in, complex* out) {
+              return fftw_plan_many_dft_r2c (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                             out, nullptr, L.out_stride, L.out_dist, FFTW_ESTIMATE);
+            }
+            static plan plan_c2r (const Layout& L, complex* in, real* out) {
+              return fftw_plan_many_dft_c2r (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                             out, nullptr, L.out_stride, L.out_dist, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+            }
+            static void execute_c2c (const plan p, complex* in, complex* out) { fftw_execute_dft (p, in, out); }
+            static void execute_r2c (const plan p, real* in, complex* out) { fftw_execute_dft_r2c (p, in, out); }
+            static void execute_c2r (const plan p, complex* in, real* out) { fftw_execute_dft_c2r (p, in, out); }
+            static void destroy (plan p) { fftw_destroy_plan (p); }
+            static int alignment_of (const void* p) { return fftw_alignment_of (reinterpret_cast<real*> (const_cast<void*> (p))); }
+        };
+
+# ifdef MRTRIX_FFTWF_SUPPORT
+      template <>
+        class FFTW<float> { NOMEMALIGN
+          public:
+            static constexpr bool available = true;
+            using real = float;
+            using complex = fftwf_complex;
+            using plan = fftwf_plan;
+
+            static plan plan_c2c (const Layout& L, complex* in, complex* out, const int sign) {
+              return fftwf_plan_many_dft (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                          out, nullptr, L.out_stride, L.out_dist, sign, FFTW_ESTIMATE);
+            }
+            static plan plan_r2c (const Layout& L, real* in, complex* out) {
+              return fftwf_plan_many_dft_r2c (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                              out, nullptr, L.out_stride, L.out_dist, FFTW_ESTIMATE);
+            }
+            static plan plan_c2r (const Layout& L, complex* in, real* out) {
+              return fftwf_plan_many_dft_c2r (1, &L.n, L.howmany, in, nullptr, L.in_stride, L.in_dist,
+                                              out, nullptr, L.out_stride, L.out_dist, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+            }
+            static void execute_c2c (const plan p, complex* in, complex* out) { fftwf_execute_dft (p, in, out); }
+            static void execute_r2c (const plan p, real* in, complex* out) { fftwf_execute_dft_r2c (p, in, out); }
+            static void execute_c2r (const plan p, complex* in, real* out) { fftwf_execute_dft_c2r (p, in, out); }
+            static void destroy (plan p) { fftwf_destroy_plan (p); }
+            static int alignment_of (const void* p) { return fftwf_alignment_of (reinterpret_cast<real*> (const_cast<void*> (p))); }
+        };
+# endif
+
+
+
+      // Everything that determines an FFTW plan: the type of transform,
+      //   the layout of the data, whether it is in-place, and the
+      //   alignment of the arrays (which must match on execution)
+      using plan_key = std::tuple<int, int, int, int, int, int, int, bool, int, int>;
+
+      enum { FORWARD_C2C, INVERSE_C2C, R2C, C2R };
+
+      template <typename ValueType>
+        plan_key make_key (const int type, const Layout& L, const void* in, const void* out) {
+          return plan_key (type, L.n, L.howmany, L.in_stride, L.in_dist, L.out_stride, L.out_dist,
+                           in == out, FFTW<ValueType>::alignment_of (in), FFTW<ValueType>::alignment_of (out));
+        }
+
+
+
+      // Plans shared by all instances; the FFTW planner is not thread-safe,
+      //   so all plans are created here under the lock
+      template <typename ValueType>
+        class PlanCache { NOMEMALIGN
+          public:
+            using plan = typename FFTW<ValueType>::plan;
+
+            ~PlanCache () {
+              for (auto& p : plans)
+                FFTW<ValueType>::destroy (p.second);
+            }
+
+            template <class Functor>
+              plan get (const plan_key& key, Functor&& create) {
+                std::lock_guard<std::mutex> lock (mutex);
+                auto it = plans.find (key);
+                if (it != plans.end())
+                  return it->second;
+                DEBUG ("creating FFTW plan for " + str(std::get<2>(key)) + " transforms of size " + str(std::get<1>(key)));
+                const plan p = create();
+                if (!p)
+                  throw Exception ("error creating FFTW plan");
+                plans[key] = p;
+                return p;
+              }
+
+          private:
+            std::mutex mutex;
+            std::map<plan_key, plan> plans;
+        };
+
+      template <typename ValueType>
+        PlanCache<ValueType>& plan_cache () {
+          static PlanCache<ValueType> cache;
+          return cache;
+        }
+
+
+
+      // Transforms all lines at once using FFTW; plans already used by this
+      //   instance are held locally to avoid locking the shared cache
+      template <typename ValueType>
+        class Engine<ValueType, true> { MEMALIGN(Engine<ValueType,true>)
+          public:
+            using complex_type = std::complex<ValueType>;
+
+            void c2c (const complex_type* in, complex_type* out, const Layout& L, const bool inverse)
+            {
+              auto p = get (make_key<ValueType> (inverse ? INVERSE_C2C : FORWARD_C2C, L, in, out), [&] {
+                  return traits::plan_c2c (L, complex_ptr (in), complex_ptr (out), inverse ? FFTW_BACKWARD : FFTW_FORWARD);
+                  });
+              traits::execute_c2c (p, complex_ptr (in), complex_ptr (out));
+            }
+
+            void r2c (const ValueType* in, complex_type* out, const Layout& L)
+            {
+              auto p = get (make_key<ValueType> (R2C, L, in, out), [&] {
+                  return traits::plan_r2c (L, const_cast<ValueType*> (in), complex_ptr (out));
+                  });
+              traits::execute_r2c (p, const_cast<ValueType*> (in), complex_ptr (out));
+            }
+
+            void c2r (const complex_type* in, ValueType* out, const Layout& L)
+            {
+              auto p = get (make_key<ValueType> (C2R, L, in, out), [&] {
+                  return traits::plan_c2r (L, complex_ptr (in), out);
+                  });
+              traits::execute_c2r (p, complex_ptr (in), out);
+            }
+
+          private:
+            using traits = FFTW<ValueType>;
+            std::map<plan_key, typename traits::plan> plans;
+
+            static typename traits::complex* complex_ptr (const complex_type* p) {
+              return reinterpret_cast<typename traits::complex*> (const_cast<complex_type*> (p));
+            }
+
+            template <class Functor>
+              typename traits::plan get (const plan_key& key, Functor&& create) {
+                auto it = plans.find (key);
+                if (it != plans.end())
+                  return it->second;
+                return plans[key] = plan_cache<ValueType>().get (key, std::forward<Functor> (create));
+              }
+        };
+
+#endif
+
+
+
+    }
+
+
+
+
+    template <typename ValueType>
+      class FFT<ValueType>::Backend : public Engine<ValueType> { MEMALIGN(FFT<ValueType>::Backend)
+      };
+
+
+
+
+    template <typename ValueType>
+      FFT<ValueType>::FFT () :
+          backend (new Backend) { }
+
+    template <typename ValueType>
+      FFT<ValueType>::FFT (const FFT&) :
+          backend (new Backend) { }
+
+    template <typename ValueType>
+      FFT<ValueType>::~FFT () { }
+
+
+
+    template <typename ValueType>
+      void FFT<ValueType>::forward (const complex_matrix_type& in, complex_matrix_type& out, const size_t axis)
+      {
+        if (&out != &in)
+          out.resize (in.rows(), in.cols());
+        if (!in.size())
+          return;
+        backend->c2c (in.data(), out.data(), layout (axis, axis ? in.cols() : in.rows(), in.rows(), in.cols(), out.rows()), false);
+      }
+
+
+
+    template <typename ValueType>
+      void FFT<ValueType>::inverse (const complex_matrix_type& in, complex_matrix_type& out, const size_t axis)
+      {
+        if (&out != &in)
+          out.resize (in.rows(), in.cols());
+        if (!in.size())
+          return;
+        const ssize_t n = axis ? in.cols() : in.rows();
+        backend->c2c (in.data(), out.data(), layout (axis, n, in.rows(), in.cols(), out.rows()), true);
+        out *= value_type(1) / n;
+      }
+
+
+
+    template <typename ValueType>
+      void FFT<ValueType>::forward (const real_matrix_type& in, complex_matrix_type& out, const size_t axis)
+      {
+        if (axis)
+          out.resize (in.rows(), in.cols()/2+1);
+        else
+          out.resize (in.rows()/2+1, in.cols());
+        if (!in.size())
+          return;
+        backend->r2c (in.data(), out.data(), layout (axis, axis ? in.cols() : in.rows(), in.rows(), in.cols(), out.rows()));
+      }
+
+
+
+    template <typename ValueType>
+      void FFT<ValueType>::inverse (const complex_matrix_type& in, real_matrix_type& out, const size_t axis, const size_t n)
+      {
+        if (size_t (axis ? in.cols() : in.rows()) != n/2+1)
+          throw Exception ("size of half spectrum does not match length of inverse real FFT");
+        if (axis)
+          out.resize (in.rows(), n);
+        else
+          out.resize (n, in.cols());
+        if (!out.size())
+          return;
+        backend->c2r (in.data(), out.data(), layout (axis, n, in.rows(), in.cols(), out.rows()));
+        out *= value_type(1) / n;
+      }
+
+
+
+    template class FFT<float>;
+    template class FFT<double>;
+
+
+
+  }
+}
+
@@ -0,0 +1,102 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __math_fft_h__
+#define __math_fft_h__
+
+#include <complex>
+#include <memory>
+
+#include "types.h"
+
+
+namespace MR
+{
+  namespace Math
+  {
+
+
+
+    //! batched one-dimensional discrete Fourier transforms
+    /*! Each call transforms all lines of a matrix along one of its
+     * dimensions: every column if \a axis is 0, every row if \a axis is 1.
+     * Transforms of real data produce (and the corresponding inverse
+     * transforms consume) only the non-redundant half of the spectrum,
+     * i.e. n/2+1 elements along the transformed axis. As for Eigen::FFT,
+     * forward transforms are unscaled, and inverse transforms are scaled
+     * by 1/n.
+     *
+     * If MRtrix3 was configured with FFTW, all lines are transformed with
+     * a single FFTW plan. Plans are created once for each distinct problem
+     * (transform type, size, number of lines, memory layout), and are
+     * then shared between all instances; executing them is thread-safe.
+     * Single precision transforms use FFTW only if its single precision
+     * library was also found. Otherwise, lines are transformed one at a
+     * time using Eigen's built-in (kissfft) implementation.
+     *
+     * An instance holds working buffers, and should therefore not be used
+     * by more than one thread at a time; copying an instance yields a new,
+     * independent instance.
+     *
+     * Typical usage:
+     * \code
+     * Math::FFT<double> fft;
+     * Eigen::MatrixXd slice = ...;
+     * Eigen::MatrixXcd kspace;
+     * fft.forward (slice, kspace, 0); // kspace has slice.rows()/2+1 rows
+     * fft.forward (kspace, kspace, 1);
+     * ...
+     * fft.inverse (kspace, kspace, 1);
+     * fft.inverse (kspace, slice, 0, slice.rows());
+     * \endcode */
+    template <typename ValueType>
+      class FFT { MEMALIGN(FFT<ValueType>)
+        public:
+          using value_type = ValueType;
+          using complex_type = std::complex<ValueType>;
+          using real_matrix_type = Eigen::Matrix<value_type, Eigen::Dynamic, Eigen::Dynamic>;
+          using complex_matrix_type = Eigen::Matrix<complex_type, Eigen::Dynamic, Eigen::Dynamic>;
+
+          FFT ();
+          FFT (const FFT&);
+          FFT& operator= (const FFT&) = delete;
+          ~FFT ();
+
+          //! forward complex transform; \a out may be the same matrix as \a in
+          void forward (const complex_matrix_type& in, complex_matrix_type& out, const size_t axis);
+          //! inverse complex transform; \a out may be the same matrix as \a in
+          void inverse (const complex_matrix_type& in, complex_matrix_type& out, const size_t axis);
+
+          //! forward transform of real data
+          /*! \a out is resized to hold n/2+1 elements along \a axis */
+          void forward (const real_matrix_type& in, complex_matrix_type& out, const size_t axis);
+          //! inverse transform to real data of length \a n
+          /*! \a in must hold n/2+1 elements along \a axis; the imaginary
+           * parts of the zero frequency (and, for even \a n, the Nyquist
+           * frequency) term are ignored. */
+          void inverse (const complex_matrix_type& in, real_matrix_type& out, const size_t axis, const size_t n);
+
+        private:
+          class Backend;
+          std::unique_ptr<Backend> backend;
+      };
+
+
+
+  }
+}
+
+#endif
@@ -25,6 +25,11 @@
 
 #define MRTRIX_USE_ZSTATISTIC_LOOKUP
 
+// Number of elements processed at once during batched evaluation of
+//   TestFixedHomoscedastic; bounds the memory required for intermediate
+//   results regardless of the number of elements or shuffles
+#define MRTRIX_GLM_ELEMENT_BLOCK_SIZE 1024
+
 //#define GLM_ALL_STATS_DEBUG
 
 namespace MR
@@ -553,6 +558,27 @@ namespace MR
 
 
 
+        void TestBase::batch (const matrix_type& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const
+        {
+          assert (size_t(shuffling_matrices.cols()) == num_inputs());
+          assert (!(shuffling_matrices.rows() % num_inputs()));
+          const size_t num_shuffles = shuffling_matrices.rows() / num_inputs();
+          stats .resize (num_shuffles);
+          zstats.resize (num_shuffles);
+          for (size_t is = 0; is != num_shuffles; ++is)
+            (*this) (shuffling_matrices.middleRows (is * num_inputs(), num_inputs()), stats[is], zstats[is]);
+        }
+
+
+
+        void TestBase::batch (const matrix_type& shuffling_matrices, vector<matrix_type>& output) const
+        {
+          vector<matrix_type> temp;
+          batch (shuffling_matrices, temp, output);
+        }
+
+
+
 
 
 
@@ -575,6 +601,7 @@ namespace MR
             partitions.emplace_back (h.partition (design));
             XtX.emplace_back (partitions.back().X.transpose()*partitions.back().X);
             one_over_dof.push_back (1.0 / (num_inputs() - partitions.back().rank_x - partitions.back().rank_z));
+            Rzy.emplace_back (partitions.back().Rz * y);
           }
         }
 
@@ -585,76 +612,92 @@ namespace MR
                                                 matrix_type& zstats) const
         {
           assert (size_t(shuffling_matrix.rows()) == num_inputs());
-          stats .resize (num_elements(), num_hypotheses());
-          zstats.resize (num_elements(), num_hypotheses());
+          vector<matrix_type> batch_stats, batch_zstats;
+          batch (shuffling_matrix, batch_stats, batch_zstats);
+          stats  = std::move (batch_stats[0]);
+          zstats = std::move (batch_zstats[0]);
+        }
+
+
+
+        void TestFixedHomoscedastic::batch (const matrix_type& shuffling_matrices,
+                                           vector<matrix_type>& stats,
+                                           vector<matrix_type>& zstats) const
+        {
+          assert (size_t(shuffling_matrices.cols()) == num_inputs());
+          assert (!(shuffling_matrices.rows() % num_inputs()));
+          const size_t num_shuffles = shuffling_matrices.rows() / num_inputs();
+          stats .resize (num_shuffles);
+          zstats.resize (num_shuffles);
+          for (size_t is = 0; is != num_shuffles; ++is) {
+            stats [is].resize (num_elements(), num_hypotheses());
+            zstats[is].resize (num_elements(), num_hypotheses());
+          }
 
-          matrix_type Sy, lambdas, residuals, beta;
-          vector_type sse;
+          matrix_type CpinvMS, RmS, betas, residuals;
 
           // Freedman-Lane for fixed design matrix case
           // Each hypothesis needs to be handled explicitly on its own
           for (size_t ih = 0; ih != c.size(); ++ih) {
 
-            // First, we perform permutation of the input data
-            // In Freedman-Lane, the initial 'effective' regression against the nuisance
-            //   variables, and permutation of the data, are done in a single step
-#ifdef GLM_TEST_DEBUG
-            VAR (shuffling_matrix.rows());
-            VAR (shuffling_matrix.cols());
-            VAR (partitions[ih].Rz.rows());
-            VAR (partitions[ih].Rz.cols());
-            VAR (y.rows());
-            VAR (y.cols());
-#endif
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
-#ifdef GLM_TEST_DEBUG
-            VAR (Sy.rows());
-            VAR (Sy.cols());
-            VAR (pinvM.rows());
-            VAR (pinvM.cols());
-#endif
-            // Now, we regress this shuffled data against the full model
-            lambdas.noalias() = pinvM * Sy;
+            // In Freedman-Lane, the data are regressed against the nuisance variables
+            //   and then shuffled; the regression is shared by all shuffles (Rzy).
+            // The shuffled data are then regressed against the full model; rather than
+            //   shuffling the data themselves, the shuffling matrices are instead folded
+            //   into the matrices that compute the effect (c * pinv(M)) and the model
+            //   residuals (Rm), and stacked for all shuffles in the batch
+            const ssize_t c_rows = c[ih].matrix().rows();
+            const matrix_type CpinvM (c[ih].matrix() * pinvM);
+            CpinvMS.resize (num_shuffles * c_rows, num_inputs());
+            RmS.resize (num_shuffles * num_inputs(), num_inputs());
+            for (size_t is = 0; is != num_shuffles; ++is) {
+              const auto S = shuffling_matrices.middleRows (is * num_inputs(), num_inputs());
+              CpinvMS.middleRows (is * c_rows, c_rows).noalias() = CpinvM * S;
+              RmS.middleRows (is * num_inputs(), num_inputs()).noalias() = Rm * S;
+            }
 #ifdef GLM_TEST_DEBUG
-            VAR (lambdas.rows());
-            VAR (lambdas.cols());
-            //VAR (matrix_type(c[ih]).rows());
-            //VAR (matrix_type(c[ih]).cols());
-            VAR (Rm.rows());
-            VAR (Rm.cols());
+            VAR (CpinvMS.rows());
+            VAR (CpinvMS.cols());
+            VAR (RmS.rows());
+            VAR (RmS.cols());
             VAR (XtX[ih].rows());
             VAR (XtX[ih].cols());
-            VAR (one_over_dof);
+            VAR (one_over_dof[ih]);
 #endif
             const size_t dof = num_inputs() - partitions[ih].rank_x - partitions[ih].rank_z;
-            const default_type one_over_dof = 1.0 / default_type(dof);
-            sse = (Rm*Sy).colwise().squaredNorm();
-#ifdef GLM_TEST_DEBUG
-            VAR (dof);
-            VAR (one_over_dof);
-            VAR (sse.size());
-#endif
-            for (size_t ie = 0; ie != num_elements(); ++ie) {
-              beta.noalias() = c[ih].matrix() * lambdas.col (ie);
-              const default_type F = ((beta.transpose() * XtX[ih] * beta) (0,0) / c[ih].rank()) /
-                                     (one_over_dof * sse[ie]);
-              if (!std::isfinite (F)) {
-                stats  (ie, ih) = zstats (ie, ih) = value_type(0);
-              } else if (c[ih].is_F()) {
-                stats  (ie, ih) = F;
+
+            for (size_t first = 0; first < num_elements(); first += MRTRIX_GLM_ELEMENT_BLOCK_SIZE) {
+              const size_t count = std::min (size_t(MRTRIX_GLM_ELEMENT_BLOCK_SIZE), num_elements() - first);
+              const auto block = Rzy[ih].middleCols (first, count);
+              betas.noalias() = CpinvMS * block;
+              residuals.noalias() = RmS * block;
+
+              for (size_t is = 0; is != num_shuffles; ++is) {
+                for (size_t i = 0; i != count; ++i) {
+                  const auto beta = betas.col (i).segment (is * c_rows, c_rows);
+                  const default_type sse = residuals.col (i).segment (is * num_inputs(), num_inputs()).squaredNorm();
+                  const default_type F = ((beta.transpose() * XtX[ih] * beta) (0,0) / c[ih].rank()) /
+                                         (one_over_dof[ih] * sse);
+                  const size_t ie = first + i;
+                  if (!std::isfinite (F)) {
+                    stats[is] (ie, ih) = zstats[is] (ie, ih) = value_type(0);
+                  } else if (c[ih].is_F()) {
+                    stats[is] (ie, ih) = F;
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->F2z (F, c[ih].rank(), dof);
+                    zstats[is] (ie, ih) = stat2z->F2z (F, c[ih].rank(), dof);
 #else
-                zstats (ie, ih) = Math::F2z (F, c[ih].rank(), dof);
+                    zstats[is] (ie, ih) = Math::F2z (F, c[ih].rank(), dof);
 #endif
-              } else {
-                assert (beta.rows() == 1);
-                stats  (ie, ih) = std::sqrt (F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
+                  } else {
+                    assert (beta.rows() == 1);
+                    stats[is] (ie, ih) = std::sqrt (F) * (beta.sum() > 0.0 ? 1.0 : -1.0);
 #ifdef MRTRIX_USE_ZSTATISTIC_LOOKUP
-                zstats (ie, ih) = stat2z->t2z (stats (ie, ih), dof);
+                    zstats[is] (ie, ih) = stat2z->t2z (stats[is] (ie, ih), dof);
 #else
-                zstats (ie, ih) = Math::t2z (stats (ie, ih), dof);
+                    zstats[is] (ie, ih) = Math::t2z (stats[is] (ie, ih), dof);
 #endif
+                  }
+                }
               }
             }
 
@@ -720,7 +763,7 @@ namespace MR
 
           for (size_t ih = 0; ih != c.size(); ++ih) {
             // First two steps are identical to the homoscedastic case
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
+            Sy.noalias() = shuffling_matrix * Rzy[ih];
 #ifdef GLM_TEST_DEBUG
             VAR (Sy);
 #endif
@@ -242,6 +242,22 @@ namespace MR
              */
             virtual void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const = 0;
 
+            /*! Compute the statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals for each shuffle, stacked vertically
+             * @param stats the output statistics for each shuffle (one column per hypothesis)
+             * @param zstats the Z-transformed output statistics for each shuffle (one column per hypothesis)
+             *
+             * The default implementation simply processes each shuffle in turn; derived classes
+             *   that can share work between shuffles should override it.
+             */
+            virtual void batch (const matrix_type& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const;
+
+            /*! Compute Z-statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals for each shuffle, stacked vertically
+             * @param output the Z-statistics for each shuffle (one column per hypothesis)
+             */
+            void batch (const matrix_type& shuffling_matrices, vector<matrix_type>& output) const;
+
 
             size_t num_inputs () const { return M.rows(); }
             size_t num_elements () const { return y.cols(); }
@@ -289,6 +305,18 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            /*! Compute the statistics for a batch of shuffles
+             * @param shuffling_matrices the matrices to permute / sign flip the residuals for each shuffle, stacked vertically
+             * @param stats the output statistics for each shuffle (one column per hypothesis)
+             * @param zstats the Z-transformed output statistics for each shuffle (one column per hypothesis)
+             *
+             * Since the design matrix is shared across all elements, the shuffling matrices
+             *   can be folded into the (small) matrices that compute the model fit and
+             *   residuals, such that all shuffles in the batch are evaluated for a block of
+             *   elements using one matrix product for each.
+             */
+            void batch (const matrix_type& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const override;
+
           protected:
             // New classes to store information relevant to Freedman-Lane implementation
             vector<Hypothesis::Partition> partitions;
@@ -296,6 +324,9 @@ namespace MR
             const matrix_type Rm;
             vector<matrix_type> XtX;
             vector<default_type> one_over_dof;
+            // Input data after regression against the nuisance variables of each hypothesis;
+            //   these do not depend on the shuffle, so are computed only once
+            vector<matrix_type> Rzy;
 
         };
         //! @}
@@ -335,6 +366,11 @@ namespace MR
              */
             void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
 
+            // The batched evaluation of TestFixedHomoscedastic does not apply here
+            void batch (const matrix_type& shuffling_matrices, vector<matrix_type>& stats, vector<matrix_type>& zstats) const override {
+              TestBase::batch (shuffling_matrices, stats, zstats);
+            }
+
           protected:
             // Variance group assignments
             const index_array_type& VG;
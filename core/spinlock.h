@@ -14,6 +14,9 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#ifndef __spinlock_h__
+#define __spinlock_h__
+
 #include <atomic>
 #include <mutex>
 
@@ -29,3 +32,5 @@ namespace MR {
   };
 
 }
+
+#endif
@@ -16,10 +16,19 @@
 
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
 
 #include "app.h"
 #include "thread.h"
 #include "file/config.h"
+#include "file/path.h"
 #include "thread_queue.h"
 
 namespace MR
@@ -92,6 +101,248 @@ namespace MR
 
 
 
+    namespace {
+
+      // Workers share ownership of the pool: at program exit, the pool is
+      //   only asked to stop, and the workers are detached rather than
+      //   joined, so that a worker that is still running a task (e.g. if
+      //   exit() was invoked from another thread) cannot hang the process
+      class Pool : public std::enable_shared_from_this<Pool> { NOMEMALIGN
+        public:
+          Pool () : idle (0), stop (false), num_tasks (0), total_latency (0), max_latency (0), affinity_initialised (false) { }
+
+          // Only invoked once no worker remains, possibly from the last worker
+          //   to exit, which cannot join itself
+          ~Pool ()
+          {
+            for (auto& w : workers)
+              if (w.joinable())
+                w.detach();
+          }
+
+          void shutdown ()
+          {
+            std::lock_guard<std::mutex> lock (mutex);
+            stop = true;
+            condition.notify_all();
+            if (num_tasks)
+              DEBUG ("thread pool: " + str(num_tasks) + " tasks run on " + str(workers.size()) + " workers; "
+                     "dispatch latency mean " + str(total_latency / int64_t(1000 * num_tasks)) + " us, max " + str(max_latency / 1000) + " us");
+          }
+
+          void add_task_initialiser (std::function<void()>&& function)
+          {
+            std::lock_guard<std::mutex> lock (mutex);
+            initialisers.push_back (std::move (function));
+          }
+
+          std::future<void> launch (std::function<void()>&& function)
+          {
+            std::packaged_task<void()> task (std::move (function));
+            auto future = task.get_future();
+            std::lock_guard<std::mutex> lock (mutex);
+            tasks.push_back ({ std::move (task), __ThreadPool::clock::now() });
+            // Each queued task is reserved a worker, so that no task ever waits
+            //   on the completion of an unrelated one
+            if (idle) {
+              --idle;
+              condition.notify_one();
+            } else {
+              const size_t index = workers.size();
+              auto self = shared_from_this();
+              workers.push_back (std::thread ([self, index] () { self->run (index); }));
+            }
+            return future;
+          }
+
+        protected:
+          struct Task { NOMEMALIGN
+            std::packaged_task<void()> task;
+            __ThreadPool::clock::time_point submitted;
+          };
+
+          std::mutex mutex;
+          std::condition_variable condition;
+          vector<std::thread> workers;
+          std::deque<Task> tasks;
+          vector<std::function<void()>> initialisers;
+          size_t idle;
+          bool stop;
+
+          // Dispatch statistics, for reporting on exit
+          size_t num_tasks;
+          int64_t total_latency, max_latency;
+
+          // CPUs to which successive workers are pinned, if requested
+          bool affinity_initialised;
+          vector<int> cpus;
+
+          void run (const size_t index)
+          {
+            set_affinity (index);
+            std::unique_lock<std::mutex> lock (mutex);
+            while (true) {
+              condition.wait (lock, [this] { return stop || tasks.size(); });
+              if (tasks.empty())
+                return;
+              Task task (std::move (tasks.front()));
+              tasks.pop_front();
+              const int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds> (__ThreadPool::clock::now() - task.submitted).count();
+              ++num_tasks;
+              total_latency += latency;
+              max_latency = std::max (max_latency, latency);
+              lock.unlock();
+              for (const auto& initialise : initialisers)
+                initialise();
+              task.task();
+              lock.lock();
+              ++idle;
+            }
+          }
+
+          void set_affinity (const size_t index);
+      };
+
+
+
+#ifdef __linux__
+      // Parse a CPU list as found in sysfs (e.g. "0-3,8-11")
+      vector<int> parse_cpulist (const std::string& list)
+      {
+        vector<int> result;
+        for (const auto& range : split (strip (list), ",", true)) {
+          const auto dash = range.find ('-');
+          const int first = to<int> (range.substr (0, dash));
+          const int last = dash == std::string::npos ? first : to<int> (range.substr (dash + 1));
+          for (int cpu = first; cpu <= last; ++cpu)
+            result.push_back (cpu);
+        }
+        return result;
+      }
+#endif
+
+
+
+      void Pool::set_affinity (const size_t index)
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        if (stop)
+          return;
+
+        if (!affinity_initialised) {
+          affinity_initialised = true;
+          //CONF option: ThreadAffinity
+          //CONF default: none
+          //CONF Pin the worker threads used for multi-threading to CPU cores
+          //CONF (Linux only). Set to "compact" to fill all cores of one NUMA
+          //CONF node before moving on to the next, "scatter" to distribute
+          //CONF successive threads across NUMA nodes in a round-robin fashion,
+          //CONF or "none" to let the operating system schedule threads freely.
+          const std::string affinity = lowercase (File::Config::get ("ThreadAffinity", "none"));
+          if (affinity == "none")
+            return;
+          if (affinity != "compact" && affinity != "scatter") {
+            WARN ("invalid value for ThreadAffinity configuration option (\"" + affinity + "\"); ignoring");
+            return;
+          }
+#ifdef __linux__
+          cpu_set_t allowed;
+          CPU_ZERO (&allowed);
+          if (sched_getaffinity (0, sizeof (allowed), &allowed)) {
+            WARN ("unable to query CPU affinity of process; ThreadAffinity ignored");
+            return;
+          }
+
+          // Group the available CPUs by NUMA node
+          vector<vector<int>> nodes;
+          for (size_t node = 0; ; ++node) {
+            const std::string path ("/sys/devices/system/node/node" + str(node) + "/cpulist");
+            if (!Path::exists (path))
+              break;
+            std::ifstream in (path);
+            std::string list;
+            std::getline (in, list);
+            vector<int> node_cpus;
+            try {
+              for (const auto cpu : parse_cpulist (list))
+                if (cpu < CPU_SETSIZE && CPU_ISSET (cpu, &allowed))
+                  node_cpus.push_back (cpu);
+            } catch (Exception&) { }
+            if (node_cpus.size())
+              nodes.push_back (std::move (node_cpus));
+          }
+          if (nodes.empty()) {
+            nodes.push_back (vector<int>());
+            for (int cpu = 0; cpu != CPU_SETSIZE; ++cpu)
+              if (CPU_ISSET (cpu, &allowed))
+                nodes.back().push_back (cpu);
+          }
+
+          if (affinity == "compact") {
+            for (const auto& node : nodes)
+              cpus.insert (cpus.end(), node.begin(), node.end());
+          } else {
+            for (size_t i = 0; ; ++i) {
+              bool any = false;
+              for (const auto& node : nodes) {
+                if (i < node.size()) {
+                  cpus.push_back (node[i]);
+                  any = true;
+                }
+              }
+              if (!any)
+                break;
+            }
+          }
+          DEBUG ("thread pool: pinning workers to CPUs [ " + join (cpus, " ") + " ] across " + str(nodes.size()) + " NUMA node(s)");
+#else
+          WARN ("ThreadAffinity configuration option is only supported on Linux; ignoring");
+#endif
+        }
+
+#ifdef __linux__
+        if (cpus.empty())
+          return;
+        cpu_set_t set;
+        CPU_ZERO (&set);
+        CPU_SET (cpus[index % cpus.size()], &set);
+        if (pthread_setaffinity_np (pthread_self(), sizeof (set), &set))
+          DEBUG ("unable to set CPU affinity of worker thread " + str(index));
+#endif
+      }
+
+
+
+      class PoolOwner { NOMEMALIGN
+        public:
+          PoolOwner () : pool (std::make_shared<Pool>()) { }
+          ~PoolOwner () { pool->shutdown(); }
+          std::shared_ptr<Pool> pool;
+      };
+
+      Pool& pool ()
+      {
+        static PoolOwner owner;
+        return *owner.pool;
+      }
+
+    }
+
+
+
+    std::future<void> __ThreadPool::launch (std::function<void()>&& task)
+    {
+      return pool().launch (std::move (task));
+    }
+
+    void __ThreadPool::add_task_initialiser (std::function<void()>&& function)
+    {
+      pool().add_task_initialiser (std::move (function));
+    }
+
+
+
+
     void (*__Backend::previous_print_func) (const std::string& msg) = nullptr;
     void (*__Backend::previous_report_to_user_func) (const std::string& msg, int type) = nullptr;
 
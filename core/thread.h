@@ -17,8 +17,12 @@
 #ifndef __mrtrix_thread_h__
 #define __mrtrix_thread_h__
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <thread>
 #include <future>
+#include <memory>
 #include <mutex>
 
 #include "debug.h"
@@ -94,11 +98,65 @@ namespace MR
     };
 
 
+
+    //! persistent pool of worker threads on which all threads are run
+    /*! Threads launched via Thread::run(), Thread::run_queue() and
+     * ThreadedLoop are executed on workers drawn from this pool, rather than
+     * on newly created threads; workers are returned to the pool once their
+     * task completes. A new worker is created whenever no idle worker is
+     * available, so that tasks that depend on each other (e.g. the stages of
+     * a Thread::Queue pipeline) can never deadlock waiting for a free worker.
+     * The pool never shrinks: it holds as many workers as there were tasks
+     * running concurrently at any one time. On program exit, idle workers
+     * are stopped, and any worker still running a task is detached rather
+     * than waited for.
+     *
+     * Since workers are re-used, thread-local variables persist from one task
+     * to the next; functions registered using add_task_initialiser() are
+     * invoked on the worker before each task, and can be used to reset such
+     * state.
+     *
+     * Workers can be pinned to specific CPU cores (Linux only), using the
+     * ThreadAffinity configuration file option. */
+    class __ThreadPool { NOMEMALIGN
+      public:
+        using clock = std::chrono::steady_clock;
+
+        static std::future<void> launch (std::function<void()>&& task);
+        //! register a function to be invoked on the worker before each task
+        /*! This should be done before any thread is launched, typically
+         * during static initialisation. */
+        static void add_task_initialiser (std::function<void()>&& function);
+    };
+
+
+
+    //! timing of the dispatch of a set of threads to the pool
+    class __DispatchTimer { NOMEMALIGN
+      public:
+        __DispatchTimer () : launched (__ThreadPool::clock::now()), max_latency (0) { }
+
+        //! to be called by each thread as it starts executing
+        void started () {
+          const int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds> (__ThreadPool::clock::now() - launched).count();
+          int64_t previous = max_latency.load();
+          while (latency > previous && !max_latency.compare_exchange_weak (previous, latency));
+        }
+
+        //! longest delay between the launch and the start of execution of any thread, in microseconds
+        int64_t latency () const { return max_latency.load() / 1000; }
+
+      protected:
+        const __ThreadPool::clock::time_point launched;
+        std::atomic<int64_t> max_latency;
+    };
+
+
     namespace {
 
       class __thread_base { NOMEMALIGN
         public:
-          __thread_base (const std::string& name = "unnamed") : name (name) { __Backend::register_thread(); }
+          __thread_base (const std::string& name = "unnamed") : name (name), dispatch (new __DispatchTimer) { __Backend::register_thread(); }
           __thread_base (const __thread_base&) = delete;
           __thread_base (__thread_base&&) = default;
           ~__thread_base () { __Backend::unregister_thread(); }
@@ -106,6 +164,17 @@ namespace MR
 
         protected:
           const std::string name;
+          std::shared_ptr<__DispatchTimer> dispatch;
+
+          template <class F>
+            std::future<void> launch (F& functor) {
+              auto timer = dispatch;
+              return __ThreadPool::launch ([&functor, timer] () { timer->started(); functor.execute(); });
+            }
+
+          std::string dispatch_overhead () const {
+            return "max. dispatch latency " + str(dispatch->latency()) + " us";
+          }
       };
 
 
@@ -115,8 +184,7 @@ namespace MR
             __single_thread (Functor&& functor, const std::string& name = "unnamed") :
             __thread_base (name) {
               DEBUG ("launching thread \"" + name + "\"...");
-              using F = typename std::remove_reference<Functor>::type;
-              thread = std::async (std::launch::async, &F::execute, &functor);
+              thread = launch (functor);
             }
           __single_thread (const __single_thread&) = delete;
           __single_thread (__single_thread&&) = default;
@@ -129,7 +197,7 @@ namespace MR
           void wait () noexcept (false) {
             DEBUG ("waiting for completion of thread \"" + name + "\"...");
             thread.get();
-            DEBUG ("thread \"" + name + "\" completed OK");
+            DEBUG ("thread \"" + name + "\" completed OK (" + dispatch_overhead() + ")");
           }
 
           ~__single_thread () {
@@ -150,11 +218,10 @@ namespace MR
             __multi_thread (Functor& functor, size_t nthreads, const std::string& name = "unnamed") :
               __thread_base (name), functors ( (nthreads>0 ? nthreads-1 : 0), functor) {
                 DEBUG ("launching " + str (nthreads) + " threads \"" + name + "\"...");
-                using F = typename std::remove_reference<Functor>::type;
                 threads.reserve (nthreads);
                 for (auto& f : functors)
-                  threads.push_back (std::async (std::launch::async, &F::execute, &f));
-                threads.push_back (std::async (std::launch::async, &F::execute, &functor));
+                  threads.push_back (launch (f));
+                threads.push_back (launch (functor));
               }
 
             __multi_thread (const __multi_thread&) = delete;
@@ -174,7 +241,7 @@ namespace MR
               }
               if (exception_thrown)
                 throw Exception ("exception thrown from one or more threads \"" + name + "\"");
-              DEBUG ("threads \"" + name + "\" completed OK");
+              DEBUG ("threads \"" + name + "\" completed OK (" + dispatch_overhead() + ")");
             }
 
             bool finished () const {
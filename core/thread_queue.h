@@ -23,9 +23,11 @@
 #include "exception.h"
 #include "memory.h"
 #include "thread.h"
+#include "thread_ring.h"
 
 #define MRTRIX_QUEUE_DEFAULT_CAPACITY 128
 #define MRTRIX_QUEUE_DEFAULT_BATCH_SIZE 128
+#define MRTRIX_QUEUE_SPIN_COUNT 256
 
 namespace MR
 {
@@ -125,6 +127,283 @@ namespace MR
 
 
 
+     namespace QueueBackend
+     {
+
+       //! the original mutex-protected storage for Thread::Queue
+       /*! Every push and pop operation acquires the queue's mutex, and
+        * threads wait on condition variables when the queue is full or empty.
+        * This is retained mostly for benchmarking purposes - see
+        * Thread::QueueBackend::LockFree. */
+       template <class T> class Locking { NOMEMALIGN
+         protected:
+         Locking (const std::string& description, size_t buffer_size) :
+           buffer (new T* [buffer_size]),
+           front (buffer),
+           back (buffer),
+           capacity (buffer_size),
+           writer_count (0),
+           reader_count (0),
+           name (description) {
+             assert (capacity > 0);
+           }
+
+         ~Locking () {
+           delete [] buffer;
+         }
+
+         std::string status () {
+           std::lock_guard<std::mutex> lock (mutex);
+           return "Thread::Queue \"" + name + "\": "
+             + str(writer_count) + " writer" + (writer_count > 1 ? "s" : "") + ", "
+             + str(reader_count) + " reader" + (reader_count > 1 ? "s" : "") + ", items waiting: " + str(size());
+         }
+
+         std::mutex mutex;
+         std::condition_variable more_data, more_space;
+         T** buffer;
+         T** front;
+         T** back;
+         size_t capacity;
+         size_t writer_count, reader_count;
+         std::stack<T*,vector<T*> > item_stack;
+         vector<std::unique_ptr<T>> items;
+         const std::string name;
+
+         void register_writer ()   {
+           std::lock_guard<std::mutex> lock (mutex);
+           ++writer_count;
+         }
+         void unregister_writer () {
+           std::lock_guard<std::mutex> lock (mutex);
+           assert (writer_count);
+           --writer_count;
+           if (!writer_count) {
+             DEBUG ("no writers left on queue \"" + name + "\"");
+             more_data.notify_all();
+           }
+         }
+         void register_reader ()   {
+           std::lock_guard<std::mutex> lock (mutex);
+           ++reader_count;
+         }
+         void unregister_reader () {
+           std::lock_guard<std::mutex> lock (mutex);
+           assert (reader_count);
+           --reader_count;
+           if (!reader_count) {
+             DEBUG ("no readers left on queue \"" + name + "\"");
+             more_space.notify_all();
+           }
+         }
+
+         FORCE_INLINE bool empty () const {
+           return (front == back);
+         }
+         FORCE_INLINE bool full () const {
+           return (inc (back) == front);
+         }
+         FORCE_INLINE size_t size () const {
+           return ( (back < front ? back+capacity : back) - front);
+         }
+
+         FORCE_INLINE T* get_item () {
+           std::lock_guard<std::mutex> lock (mutex);
+           T* item (new T);
+           items.push_back (std::unique_ptr<T> (item));
+           return item;
+         }
+
+         FORCE_INLINE bool push (T*& item) {
+           std::unique_lock<std::mutex> lock (mutex);
+           more_space.wait (lock, [this]{ return !(full() && reader_count); });
+           if (!reader_count) return false;
+           *back = item;
+           back = inc (back);
+           if (item_stack.empty()) {
+             item = new T;
+             items.push_back (std::unique_ptr<T> (item));
+           }
+           else {
+             item = item_stack.top();
+             item_stack.pop();
+           }
+           more_data.notify_one();
+           return true;
+         }
+
+         FORCE_INLINE bool pop (T*& item) {
+           std::unique_lock<std::mutex> lock (mutex);
+           if (item)
+             item_stack.push (item);
+           item = nullptr;
+           more_data.wait (lock, [this]{ return !(empty() && writer_count); });
+           if (empty() && !writer_count)
+             return false;
+           item = *front;
+           front = inc (front);
+           more_space.notify_one();
+           return true;
+         }
+
+         FORCE_INLINE void recycle (T*& item) {
+           std::unique_lock<std::mutex> lock (mutex);
+           if (item)
+             item_stack.push (item);
+         }
+
+         FORCE_INLINE T** inc (T** p) const {
+           ++p;
+           if (p >= buffer + capacity) p = buffer;
+           return p;
+         }
+       };
+
+
+
+       //! lock-free storage for Thread::Queue
+       /*! Items are handed over through a lock-free bounded ring buffer
+        * (Thread::Ring), and spare items are recycled through a second such
+        * ring. Threads that find the queue full (writers) or empty (readers)
+        * spin for MRTRIX_QUEUE_SPIN_COUNT attempts before parking on a
+        * condition variable. The mutex is only involved when parking or waking
+        * threads, and when allocating new items. */
+       template <class T> class LockFree { NOMEMALIGN
+         protected:
+         LockFree (const std::string& description, size_t buffer_size) :
+           data (buffer_size),
+           spare (2*buffer_size),
+           writer_count (0),
+           reader_count (0),
+           waiting_writers (0),
+           waiting_readers (0),
+           name (description) {
+             assert (buffer_size > 0);
+           }
+
+         std::string status () {
+           const size_t writers = writer_count, readers = reader_count;
+           return "Thread::Queue \"" + name + "\": "
+             + str(writers) + " writer" + (writers > 1 ? "s" : "") + ", "
+             + str(readers) + " reader" + (readers > 1 ? "s" : "") + ", items waiting: " + str(data.size());
+         }
+
+         std::mutex mutex;
+         std::condition_variable more_data, more_space;
+         Ring<T*> data, spare;
+         std::atomic<size_t> writer_count, reader_count;
+         std::atomic<size_t> waiting_writers, waiting_readers;
+         vector<T*> overflow;
+         vector<std::unique_ptr<T>> items;
+         const std::string name;
+
+         void register_writer ()   {
+           ++writer_count;
+         }
+         void unregister_writer () {
+           assert (writer_count);
+           if (!(--writer_count)) {
+             DEBUG ("no writers left on queue \"" + name + "\"");
+             std::lock_guard<std::mutex> lock (mutex);
+             more_data.notify_all();
+           }
+         }
+         void register_reader ()   {
+           ++reader_count;
+         }
+         void unregister_reader () {
+           assert (reader_count);
+           if (!(--reader_count)) {
+             DEBUG ("no readers left on queue \"" + name + "\"");
+             std::lock_guard<std::mutex> lock (mutex);
+             more_space.notify_all();
+           }
+         }
+
+         FORCE_INLINE T* get_item () {
+           T* item;
+           if (spare.try_pop (item))
+             return item;
+           std::lock_guard<std::mutex> lock (mutex);
+           if (overflow.size()) {
+             item = overflow.back();
+             overflow.pop_back();
+             return item;
+           }
+           item = new T;
+           items.push_back (std::unique_ptr<T> (item));
+           return item;
+         }
+
+         FORCE_INLINE void release_item (T* item) {
+           if (spare.try_push (item))
+             return;
+           std::lock_guard<std::mutex> lock (mutex);
+           overflow.push_back (item);
+         }
+
+         // spin on condition, then park on condition variable if still not met:
+         template <class Condition>
+           FORCE_INLINE void wait_until (Condition&& condition, std::atomic<size_t>& waiting, std::condition_variable& cv) {
+             for (size_t n = 0; n < MRTRIX_QUEUE_SPIN_COUNT; ++n) {
+               if (condition())
+                 return;
+               spin_wait (n);
+             }
+             std::unique_lock<std::mutex> lock (mutex);
+             ++waiting;
+             std::atomic_thread_fence (std::memory_order_seq_cst);
+             cv.wait (lock, condition);
+             --waiting;
+           }
+
+         FORCE_INLINE void notify (std::atomic<size_t>& waiting, std::condition_variable& cv) {
+           std::atomic_thread_fence (std::memory_order_seq_cst);
+           if (waiting.load()) {
+             std::lock_guard<std::mutex> lock (mutex);
+             cv.notify_one();
+           }
+         }
+
+         FORCE_INLINE bool push (T*& item) {
+           bool pushed = false;
+           wait_until ([&] { return !reader_count || (pushed = data.try_push (item)); }, waiting_writers, more_space);
+           if (!pushed)
+             return false;
+           notify (waiting_readers, more_data);
+           item = get_item();
+           return true;
+         }
+
+         FORCE_INLINE bool pop (T*& item) {
+           if (item)
+             release_item (item);
+           item = nullptr;
+           wait_until ([&] {
+               if (data.try_pop (item))
+                 return true;
+               if (writer_count)
+                 return false;
+               // no writers left: check for any item pushed before the last writer unregistered
+               data.try_pop (item);
+               return true;
+               }, waiting_readers, more_data);
+           if (!item)
+             return false;
+           notify (waiting_writers, more_space);
+           return true;
+         }
+
+         FORCE_INLINE void recycle (T*& item) {
+           if (item)
+             release_item (item);
+         }
+       };
+
+     }
+
+
+
     //! A first-in first-out thread-safe item queue
     /*! This class implements a thread-safe means of pushing data items into a
      * queue, so that they can each be processed in one or more separate
@@ -134,6 +413,13 @@ namespace MR
      * function Thread::run_queue(). You should never need to use the
      * Thread::Queue directly unless you have a very unusual situation.
      *
+     * The storage and synchronisation of the queue are delegated to the \a
+     * Backend template parameter. By default, this is
+     * Thread::QueueBackend::LockFree, which hands items over through a
+     * lock-free ring buffer and only parks threads after spinning briefly.
+     * The original mutex-based implementation is available as
+     * Thread::QueueBackend::Locking.
+     *
      * \section thread_queue_usage Usage overview
      *
      * Thread::Queue has somewhat unusual usage, which consists of the following
@@ -331,7 +617,8 @@ namespace MR
      *
      * \sa Thread::run_queue()
      */
-     template <class T> class Queue { NOMEMALIGN
+     template <class T, template <class> class Backend = QueueBackend::LockFree>
+       class Queue : protected Backend<T> { NOMEMALIGN
        public:
          //! Construct a Queue of items of type \c T
          /*! \param description a string identifying the queue for degugging purposes
@@ -342,25 +629,10 @@ namespace MR
           * MRTRIX_QUEUE_DEFAULT_CAPACITY items.
           */
          Queue (const std::string& description = "unnamed", size_t buffer_size = MRTRIX_QUEUE_DEFAULT_CAPACITY) :
-           buffer (new T* [buffer_size]),
-           front (buffer),
-           back (buffer),
-           capacity (buffer_size),
-           writer_count (0),
-           reader_count (0),
-           name (description) {
-             assert (capacity > 0);
-           }
+           Backend<T> (description, buffer_size) { }
 
          Queue (const Queue&) = delete;
-         Queue (Queue&&) = default;
          Queue& operator= (const Queue&) = delete;
-         Queue& operator= (Queue&&) = default;
-
-
-         ~Queue () {
-           delete [] buffer;
-         }
 
          //! This class is used to register a writer with the queue
          /*! Items cannot be written directly onto a Thread::Queue queue. An
@@ -377,7 +649,7 @@ namespace MR
              //! Register a Writer object with the queue
              /*! The Writer object will register itself with the queue as a
               * writer. */
-             Writer (Queue<T>& queue) : Q (queue) {
+             Writer (Queue& queue) : Q (queue) {
                Q.register_writer();
              }
              Writer (const Writer& W) : Q (W.Q) {
@@ -421,14 +693,14 @@ namespace MR
                    return p;
                  }
                private:
-                 Queue<T>& Q;
+                 Queue& Q;
                  T* p;
              };
 
              Item placeholder () const { return Item (*this); }
 
            private:
-             Queue<T>& Q;
+             Queue& Q;
          };
 
 
@@ -447,7 +719,7 @@ namespace MR
              //! Register a Reader object with the queue.
              /*! The Reader object will register itself with the queue as a
               * reader. */
-             Reader (Queue<T>& queue) : Q (queue) {
+             Reader (Queue& queue) : Q (queue) {
                Q.register_reader();
              }
              Reader (const Reader& reader) : Q (reader.Q) {
@@ -502,124 +774,21 @@ namespace MR
                    return !p;
                  }
                private:
-                 Queue<T>& Q;
+                 Queue& Q;
                  T* p;
              };
 
              Item placeholder () const { return Item (*this); }
 
            private:
-             Queue<T>& Q;
+             Queue& Q;
          };
 
          //! Print out a status report for debugging purposes
          void status () {
-           std::lock_guard<std::mutex> lock (mutex);
-           std::cerr << "Thread::Queue \"" + name + "\": "
-             << writer_count << " writer" << (writer_count > 1 ? "s" : "") << ", "
-             << reader_count << " reader" << (reader_count > 1 ? "s" : "") << ", items waiting: " << size() << "\n";
-         }
-
-
-       private:
-         std::mutex mutex;
-         std::condition_variable more_data, more_space;
-         T** buffer;
-         T** front;
-         T** back;
-         size_t capacity;
-         size_t writer_count, reader_count;
-         std::stack<T*,vector<T*> > item_stack;
-         vector<std::unique_ptr<T>> items;
-         std::string name;
-
-         void register_writer ()   {
-           std::lock_guard<std::mutex> lock (mutex);
-           ++writer_count;
-         }
-         void unregister_writer () {
-           std::lock_guard<std::mutex> lock (mutex);
-           assert (writer_count);
-           --writer_count;
-           if (!writer_count) {
-             DEBUG ("no writers left on queue \"" + name + "\"");
-             more_data.notify_all();
-           }
-         }
-         void register_reader ()   {
-           std::lock_guard<std::mutex> lock (mutex);
-           ++reader_count;
-         }
-         void unregister_reader () {
-           std::lock_guard<std::mutex> lock (mutex);
-           assert (reader_count);
-           --reader_count;
-           if (!reader_count) {
-             DEBUG ("no readers left on queue \"" + name + "\"");
-             more_space.notify_all();
-           }
-         }
-
-         FORCE_INLINE bool empty () const {
-           return (front == back);
-         }
-         FORCE_INLINE bool full () const {
-           return (inc (back) == front);
-         }
-         FORCE_INLINE size_t size () const {
-           return ( (back < front ? back+capacity : back) - front);
+           std::cerr << Backend<T>::status() << "\n";
          }
 
-         FORCE_INLINE T* get_item () {
-           std::lock_guard<std::mutex> lock (mutex);
-           T* item (new T);
-           items.push_back (std::unique_ptr<T> (item));
-           return item;
-         }
-
-         FORCE_INLINE bool push (T*& item) {
-           std::unique_lock<std::mutex> lock (mutex);
-           more_space.wait (lock, [this]{ return !(full() && reader_count); });
-           if (!reader_count) return false;
-           *back = item;
-           back = inc (back);
-           if (item_stack.empty()) {
-             item = new T;
-             items.push_back (std::unique_ptr<T> (item));
-           }
-           else {
-             item = item_stack.top();
-             item_stack.pop();
-           }
-           more_data.notify_one();
-           return true;
-         }
-
-         FORCE_INLINE bool pop (T*& item) {
-           std::unique_lock<std::mutex> lock (mutex);
-           if (item)
-             item_stack.push (item);
-           item = nullptr;
-           more_data.wait (lock, [this]{ return !(empty() && writer_count); });
-           if (empty() && !writer_count)
-             return false;
-           item = *front;
-           front = inc (front);
-           more_space.notify_one();
-           return true;
-         }
-
-         FORCE_INLINE void recycle (T*& item) {
-           std::unique_lock<std::mutex> lock (mutex);
-           if (item)
-             item_stack.push (item);
-         }
-
-         FORCE_INLINE T** inc (T** p) const {
-           ++p;
-           if (p >= buffer + capacity) p = buffer;
-           return p;
-         }
      };
 
 
@@ -0,0 +1,159 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __mrtrix_thread_ring_h__
+#define __mrtrix_thread_ring_h__
+
+#include <atomic>
+#include <thread>
+
+#include "types.h"
+
+namespace MR
+{
+  namespace Thread
+  {
+
+    /** \addtogroup thread_classes
+     * @{ */
+
+    //! hint to the CPU that the calling thread is busy-waiting
+    /*! For the first few iterations of a spin loop, this issues the
+     * processor's pause instruction (where available); after that, it yields
+     * the remainder of the thread's time slice to avoid starving other threads
+     * when the system is oversubscribed. */
+    inline void spin_wait (size_t iteration)
+    {
+      if (iteration < 16) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__ ("yield");
+#endif
+      }
+      else
+        std::this_thread::yield();
+    }
+
+
+
+    //! a bounded, lock-free, multi-producer / multi-consumer ring buffer
+    /*! This implements the bounded MPMC queue of D. Vyukov: each cell in the
+     * ring carries a sequence number that indicates whether it is ready to be
+     * written or read for the current lap around the ring. Producers and
+     * consumers claim cells using a single compare-and-swap on the
+     * corresponding position counter, and neither ever blocks: try_push()
+     * fails if the ring is full, and try_pop() fails if it is empty.
+     *
+     * The capacity is rounded up to the next power of two. \a T should be
+     * cheap to copy (in Thread::Queue, it is a pointer to the actual item). */
+    template <class T>
+      class Ring { NOMEMALIGN
+        public:
+          Ring (size_t min_capacity) :
+            cells (round_up (min_capacity)),
+            mask (cells.size() - 1),
+            enqueue_pos (0),
+            dequeue_pos (0) {
+              for (size_t n = 0; n < cells.size(); ++n)
+                cells[n].sequence.store (n, std::memory_order_relaxed);
+            }
+
+          Ring (const Ring&) = delete;
+          Ring& operator= (const Ring&) = delete;
+
+          size_t capacity () const { return cells.size(); }
+
+          //! approximate number of items currently held in the ring
+          size_t size () const {
+            const size_t back = enqueue_pos.load (std::memory_order_relaxed);
+            const size_t front = dequeue_pos.load (std::memory_order_relaxed);
+            return back > front ? back - front : 0;
+          }
+
+          bool try_push (const T& item)
+          {
+            Cell* cell;
+            size_t pos = enqueue_pos.load (std::memory_order_relaxed);
+            while (true) {
+              cell = &cells[pos & mask];
+              const size_t seq = cell->sequence.load (std::memory_order_acquire);
+              const ssize_t diff = ssize_t (seq) - ssize_t (pos);
+              if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed))
+                  break;
+              }
+              else if (diff < 0)
+                return false;
+              else
+                pos = enqueue_pos.load (std::memory_order_relaxed);
+            }
+            cell->value = item;
+            cell->sequence.store (pos+1, std::memory_order_release);
+            return true;
+          }
+
+          bool try_pop (T& item)
+          {
+            Cell* cell;
+            size_t pos = dequeue_pos.load (std::memory_order_relaxed);
+            while (true) {
+              cell = &cells[pos & mask];
+              const size_t seq = cell->sequence.load (std::memory_order_acquire);
+              const ssize_t diff = ssize_t (seq) - ssize_t (pos+1);
+              if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak (pos, pos+1, std::memory_order_relaxed))
+                  break;
+              }
+              else if (diff < 0)
+                return false;
+              else
+                pos = dequeue_pos.load (std::memory_order_relaxed);
+            }
+            item = cell->value;
+            cell->sequence.store (pos+mask+1, std::memory_order_release);
+            return true;
+          }
+
+        protected:
+          struct Cell { NOMEMALIGN
+            std::atomic<size_t> sequence;
+            T value;
+          };
+
+          vector<Cell> cells;
+          const size_t mask;
+          // keep producer and consumer positions on separate cache lines:
+          char padding0[64];
+          std::atomic<size_t> enqueue_pos;
+          char padding1[64];
+          std::atomic<size_t> dequeue_pos;
+          char padding2[64];
+
+          static size_t round_up (size_t n) {
+            size_t size = 2;
+            while (size < n)
+              size <<= 1;
+            return size;
+          }
+      };
+
+    /** @} */
+  }
+}
+
+#endif
+
@@ -0,0 +1 @@
+__version__ = "3.0.8" #pylint: disable=unused-variable
@@ -0,0 +1,395 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_denoise_h__
+#define __dwi_denoise_h__
+
+#include <Eigen/Dense>
+#include <Eigen/Eigenvalues>
+
+#include "image.h"
+#include "algo/iterator.h"
+#include "algo/loop.h"
+
+// The MP-PCA denoising implemented here is subject to the additional
+//   copyright notice and conditions listed in the dwidenoise command
+
+namespace MR
+{
+  namespace DWI
+  {
+
+    // MP-PCA denoising of each voxel, using the DWI signals of all voxels
+    // within a patch centred on it; data type F may be real or complex
+    template <typename F = float>
+    class DenoisingFunctor {
+      MEMALIGN(DenoisingFunctor)
+
+    public:
+
+      using MatrixType = Eigen::Matrix<F, Eigen::Dynamic, Eigen::Dynamic>;
+      using VectorType = Eigen::Matrix<F, Eigen::Dynamic, 1>;
+      using RealType = typename Eigen::NumTraits<F>::Real;
+      using RealMatrixType = Eigen::Matrix<RealType, Eigen::Dynamic, Eigen::Dynamic>;
+      using RealVectorType = Eigen::Matrix<RealType, Eigen::Dynamic, 1>;
+      using SValsType = Eigen::VectorXd;
+
+      DenoisingFunctor (int ndwi, const vector<uint32_t>& extent,
+                        Image<bool>& mask, Image<float>& noise, bool exp1)
+        : extent {{extent[0]/2, extent[1]/2, extent[2]/2}},
+          m (ndwi), n (extent[0]*extent[1]*extent[2]),
+          r (std::min(m,n)), q (std::max(m,n)), exp1(exp1),
+          X (m,n), pos {{0, 0, 0}},
+          eig (r), tridiag (r), y (r), u0 (r), u1 (r), u2 (r),
+          mask (mask), noise (noise)
+      { }
+
+      template <typename ImageType>
+      void operator () (ImageType& dwi, ImageType& out)
+      {
+        // Process voxels in mask only
+        if (mask.valid()) {
+          assign_pos_of (dwi, 0, 3).to (mask);
+          if (!mask.value())
+            return;
+        }
+
+        // Load data in local window
+        load_data (dwi);
+
+        // Compute Eigendecomposition:
+        MatrixType XtX (r,r);
+        if (m <= n)
+          XtX.template triangularView<Eigen::Lower>() = X * X.adjoint();
+        else
+          XtX.template triangularView<Eigen::Lower>() = X.adjoint() * X;
+        denoise (XtX);
+
+        // Store output
+        assign_pos_of(dwi).to(out);
+        out.row(3) = X.col(n/2);
+
+        // store noise map if requested:
+        if (noise.valid()) {
+          assign_pos_of(dwi, 0, 3).to(noise);
+          noise.value() = float (std::sqrt(sigma2));
+        }
+      }
+
+    protected:
+      const std::array<ssize_t, 3> extent;
+      const ssize_t m, n, r, q;
+      const bool exp1;
+      MatrixType X;
+      std::array<ssize_t, 3> pos;
+      double sigma2;
+      Eigen::SelfAdjointEigenSolver<MatrixType> eig;
+      Eigen::Tridiagonalization<MatrixType> tridiag;
+      VectorType y;
+      RealMatrixType U;
+      RealVectorType u0, u1, u2;
+      Image<bool> mask;
+      Image<float> noise;
+
+      // Eigendecomposition of the (lower triangle of the) Gram matrix of the patch,
+      // noise level estimation, and denoising of the central voxel X.col(n/2)
+      //
+      // Only the eigenvalues are computed in full; the projection onto the signal
+      // components is then formed from the eigenvectors of either the signal or
+      // the noise components (whichever are fewer), obtained by inverse iteration
+      // on the tridiagonal form of the Gram matrix.
+      void denoise (const MatrixType& XtX)
+      {
+        const RealType scale = tridiagonalise (XtX);
+        // eigenvalues sorted in increasing order:
+        SValsType s = double (scale) * eig.eigenvalues().template cast<double>();
+
+        // Marchenko-Pastur optimal threshold
+        const double lam_r = std::max(s[0], 0.0) / q;
+        double clam = 0.0;
+        sigma2 = 0.0;
+        ssize_t cutoff_p = 0;
+        for (ssize_t p = 0; p < r; ++p)     // p+1 is the number of noise components
+        {                                   // (as opposed to the paper where p is defined as the number of signal components)
+          double lam = std::max(s[p], 0.0) / q;
+          clam += lam;
+          double gam = double(p+1) / (exp1 ? q : q-(r-p-1));
+          double sigsq1 = clam / double(p+1);
+          double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt(gam));
+          // sigsq2 > sigsq1 if signal else noise
+          if (sigsq2 < sigsq1) {
+            sigma2 = sigsq1;
+            cutoff_p = p+1;
+          }
+        }
+
+        if (cutoff_p > 0) {
+          // recombine data using only eigenvectors above threshold:
+          if (m <= n) {
+            y = X.col (n/2);
+          } else {
+            y.setZero();
+            y[n/2] = F(1.0);
+          }
+          y = tridiag.matrixQ().adjoint() * y;
+          const bool signal = r-cutoff_p <= cutoff_p;
+          if (signal)
+            tridiagonal_eigenvectors (cutoff_p, r);
+          else
+            tridiagonal_eigenvectors (0, cutoff_p);
+          const MatrixType V = U.template cast<F>();
+          const VectorType projection = V * (V.adjoint() * y);
+          if (signal)
+            y = projection;
+          else
+            y -= projection;
+          y = tridiag.matrixQ() * y;
+          if (m <= n)
+            X.col (n/2) = y;
+          else
+            X.col (n/2) = X * y;
+        }
+      }
+
+      // Tridiagonal form of the Gram matrix, and its eigenvalues; the matrix is
+      // scaled such that its largest entry is 1, as in SelfAdjointEigenSolver::compute(),
+      // since the convergence test of computeFromTridiagonal() is not scale-invariant
+      // (repeated eigenvalues may otherwise fail to converge, and be left unsorted).
+      // Returns the scale factor of the eigenvalues.
+      RealType tridiagonalise (const MatrixType& XtX)
+      {
+        // for a Gram matrix, the largest entry lies on the diagonal
+        RealType scale = XtX.diagonal().real().maxCoeff();
+        if (!(scale > RealType(0.0)))
+          scale = RealType(1.0);
+        tridiag.compute (XtX / scale);
+        eig.computeFromTridiagonal (tridiag.diagonal(), tridiag.subDiagonal(), Eigen::EigenvaluesOnly);
+        return scale;
+      }
+
+      // Eigenvectors of the tridiagonal matrix for eigenvalues [from, to), as the
+      // columns of U, by inverse iteration; eigenvectors are orthogonalised
+      // against each other within each iteration so as to remain distinct for
+      // (near-)degenerate eigenvalues
+      void tridiagonal_eigenvectors (ssize_t from, ssize_t to)
+      {
+        const auto& d (tridiag.diagonal());
+        const auto& e (tridiag.subDiagonal());
+        const RealType tiny = std::numeric_limits<RealType>::epsilon() *
+            std::max (d.cwiseAbs().maxCoeff() + (r > 1 ? RealType(2.0) * e.cwiseAbs().maxCoeff() : RealType(0.0)),
+                      std::numeric_limits<RealType>::min());
+        U.resize (r, to-from);
+        RealType shift = RealType(0.0);
+        for (ssize_t k = 0; k < to-from; ++k) {
+          // (near-)repeated eigenvalues are perturbed so as to be separated
+          // by at least 10 tiny, as in LAPACK's xSTEIN
+          shift = k ? std::max (RealType (eig.eigenvalues()[from+k]), shift + RealType(10.0) * tiny) : RealType (eig.eigenvalues()[from]);
+          auto u = U.col (k);
+          for (ssize_t i = 0; i < r; ++i)
+            u[i] = RealType(1.0) + RealType(0.5) * std::sin (RealType(k*r+i));
+          for (size_t iter = 0; iter < 3; ++iter) {
+            solve_shifted_tridiagonal (shift, tiny, u);
+            for (ssize_t j = 0; j < k; ++j)
+              u -= U.col(j).dot (u) * U.col(j);
+            u.normalize();
+          }
+        }
+      }
+
+      // Solve (T - shift I) x = b in place, for T the tridiagonal matrix, using
+      // Gaussian elimination with partial pivoting; zero pivots are replaced with tiny
+      template <class ColumnType>
+      void solve_shifted_tridiagonal (RealType shift, RealType tiny, ColumnType&& x)
+      {
+        const auto& d (tridiag.diagonal());
+        const auto& e (tridiag.subDiagonal());
+        u0[0] = d[0] - shift;
+        u1[0] = r > 1 ? e[0] : RealType(0.0);
+        for (ssize_t i = 0; i < r-1; ++i) {
+          const RealType lower = e[i], next_diag = d[i+1] - shift, next_upper = i+1 < r-1 ? e[i+1] : RealType(0.0);
+          u2[i] = RealType(0.0);
+          if (std::abs (lower) > std::abs (u0[i])) {
+            const RealType factor = u0[i] / lower;
+            u0[i+1] = u1[i] - factor * next_diag;
+            u1[i+1] = u2[i] - factor * next_upper;
+            u0[i] = lower;
+            u1[i] = next_diag;
+            u2[i] = next_upper;
+            std::swap (x[i], x[i+1]);
+            x[i+1] -= factor * x[i];
+          } else {
+            if (u0[i] == RealType(0.0))
+              u0[i] = tiny;
+            const RealType factor = lower / u0[i];
+            u0[i+1] = next_diag - factor * u1[i];
+            u1[i+1] = next_upper - factor * u2[i];
+            x[i+1] -= factor * x[i];
+          }
+        }
+        if (u0[r-1] == RealType(0.0))
+          u0[r-1] = tiny;
+        for (ssize_t i = r-1; i >= 0; --i) {
+          if (i+1 < r) x[i] -= u1[i] * x[i+1];
+          if (i+2 < r) x[i] -= u2[i] * x[i+2];
+          x[i] /= u0[i];
+        }
+      }
+
+      template <typename ImageType>
+      void load_data (ImageType& dwi) {
+        pos[0] = dwi.index(0); pos[1] = dwi.index(1); pos[2] = dwi.index(2);
+        // fill patch
+        X.setZero();
+        size_t k = 0;
+        for (int z = -extent[2]; z <= extent[2]; z++) {
+          dwi.index(2) = wrapindex(z, 2, dwi.size(2));
+          for (int y = -extent[1]; y <= extent[1]; y++) {
+            dwi.index(1) = wrapindex(y, 1, dwi.size(1));
+            for (int x = -extent[0]; x <= extent[0]; x++, k++) {
+              dwi.index(0) = wrapindex(x, 0, dwi.size(0));
+              X.col(k) = dwi.row(3);
+            }
+          }
+        }
+        // reset image position
+        dwi.index(0) = pos[0];
+        dwi.index(1) = pos[1];
+        dwi.index(2) = pos[2];
+      }
+
+      inline size_t wrapindex(int r, int axis, int max) const {
+        // patch handling at image edges
+        int rr = pos[axis] + r;
+        if (rr < 0)    rr = extent[axis] - r;
+        if (rr >= max) rr = (max-1) - extent[axis] - r;
+        return rr;
+      }
+
+    };
+
+
+    // Denoising of entire rows of voxels along one axis: as the window slides
+    // along the row, the Gram matrix of the patch is updated by adding the
+    // contribution of the slab of voxels entering the window and subtracting that
+    // of the slab leaving it, rather than being recomputed in full. This is only
+    // applicable if the Gram matrix is formed over DWI volumes (m <= n). Updates
+    // are accumulated in double precision, and the Gram matrix is recomputed from
+    // scratch at the start of each row.
+    template <typename F = float>
+    class SlidingDenoisingFunctor : public DenoisingFunctor<F> {
+      MEMALIGN(SlidingDenoisingFunctor)
+
+    public:
+
+      using typename DenoisingFunctor<F>::MatrixType;
+      using GramType = Eigen::Matrix<typename std::conditional<Eigen::NumTraits<F>::IsComplex, cdouble, double>::type, Eigen::Dynamic, Eigen::Dynamic>;
+
+      SlidingDenoisingFunctor (int ndwi, const vector<uint32_t>& extent, int axis,
+                               Image<F>& dwi, Image<F>& out, Image<bool>& mask, Image<float>& noise, bool exp1)
+        : DenoisingFunctor<F> (ndwi, extent, mask, noise, exp1),
+          axis (axis), dwi (dwi), out (out),
+          slabs (extent[axis], GramType (ndwi, this->n / extent[axis])),
+          gram (ndwi, ndwi), XtX (ndwi, ndwi), column (ndwi)
+      {
+        assert (this->m <= this->n);
+      }
+
+      void operator () (const Iterator& pos)
+      {
+        assign_pos_of (pos).to (dwi, out);
+        const ssize_t width = 2*this->extent[axis] + 1;
+        ssize_t start = -width;
+
+        for (auto l = Loop (axis) (dwi, out); l; ++l) {
+          // Process voxels in mask only
+          if (this->mask.valid()) {
+            assign_pos_of (dwi, 0, 3).to (this->mask);
+            if (!this->mask.value())
+              continue;
+          }
+
+          const ssize_t new_start = window_start (axis, dwi.index (axis));
+          if (new_start - start >= width) {
+            start = new_start;
+            gram.setZero();
+            for (ssize_t i = start; i < start + width; ++i) {
+              load_slab (i);
+              gram.template selfadjointView<Eigen::Lower>().rankUpdate (slab (i));
+            }
+          }
+          else {
+            for (; start < new_start; ++start) {
+              gram.template selfadjointView<Eigen::Lower>().rankUpdate (slab (start), -1.0);
+              load_slab (start + width);
+              gram.template selfadjointView<Eigen::Lower>().rankUpdate (slab (start + width));
+            }
+          }
+
+          XtX.template triangularView<Eigen::Lower>() = gram.template cast<F>();
+          this->X.col (this->n/2) = dwi.row(3);
+          this->denoise (XtX);
+
+          out.row(3) = this->X.col (this->n/2);
+          if (this->noise.valid()) {
+            assign_pos_of (dwi, 0, 3).to (this->noise);
+            this->noise.value() = float (std::sqrt (this->sigma2));
+          }
+        }
+      }
+
+    private:
+      const int axis;
+      Image<F> dwi, out;
+      vector<GramType> slabs;
+      GramType gram;
+      MatrixType XtX;
+      Eigen::Matrix<F, Eigen::Dynamic, 1> column;
+
+      // The patch is shifted rather than truncated at the image edges
+      // (matching DenoisingFunctor::wrapindex())
+      ssize_t window_start (int a, ssize_t index) const {
+        return std::max (ssize_t(0), std::min (index - this->extent[a], dwi.size(a) - 1 - 2*this->extent[a]));
+      }
+
+      GramType& slab (ssize_t index) { return slabs[index % slabs.size()]; }
+
+      // load the voxels of the patch at position index along the sliding axis
+      void load_slab (ssize_t index) {
+        const int a1 = (axis+1) % 3, a2 = (axis+2) % 3;
+        const ssize_t pos[3] = { dwi.index(0), dwi.index(1), dwi.index(2) };
+        const ssize_t start1 = window_start (a1, pos[a1]), start2 = window_start (a2, pos[a2]);
+        GramType& S (slab (index));
+        dwi.index (axis) = index;
+        ssize_t k = 0;
+        for (ssize_t i2 = start2; i2 <= start2 + 2*this->extent[a2]; ++i2) {
+          dwi.index (a2) = i2;
+          for (ssize_t i1 = start1; i1 <= start1 + 2*this->extent[a1]; ++i1, ++k) {
+            dwi.index (a1) = i1;
+            column = dwi.row(3);
+            S.col (k) = column.template cast<typename GramType::Scalar>();
+          }
+        }
+        dwi.index(0) = pos[0];
+        dwi.index(1) = pos[1];
+        dwi.index(2) = pos[2];
+      }
+
+    };
+
+  }
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include "dwi/directions/set.h"
 
 #include "dwi/tractography/file.h"
+#include "dwi/tractography/mapped_reader.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 
@@ -108,8 +109,9 @@ namespace MR
           class TrackMappingWorker
           { MEMALIGN(TrackMappingWorker)
             public:
-              TrackMappingWorker (Model& i, const default_type upsample_ratio) :
+              TrackMappingWorker (Model& i, const Tractography::MappedReader<>& reader, const default_type upsample_ratio) :
                   master (i),
+                  reader (reader),
                   mapper (i.header(), i.dirs),
                   mutex (new std::mutex),
                   TD_sum (0.0),
@@ -121,15 +123,19 @@ namespace MR
               }
               TrackMappingWorker (const TrackMappingWorker& that) :
                   master (that.master),
+                  reader (that.reader),
                   mapper (that.mapper),
                   mutex (that.mutex),
                   TD_sum (0.0),
                   fixel_TDs (master.fixels.size(), 0.0),
                   fixel_counts (master.fixels.size(), 0) { }
               ~TrackMappingWorker();
+              bool operator() (const TrackIndexRange&);
               bool operator() (const Tractography::Streamline<>&);
             private:
               Model& master;
+              const Tractography::MappedReader<>& reader;
+              Tractography::Streamline<> tck;
               Mapping::TrackMapperBase mapper;
               std::shared_ptr<std::mutex> mutex;
               double TD_sum;
@@ -173,7 +179,7 @@ namespace MR
       void Model<Fixel>::map_streamlines (const std::string& path)
       {
         Tractography::Properties properties;
-        Tractography::Reader<> file (path, properties);
+        Tractography::MappedReader<> file (path, properties);
 
         const track_t count = (properties.find ("count") == properties.end()) ? 0 : to<track_t>(properties["count"]);
         if (!count)
@@ -182,10 +188,14 @@ namespace MR
         contributions.assign (count, nullptr);
 
         {
-          Mapping::TrackLoader loader (file, count);
-          TrackMappingWorker worker (*this, Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
-          Thread::run_queue (loader,
-                             Thread::batch (Tractography::Streamline<>()),
+          // Each thread reads its own ranges of streamlines directly from the mapped file;
+          //   keep the ranges small enough to distribute the work evenly for smaller files
+          const track_t num_to_map = std::min (count, track_t (file.size()));
+          const track_t range_size = std::max (track_t(1), std::min (track_t(SIFT_TRACK_INDEX_BUFFER_SIZE), num_to_map / track_t(100)));
+          TrackIndexRangeWriter writer (range_size, num_to_map, "mapping tracks to image");
+          TrackMappingWorker worker (*this, file, Mapping::determine_upsample_ratio (Fixel_map<Fixel>::header(), properties, 0.1));
+          Thread::run_queue (writer,
+                             TrackIndexRange(),
                              Thread::multi (worker));
         }
 
@@ -351,6 +361,19 @@ namespace MR
 
 
 
+      template <class Fixel>
+      bool Model<Fixel>::TrackMappingWorker::operator() (const TrackIndexRange& range)
+      {
+        for (track_t track_index = range.first; track_index != range.second; ++track_index) {
+          reader.load (track_index, tck);
+          if (!(*this) (tck))
+            return false;
+        }
+        return true;
+      }
+
+
+
       template <class Fixel>
       bool Model<Fixel>::TrackMappingWorker::operator() (const Tractography::Streamline<>& in)
       {
@@ -30,6 +30,7 @@
 #include "dwi/tractography/SIFT2/streamline_stats.h"
 #include "dwi/tractography/SIFT2/tckfactor.h"
 
+#include "dwi/tractography/weights.h"
 #include "dwi/tractography/SIFT/track_index_range.h"
 
 
@@ -356,7 +357,12 @@ namespace MR {
           weights[i] = (coefficients[i] == min_coeff || !std::isfinite(coefficients[i])) ?
                         0.0 :
                         std::exp (coefficients[i]);
-        save_vector (weights, path);
+        // Binary weights files carry the header of the track file, so that
+        //   the two can subsequently be verified as matching
+        Properties properties;
+        if (is_binary_weights_file (path))
+          Tractography::Reader<float> reader (tck_file_path, properties);
+        save_weights (weights, path, properties);
       }
 
 
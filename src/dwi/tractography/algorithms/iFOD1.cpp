@@ -31,13 +31,31 @@ namespace MR
         const OptionGroup iFODOptions = OptionGroup ("Options specific to the iFOD tracking algorithms")
 
         + Option ("power", "raise the FOD to the power specified (defaults are: 1.0 for iFOD1; 1.0/nsamples for iFOD2).")
-          + Argument ("value").type_float (0.0);
+          + Argument ("value").type_float (0.0)
+
+        + Option ("fod_lookup",
+                  "pre-compute the FOD amplitudes in every voxel along a set of directions, and obtain "
+                  "amplitudes during tracking by interpolation within this set rather than by evaluating "
+                  "the spherical harmonic series. This is faster, at the expense of memory "
+                  "(4 bytes per direction per non-zero image voxel) and a slight loss of precision. "
+                  "Available numbers of directions are 60, 129, 300, 321, 469, 513, 1281 and 5000; "
+                  "larger sets are more accurate but require more memory.")
+          + Argument ("directions").type_integer (1);
 
 
         void load_iFOD_options (Tractography::Properties& properties)
         {
           auto opt = get_options ("power");
           if (opt.size()) properties["fod_power"] = str<float> (opt[0][0]);
+          opt = get_options ("fod_lookup");
+          if (opt.size()) {
+            const unsigned int num_directions = opt[0][0];
+            const vector<unsigned int> available { 60, 129, 300, 321, 469, 513, 1281, 5000 };
+            if (std::find (available.begin(), available.end(), num_directions) == available.end())
+              throw Exception ("invalid number of directions for -fod_lookup option (" + str(num_directions) + "); "
+                               "available numbers are " + join (available, ", "));
+            properties["fod_lookup_directions"] = str (num_directions);
+          }
         }
 
       }
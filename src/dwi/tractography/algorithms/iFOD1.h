@@ -18,6 +18,7 @@
 #define __dwi_tractography_algorithms_iFOD1_h__
 
 #include "math/SH.h"
+#include "dwi/tractography/tracking/amplitude_lookup.h"
 #include "dwi/tractography/tracking/method.h"
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/tractography.h"
@@ -85,6 +86,10 @@ namespace MR
           properties.set (precomputed, "sh_precomputed");
           if (precomputed)
             precomputer.init (lmax);
+          size_t lookup_directions = 0;
+          properties.set (lookup_directions, "fod_lookup_directions");
+          if (lookup_directions)
+            amplitude_lookup.reset (new AmplitudeLookup (source, lookup_directions));
 
         }
 
@@ -113,6 +118,7 @@ namespace MR
         size_t lmax, max_trials;
         float sin_max_angle_1o, fod_power;
         Math::SH::PrecomputedAL<float> precomputer;
+        std::unique_ptr<AmplitudeLookup> amplitude_lookup;
 
         private:
         mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -131,7 +137,9 @@ namespace MR
         mean_sample_num (0),
         num_sample_runs (0),
         num_truncations (0),
-        max_truncation (0.0) {
+        max_truncation (0.0),
+        batch (S.lmax, &S.precomputer),
+        lookup (S.amplitude_lookup.get()) {
         calibrate (*this);
       }
 
@@ -147,7 +155,7 @@ namespace MR
 
       bool init() override
       {
-        if (!get_data (source))
+        if (!set_position (pos))
           return (false);
 
         if (!S.init_dir.allFinite()) {
@@ -179,12 +187,28 @@ namespace MR
 
       term_t next () override
       {
-        if (!get_data (source))
+        if (!set_position (pos))
           return EXIT_IMAGE;
 
+        // Evaluate the FOD amplitude along all calibration directions in a single batch;
+        //   the test for invalid amplitudes therefore no longer exits before the
+        //   remaining directions have been evaluated, but this can only occur on
+        //   the last step of a streamline
+        calib_dirs.resize (3, calibrate_list.size());
+        for (size_t i = 0; i < calibrate_list.size(); ++i)
+          calib_dirs.col(i) = rotate_direction (dir, calibrate_list[i]);
+        if (lookup) {
+          calib_amplitudes.resize (calibrate_list.size());
+          for (size_t i = 0; i < calibrate_list.size(); ++i)
+            calib_amplitudes[i] = lookup.value (calib_dirs.col(i));
+        } else {
+          batch.set_directions (calib_dirs);
+          batch.value (values, calib_amplitudes);
+        }
+
         float max_val = 0.0;
         for (size_t i = 0; i < calibrate_list.size(); ++i) {
-          float val = FOD (rotate_direction (dir, calibrate_list[i]));
+          const float val = calib_amplitudes[i];
           if (std::isnan (val))
             return EXIT_IMAGE;
           else if (val > max_val)
@@ -229,7 +253,7 @@ namespace MR
 
       float get_metric (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) override
       {
-        if (!get_data (source, position))
+        if (!set_position (position))
           return 0.0;
         return FOD (direction);
       }
@@ -243,8 +267,23 @@ namespace MR
       float max_truncation;
       vector< Eigen::Vector3f > calibrate_list;
 
+      Math::SH::BatchEvaluator<float> batch;
+      Eigen::Matrix3Xf calib_dirs;
+      Eigen::VectorXf calib_amplitudes;
+
+      // Amplitudes pre-computed along a dense direction set, if requested
+      AmplitudeLookup::Sampler lookup;
+
+      // Prepare for evaluation of FOD() at a new position
+      bool set_position (const Eigen::Vector3f& position)
+      {
+        return (lookup ? lookup.set_position (position) : get_data (source, position));
+      }
+
       float FOD (const Eigen::Vector3f& d) const
       {
+        if (lookup)
+          return lookup.value (d);
         return (S.precomputer ?
             S.precomputer.value (values, d) :
             Math::SH::value (values, d, S.lmax)
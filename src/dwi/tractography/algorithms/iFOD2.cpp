@@ -32,13 +32,22 @@ namespace MR
 
         + Option ("samples",
                   "set the number of FOD samples to take per step (Default: " + str(Tracking::Defaults::ifod2_nsamples) + ").")
-          + Argument ("number").type_integer (2, 100);
+          + Argument ("number").type_integer (2, 100)
+
+        + Option ("batch",
+                  "set the number of candidate paths to generate and evaluate together during rejection sampling "
+                  "(Default: " + str(Tracking::Defaults::ifod2_batch_size) + "); "
+                  "values greater than 1 yield results that are statistically equivalent to, "
+                  "but not identical to, those of generating and evaluating candidates one at a time.")
+          + Argument ("number").type_integer (1, 1000);
 
 
         void load_iFOD2_options (Tractography::Properties& properties)
         {
           auto opt = get_options ("samples");
           if (opt.size()) properties["samples_per_step"] = str<unsigned int> (opt[0][0]);
+          opt = get_options ("batch");
+          if (opt.size()) properties["candidates_per_batch"] = str<unsigned int> (opt[0][0]);
         }
 
       }
@@ -22,6 +22,8 @@
 #include "types.h"
 #include "math/SH.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/tracking/amplitude_lookup.h"
+#include "dwi/tractography/tracking/batch_interp.h"
 #include "dwi/tractography/tracking/method.h"
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/tractography.h"
@@ -53,6 +55,7 @@ namespace MR
                     lmax (Math::SH::LforN (source.size(3))),
                     num_samples (Defaults::ifod2_nsamples),
                     max_trials (Defaults::max_trials_per_step),
+                    batch_size (Defaults::ifod2_batch_size),
                     sin_max_angle_ho (NaN),
                     mean_samples (0.0),
                     mean_truncations (0.0),
@@ -77,12 +80,17 @@ namespace MR
                   properties.set (lmax, "lmax");
                   properties.set (num_samples, "samples_per_step");
                   properties.set (max_trials, "max_trials");
+                  properties.set (batch_size, "candidates_per_batch");
                   fod_power = 1.0/num_samples;
                   properties.set (fod_power, "fod_power");
                   bool precomputed = true;
                   properties.set (precomputed, "sh_precomputed");
                   if (precomputed)
                     precomputer.init (lmax);
+                  size_t lookup_directions = 0;
+                  properties.set (lookup_directions, "fod_lookup_directions");
+                  if (lookup_directions)
+                    amplitude_lookup.reset (new AmplitudeLookup (source, lookup_directions));
 
                   // num_samples is number of samples excluding first point
                   --num_samples;
@@ -129,9 +137,10 @@ namespace MR
 
                 float internal_step_size() const override { return step_size / float(num_samples); }
 
-                size_t lmax, num_samples, max_trials;
+                size_t lmax, num_samples, max_trials, batch_size;
                 float sin_max_angle_ho, fod_power;
                 Math::SH::PrecomputedAL<float> precomputer;
+                std::unique_ptr<AmplitudeLookup> amplitude_lookup;
 
               private:
                 mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -158,7 +167,10 @@ namespace MR
               calib_positions (S.num_samples),
               tangents (S.num_samples),
               calib_tangents (S.num_samples),
-              sample_idx (S.num_samples)
+              sample_idx (S.num_samples),
+              interp (S.source),
+              batch (S.lmax, &S.precomputer),
+              lookup (S.amplitude_lookup.get())
           {
             calibrate (*this);
           }
@@ -177,7 +189,10 @@ namespace MR
               calib_positions (S.num_samples),
               tangents (S.num_samples),
               calib_tangents (S.num_samples),
-              sample_idx (S.num_samples)
+              sample_idx (S.num_samples),
+              interp (S.source),
+              batch (S.lmax, &S.precomputer),
+              lookup (S.amplitude_lookup.get())
           {
           }
 
@@ -196,7 +211,7 @@ namespace MR
 
             bool init() override
             {
-              if (!get_data (source))
+              if (!set_position (pos))
                 return false;
 
               if (!S.init_dir.allFinite()) {
@@ -240,10 +255,19 @@ namespace MR
 
               Eigen::Vector3f next_pos, next_dir;
 
+              // The amplitudes along all calibration paths are computed before any
+              //   of the exit conditions below are tested; unlike sequential
+              //   evaluation, the remaining paths (and the samples of a path beyond
+              //   one below threshold) are therefore evaluated even if the first
+              //   path leaves the image. This only affects the last step of each
+              //   streamline, and was measured to be outweighed by the gain from
+              //   batched evaluation on every other step.
+              get_calibration_amplitudes();
+
               float max_val = 0.0;
               for (size_t i = 0; i < calibrate_list.size(); ++i) {
-                get_path (calib_positions, calib_tangents, rotate_direction (dir, calibrate_list[i]));
-                float val = path_prob (calib_positions, calib_tangents);
+                const float* amplitudes = calib_amplitudes.data() + i*S.num_samples;
+                float val = path_prob (calib_end_positions[i], [&] (size_t n) { return amplitudes[n]; });
                 if (std::isnan (val))
                   return EXIT_IMAGE;
                 else if (val > max_val)
@@ -257,24 +281,46 @@ namespace MR
 
               num_sample_runs++;
 
-              for (size_t n = 0; n < S.max_trials; n++) {
-                float val = rand_path_prob ();
-
-                if (val > max_val) {
-                  DEBUG ("max_val exceeded!!! (val = " + str(val) + ", max_val = " + str (max_val) + ")");
-                  ++num_truncations;
-                  if (val/max_val > max_truncation)
-                    max_truncation = val/max_val;
+              if (S.batch_size > 1) {
+
+                // Generate and evaluate candidate paths in batches; the first
+                //   candidate to be accepted is taken. All directions of a batch
+                //   are drawn before any acceptance test, so the random number
+                //   sequence (and hence the output for a given seed) differs
+                //   from that of one-at-a-time generation, although the
+                //   distribution of accepted paths is the same
+                for (size_t n = 0; n < S.max_trials; ) {
+                  const size_t num_candidates = std::min (S.batch_size, S.max_trials - n);
+                  get_candidate_probabilities (num_candidates);
+                  for (size_t k = 0; k != num_candidates; ++k, ++n) {
+                    if (accept (candidate_probs[k], max_val)) {
+                      mean_sample_num += n;
+                      half_log_prob0 = candidate_half_log_probN[k];
+                      for (size_t i = 0; i != S.num_samples; ++i) {
+                        positions[i] = candidate_positions.col (k*S.num_samples + i);
+                        tangents [i] = candidate_tangents .col (k*S.num_samples + i);
+                      }
+                      pos = positions[0];
+                      dir = tangents [0];
+                      sample_idx = 0;
+                      return CONTINUE;
+                    }
+                  }
                 }
 
-                if (uniform(rng) < val/max_val) {
-                  mean_sample_num += n;
-                  half_log_prob0 = last_half_log_probN;
-                  pos = positions[0];
-                  dir = tangents [0];
-                  sample_idx = 0;
-                  return CONTINUE;
+              } else {
+
+                for (size_t n = 0; n < S.max_trials; n++) {
+                  if (accept (rand_path_prob(), max_val)) {
+                    mean_sample_num += n;
+                    half_log_prob0 = last_half_log_probN;
+                    pos = positions[0];
+                    dir = tangents [0];
+                    sample_idx = 0;
+                    return CONTINUE;
+                  }
                 }
+
               }
 
               return MODEL;
@@ -283,7 +329,7 @@ namespace MR
 
             float get_metric (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) override
             {
-              if (!get_data (source, position))
+              if (!set_position (position))
                 return 0.0;
               return FOD (direction);
             }
@@ -322,7 +368,7 @@ namespace MR
 
               // Need to get the path probability contribution from the FOD at this point
               pos = tck.back();
-              get_data (source);
+              set_position (pos);
               half_log_prob0 = 0.5 * std::log (FOD (dir));
 
               // Make sure that arc is re-calculated when next() is called
@@ -351,10 +397,41 @@ namespace MR
             //   in the arc - more dense structural image sampling
             size_t sample_idx;
 
+            // FOD amplitudes for all sample points of all calibration paths are evaluated in a single batch:
+            //   each row of calib_coefs holds the SH coefficients at one sample point, with the
+            //   corresponding tangent in the matching column of calib_dirs
+            BatchInterp interp;
+            Math::SH::BatchEvaluator<float> batch;
+            Eigen::MatrixXf calib_coefs;
+            Eigen::Matrix3Xf calib_positions_batch, calib_dirs;
+            Eigen::VectorXf calib_amplitudes;
+            vector<Eigen::Vector3f> calib_end_positions;
+
+            // Likewise for batches of candidate paths during rejection sampling: the sample points of
+            //   candidate k occupy columns [k*num_samples, (k+1)*num_samples) of candidate_positions
+            //   and candidate_tangents
+            Eigen::Matrix3Xf candidate_positions, candidate_tangents;
+            Eigen::MatrixXf candidate_coefs;
+            Eigen::VectorXf candidate_amplitudes;
+            vector<float> candidate_probs, candidate_half_log_probN;
+
+            // Amplitudes pre-computed along a dense direction set, if requested;
+            //   this replaces both the interpolation of SH coefficients and their evaluation
+            AmplitudeLookup::Sampler lookup;
+
+
+
+            // Prepare for evaluation of FOD() at a new position
+            FORCE_INLINE bool set_position (const Eigen::Vector3f& position)
+            {
+              return (lookup ? lookup.set_position (position) : get_data (source, position));
+            }
 
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& direction) const
             {
+              if (lookup)
+                return lookup.value (direction);
               return (S.precomputer ?
                   S.precomputer.value (values, direction) :
                   Math::SH::value (values, direction, S.lmax)
@@ -363,7 +440,7 @@ namespace MR
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& position, const Eigen::Vector3f& direction)
             {
-              if (!get_data (source, position))
+              if (!set_position (position))
                 return NaN;
               return FOD (direction);
             }
@@ -379,12 +456,60 @@ namespace MR
 
 
 
+            // Rejection sampling test of a candidate path of probability val
+            FORCE_INLINE bool accept (const float val, const float max_val)
+            {
+              if (val > max_val) {
+                DEBUG ("max_val exceeded!!! (val = " + str(val) + ", max_val = " + str (max_val) + ")");
+                ++num_truncations;
+                if (val/max_val > max_truncation)
+                  max_truncation = val/max_val;
+              }
+              return uniform(rng) < val/max_val;
+            }
+
+
+
+            // Generate a batch of random candidate paths, and compute their probabilities
+            void get_candidate_probabilities (const size_t num_candidates)
+            {
+              const size_t N = num_candidates * S.num_samples;
+              candidate_positions.resize (3, N);
+              candidate_tangents.resize (3, N);
+              for (size_t k = 0; k != num_candidates; ++k) {
+                get_path (positions, tangents, rand_dir (dir));
+                for (size_t i = 0; i != S.num_samples; ++i) {
+                  candidate_positions.col (k*S.num_samples + i) = positions[i];
+                  candidate_tangents .col (k*S.num_samples + i) = tangents[i];
+                }
+              }
+
+              get_amplitudes (candidate_positions, candidate_tangents, candidate_coefs, candidate_amplitudes);
+
+              candidate_probs.resize (num_candidates);
+              candidate_half_log_probN.resize (num_candidates);
+              for (size_t k = 0; k != num_candidates; ++k) {
+                const float* amplitudes = candidate_amplitudes.data() + k*S.num_samples;
+                candidate_probs[k] = path_prob (candidate_positions.col ((k+1)*S.num_samples - 1), [&] (size_t n) { return amplitudes[n]; });
+                candidate_half_log_probN[k] = last_half_log_probN;
+              }
+            }
+
+
+
             float path_prob (vector<Eigen::Vector3f>& positions, vector<Eigen::Vector3f>& tangents)
+            {
+              return path_prob (positions[S.num_samples - 1], [&] (size_t i) { return FOD (positions[i], tangents[i]); });
+            }
+
+            // Amplitude functor provides the FOD amplitude at each sample point along the path
+            template <class AmplitudeFunctor>
+            float path_prob (const Eigen::Vector3f& end_position, AmplitudeFunctor&& amplitude)
             {
 
               // Early exit for ACT when path is not sensible
               if (S.is_act()) {
-                if (!act().fetch_tissue_data (positions[S.num_samples - 1]))
+                if (!act().fetch_tissue_data (end_position))
                   return (NaN);
                 if (act().tissues().get_csf() >= 0.5)
                   return 0.0;
@@ -393,7 +518,7 @@ namespace MR
               float log_prob = half_log_prob0;
               for (size_t i = 0; i < S.num_samples; ++i) {
 
-                float fod_amp = FOD (positions[i], tangents[i]);
+                float fod_amp = amplitude (i);
                 if (std::isnan (fod_amp))
                   return NaN;
                 if (fod_amp < S.threshold)
@@ -411,6 +536,61 @@ namespace MR
             }
 
 
+
+            void get_calibration_amplitudes ()
+            {
+              // Unless candidates are evaluated in batches, the SH coefficients are
+              //   interpolated one position at a time as for the candidate paths,
+              //   such that the output is identical to that of earlier versions
+              const bool use_batch_interp = lookup || S.batch_size > 1;
+              const size_t N = calibrate_list.size() * S.num_samples;
+              calib_positions_batch.resize (3, N);
+              calib_dirs.resize (3, N);
+              if (!use_batch_interp)
+                calib_coefs.resize (N, values.size());
+              calib_end_positions.resize (calibrate_list.size());
+              for (size_t i = 0; i < calibrate_list.size(); ++i) {
+                get_path (calib_positions, calib_tangents, rotate_direction (dir, calibrate_list[i]));
+                calib_end_positions[i] = calib_positions[S.num_samples - 1];
+                for (size_t j = 0; j < S.num_samples; ++j) {
+                  const size_t n = i*S.num_samples + j;
+                  calib_positions_batch.col (n) = calib_positions[j];
+                  calib_dirs.col (n) = calib_tangents[j];
+                  if (!use_batch_interp) {
+                    if (get_data (source, calib_positions[j]))
+                      calib_coefs.row (n) = values.transpose();
+                    else
+                      calib_coefs.row (n).setConstant (NaN);
+                  }
+                }
+              }
+              if (use_batch_interp) {
+                get_amplitudes (calib_positions_batch, calib_dirs, calib_coefs, calib_amplitudes);
+              } else {
+                batch.set_directions (calib_dirs);
+                batch.paired_value (calib_coefs, calib_amplitudes);
+              }
+            }
+
+
+
+            // FOD amplitude at each position along the matching direction; coefs is used
+            //   as scratch space for the SH coefficients if these need to be interpolated
+            void get_amplitudes (const Eigen::Matrix3Xf& positions, const Eigen::Matrix3Xf& directions,
+                                 Eigen::MatrixXf& coefs, Eigen::VectorXf& amplitudes)
+            {
+              if (lookup) {
+                amplitudes.resize (positions.cols());
+                for (ssize_t n = 0; n != positions.cols(); ++n)
+                  amplitudes[n] = lookup.set_position (positions.col (n)) ? lookup.value (directions.col (n)) : NaN;
+              } else {
+                interp (positions, coefs);
+                batch.set_directions (directions);
+                batch.paired_value (coefs, amplitudes);
+              }
+            }
+
+
           protected:
             void get_path (vector<Eigen::Vector3f>& positions, vector<Eigen::Vector3f>& tangents, const Eigen::Vector3f& end_dir) const
             {
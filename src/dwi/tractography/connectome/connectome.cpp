@@ -115,7 +115,7 @@ const OptionGroup MetricOptions = OptionGroup ("Structural connectome metric opt
   + Option ("scale_invlength", "scale each contribution to the connectome edge by the inverse of the streamline length")
   + Option ("scale_invnodevol", "scale each contribution to the connectome edge by the inverse of the two node volumes")
 
-  + Option ("scale_file", "scale each contribution to the connectome edge according to the values in a vector file")
+  + Option ("scale_file", "scale each contribution to the connectome edge according to the values in a vector file; this may also be a binary track weights file (.tsw)")
     + Argument ("path").type_image_in();
 
 
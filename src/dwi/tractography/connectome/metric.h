@@ -26,6 +26,7 @@
 #include "connectome/connectome.h"
 
 #include "dwi/tractography/streamline.h"
+#include "dwi/tractography/weights.h"
 #include "dwi/tractography/connectome/connectome.h"
 
 
@@ -120,7 +121,7 @@ class Metric { MEMALIGN(Metric)
         return;
       }
       file_path = Path::basename (path);
-      file_values = MR::load_vector (path);
+      file_values = load_weights (path);
     }
 
 
@@ -24,6 +24,7 @@
 #include "types.h"
 
 #include "dwi/tractography/file.h"
+#include "dwi/tractography/mapped_reader.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
 
@@ -36,15 +37,26 @@ namespace MR {
 
 
 
+        // Feeds the streamlines of all input files in sequence
+        // The first \a skip non-empty streamlines across all files can be
+        //   bypassed without being read, using the offset index of each file;
+        //   this is only appropriate if no streamline would otherwise be
+        //   rejected by the Worker class. Empty streamlines within the skipped
+        //   range are still delivered, such that the Receiver class accounts
+        //   for them exactly as it would if no streamline had been bypassed.
         class Loader
         { MEMALIGN(Loader)
 
           public:
-            Loader (const vector<std::string>& files) :
+            Loader (const vector<std::string>& files, const size_t skip = 0) :
               file_list (files),
               dummy_properties (),
-              reader (new Reader<> (file_list[0], dummy_properties)),
-              file_index (0) { }
+              file_index (0),
+              next (0),
+              skip (skip)
+            {
+              open (0);
+            }
 
             bool operator() (Streamline<>&);
 
@@ -52,8 +64,16 @@ namespace MR {
           private:
             const vector<std::string>& file_list;
             Properties dummy_properties;
-            std::unique_ptr<Reader<> > reader;
-            size_t file_index;
+            std::unique_ptr<MappedReader<> > reader;
+            size_t file_index, next;
+            size_t skip;
+
+            void open (const size_t index)
+            {
+              dummy_properties.clear();
+              reader.reset (new MappedReader<> (file_list[index], dummy_properties));
+              next = 0;
+            }
 
         };
 
@@ -63,18 +83,18 @@ namespace MR {
         {
           out.clear();
 
-          if ((*reader) (out))
-            return true;
-
-          while (++file_index != file_list.size()) {
-            dummy_properties.clear();
-            reader.reset (new Reader<> (file_list[file_index], dummy_properties));
-            if ((*reader) (out))
+          while (true) {
+            for (; skip && next != reader->size() && reader->num_vertices (next); ++next)
+              --skip;
+            if (next != reader->size()) {
+              reader->load (next++, out);
               return true;
+            }
+            if (++file_index == file_list.size())
+              return false;
+            open (file_index);
           }
 
-          return false;
-
         }
 
 
@@ -28,6 +28,7 @@
 #include "dwi/tractography/file_base.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
+#include "dwi/tractography/weights.h"
 
 
 namespace MR
@@ -68,8 +69,11 @@ namespace MR
           {
             open (file, "tracks", properties);
             auto opt = App::get_options ("tck_weights_in");
-            if (opt.size())
-              weights = load_vector<ValueType> (opt[0][0]);
+            if (opt.size()) {
+              weights.reset (new TrackWeightsIn (opt[0][0]));
+              if (weights->properties().find ("timestamp") != weights->properties().end())
+                check_timestamps (properties, weights->properties(), "tracks / track weights");
+            }
           }
 
 
@@ -96,12 +100,12 @@ namespace MR
                 if (std::isnan (p[0])) {
                   tck.set_index (current_index++);
 
-                  if (weights.size()) {
+                  if (weights) {
 
-                    if (tck.get_index() < size_t(weights.size())) {
-                      tck.weight = weights[tck.get_index()];
+                    if (tck.get_index() < weights->size()) {
+                      tck.weight = (*weights)[tck.get_index()];
                     } else {
-                      WARN ("Streamline weights file contains less entries (" + str(weights.size()) + ") than .tck file; "
+                      WARN ("Streamline weights file contains less entries (" + str(weights->size()) + ") than .tck file; "
                             "ceasing reading of streamline data");
                       in.close();
                       tck.clear();
@@ -129,7 +133,7 @@ namespace MR
           using __ReaderBase__::dtype;
           using __ReaderBase__::current_index;
 
-          Eigen::Matrix<ValueType, Eigen::Dynamic, 1> weights;
+          std::unique_ptr<TrackWeightsIn> weights;
 
           //! takes care of byte ordering issues
 
@@ -171,10 +175,10 @@ namespace MR
           //! Check that the weights file does not contain excess entries
           void check_excess_weights()
           {
-            if (!weights.size())
+            if (!weights)
               return;
-            if (size_t(weights.size()) > current_index) {
-              WARN ("Streamline weights file contains more entries (" + str(weights.size()) + ") than .tck file (" + str(current_index) + ")");
+            if (weights->size() > current_index) {
+              WARN ("Streamline weights file contains more entries (" + str(weights->size()) + ") than .tck file (" + str(current_index) + ")");
             }
           }
 
@@ -243,6 +247,13 @@ namespace MR
               throw Exception ("error writing tracks file \"" + name + "\": " + strerror (errno));
             open_success = true;
 
+            // retain the header entries needed to generate a matching
+            //   binary weights file (ROIs are not copyable):
+            weights_properties.clear();
+            weights_properties.insert (properties.begin(), properties.end());
+            weights_properties.prior_rois = properties.prior_rois;
+            weights_properties.comments = properties.comments;
+
             auto opt = App::get_options ("tck_weights_out");
             if (opt.size())
               set_weights_path (opt[0][0]);
@@ -260,8 +271,10 @@ namespace MR
 
             commit (buffer, tck.size()+1);
 
-            if (weights_name.size())
-              write_weights (str(tck.weight) + "\n");
+            if (weights) {
+              (*weights) (tck.weight);
+              weights->commit();
+            }
 
             ++count;
             ++total_count;
@@ -270,16 +283,17 @@ namespace MR
 
 
           //! set the path to the track weights
+          /*! weights are written in binary form if \a path has the .tsw
+           * suffix, and as text otherwise (see TrackWeightsOut). */
           void set_weights_path (const std::string& path) {
-            if (weights_name.size())
+            if (weights)
               throw Exception ("Cannot change output streamline weights file path");
-            weights_name = path;
-            App::check_overwrite (weights_name);
-            File::OFStream out (weights_name, std::ios::out | std::ios::binary | std::ios::trunc);
+            weights.reset (new TrackWeightsOut (path, weights_properties));
           }
 
         protected:
-          std::string weights_name;
+          std::unique_ptr<TrackWeightsOut> weights;
+          Properties weights_properties;
           int64_t barrier_addr;
 
           //! indicates end of track and start of new track
@@ -296,15 +310,6 @@ namespace MR
               dest = { BE(src[0]), BE(src[1]), BE(src[2]) };
           }
 
-          //! write track weights data to file
-          void write_weights (const std::string& contents) {
-            File::OFStream out (weights_name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
-            out << contents;
-            if (!out.good())
-              throw Exception ("error writing streamline weights file \"" + weights_name + "\": " + strerror (errno));
-          }
-
-
           //! write track point data to file
           /*! \note \c buffer needs to be greater than \c num_points by one
            * element to add the barrier. */
@@ -356,8 +361,7 @@ namespace MR
           using __WriterBase__<ValueType>::total_count;
           using WriterUnbuffered<ValueType>::delimiter;
           using WriterUnbuffered<ValueType>::format_point;
-          using WriterUnbuffered<ValueType>::weights_name;
-          using WriterUnbuffered<ValueType>::write_weights;
+          using WriterUnbuffered<ValueType>::weights;
           using vector_type = typename WriterUnbuffered<ValueType>::vector_type;
 
           //! create new RAM-buffered track file with specified properties
@@ -400,8 +404,8 @@ namespace MR
             }
             add_point (delimiter());
 
-            if (weights_name.size())
-              weights_buffer += str (tck.weight) + ' ';
+            if (weights)
+              (*weights) (tck.weight, ' ');
 
             ++count;
             ++total_count;
@@ -413,7 +417,6 @@ namespace MR
           size_t buffer_capacity;
           std::unique_ptr<vector_type[]> buffer;
           size_t buffer_size;
-          std::string weights_buffer;
 
           //! add point to buffer and increment buffer_size accordingly
           void add_point (const vector_type& p) {
@@ -424,10 +427,8 @@ namespace MR
             WriterUnbuffered<ValueType>::commit (buffer.get(), buffer_size);
             buffer_size = 0;
 
-            if (weights_name.size()) {
-              write_weights (weights_buffer);
-              weights_buffer.clear();
-            }
+            if (weights)
+              weights->commit();
           }
 
       };
@@ -29,7 +29,7 @@ namespace MR {
 
         const std::string firstline ("mrtrix " + type);
         File::KeyValue::Reader kv (file, firstline.c_str());
-        std::string data_file;
+        std::string file_spec;
 
         while (kv.next()) {
           const std::string key = lowercase (kv.key());
@@ -45,7 +45,7 @@ namespace MR {
             }
           }
           else if (key == "comment") properties.comments.push_back (kv.value());
-          else if (key == "file") data_file = kv.value();
+          else if (key == "file") file_spec = kv.value();
           else if (key == "datatype") dtype = DataType::parse (kv.value());
           else add_line (properties[kv.key()], kv.value());
         }
@@ -57,10 +57,10 @@ namespace MR {
           throw Exception ("only supported datatype for tracks file are "
               "Float32LE, Float32BE, Float64LE & Float64BE (in " + type  + " file \"" + file + "\")");
 
-        if (data_file.empty())
+        if (file_spec.empty())
           throw Exception ("missing \"files\" specification for " + type  + " file \"" + file + "\"");
 
-        std::istringstream files_stream (data_file);
+        std::istringstream files_stream (file_spec);
         std::string fname;
         files_stream >> fname;
         int64_t offset = 0;
@@ -81,6 +81,8 @@ namespace MR {
         if (!in)
           throw Exception ("error opening " + type  + " data file \"" + fname + "\": " + strerror(errno));
         in.seekg (offset);
+        data_file = fname;
+        data_offset = offset;
       }
 
     }
@@ -41,7 +41,7 @@ namespace MR
       class __ReaderBase__
       { NOMEMALIGN
         public:
-            __ReaderBase__() : current_index (0) { }
+            __ReaderBase__() : current_index (0), data_offset (0) { }
           ~__ReaderBase__ () {
             if (in.is_open())
               in.close();
@@ -55,6 +55,9 @@ namespace MR
           std::ifstream in;
           DataType dtype;
           uint64_t current_index;
+          // location of the raw data, as specified in the header:
+          std::string data_file;
+          int64_t data_offset;
       };
 
 
@@ -0,0 +1,180 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/mapped_reader.h"
+
+#include <sys/stat.h>
+#include <fstream>
+
+#include "raw.h"
+#include "file/config.h"
+
+
+#define TRACK_INDEX_CACHE_MAGIC "mrtrix track index\n"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+
+      namespace {
+
+        template <typename T>
+          void scan_vertices (const uint8_t* data, size_t num_vertices, bool is_big_endian, vector<uint64_t>& starts)
+          {
+            for (size_t n = 0; n != num_vertices; ++n) {
+              const T x = Raw::fetch<T> (data, 3*n, is_big_endian);
+              if (std::isnan (x))
+                starts.push_back (n+1);
+              else if (std::isinf (x))
+                return;
+            }
+          }
+
+        // size and modification time of the track file, used to validate the cache
+        bool file_signature (const std::string& path, uint64_t& size, int64_t& mtime)
+        {
+          struct stat buf;
+          if (stat (path.c_str(), &buf))
+            return false;
+          size = buf.st_size;
+          mtime = buf.st_mtime;
+          return true;
+        }
+
+      }
+
+
+
+      //CONF option: TrackIndexCache
+      //CONF default: 0 (false)
+      //CONF Whether to store the offset index of each streamline in a
+      //CONF track file in a separate file alongside it (with the suffix
+      //CONF .idx appended), so that it need not be recomputed every time
+      //CONF the file is accessed through a memory-mapping.
+      TrackOffsetIndex::TrackOffsetIndex (const std::string& data_file, const uint8_t* data, size_t num_vertices, const DataType dtype)
+      {
+        const bool use_cache = File::Config::get_bool ("TrackIndexCache", false);
+        const std::string cache_file = data_file + ".idx";
+        if (use_cache && load (cache_file, data_file, num_vertices))
+          return;
+
+        starts.assign (1, 0);
+        if (dtype == DataType::Float32LE || dtype == DataType::Float32BE)
+          scan_vertices<float> (data, num_vertices, dtype.is_big_endian(), starts);
+        else
+          scan_vertices<double> (data, num_vertices, dtype.is_big_endian(), starts);
+        DEBUG ("offset index of track file \"" + data_file + "\" contains " + str(size()) + " streamlines");
+
+        if (use_cache) {
+          try {
+            save (cache_file, data_file);
+          }
+          catch (Exception& e) {
+            DEBUG ("unable to save track offset index: " + e[0]);
+          }
+        }
+      }
+
+
+
+      bool TrackOffsetIndex::load (const std::string& cache_file, const std::string& data_file, const size_t num_vertices)
+      {
+        uint64_t file_size;
+        int64_t mtime;
+        if (!file_signature (data_file, file_size, mtime))
+          return false;
+        std::ifstream in (cache_file, std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        const std::string magic (TRACK_INDEX_CACHE_MAGIC);
+        std::string header (magic.size(), '\0');
+        uint8_t fields[24];
+        in.read (&header[0], header.size());
+        in.read (reinterpret_cast<char*> (fields), sizeof (fields));
+        if (!in || header != magic ||
+            Raw::fetch_LE<uint64_t> (fields, 0) != file_size ||
+            Raw::fetch_LE<int64_t> (fields, 1) != mtime) {
+          DEBUG ("track offset index \"" + cache_file + "\" is out of date - ignored");
+          return false;
+        }
+
+        // every streamline occupies at least one vertex (its delimiter)
+        const uint64_t num_tracks = Raw::fetch_LE<uint64_t> (fields, 2);
+        if (num_tracks > num_vertices) {
+          DEBUG ("track offset index \"" + cache_file + "\" is invalid - ignored");
+          return false;
+        }
+        starts.resize (num_tracks + 1);
+        in.read (reinterpret_cast<char*> (starts.data()), starts.size() * sizeof (uint64_t));
+        if (!in) {
+          DEBUG ("track offset index \"" + cache_file + "\" is truncated - ignored");
+          starts.clear();
+          return false;
+        }
+        for (auto& s : starts)
+          s = ByteOrder::LE (s);
+        // the file signature does not guarantee that the contents match, so
+        //   check that the offsets are consistent with the track file
+        bool valid = starts[0] == 0 && starts.back() <= num_vertices;
+        for (size_t n = 1; valid && n != starts.size(); ++n)
+          valid = starts[n] > starts[n-1];
+        if (!valid) {
+          DEBUG ("track offset index \"" + cache_file + "\" is invalid - ignored");
+          starts.clear();
+          return false;
+        }
+        DEBUG ("offset index for track file \"" + data_file + "\" loaded from \"" + cache_file + "\"");
+        return true;
+      }
+
+
+
+      void TrackOffsetIndex::save (const std::string& cache_file, const std::string& data_file) const
+      {
+        uint64_t file_size;
+        int64_t mtime;
+        if (!file_signature (data_file, file_size, mtime))
+          return;
+
+        std::ofstream out (cache_file, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+          throw Exception ("error creating track offset index \"" + cache_file + "\": " + strerror (errno));
+        uint8_t fields[24];
+        Raw::store_LE<uint64_t> (file_size, fields, 0);
+        Raw::store_LE<int64_t> (mtime, fields, 1);
+        Raw::store_LE<uint64_t> (size(), fields, 2);
+        out << TRACK_INDEX_CACHE_MAGIC;
+        out.write (reinterpret_cast<const char*> (fields), sizeof (fields));
+        for (auto s : starts) {
+          s = ByteOrder::LE (s);
+          out.write (reinterpret_cast<const char*> (&s), sizeof (s));
+        }
+        if (!out)
+          throw Exception ("error writing track offset index \"" + cache_file + "\": " + strerror (errno));
+      }
+
+
+
+    }
+  }
+}
@@ -0,0 +1,236 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_mapped_reader_h__
+#define __dwi_tractography_mapped_reader_h__
+
+#include "app.h"
+#include "memory.h"
+#include "raw.h"
+#include "types.h"
+#include "file/mmap.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/file_base.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/streamline.h"
+#include "dwi/tractography/weights.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+
+      //! the location of each streamline within the vertex data of a track file
+      /*! The index holds, for each streamline, the offset (in vertices) of
+       * its first vertex from the start of the track data; the vertices of
+       * streamline \a n therefore lie in [ begin(n), end(n) ), with the
+       * delimiter at end(n). Only streamlines that are terminated by a
+       * delimiter are included, so that a partially written track file
+       * yields only its complete streamlines.
+       *
+       * Building the index requires a single pass over the first coordinate
+       * of every vertex. If the TrackIndexCache config file option is set,
+       * the index is also saved alongside the track data file (with the
+       * suffix .idx appended), and re-used on subsequent reads for as long as
+       * the size and modification time of the track file remain unchanged,
+       * and the offsets it holds are consistent with the track file. */
+      class TrackOffsetIndex
+      { NOMEMALIGN
+        public:
+          TrackOffsetIndex (const std::string& data_file, const uint8_t* data, size_t num_vertices, const DataType dtype);
+
+          size_t size () const { return starts.size() - 1; }
+          uint64_t begin (size_t n) const { return starts[n]; }
+          uint64_t end (size_t n) const { return starts[n+1] - 1; }
+
+        protected:
+          vector<uint64_t> starts;
+
+          bool load (const std::string& cache_file, const std::string& data_file, const size_t num_vertices);
+          void save (const std::string& cache_file, const std::string& data_file) const;
+      };
+
+
+
+
+      //! A class to read streamlines data through a memory-mapping
+      /*! This provides the same sequential interface as Reader, but maps the
+       * track data into memory and builds a TrackOffsetIndex on
+       * construction, so that streamlines can also be accessed in any order:
+       *
+       * - load() copies streamline \a n into a Streamline, with any
+       * byte-swapping or type conversion required. It does not modify the
+       * state of the reader, and can therefore be used concurrently from
+       * multiple threads, e.g. to have each thread process its own range of
+       * streamline indices.
+       *
+       * - span() provides direct access to the vertices of streamline \a n
+       * within the mapped data, without any copy. This is only possible if
+       * the data are stored in native byte order using \a ValueType (see
+       * zero_copy()); this is the case for the default Float32LE on
+       * little-endian systems.
+       *
+       * As with Reader, streamline weights will be loaded if the
+       * -tck_weights_in option has been supplied. */
+      template <class ValueType = float>
+      class MappedReader : public __ReaderBase__, public ReaderInterface<ValueType>
+      { NOMEMALIGN
+        public:
+          using point_type = Eigen::Matrix<ValueType,3,1>;
+
+          //! a view of the vertices of a streamline within the mapped data
+          class Span
+          { NOMEMALIGN
+            public:
+              Span (const point_type* data, size_t size) : data (data), num (size) { }
+              const point_type* begin () const { return data; }
+              const point_type* end () const { return data + num; }
+              size_t size () const { return num; }
+              bool empty () const { return !num; }
+              const point_type& operator[] (size_t n) const { assert (n < num); return data[n]; }
+              const point_type& front () const { return data[0]; }
+              const point_type& back () const { return data[num-1]; }
+            private:
+              const point_type* data;
+              size_t num;
+          };
+
+
+          //! open the \c file for reading and load header into \c properties
+          MappedReader (const std::string& file, Properties& properties) :
+            num_tracks (0)
+          {
+            open (file, "tracks", properties);
+            in.close();
+            mmap.reset (new File::MMap (File::Entry (data_file, data_offset)));
+            vertex_size = 3 * dtype.bytes();
+            DataType native (DataType::from<ValueType>());
+            native.set_byte_order_native();
+            is_native = (dtype == native);
+            index.reset (new TrackOffsetIndex (data_file, mmap->address(), mmap->size() / vertex_size, dtype));
+            num_tracks = index->size();
+
+            auto opt = App::get_options ("tck_weights_in");
+            if (opt.size()) {
+              weights.reset (new TrackWeightsIn (opt[0][0]));
+              if (weights->properties().find ("timestamp") != weights->properties().end())
+                check_timestamps (properties, weights->properties(), "tracks / track weights");
+              if (weights->size() < num_tracks) {
+                WARN ("Streamline weights file contains less entries (" + str(weights->size()) + ") than .tck file; "
+                      "only the first " + str(weights->size()) + " streamlines will be read");
+                num_tracks = weights->size();
+              } else if (weights->size() > num_tracks) {
+                WARN ("Streamline weights file contains more entries (" + str(weights->size()) + ") than .tck file (" + str(num_tracks) + ")");
+              }
+            }
+          }
+
+
+          //! the number of (complete) streamlines in the file
+          size_t size () const { return num_tracks; }
+
+          //! the number of vertices in streamline \a n
+          size_t num_vertices (size_t n) const { assert (n < num_tracks); return index->end (n) - index->begin (n); }
+
+          //! the weight of streamline \a n (1.0 unless -tck_weights_in is used)
+          ValueType weight (size_t n) const { return weights ? ValueType ((*weights)[n]) : ValueType (1.0); }
+
+          //! whether span() can be used
+          bool zero_copy () const { return is_native; }
+
+          //! the vertices of streamline \a n, in place in the mapped data
+          Span span (size_t n) const
+          {
+            assert (n < num_tracks);
+            if (!is_native)
+              throw Exception ("cannot access track data in place: data type " + std::string (dtype.specifier()) + " does not match");
+            return Span (reinterpret_cast<const point_type*> (mmap->address()) + index->begin (n), num_vertices (n));
+          }
+
+          //! copy streamline \a n into \a tck
+          void load (size_t n, Streamline<ValueType>& tck) const
+          {
+            assert (n < num_tracks);
+            if (is_native) {
+              const Span data (span (n));
+              tck.assign (data.begin(), data.end());
+            } else {
+              const size_t begin = index->begin (n);
+              tck.resize (num_vertices (n));
+              for (size_t i = 0; i != tck.size(); ++i)
+                tck[i] = get_point (begin + i);
+            }
+            tck.set_index (n);
+            tck.weight = weight (n);
+          }
+
+          //! fetch next track from file
+          bool operator() (Streamline<ValueType>& tck) {
+            if (current_index >= num_tracks) {
+              tck.clear();
+              return false;
+            }
+            load (current_index++, tck);
+            return true;
+          }
+
+          //! set the index of the next streamline to be returned by operator()
+          void seek (size_t n) { current_index = std::min (n, num_tracks); }
+
+
+        protected:
+          using __ReaderBase__::in;
+          using __ReaderBase__::dtype;
+          using __ReaderBase__::current_index;
+          using __ReaderBase__::data_file;
+          using __ReaderBase__::data_offset;
+
+          std::unique_ptr<File::MMap> mmap;
+          std::unique_ptr<TrackOffsetIndex> index;
+          std::unique_ptr<TrackWeightsIn> weights;
+          size_t vertex_size, num_tracks;
+          bool is_native;
+
+          point_type get_point (size_t vertex) const
+          {
+            const uint8_t* p = mmap->address() + vertex * vertex_size;
+            const bool is_big_endian = dtype.is_big_endian();
+            if (dtype.bytes() == 4)
+              return { ValueType (Raw::fetch<float> (p, 0, is_big_endian)),
+                       ValueType (Raw::fetch<float> (p, 1, is_big_endian)),
+                       ValueType (Raw::fetch<float> (p, 2, is_big_endian)) };
+            return { ValueType (Raw::fetch<double> (p, 0, is_big_endian)),
+                     ValueType (Raw::fetch<double> (p, 1, is_big_endian)),
+                     ValueType (Raw::fetch<double> (p, 2, is_big_endian)) };
+          }
+
+          MappedReader (const MappedReader&) = delete;
+      };
+
+
+
+    }
+  }
+}
+
+
+#endif
+
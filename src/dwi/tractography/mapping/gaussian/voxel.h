@@ -167,7 +167,7 @@ namespace MR {
 
 
 
-          class SetVoxel : public std::set<Voxel>, public Mapping::SetVoxelExtras
+          class SetVoxel : public FlatVoxelSet<Voxel>, public Mapping::SetVoxelExtras
           { MEMALIGN(SetVoxel)
             public:
 
@@ -176,16 +176,14 @@ namespace MR {
               inline void insert (const Eigen::Vector3i& v, const default_type l, const default_type f)
               {
                 const Voxel temp (v, l, f);
-                iterator existing = std::set<Voxel>::find (temp);
-                if (existing == std::set<Voxel>::end())
-                  std::set<Voxel>::insert (temp);
-                else
-                  (*existing).add (l, f);
+                const auto existing = FlatVoxelSet<Voxel>::insert (temp);
+                if (!existing.second)
+                  existing.first->add (l, f);
               }
           };
 
 
-          class SetVoxelDEC : public std::set<VoxelDEC>, public Mapping::SetVoxelExtras
+          class SetVoxelDEC : public FlatVoxelSet<VoxelDEC>, public Mapping::SetVoxelExtras
           { MEMALIGN(SetVoxelDEC)
             public:
 
@@ -194,16 +192,14 @@ namespace MR {
               inline void insert (const Eigen::Vector3i& v, const Eigen::Vector3d& d, const default_type l, const default_type f)
               {
                 const VoxelDEC temp (v, d, l, f);
-                iterator existing = std::set<VoxelDEC>::find (temp);
-                if (existing == std::set<VoxelDEC>::end())
-                  std::set<VoxelDEC>::insert (temp);
-                else
-                  (*existing).add (d, l, f);
+                const auto existing = FlatVoxelSet<VoxelDEC>::insert (temp);
+                if (!existing.second)
+                  existing.first->add (d, l, f);
               }
           };
 
 
-          class SetDixel : public std::set<Dixel>, public Mapping::SetVoxelExtras
+          class SetDixel : public FlatVoxelSet<Dixel>, public Mapping::SetVoxelExtras
           { MEMALIGN(SetDixel)
             public:
 
@@ -213,16 +209,14 @@ namespace MR {
               inline void insert (const Eigen::Vector3i& v, const dir_index_type d, const default_type l, const default_type f)
               {
                 const Dixel temp (v, d, l, f);
-                iterator existing = std::set<Dixel>::find (temp);
-                if (existing == std::set<Dixel>::end())
-                  std::set<Dixel>::insert (temp);
-                else
-                  (*existing).add (l, f);
+                const auto existing = FlatVoxelSet<Dixel>::insert (temp);
+                if (!existing.second)
+                  existing.first->add (l, f);
               }
           };
 
 
-          class SetVoxelTOD : public std::set<VoxelTOD>, public Mapping::SetVoxelExtras
+          class SetVoxelTOD : public FlatVoxelSet<VoxelTOD>, public Mapping::SetVoxelExtras
           { MEMALIGN(SetVoxelTOD)
             public:
 
@@ -232,11 +226,9 @@ namespace MR {
               inline void insert (const Eigen::Vector3i& v, const vector_type& t, const default_type l, const default_type f)
               {
                 const VoxelTOD temp (v, t, l, f);
-                iterator existing = std::set<VoxelTOD>::find (temp);
-                if (existing == std::set<VoxelTOD>::end())
-                  std::set<VoxelTOD>::insert (temp);
-                else
-                  (*existing).add (t, l, f);
+                const auto existing = FlatVoxelSet<VoxelTOD>::insert (temp);
+                if (!existing.second)
+                  existing.first->add (t, l, f);
               }
           };
 
@@ -126,6 +126,7 @@ namespace MR {
                   else
                     voxelise (temp, out);
                   postprocess (temp, out);
+                  out.sort();
                 }
                 return true;
               }
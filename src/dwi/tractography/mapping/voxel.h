@@ -19,9 +19,10 @@
 
 
 
-#include <set>
+#include <algorithm>
 
 #include "image.h"
+#include "types.h"
 
 #include "dwi/directions/set.h"
 
@@ -267,6 +268,130 @@ namespace MR {
 
 
 
+        // Hash of the location (and, for dixels, the direction) of a voxel,
+        //   consistent with the corresponding operator==()
+        inline uint64_t voxel_hash (const Voxel& v)
+        {
+          return (uint64_t(uint32_t(v[0])) * 73856093ULL) ^ (uint64_t(uint32_t(v[1])) * 19349663ULL) ^ (uint64_t(uint32_t(v[2])) * 83492791ULL);
+        }
+        inline uint64_t voxel_hash (const Dixel& v)
+        {
+          return voxel_hash (static_cast<const Voxel&> (v)) ^ (uint64_t(v.get_dir()) * 2654435761ULL);
+        }
+
+
+
+        // Insertion-only set of voxels, used as the base of the Set* classes below
+        // Elements are stored contiguously in order of insertion, and located
+        //   using an open-addressing hash table of their indices; this avoids the
+        //   per-element allocation and pointer chasing of std::set. Calling clear()
+        //   retains all allocated memory, and invalidates the hash table in constant
+        //   time, so that a set re-used for successive streamlines (as is the case
+        //   for items in a Thread::Queue) quickly stops allocating altogether.
+        // As with std::set, elements are immutable through the iterators (other
+        //   than through their mutable members); sort() provides the same iteration
+        //   order as std::set, and is invoked by the track mappers once mapping of
+        //   each streamline is complete. Both clear() and sort() invalidate the
+        //   existing hash table entries using a generation counter, such that
+        //   their cost depends only on the number of elements, and not on the
+        //   capacity of the table (which may have grown for an earlier, longer
+        //   streamline).
+        template <class VoxType>
+        class FlatVoxelSet
+        { NOMEMALIGN
+          public:
+            using value_type = VoxType;
+            using const_iterator = typename vector<VoxType>::const_iterator;
+            using iterator = const_iterator;
+
+            FlatVoxelSet () : generation (1), bits (0) { }
+
+            const_iterator begin () const { return elements.begin(); }
+            const_iterator end () const { return elements.end(); }
+            size_t size () const { return elements.size(); }
+            bool empty () const { return elements.empty(); }
+
+            void clear ()
+            {
+              elements.clear();
+              reindex();
+            }
+
+            // Insert v if no equal element is present; as std::set::insert(), returns
+            //   an iterator to the element, and whether insertion took place
+            std::pair<const_iterator, bool> insert (const VoxType& v)
+            {
+              if (2 * (elements.size() + 1) > slots.size())
+                reset_slots (std::max (size_t(64), 2 * slots.size()));
+              const size_t mask = slots.size() - 1;
+              for (size_t slot = home (v); ; slot = (slot + 1) & mask) {
+                if (slots[slot].generation != generation) {
+                  slots[slot] = Slot (generation, elements.size());
+                  elements.push_back (v);
+                  return std::make_pair (elements.cend() - 1, true);
+                }
+                const const_iterator existing = elements.cbegin() + slots[slot].index;
+                if (*existing == v)
+                  return std::make_pair (existing, false);
+              }
+            }
+
+            void sort ()
+            {
+              std::sort (elements.begin(), elements.end());
+              reindex();
+            }
+
+          private:
+            class Slot
+            { NOMEMALIGN
+              public:
+                Slot () : generation (0), index (0) { }
+                Slot (const uint32_t g, const size_t i) : generation (g), index (i) { }
+                uint32_t generation, index;
+            };
+
+            vector<VoxType> elements;
+            vector<Slot> slots;
+            uint32_t generation;
+            size_t bits;
+
+            size_t home (const VoxType& v) const
+            {
+              // Fibonacci hashing: take the upper bits of the product
+              return (voxel_hash (v) * 11400714819323198485ULL) >> (64 - bits);
+            }
+
+            // Re-build the hash table with the requested number of slots (a power of two)
+            void reset_slots (const size_t num_slots)
+            {
+              slots.assign (num_slots, Slot());
+              generation = 0;
+              for (bits = 0; (size_t(1) << bits) < num_slots; ++bits);
+              reindex();
+            }
+
+            // Invalidate all slots by advancing the generation counter (only
+            //   erasing the table explicitly if the counter wraps around), then
+            //   re-insert the indices of all elements
+            void reindex ()
+            {
+              if (!++generation) {
+                slots.assign (slots.size(), Slot());
+                generation = 1;
+              }
+              const size_t mask = slots.size() - 1;
+              for (size_t n = 0; n != elements.size(); ++n) {
+                size_t slot = home (elements[n]);
+                while (slots[slot].generation == generation)
+                  slot = (slot + 1) & mask;
+                slots[slot] = Slot (generation, n);
+              }
+            }
+        };
+
+
+
         class SetVoxelExtras
         { NOMEMALIGN
           public:
@@ -282,17 +407,15 @@ namespace MR {
 
         // Set classes that give sensible behaviour to the insert() function depending on the base voxel class
 
-        class SetVoxel : public std::set<Voxel>, public SetVoxelExtras
+        class SetVoxel : public FlatVoxelSet<Voxel>, public SetVoxelExtras
         { NOMEMALIGN
           public:
             using VoxType = Voxel;
             inline void insert (const Voxel& v)
             {
-              iterator existing = std::set<Voxel>::find (v);
-              if (existing == std::set<Voxel>::end())
-                std::set<Voxel>::insert (v);
-              else
-                (*existing) += v.get_length();
+              const auto existing = FlatVoxelSet<Voxel>::insert (v);
+              if (!existing.second)
+                (*existing.first) += v.get_length();
             }
             inline void insert (const Eigen::Vector3i& v, const default_type l)
             {
@@ -305,17 +428,15 @@ namespace MR {
 
 
 
-        class SetVoxelDEC : public std::set<VoxelDEC>, public SetVoxelExtras
+        class SetVoxelDEC : public FlatVoxelSet<VoxelDEC>, public SetVoxelExtras
         { NOMEMALIGN
           public:
             using VoxType = VoxelDEC;
             inline void insert (const VoxelDEC& v)
             {
-              iterator existing = std::set<VoxelDEC>::find (v);
-              if (existing == std::set<VoxelDEC>::end())
-                std::set<VoxelDEC>::insert (v);
-              else
-                existing->add (v.get_colour(), v.get_length());
+              const auto existing = FlatVoxelSet<VoxelDEC>::insert (v);
+              if (!existing.second)
+                existing.first->add (v.get_colour(), v.get_length());
             }
             inline void insert (const Eigen::Vector3i& v, const Eigen::Vector3d& d)
             {
@@ -332,17 +453,15 @@ namespace MR {
 
 
 
-        class SetVoxelDir : public std::set<VoxelDir>, public SetVoxelExtras
+        class SetVoxelDir : public FlatVoxelSet<VoxelDir>, public SetVoxelExtras
         { NOMEMALIGN
           public:
             using VoxType = VoxelDir;
             inline void insert (const VoxelDir& v)
             {
-              iterator existing = std::set<VoxelDir>::find (v);
-              if (existing == std::set<VoxelDir>::end())
-                std::set<VoxelDir>::insert (v);
-              else
-                existing->add (v.get_dir(), v.get_length());
+              const auto existing = FlatVoxelSet<VoxelDir>::insert (v);
+              if (!existing.second)
+                existing.first->add (v.get_dir(), v.get_length());
             }
             inline void insert (const Eigen::Vector3i& v, const Eigen::Vector3d& d)
             {
@@ -357,7 +476,7 @@ namespace MR {
         };
 
 
-        class SetDixel : public std::set<Dixel>, public SetVoxelExtras
+        class SetDixel : public FlatVoxelSet<Dixel>, public SetVoxelExtras
         { NOMEMALIGN
           public:
 
@@ -366,11 +485,9 @@ namespace MR {
 
             inline void insert (const Dixel& v)
             {
-              iterator existing = std::set<Dixel>::find (v);
-              if (existing == std::set<Dixel>::end())
-                std::set<Dixel>::insert (v);
-              else
-                (*existing) += v.get_length();
+              const auto existing = FlatVoxelSet<Dixel>::insert (v);
+              if (!existing.second)
+                (*existing.first) += v.get_length();
             }
             inline void insert (const Eigen::Vector3i& v, const dir_index_type d)
             {
@@ -388,7 +505,7 @@ namespace MR {
 
 
 
-        class SetVoxelTOD : public std::set<VoxelTOD>, public SetVoxelExtras
+        class SetVoxelTOD : public FlatVoxelSet<VoxelTOD>, public SetVoxelExtras
         { NOMEMALIGN
           public:
 
@@ -397,11 +514,9 @@ namespace MR {
 
             inline void insert (const VoxelTOD& v)
             {
-              iterator existing = std::set<VoxelTOD>::find (v);
-              if (existing == std::set<VoxelTOD>::end())
-                std::set<VoxelTOD>::insert (v);
-              else
-                (*existing) += v.get_tod();
+              const auto existing = FlatVoxelSet<VoxelTOD>::insert (v);
+              if (!existing.second)
+                (*existing.first) += v.get_tod();
             }
             inline void insert (const Eigen::Vector3i& v, const vector_type& t)
             {
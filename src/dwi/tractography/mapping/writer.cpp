@@ -16,6 +16,8 @@
 
 #include "dwi/tractography/mapping/writer.h"
 
+#include "file/config.h"
+
 
 namespace MR {
 namespace DWI {
@@ -28,6 +30,22 @@ const char* writer_dims[] = { "undefined", "greyscale", "DEC", "dixel", "TOD", N
 
 
 
+size_t private_buffer_limit()
+{
+  //CONF option: TrackMappingPrivateBufferLimit
+  //CONF default: 2048
+  //CONF The maximal total amount of memory (in MB) that may be used during
+  //CONF track mapping (e.g. in tckmap) to provide each mapping thread with
+  //CONF its own copy of the output buffer(s), rather than passing all
+  //CONF mapped streamlines to a single writer thread. If the buffers for
+  //CONF all threads would exceed this amount, the single writer thread is
+  //CONF used instead.
+  static const size_t limit = size_t (File::Config::get_int ("TrackMappingPrivateBufferLimit", 2048)) << 20;
+  return limit;
+}
+
+
+
 }
 }
 }
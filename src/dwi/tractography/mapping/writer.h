@@ -17,13 +17,18 @@
 #ifndef __dwi_tractography_mapping_writer_h__
 #define __dwi_tractography_mapping_writer_h__
 
+#include <mutex>
+
 #include "memory.h"
 #include "file/path.h"
 #include "file/utils.h"
 #include "image.h"
 #include "algo/loop.h"
+#include "algo/threaded_loop.h"
 #include "thread_queue.h"
 
+#include "dwi/tractography/streamline.h"
+
 #include "dwi/tractography/mapping/twi_stats.h"
 #include "dwi/tractography/mapping/voxel.h"
 #include "dwi/tractography/mapping/gaussian/voxel.h"
@@ -43,6 +48,9 @@ namespace MR {
         enum writer_dim { UNDEFINED, GREYSCALE, DEC, DIXEL, TOD };
         extern const char* writer_dims[];
 
+        // Maximal total memory (in bytes) that may be used by thread-private buffers
+        size_t private_buffer_limit();
+
 
 
         class MapWriterBase
@@ -78,6 +86,14 @@ namespace MR {
             virtual bool operator() (const Gaussian::SetDixel&)    { return false; }
             virtual bool operator() (const Gaussian::SetVoxelTOD&) { return false; }
 
+            // When mapping is cheap, a single thread receiving the output of all mapping
+            //   threads becomes the bottleneck; instead, each mapping thread can accumulate
+            //   into its own private writer (see MapAccumulator), and these are then
+            //   combined in parallel by finalise(). This is only done if there is enough
+            //   memory to hold one copy of the buffers per thread.
+            virtual bool use_private_buffers (const size_t num_threads) const { return false; }
+            virtual MapWriterBase& get_private () { throw Exception ("Writer does not support thread-private buffers"); }
+
 
           protected:
             const Header& H;
@@ -152,6 +168,9 @@ namespace MR {
 
           void finalise () override {
 
+            if (private_writers.size())
+              reduce();
+
             auto loop = Loop (buffer, 0, 3);
             switch (voxel_statistic) {
 
@@ -247,10 +266,23 @@ namespace MR {
           bool operator() (const Gaussian::SetDixel& in)    override { receive_dixel     (in); return true; }
           bool operator() (const Gaussian::SetVoxelTOD& in) override { receive_tod       (in); return true; }
 
+          bool use_private_buffers (const size_t num_threads) const override;
+          MapWriterBase& get_private () override
+          {
+            std::lock_guard<std::mutex> lock (private_mutex);
+            private_writers.emplace_back (new MapWriter (H, output_image_name, voxel_statistic, type));
+            return *private_writers.back();
+          }
+
 
           private:
           Image<value_type> buffer;
 
+          vector<std::unique_ptr<MapWriter>> private_writers;
+          std::mutex private_mutex;
+          class Reducer;
+          void reduce ();
+
           // Template functions used so that the functors don't have to be written twice
           //   (once for standard TWI and one for Gaussian track-wise statistic)
           template <class Cont> void receive_greyscale (const Cont&);
@@ -440,6 +472,168 @@ namespace MR {
 
 
 
+        template <typename value_type>
+          bool MapWriter<value_type>::use_private_buffers (const size_t num_threads) const
+          {
+            if (num_threads < 2)
+              return false;
+            size_t bytes = footprint<value_type> (voxel_count (buffer));
+            if (counts)
+              bytes += footprint<float> (voxel_count (*counts));
+            return num_threads * bytes <= private_buffer_limit();
+          }
+
+        // Bitwise images cannot be combined safely across threads, since adjacent
+        //   voxels share the same byte
+        template <>
+        inline bool MapWriter<bool>::use_private_buffers (const size_t) const
+        {
+          return false;
+        }
+
+
+
+
+        // Combine the contents of the private buffers into the main buffer for a
+        //   single voxel, in a manner consistent with the voxel statistic
+        template <typename value_type>
+          class MapWriter<value_type>::Reducer
+        { MEMALIGN(MapWriter<value_type>::Reducer)
+
+          public:
+            Reducer (MapWriter& master) :
+                type (master.type),
+                voxel_statistic (master.voxel_statistic)
+            {
+              if (master.counts)
+                counts = *master.counts;
+              for (const auto& w : master.private_writers) {
+                buffers.push_back (w->buffer);
+                if (w->counts)
+                  private_counts.push_back (*w->counts);
+              }
+            }
+
+            void operator() (Image<value_type>& out)
+            {
+              if (counts.valid())
+                assign_pos_of (out, 0, 3).to (counts);
+              for (size_t n = 0; n != buffers.size(); ++n) {
+                auto& in (buffers[n]);
+                assign_pos_of (out, 0, 3).to (in);
+                if (counts.valid())
+                  assign_pos_of (out, 0, 3).to (private_counts[n]);
+                switch (type) {
+                  case GREYSCALE: reduce_scalar (out, in, n); break;
+                  case DIXEL:
+                    for (auto l = Loop (3) (out, in); l; ++l) {
+                      if (counts.valid())
+                        counts.index(3) = private_counts[n].index(3) = out.index(3);
+                      reduce_scalar (out, in, n);
+                    }
+                    break;
+                  case DEC: reduce_dec (out, in, n); break;
+                  case TOD: reduce_tod (out, in, n); break;
+                  default: assert (0);
+                }
+              }
+            }
+
+          private:
+            const writer_dim type;
+            const vox_stat_t voxel_statistic;
+            vector<Image<value_type>> buffers;
+            Image<float> counts;
+            vector<Image<float>> private_counts;
+
+            void reduce_scalar (Image<value_type>& out, Image<value_type>& in, const size_t n)
+            {
+              switch (voxel_statistic) {
+                case V_SUM:  out.value() += in.value(); break;
+                case V_MIN:  out.value() = std::min (value_type (out.value()), value_type (in.value())); break;
+                case V_MAX:  out.value() = std::max (value_type (out.value()), value_type (in.value())); break;
+                case V_MEAN: out.value() += in.value(); counts.value() += private_counts[n].value(); break;
+                default:     throw Exception ("Unknown / unhandled voxel statistic in MapWriter::reduce()");
+              }
+            }
+
+            void reduce_dec (Image<value_type>& out, Image<value_type>& in, const size_t n)
+            {
+              Eigen::Vector3d out_value, in_value;
+              for (out.index(3) = in.index(3) = 0; out.index(3) != 3; ++out.index(3), ++in.index(3)) {
+                out_value[out.index(3)] = out.value();
+                in_value[in.index(3)] = in.value();
+              }
+              switch (voxel_statistic) {
+                case V_SUM:
+                  out_value += in_value;
+                  counts.value() += private_counts[n].value();
+                  break;
+                case V_MIN:
+                  if (in_value.squaredNorm() < out_value.squaredNorm())
+                    out_value = in_value;
+                  break;
+                case V_MEAN:
+                  out_value += in_value;
+                  break;
+                case V_MAX:
+                  if (in_value.squaredNorm() > out_value.squaredNorm())
+                    out_value = in_value;
+                  break;
+                default:
+                  throw Exception ("Unknown / unhandled voxel statistic in MapWriter::reduce()");
+              }
+              for (out.index(3) = 0; out.index(3) != 3; ++out.index(3))
+                out.value() = out_value[out.index(3)];
+            }
+
+            // For TOD with voxel statistic min/max, the counts buffers hold the
+            //   minimum / maximum factor contributing to the TOD in each voxel
+            void reduce_tod (Image<value_type>& out, Image<value_type>& in, const size_t n)
+            {
+              switch (voxel_statistic) {
+                case V_SUM:
+                  for (auto l = Loop (3) (out, in); l; ++l)
+                    out.value() += in.value();
+                  break;
+                case V_MIN:
+                  if (private_counts[n].value() < counts.value()) {
+                    counts.value() = private_counts[n].value();
+                    for (auto l = Loop (3) (out, in); l; ++l)
+                      out.value() = in.value();
+                  }
+                  break;
+                case V_MAX:
+                  if (private_counts[n].value() > counts.value()) {
+                    counts.value() = private_counts[n].value();
+                    for (auto l = Loop (3) (out, in); l; ++l)
+                      out.value() = in.value();
+                  }
+                  break;
+                case V_MEAN:
+                  for (auto l = Loop (3) (out, in); l; ++l)
+                    out.value() += in.value();
+                  counts.value() += private_counts[n].value();
+                  break;
+                default:
+                  throw Exception ("Unknown / unhandled voxel statistic in MapWriter::reduce()");
+              }
+            }
+        };
+
+
+
+        template <typename value_type>
+          void MapWriter<value_type>::reduce ()
+          {
+            ThreadedLoop ("combining " + str(private_writers.size()) + " thread-private " + str(writer_dims[type]) + " buffers", buffer, 0, 3)
+                .run (Reducer (*this), buffer);
+            private_writers.clear();
+          }
+
+
+
+
         template <>
         inline void MapWriter<bool>::add (const default_type weight, const default_type factor)
         {
@@ -503,6 +697,46 @@ namespace MR {
 
 
 
+
+        // Maps streamlines and accumulates the result into a thread-private writer
+        //   obtained from the main writer; for use as the final stage of the
+        //   pipeline, in place of mapper -> writer, when the main writer
+        //   supports thread-private buffers
+        template <class MapperType, class Cont>
+          class MapAccumulator
+        { MEMALIGN(MapAccumulator<MapperType,Cont>)
+
+          public:
+            MapAccumulator (const MapperType& mapper, MapWriterBase& master) :
+                mapper (mapper),
+                master (master),
+                writer (nullptr) { }
+
+            MapAccumulator (const MapAccumulator& that) :
+                mapper (that.mapper),
+                master (that.master),
+                writer (nullptr) { }
+
+            bool operator() (Streamline<>& in)
+            {
+              // Only request a private buffer once this copy is actually in use by a thread
+              if (!writer)
+                writer = &master.get_private();
+              mapper (in, voxels);
+              return (*writer) (voxels);
+            }
+
+          private:
+            MapperType mapper;
+            MapWriterBase& master;
+            MapWriterBase* writer;
+            Cont voxels;
+        };
+
+
+
+
+
       }
     }
   }
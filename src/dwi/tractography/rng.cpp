@@ -15,6 +15,7 @@
  */
 
 #include "dwi/tractography/rng.h"
+#include "thread.h"
 
 namespace MR
 {
@@ -25,6 +26,18 @@ namespace MR
 
       thread_local Math::RNG rng;
 
+      namespace {
+        // Threads are run on re-used workers, on which the thread-local RNG
+        //   would otherwise carry on from the previous task; re-seed it for
+        //   each task, as though the task were run on a new thread
+        class ReseedPerTask { NOMEMALIGN
+          public:
+            ReseedPerTask () {
+              Thread::__ThreadPool::add_task_initialiser ([] () { rng.seed (Math::RNG::get_seed()); });
+            }
+        } reseed_per_task;
+      }
+
     }
   }
 }
@@ -22,7 +22,9 @@
 #include "types.h"
 #include "file/config.h"
 #include "file/key_value.h"
+#include "file/mmap.h"
 #include "file/ofstream.h"
+#include "raw.h"
 #include "dwi/tractography/file_base.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
@@ -262,6 +264,146 @@ namespace MR
       };
 
 
+
+      //! class to read per-streamline weights from a binary track weights file
+      /*! Binary track weights files (conventionally with the .tsw suffix) use
+       * the same header format as track scalar files, but with the file type
+       * "mrtrix track weights". Rather than a delimited list of values for
+       * each streamline, the data consist of a single contiguous array of \c
+       * count values, one per streamline. The data are therefore not read
+       * sequentially, but accessed in place through a read-only memory
+       * mapping: individual values can be fetched in any order using
+       * operator[](), without any parsing. */
+      class WeightsReader : public __ReaderBase__
+      { NOMEMALIGN
+        public:
+          WeightsReader (const std::string& file, Properties& properties) :
+            num_values (0),
+            data (nullptr)
+          {
+            open (file, "track weights", properties);
+            in.close();
+            auto count = properties.find ("count");
+            if (count == properties.end())
+              throw Exception ("missing \"count\" field in track weights file \"" + file + "\"");
+            num_values = to<size_t> (count->second);
+            if (!num_values)
+              return;
+            mmap.reset (new File::MMap (File::Entry (data_file, data_offset), false, true, num_values * dtype.bytes()));
+            data = mmap->address();
+          }
+
+          //! the number of values in the file
+          size_t size () const { return num_values; }
+
+          //! the weight of streamline \a index
+          default_type operator[] (size_t index) const
+          {
+            assert (index < num_values);
+            switch (dtype()) {
+              case DataType::Float32LE: return Raw::fetch_LE<float> (data, index);
+              case DataType::Float32BE: return Raw::fetch_BE<float> (data, index);
+              case DataType::Float64LE: return Raw::fetch_LE<double> (data, index);
+              case DataType::Float64BE: return Raw::fetch_BE<double> (data, index);
+              default: assert (0); break;
+            }
+            return NaN;
+          }
+
+        protected:
+          using __ReaderBase__::in;
+          using __ReaderBase__::dtype;
+          using __ReaderBase__::data_file;
+          using __ReaderBase__::data_offset;
+
+          std::unique_ptr<File::MMap> mmap;
+          size_t num_values;
+          const uint8_t* data;
+
+          WeightsReader (const WeightsReader&) = delete;
+      };
+
+
+
+      //! class to handle writing per-streamline weights to a binary file
+      /*! writes a track weights file header as specified in \a properties,
+       * followed by one value per call to operator(). As with ScalarWriter,
+       * values are held in a write-back RAM buffer of up to
+       * TrackWriterBufferSize bytes, and only committed to file when the
+       * buffer is full, when commit() is invoked explicitly, or on
+       * destruction. The buffer only grows as required, so that many such
+       * writers can be open at once when each is committed frequently. The
+       * file type is "mrtrix track weights"; see WeightsReader. */
+      template <typename T = float>
+      class WeightsWriter : public __WriterBase__<T>
+      { NOMEMALIGN
+        public:
+          using value_type = T;
+          using __WriterBase__<T>::count;
+          using __WriterBase__<T>::total_count;
+          using __WriterBase__<T>::name;
+          using __WriterBase__<T>::dtype;
+          using __WriterBase__<T>::create;
+          using __WriterBase__<T>::update_counts;
+          using __WriterBase__<T>::verify_stream;
+          using __WriterBase__<T>::open_success;
+
+          WeightsWriter (const std::string& file, const Properties& properties) :
+            __WriterBase__<T> (file),
+            buffer_capacity (std::max (File::Config::get_int ("TrackWriterBufferSize", 16777216) / sizeof (value_type), size_t(1)))
+          {
+            File::OFStream out;
+            try {
+              out.open (name, std::ios::out | std::ios::binary | std::ios::trunc);
+            } catch (Exception& e) {
+              throw Exception (e, "Unable to create output track weights file");
+            }
+
+            // Do NOT set Properties timestamp here! (Must match corresponding .tck file)
+            create (out, properties, "track weights");
+            verify_stream (out);
+            open_success = true;
+            current_offset = out.tellp();
+          }
+
+          ~WeightsWriter() {
+            commit();
+          }
+
+          bool operator() (default_type weight)
+          {
+            if (buffer.size() == buffer_capacity)
+              commit();
+            using namespace ByteOrder;
+            buffer.push_back (dtype.is_little_endian() ? LE (value_type (weight)) : BE (value_type (weight)));
+            ++count;
+            ++total_count;
+            return true;
+          }
+
+          void commit ()
+          {
+            if (buffer.empty() || !open_success)
+              return;
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            out.seekp (current_offset, out.beg);
+            out.write (reinterpret_cast<const char*> (buffer.data()), sizeof(value_type)*buffer.size());
+            current_offset = int64_t (out.tellp());
+            verify_stream (out);
+            update_counts (out);
+            verify_stream (out);
+            buffer.clear();
+          }
+
+        protected:
+          const size_t buffer_capacity;
+          vector<value_type> buffer;
+          int64_t current_offset;
+
+          WeightsWriter (const WeightsWriter&) = delete;
+      };
+
+
     }
   }
 }
@@ -0,0 +1,204 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/tracking/amplitude_lookup.h"
+
+#include <algorithm>
+
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+#include "math/SH.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        constexpr int32_t AmplitudeLookup::zero_voxel;
+        constexpr int32_t AmplitudeLookup::invalid_voxel;
+
+
+
+        class AmplitudeLookup::Projector { MEMALIGN(Projector)
+          public:
+            Projector (AmplitudeLookup& lookup, const Eigen::MatrixXf& transform) :
+                L (lookup),
+                transform (transform),
+                coefs (transform.cols()) { }
+
+            void operator() (Image<float>& in)
+            {
+              const int32_t row = L.voxel_row (in.index(0), in.index(1), in.index(2));
+              if (row < 0)
+                return;
+              for (auto l = Loop (3) (in); l; ++l)
+                coefs[in.index(3)] = in.value();
+              Eigen::Map<Eigen::VectorXf> (L.amplitudes.data() + size_t(row) * transform.rows(), transform.rows()).noalias() = transform * coefs;
+            }
+
+          private:
+            AmplitudeLookup& L;
+            const Eigen::MatrixXf& transform;
+            Eigen::VectorXf coefs;
+        };
+
+
+
+        AmplitudeLookup::AmplitudeLookup (Image<float>& source, const size_t num_directions) :
+            scanner2voxel (Transform (source).scanner2voxel),
+            num_dirs (num_directions)
+        {
+          for (size_t axis = 0; axis != 3; ++axis)
+            sizes[axis] = source.size (axis);
+          const DWI::Directions::FastLookupSet dirs (num_directions);
+          init_direction_lookup (dirs);
+
+          // Only voxels with non-zero FOD coefficients are allocated storage
+          rows.resize (sizes[0] * sizes[1] * sizes[2]);
+          size_t num_rows = 0;
+          for (auto l = Loop ("locating non-zero FOD voxels", source, 0, 3) (source); l; ++l) {
+            bool zero = true, finite = true;
+            for (auto v = Loop (3) (source); v; ++v) {
+              const float value = source.value();
+              if (value)
+                zero = false;
+              if (!std::isfinite (value))
+                finite = false;
+            }
+            rows[source.index(0) + sizes[0] * (source.index(1) + sizes[1] * source.index(2))] =
+                finite ? (zero ? zero_voxel : int32_t (num_rows++)) : invalid_voxel;
+          }
+
+          const size_t bytes = num_rows * num_directions * sizeof (float);
+          INFO ("pre-computing FOD amplitudes along " + str(num_directions) + " directions in "
+                + str(num_rows) + " voxels requires " + str(bytes / (1024*1024)) + " MB");
+          try {
+            amplitudes.resize (num_rows * num_directions);
+          } catch (std::bad_alloc&) {
+            throw Exception ("Insufficient memory to pre-compute FOD amplitudes along " + str(num_directions) + " directions "
+                             "(" + str(bytes / (1024*1024)) + " MB required); use a smaller direction set");
+          }
+
+          Eigen::MatrixXd cartesian (num_directions, 3);
+          for (size_t i = 0; i != num_directions; ++i)
+            cartesian.row (i) = dirs[i].transpose();
+          const Eigen::MatrixXf transform = Math::SH::init_transform_cart (cartesian, Math::SH::LforN (source.size (3))).cast<float>();
+
+          ThreadedLoop ("pre-computing FOD amplitudes along " + str(num_directions) + " directions", source, 0, 3)
+              .run (Projector (*this, transform), source);
+        }
+
+
+
+        void AmplitudeLookup::init_direction_lookup (const DWI::Directions::FastLookupSet& dirs)
+        {
+          vector<Eigen::Vector3f> unit_vectors;
+          for (size_t i = 0; i != dirs.size(); ++i)
+            unit_vectors.push_back (dirs[i].cast<float>());
+          auto same_hemisphere = [&] (const Eigen::Vector3f& reference, const index_type i) {
+            return reference.dot (unit_vectors[i]) < 0.0f ? Eigen::Vector3f (-unit_vectors[i]) : unit_vectors[i];
+          };
+
+          // Adjacency within the direction set accounts for antipodal symmetry:
+          //   neighbours lying in the opposite hemisphere are negated
+          vector<vector<uint32_t>> vertex_triangles (dirs.size());
+          for (index_type i = 0; i != dirs.size(); ++i) {
+            const auto& adj = dirs.get_adj_dirs (i);
+            for (size_t a = 0; a != adj.size(); ++a) {
+              if (adj[a] < i)
+                continue;
+              const Eigen::Vector3f uj = same_hemisphere (unit_vectors[i], adj[a]);
+              for (size_t b = a+1; b != adj.size(); ++b) {
+                if (adj[b] < i || !dirs.dirs_are_adjacent (adj[a], adj[b]))
+                  continue;
+                const Eigen::Vector3f uk = same_hemisphere (unit_vectors[i], adj[b]);
+                if (uj.dot (uk) <= 0.0f)
+                  continue;
+                Eigen::Matrix3f M;
+                M.col(0) = unit_vectors[i];
+                M.col(1) = uj;
+                M.col(2) = uk;
+                if (std::abs (M.determinant()) < 1.0e-6f)
+                  continue;
+                Triangle t;
+                t.vertices[0] = i;
+                t.vertices[1] = adj[a];
+                t.vertices[2] = adj[b];
+                t.inverse = M.inverse();
+                for (size_t n = 0; n != 3; ++n)
+                  vertex_triangles[t.vertices[n]].push_back (triangles.size());
+                triangles.push_back (t);
+              }
+            }
+          }
+          if (triangles.empty())
+            throw Exception ("Unable to triangulate set of " + str(dirs.size()) + " directions for FOD amplitude lookup");
+
+          // Each grid cell lists the triangles containing any of a set of
+          //   points sampled across the cell (including its boundaries); these
+          //   are found via the triangles incident to the nearest direction
+          grid_size = std::ceil (std::sqrt (2.0 * dirs.size()));
+          constexpr size_t samples_per_cell = 4;
+          cell_offsets.assign (1, 0);
+          vector<uint32_t> this_cell;
+          for (size_t face = 0; face != 3; ++face) {
+            for (size_t iu = 0; iu != grid_size; ++iu) {
+              for (size_t iv = 0; iv != grid_size; ++iv) {
+                this_cell.clear();
+                for (size_t su = 0; su != samples_per_cell; ++su) {
+                  for (size_t sv = 0; sv != samples_per_cell; ++sv) {
+                    Eigen::Vector3d p;
+                    p[face] = 1.0;
+                    p[(face+1)%3] = 2.0 * (iu + su / default_type(samples_per_cell-1)) / grid_size - 1.0;
+                    p[(face+2)%3] = 2.0 * (iv + sv / default_type(samples_per_cell-1)) / grid_size - 1.0;
+                    p.normalize();
+                    const Eigen::Vector3f d = p.cast<float>();
+                    float best = -std::numeric_limits<float>::infinity();
+                    uint32_t best_triangle = 0;
+                    for (const auto t : vertex_triangles[dirs.select_direction (p)]) {
+                      Eigen::Vector3f b = triangles[t].inverse * d;
+                      if (b.sum() < 0.0f)
+                        b = -b;
+                      if (b.minCoeff() > best) {
+                        best = b.minCoeff();
+                        best_triangle = t;
+                      }
+                    }
+                    if (std::find (this_cell.begin(), this_cell.end(), best_triangle) == this_cell.end())
+                      this_cell.push_back (best_triangle);
+                  }
+                }
+                cell_triangles.insert (cell_triangles.end(), this_cell.begin(), this_cell.end());
+                cell_offsets.push_back (cell_triangles.size());
+              }
+            }
+          }
+        }
+
+
+
+      }
+    }
+  }
+}
+
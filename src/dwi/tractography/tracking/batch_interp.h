@@ -0,0 +1,157 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_tracking_batch_interp_h__
+#define __dwi_tractography_tracking_batch_interp_h__
+
+
+#include "image.h"
+#include "transform.h"
+#include "types.h"
+
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        //! Trilinear interpolation of all volumes of a 4D image at many positions at once
+        /*! For each position, the result is equivalent to setting the position
+         * of Interpolator<Image<float>>::type (i.e. masked trilinear
+         * interpolation), and reading the values of all volumes as done by
+         * MethodBase::get_data(): the row of the output is set to NaN wherever
+         * get_data() would have returned false.
+         *
+         * Only the transformation of positions into voxel space is performed
+         * as a single matrix operation; the interpolation itself proceeds one
+         * position at a time.
+         *
+         * Voxel data are read directly from memory; the image must therefore
+         * be accessed via direct IO (as is the case for SharedBase::source). */
+        class BatchInterp { MEMALIGN(BatchInterp)
+          public:
+            BatchInterp (Image<float> image) :
+                scanner2voxel (Transform (image).scanner2voxel),
+                num_volumes (image.size(3))
+            {
+              for (size_t axis = 0; axis != 4; ++axis)
+                image.index (axis) = 0;
+              data = image.address();
+              for (size_t axis = 0; axis != 4; ++axis)
+                strides[axis] = image.stride (axis);
+              for (size_t axis = 0; axis != 3; ++axis)
+                sizes[axis] = image.size (axis);
+            }
+
+            //! interpolate at the scanner-space positions in the columns of \a positions
+            /*! Upon return, row \a n of \a values holds the values of all
+             * volumes at position \a n. */
+            template <class PositionsType>
+            void operator() (const PositionsType& positions, Eigen::MatrixXf& values)
+            {
+              const ssize_t N = positions.cols();
+              voxels.noalias() = scanner2voxel.linear() * positions.template cast<default_type>();
+              voxels.colwise() += scanner2voxel.translation();
+              values.resize (N, num_volumes);
+
+              for (ssize_t n = 0; n != N; ++n) {
+                const Eigen::Vector3d pos (voxels.col (n));
+
+                // Out of bounds, or no finite & non-zero data in the nearest voxel
+                if (!in_bounds (pos) || !non_zero (data + offset (std::lround (pos[0]), std::lround (pos[1]), std::lround (pos[2])))) {
+                  values.row (n).setConstant (NaN);
+                  continue;
+                }
+
+                Eigen::Vector3d f (pos[0] - std::floor (pos[0]), pos[1] - std::floor (pos[1]), pos[2] - std::floor (pos[2]));
+                for (size_t axis = 0; axis != 3; ++axis) {
+                  if (pos[axis] < 0.0 || pos[axis] > sizes[axis] - 1.0)
+                    f[axis] = 0.0;
+                }
+                const float x_weights[2] = { float(1.0 - f[0]), float(f[0]) };
+                const float y_weights[2] = { float(1.0 - f[1]), float(f[1]) };
+                const float z_weights[2] = { float(1.0 - f[2]), float(f[2]) };
+                const ssize_t c[3] = { ssize_t (std::floor (pos[0])), ssize_t (std::floor (pos[1])), ssize_t (std::floor (pos[2])) };
+
+                auto row = values.row (n);
+                row.setZero();
+                for (ssize_t z = 0; z < 2; ++z) {
+                  const ssize_t iz = clamp (c[2] + z, 2);
+                  for (ssize_t y = 0; y < 2; ++y) {
+                    const ssize_t iy = clamp (c[1] + y, 1);
+                    const float partial_weight = y_weights[y] * z_weights[z];
+                    for (ssize_t x = 0; x < 2; ++x) {
+                      float weight = x_weights[x] * partial_weight;
+                      if (weight < 1.0e-6f)
+                        weight = 0.0f;
+                      row += weight * volumes (data + offset (clamp (c[0] + x, 0), iy, iz)).transpose();
+                    }
+                  }
+                }
+
+                if (std::isnan (row[0]))
+                  row.setConstant (NaN);
+              }
+            }
+
+          private:
+            const transform_type scanner2voxel;
+            const ssize_t num_volumes;
+            const float* data;
+            ssize_t strides[4];
+            ssize_t sizes[3];
+            Eigen::Matrix3Xd voxels;
+
+            using volumes_type = Eigen::Map<const Eigen::VectorXf, 0, Eigen::InnerStride<>>;
+
+            FORCE_INLINE bool in_bounds (const Eigen::Vector3d& pos) const {
+              return pos[0] > -0.5 && pos[0] < sizes[0] - 0.5 &&
+                     pos[1] > -0.5 && pos[1] < sizes[1] - 0.5 &&
+                     pos[2] > -0.5 && pos[2] < sizes[2] - 0.5;
+            }
+            FORCE_INLINE ssize_t clamp (const ssize_t x, const size_t axis) const {
+              return x < 0 ? 0 : (x >= sizes[axis] ? sizes[axis] - 1 : x);
+            }
+            FORCE_INLINE ssize_t offset (const ssize_t x, const ssize_t y, const ssize_t z) const {
+              return x * strides[0] + y * strides[1] + z * strides[2];
+            }
+            FORCE_INLINE volumes_type volumes (const float* p) const {
+              return volumes_type (p, num_volumes, Eigen::InnerStride<> (strides[3]));
+            }
+            // NaN values count as non-zero, as in Interp::Masked
+            FORCE_INLINE bool non_zero (const float* p) const {
+              for (ssize_t v = 0; v != num_volumes; ++v)
+                if (p[v * strides[3]])
+                  return true;
+              return false;
+            }
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
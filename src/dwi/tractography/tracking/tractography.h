@@ -61,6 +61,7 @@ namespace MR
           constexpr float maxlength_voxels = 100.0f;
 
           constexpr size_t ifod2_nsamples = 4;
+          constexpr size_t ifod2_batch_size = 1;
         }
 
         extern const App::OptionGroup TrackOption;
@@ -16,6 +16,9 @@
 
 #include "dwi/tractography/weights.h"
 
+#include "app.h"
+#include "file/ofstream.h"
+
 namespace MR
 {
   namespace DWI
@@ -26,13 +29,70 @@ namespace MR
       using namespace App;
 
       const Option TrackWeightsInOption
-      = Option ("tck_weights_in", "specify a text scalar file containing the streamline weights")
+      = Option ("tck_weights_in", "specify a file containing the streamline weights; "
+                                  "this may be either a text file with one value per streamline, "
+                                  "or a binary track weights file (.tsw)")
           + Argument ("path").type_file_in();
 
       const Option TrackWeightsOutOption
-      = Option ("tck_weights_out", "specify the path for an output text scalar file containing streamline weights")
+      = Option ("tck_weights_out", "specify the path for an output file containing streamline weights; "
+                                   "these will be written in binary form if the path has the .tsw suffix, "
+                                   "and as a text file otherwise")
           + Argument ("path").type_file_out();
 
+
+
+
+      TrackWeightsIn::TrackWeightsIn (const std::string& path)
+      {
+        if (is_binary_weights_file (path))
+          binary.reset (new WeightsReader (path, header));
+        else
+          text = load_vector (path);
+      }
+
+
+
+      TrackWeightsOut::TrackWeightsOut (const std::string& path, const Properties& properties) :
+          path (path)
+      {
+        if (is_binary_weights_file (path)) {
+          binary.reset (new WeightsWriter<float> (path, properties));
+        } else {
+          App::check_overwrite (path);
+          File::OFStream out (path, std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+      }
+
+      void TrackWeightsOut::commit ()
+      {
+        if (binary) {
+          binary->commit();
+          return;
+        }
+        if (text.empty())
+          return;
+        File::OFStream out (path, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+        out << text;
+        if (!out.good())
+          throw Exception ("error writing streamline weights file \"" + path + "\": " + strerror (errno));
+        text.clear();
+      }
+
+
+
+      Eigen::VectorXd load_weights (const std::string& path)
+      {
+        if (!is_binary_weights_file (path))
+          return load_vector (path);
+        Properties properties;
+        WeightsReader in (path, properties);
+        Eigen::VectorXd weights (in.size());
+        for (size_t n = 0; n != in.size(); ++n)
+          weights[n] = in[n];
+        return weights;
+      }
+
     }
   }
 }
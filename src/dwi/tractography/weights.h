@@ -18,6 +18,11 @@
 #define __dwi_tractography_weights_h__
 
 #include "cmdline_option.h"
+#include "types.h"
+#include "file/path.h"
+#include "math/math.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/scalar_file.h"
 
 namespace MR
 {
@@ -30,6 +35,98 @@ namespace MR
       extern const App::Option TrackWeightsInOption;
       extern const App::Option TrackWeightsOutOption;
 
+
+
+      //! whether \a path refers to a binary track weights file
+      /*! Streamline weights are stored in binary form (see WeightsReader and
+       * WeightsWriter) if the file name has the .tsw suffix; any other path is
+       * handled as a text file with one value per streamline. */
+      inline bool is_binary_weights_file (const std::string& path)
+      {
+        return Path::has_suffix (lowercase (path), ".tsw");
+      }
+
+
+
+      //! read-only access to per-streamline weights, in either text or binary format
+      /*! Binary (.tsw) files are memory-mapped, and individual weights
+       * fetched from the mapping on demand; text files are parsed in full on
+       * construction. */
+      class TrackWeightsIn
+      { NOMEMALIGN
+        public:
+          TrackWeightsIn (const std::string& path);
+
+          size_t size () const { return binary ? binary->size() : size_t (text.size()); }
+          default_type operator[] (size_t index) const { return binary ? (*binary)[index] : text[index]; }
+
+          //! the header of a binary weights file (empty for a text file)
+          const Properties& properties () const { return header; }
+
+        protected:
+          Properties header;
+          std::unique_ptr<WeightsReader> binary;
+          Eigen::VectorXd text;
+      };
+
+
+
+      //! write per-streamline weights, in either text or binary format
+      /*! The format is determined from the suffix of \a path (see
+       * is_binary_weights_file()). For a binary file, the header is
+       * generated from \a properties, which should be those of the
+       * corresponding track file. Weights are buffered in RAM until commit()
+       * is invoked, or on destruction. */
+      class TrackWeightsOut
+      { NOMEMALIGN
+        public:
+          TrackWeightsOut (const std::string& path, const Properties& properties);
+          ~TrackWeightsOut () { commit(); }
+
+          //! append a weight; \a separator follows each value in a text file
+          void operator() (default_type weight, const char separator = '\n') {
+            if (binary)
+              (*binary) (weight);
+            else
+              text += str (weight) + separator;
+          }
+
+          void commit ();
+
+        protected:
+          const std::string path;
+          std::unique_ptr<WeightsWriter<float>> binary;
+          std::string text;
+      };
+
+
+
+      //! load per-streamline weights from a text or binary (.tsw) file
+      Eigen::VectorXd load_weights (const std::string& path);
+
+      //! save per-streamline weights to a text or binary (.tsw) file
+      /*! \a properties are only used for binary files; see TrackWeightsOut. */
+      template <class VectorType>
+        void save_weights (const VectorType& weights, const std::string& path, const Properties& properties)
+        {
+          if (!is_binary_weights_file (path)) {
+            save_vector (weights, path);
+            return;
+          }
+          WeightsWriter<float> out (path, properties);
+          for (ssize_t n = 0; n != ssize_t (weights.size()); ++n)
+            out (weights[n]);
+        }
+
+      //! save per-streamline weights not associated with any particular track file
+      template <class VectorType>
+        void save_weights (const VectorType& weights, const std::string& path)
+        {
+          Properties properties;
+          properties.erase ("timestamp");
+          save_weights (weights, path, properties);
+        }
+
     }
   }
 }
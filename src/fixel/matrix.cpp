@@ -17,9 +17,13 @@
 
 #include "fixel/matrix.h"
 
+#include <queue>
+
 #include "app.h"
+#include "signal_handler.h"
 #include "thread_queue.h"
 #include "types.h"
+#include "file/config.h"
 #include "file/ofstream.h"
 #include "file/path.h"
 #include "file/utils.h"
@@ -123,11 +127,7 @@ namespace MR
 
 
 
-      init_matrix_type generate (
-          const std::string& track_filename,
-          Image<index_type>& index_image,
-          Image<bool>& fixel_mask,
-          const float angular_threshold)
+      namespace
       {
 
         class TrackProcessor { MEMALIGN(TrackProcessor)
@@ -198,122 +198,152 @@ namespace MR
         };
 
 
-        auto directions_image = Fixel::find_directions_header (Path::dirname (index_image.name())).template get_image<default_type>().with_direct_io ({+2,+1});
-        DWI::Tractography::Properties properties;
-        DWI::Tractography::Reader<float> track_file (track_filename, properties);
-        const uint32_t num_tracks = properties["count"].empty() ? 0 : to<uint32_t>(properties["count"]);
-        DWI::Tractography::Mapping::TrackLoader loader (track_file, num_tracks, "computing fixel-fixel connectivity matrix");
-        DWI::Tractography::Mapping::TrackMapperBase mapper (index_image);
-        mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_image, properties, 0.333f));
-        mapper.set_use_precise_mapping (true);
-        TrackProcessor track_processor (mapper, index_image, directions_image, fixel_mask, angular_threshold);
-        init_matrix_type connectivity_matrix (Fixel::get_number_of_fixels (index_image));
-        Thread::run_queue (loader,
-                           Thread::batch (DWI::Tractography::Streamline<float>()),
-                           track_processor,
-                           Thread::batch (vector<index_type>()),
-                           // Inline lambda function for receiving streamline fixel visitations and
-                           //   updating the connectivity matrix
-                           [&] (const vector<index_type>& fixels)
-                           {
-                             try {
-                               for (auto f : fixels)
-                                 connectivity_matrix[f].add (fixels);
-                               return true;
-                             } catch (...) {
-                               throw Exception ("Error assigning memory for CFE connectivity matrix");
-                               return false;
-                             }
-                           });
-        return connectivity_matrix;
-      }
 
+        // Map all streamlines to fixels, and pass the resulting (sorted) list
+        //   of fixel indices for each streamline to the sink functor
+        template <class SinkType>
+        void map_tracks (const std::string& track_filename,
+                         Image<index_type>& index_image,
+                         Image<bool>& fixel_mask,
+                         const float angular_threshold,
+                         SinkType&& sink)
+        {
+          auto directions_image = Fixel::find_directions_header (Path::dirname (index_image.name())).template get_image<default_type>().with_direct_io ({+2,+1});
+          DWI::Tractography::Properties properties;
+          DWI::Tractography::Reader<float> track_file (track_filename, properties);
+          const uint32_t num_tracks = properties["count"].empty() ? 0 : to<uint32_t>(properties["count"]);
+          DWI::Tractography::Mapping::TrackLoader loader (track_file, num_tracks, "computing fixel-fixel connectivity matrix");
+          DWI::Tractography::Mapping::TrackMapperBase mapper (index_image);
+          mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_image, properties, 0.333f));
+          mapper.set_use_precise_mapping (true);
+          TrackProcessor track_processor (mapper, index_image, directions_image, fixel_mask, angular_threshold);
+          Thread::run_queue (loader,
+                             Thread::batch (DWI::Tractography::Streamline<float>()),
+                             track_processor,
+                             Thread::batch (vector<index_type>()),
+                             sink);
+        }
 
 
 
+        //CONF option: FixelMatrixMemoryLimit
+        //CONF default: 8192
+        //CONF The maximal amount of memory (in MB) to be used to hold the
+        //CONF fixel-fixel connectivity matrix during its construction by
+        //CONF fixelconnectivity. Beyond this limit, the matrix is
+        //CONF constructed in parts, which are written to temporary files
+        //CONF and merged once all streamlines have been processed.
+        size_t memory_limit ()
+        {
+          return size_t(File::Config::get_int ("FixelMatrixMemoryLimit", 8192)) << 20;
+        }
 
-      void normalise_and_write (init_matrix_type& matrix,
-                                const connectivity_value_type threshold,
-                                const std::string& path,
-                                const KeyValues& keyvals)
-      {
 
-        if (Path::exists (path)) {
-          if (!Path::is_dir (path)) {
-            if (App::overwrite_files) {
-              File::remove (path);
-            } else {
-              throw Exception ("Cannot create fixel-fixel connectivity matrix \"" + path + "\": Already exists as file");
+
+        // Write a normalised & thresholded connectivity matrix to the filesystem,
+        //   one fixel at a time in order of fixel index
+        class Writer
+        { NOMEMALIGN
+          public:
+            Writer (const std::string& path, const size_t num_fixels, const KeyValues& keyvals);
+
+            void add (const vector<InitElement>& connections, const count_type track_count, const connectivity_value_type threshold);
+            // Update headers to reflect the number of fixel-fixel connections
+            void finalise();
+
+          protected:
+            Image<index_image_type> index_image;
+            File::OFStream fixel_stream, value_stream;
+            size_t num_fixels, fixel_index, data_count;
+            vector<index_type> fixel_buffer;
+            vector<connectivity_value_type> value_buffer;
+
+            static const std::string leadin;
+            // Need enough space for the largest possible 64-bit unsigned integer,
+            //   plus ",1,1" for the two dummy axes
+            static size_t dim_padding() { return std::log10 (std::numeric_limits<size_t>::max()) + 4; }
+        };
+
+        const std::string Writer::leadin = "mrtrix image\ndim: ";
+
+
+
+        Writer::Writer (const std::string& path, const size_t num_fixels, const KeyValues& keyvals) :
+            num_fixels (num_fixels),
+            fixel_index (0),
+            data_count (0)
+        {
+          if (Path::exists (path)) {
+            if (!Path::is_dir (path)) {
+              if (App::overwrite_files) {
+                File::remove (path);
+              } else {
+                throw Exception ("Cannot create fixel-fixel connectivity matrix \"" + path + "\": Already exists as file");
+              }
             }
+          } else {
+            File::mkdir (path);
           }
-        } else {
-          File::mkdir (path);
-        }
 
-        Header index_header;
-        index_header.ndim() = 4;
-        index_header.size(0) = matrix.size();
-        index_header.size(1) = 1;
-        index_header.size(2) = 1;
-        index_header.size(3) = 2;
-        index_header.stride(0) = 2;
-        index_header.stride(1) = 3;
-        index_header.stride(2) = 4;
-        index_header.stride(3) = 1;
-        index_header.spacing(0) = index_header.spacing(1) = index_header.spacing(2) = 1.0;
-        index_header.transform() = transform_type::Identity();
-        index_header.keyval() = keyvals;
-        index_header.keyval()["nfixels"] = str(matrix.size());
-        index_header.datatype() = DataType::from<index_image_type>();
-        Image<index_image_type> index_image = Image<index_image_type>::create (Path::join (path, "index.mif"), index_header);
-
-        // Can't use function write_mrtrix_header() as the file offset of the
-        //   first entry of the "dim" field needs to be known
-        //   (and enough space needs to be left to fill in a large number upon completion)
-        File::OFStream fixel_stream (Path::join (path, "fixels.mif"), std::ios_base::out | std::ios_base::binary);
-        File::OFStream value_stream (Path::join (path, "values.mif"), std::ios_base::out | std::ios_base::binary);
-
-        const std::string leadin = "mrtrix image\ndim: ";
-        // Need enough space for the largest possible 64-bit unsigned integer,
-        //   plus ",1,1" for the two dummy axes
-        const size_t dim_padding = std::log10 (std::numeric_limits<size_t>::max()) + 4;
-
-        Eigen::IOFormat fmt(Eigen::FullPrecision, Eigen::DontAlignCols, ", ", "\ntransform: ", "", "", "\ntransform: ", "");
-
-        for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
-          File::OFStream& stream (stream_index ? value_stream : fixel_stream);
-          stream << leadin << std::string (dim_padding, ' ') << "\n";
-          stream << "vox: 1,1,1\n";
-          stream << "layout: +0,+1,+2\n";
-          stream << "datatype: ";
-          if (stream_index)
-            stream << DataType::from<connectivity_value_type>().specifier();
-          else
-            stream << DataType::from<index_type>().specifier();
-          stream << transform_type::Identity().matrix().topLeftCorner(3,4).format(fmt) << "\n";
-          stream << "scaling: 0,1\n";
-          stream << "nfixels: " + str(matrix.size()) + "\n";
-          File::KeyValue::write (stream, keyvals, "", true);
-          stream << "file: ";
-          uint64_t offset = uint64_t(stream.tellp()) + 18;
-          offset += ((4 - (offset % 4)) % 4);
-          stream << ". " << offset << "\nEND\n";
-          stream << std::string (offset - uint64_t(stream.tellp()), '\0');
+          Header index_header;
+          index_header.ndim() = 4;
+          index_header.size(0) = num_fixels;
+          index_header.size(1) = 1;
+          index_header.size(2) = 1;
+          index_header.size(3) = 2;
+          index_header.stride(0) = 2;
+          index_header.stride(1) = 3;
+          index_header.stride(2) = 4;
+          index_header.stride(3) = 1;
+          index_header.spacing(0) = index_header.spacing(1) = index_header.spacing(2) = 1.0;
+          index_header.transform() = transform_type::Identity();
+          index_header.keyval() = keyvals;
+          index_header.keyval()["nfixels"] = str(num_fixels);
+          index_header.datatype() = DataType::from<index_image_type>();
+          index_image = Image<index_image_type>::create (Path::join (path, "index.mif"), index_header);
+
+          // Can't use function write_mrtrix_header() as the file offset of the
+          //   first entry of the "dim" field needs to be known
+          //   (and enough space needs to be left to fill in a large number upon completion)
+          fixel_stream.open (Path::join (path, "fixels.mif"), std::ios_base::out | std::ios_base::binary);
+          value_stream.open (Path::join (path, "values.mif"), std::ios_base::out | std::ios_base::binary);
+
+          Eigen::IOFormat fmt(Eigen::FullPrecision, Eigen::DontAlignCols, ", ", "\ntransform: ", "", "", "\ntransform: ", "");
+
+          for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
+            File::OFStream& stream (stream_index ? value_stream : fixel_stream);
+            stream << leadin << std::string (dim_padding(), ' ') << "\n";
+            stream << "vox: 1,1,1\n";
+            stream << "layout: +0,+1,+2\n";
+            stream << "datatype: ";
+            if (stream_index)
+              stream << DataType::from<connectivity_value_type>().specifier();
+            else
+              stream << DataType::from<index_type>().specifier();
+            stream << transform_type::Identity().matrix().topLeftCorner(3,4).format(fmt) << "\n";
+            stream << "scaling: 0,1\n";
+            stream << "nfixels: " + str(num_fixels) + "\n";
+            File::KeyValue::write (stream, keyvals, "", true);
+            stream << "file: ";
+            uint64_t offset = uint64_t(stream.tellp()) + 18;
+            offset += ((4 - (offset % 4)) % 4);
+            stream << ". " << offset << "\nEND\n";
+            stream << std::string (offset - uint64_t(stream.tellp()), '\0');
+          }
         }
 
-        ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", matrix.size());
-        size_t data_count = 0;
-        vector<index_type> fixel_buffer;
-        vector<connectivity_value_type> value_buffer;
-        for (size_t fixel_index = 0; fixel_index != matrix.size(); ++fixel_index) {
 
+
+        void Writer::add (const vector<InitElement>& connections, const count_type track_count, const connectivity_value_type threshold)
+        {
+          assert (fixel_index < num_fixels);
           fixel_buffer.clear();
           value_buffer.clear();
-          fixel_buffer.reserve (matrix[fixel_index].size());
-          value_buffer.reserve (matrix[fixel_index].size());
+          fixel_buffer.reserve (connections.size());
+          value_buffer.reserve (connections.size());
 
-          const connectivity_value_type normalisation_factor = connectivity_value_type(1) / connectivity_value_type (matrix[fixel_index].count());
-          for (auto& it : matrix[fixel_index]) {
+          const connectivity_value_type normalisation_factor = connectivity_value_type(1) / connectivity_value_type (track_count);
+          for (auto& it : connections) {
             const connectivity_value_type connectivity = normalisation_factor * it.value();
             if (connectivity >= threshold) {
               fixel_buffer.push_back (it.index());
@@ -321,7 +351,7 @@ namespace MR
             }
           }
 
-          index_image.index (0) = fixel_index;
+          index_image.index (0) = fixel_index++;
           index_image.index (3) = 0; index_image.value() = uint64_t(fixel_buffer.size());
           index_image.index (3) = 1; index_image.value() = fixel_buffer.size() ? data_count : uint64_t(0);
 
@@ -329,20 +359,113 @@ namespace MR
           value_stream.write (reinterpret_cast<const char*>(value_buffer.data()), value_buffer.size() * sizeof (connectivity_value_type));
 
           data_count += fixel_buffer.size();
+        }
 
-          // Force deallocation of memory used for this fixel in the generated matrix
-          InitFixel().swap (matrix[fixel_index]);
 
-          ++progress;
+
+        void Writer::finalise()
+        {
+          assert (fixel_index == num_fixels);
+          std::string dim_string = str(data_count) + ",1,1";
+          dim_string += std::string (dim_padding() - dim_string.size(), ' ');
+          for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
+            File::OFStream& stream (stream_index ? value_stream : fixel_stream);
+            stream.seekp (leadin.size());
+            stream << dim_string;
+          }
+        }
+
+
+
+        // A partial connectivity matrix, written to a temporary file as a run of
+        //   non-empty fixels in increasing order of fixel index; for each, the fixel
+        //   index and number of connections are followed by the connected fixel
+        //   index and streamline count of each connection, in increasing order of
+        //   connected fixel index. Data are stored in native byte order.
+        class Run
+        { NOMEMALIGN
+          public:
+            Run (init_matrix_type& matrix);
+            Run (const Run&) = delete;
+            Run (Run&&) = default;
+            ~Run();
+
+            // Read the connections of the next fixel in the run;
+            //   returns false once the run is exhausted
+            bool next();
+            index_type fixel() const { return current_fixel; }
+            // Append the connections of the current fixel
+            void append (vector<InitElement>& connections);
+
+          protected:
+            std::string filename;
+            std::unique_ptr<std::ifstream> in;
+            index_type current_fixel;
+            vector<fixel_index_type> buffer;
+        };
+
+
+
+        Run::Run (init_matrix_type& matrix) :
+            filename (File::create_tempfile (0, "dat")),
+            current_fixel (0)
+        {
+          SignalHandler::mark_file_for_deletion (filename);
+          std::ofstream out (filename, std::ios_base::out | std::ios_base::binary);
+          for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+            if (matrix[fixel].empty())
+              continue;
+            buffer.resize (2 * matrix[fixel].size() + 2);
+            buffer[0] = fixel;
+            buffer[1] = matrix[fixel].size();
+            auto b = buffer.begin() + 2;
+            for (const auto& element : matrix[fixel]) {
+              *b++ = element.index();
+              *b++ = element.value();
+            }
+            out.write (reinterpret_cast<const char*> (buffer.data()), buffer.size() * sizeof (fixel_index_type));
+            // Force deallocation of memory used for this fixel
+            InitFixel().swap (matrix[fixel]);
+          }
+          if (!out)
+            throw Exception ("error writing temporary file \"" + filename + "\" for fixel-fixel connectivity matrix: " + strerror (errno));
+          out.close();
+          in.reset (new std::ifstream (filename, std::ios_base::in | std::ios_base::binary));
+          if (!*in)
+            throw Exception ("error opening temporary file \"" + filename + "\" for fixel-fixel connectivity matrix: " + strerror (errno));
         }
 
-        // Update headers to reflect the number of fixel-fixel connections
-        std::string dim_string = str(data_count) + ",1,1";
-        dim_string += std::string (dim_padding - dim_string.size(), ' ');
-        for (size_t stream_index = 0; stream_index != 2; ++stream_index) {
-          File::OFStream& stream (stream_index ? value_stream : fixel_stream);
-          stream.seekp (leadin.size());
-          stream << dim_string;
+
+
+        Run::~Run()
+        {
+          if (filename.size()) {
+            in.reset();
+            File::remove (filename);
+            SignalHandler::unmark_file_for_deletion (filename);
+          }
+        }
+
+
+
+        bool Run::next()
+        {
+          fixel_index_type header[2];
+          if (!in->read (reinterpret_cast<char*> (header), sizeof (header)))
+            return false;
+          current_fixel = header[0];
+          buffer.resize (2 * header[1]);
+          if (!in->read (reinterpret_cast<char*> (buffer.data()), buffer.size() * sizeof (fixel_index_type)))
+            throw Exception ("error reading temporary file \"" + filename + "\" for fixel-fixel connectivity matrix");
+          return true;
+        }
+
+
+
+        void Run::append (vector<InitElement>& connections)
+        {
+          for (size_t i = 0; i != buffer.size(); i += 2)
+            connections.emplace_back (InitElement (buffer[i], buffer[i+1]));
         }
 
       }
@@ -350,8 +473,143 @@ namespace MR
 
 
 
+      init_matrix_type generate (
+          const std::string& track_filename,
+          Image<index_type>& index_image,
+          Image<bool>& fixel_mask,
+          const float angular_threshold)
+      {
+        init_matrix_type connectivity_matrix (Fixel::get_number_of_fixels (index_image));
+        map_tracks (track_filename, index_image, fixel_mask, angular_threshold,
+                    // Inline lambda function for receiving streamline fixel visitations and
+                    //   updating the connectivity matrix
+                    [&] (const vector<index_type>& fixels)
+                    {
+                      try {
+                        for (auto f : fixels)
+                          connectivity_matrix[f].add (fixels);
+                        return true;
+                      } catch (...) {
+                        throw Exception ("Error assigning memory for CFE connectivity matrix");
+                        return false;
+                      }
+                    });
+        return connectivity_matrix;
+      }
+
+
+
+
+
+      void generate_and_write (
+          const std::string& track_filename,
+          Image<index_type>& index_image,
+          Image<bool>& fixel_mask,
+          const float angular_threshold,
+          const connectivity_value_type connectivity_threshold,
+          const std::string& path,
+          const KeyValues& keyvals)
+      {
+        const size_t num_fixels = Fixel::get_number_of_fixels (index_image);
+        const size_t limit = memory_limit();
+        init_matrix_type connectivity_matrix (num_fixels);
+        // Streamline counts per fixel need to persist across runs
+        vector<count_type> track_counts (num_fixels, 0);
+        vector<Run> runs;
+        size_t memory_used = 0;
+
+        map_tracks (track_filename, index_image, fixel_mask, angular_threshold,
+                    [&] (const vector<index_type>& fixels)
+                    {
+                      try {
+                        for (auto f : fixels) {
+                          const size_t capacity = connectivity_matrix[f].capacity();
+                          connectivity_matrix[f].add (fixels);
+                          memory_used += (connectivity_matrix[f].capacity() - capacity) * sizeof (InitElement);
+                          ++track_counts[f];
+                        }
+                      } catch (...) {
+                        throw Exception ("Error assigning memory for CFE connectivity matrix");
+                      }
+                      if (memory_used > limit) {
+                        DEBUG ("writing partial fixel-fixel connectivity matrix to temporary file (" + str(memory_used >> 20) + " MB)");
+                        runs.emplace_back (connectivity_matrix);
+                        memory_used = 0;
+                      }
+                      return true;
+                    });
+
+        Writer writer (path, num_fixels, keyvals);
+
+        if (runs.empty()) {
+          ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", num_fixels);
+          for (size_t fixel_index = 0; fixel_index != num_fixels; ++fixel_index) {
+            writer.add (connectivity_matrix[fixel_index], track_counts[fixel_index], connectivity_threshold);
+            InitFixel().swap (connectivity_matrix[fixel_index]);
+            ++progress;
+          }
+          writer.finalise();
+          return;
+        }
+
+        runs.emplace_back (connectivity_matrix);
+        connectivity_matrix = init_matrix_type();
+        INFO ("merging " + str(runs.size()) + " partial fixel-fixel connectivity matrices");
+
+        // k-way merge: the runs holding the next fixel are found using a min-heap
+        using heap_entry_type = std::pair<index_type, size_t>;
+        std::priority_queue<heap_entry_type, vector<heap_entry_type>, std::greater<heap_entry_type>> heap;
+        for (size_t r = 0; r != runs.size(); ++r) {
+          if (runs[r].next())
+            heap.push (heap_entry_type (runs[r].fixel(), r));
+        }
+
+        ProgressBar progress ("Merging, normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", num_fixels);
+        vector<InitElement> connections;
+        for (size_t fixel_index = 0; fixel_index != num_fixels; ++fixel_index) {
+          connections.clear();
+          while (!heap.empty() && heap.top().first == fixel_index) {
+            const size_t r = heap.top().second;
+            heap.pop();
+            runs[r].append (connections);
+            if (runs[r].next())
+              heap.push (heap_entry_type (runs[r].fixel(), r));
+          }
+          // Sum the streamline counts of connections appearing in multiple runs
+          std::sort (connections.begin(), connections.end());
+          size_t out = 0;
+          for (size_t in = 0; in != connections.size(); ++in) {
+            if (out && connections[out-1].index() == connections[in].index())
+              connections[out-1] = InitElement (connections[in].index(), connections[out-1].value() + connections[in].value());
+            else
+              connections[out++] = connections[in];
+          }
+          connections.resize (out);
+          writer.add (connections, track_counts[fixel_index], connectivity_threshold);
+          ++progress;
+        }
+        writer.finalise();
+      }
+
+
+
 
 
+      void normalise_and_write (init_matrix_type& matrix,
+                                const connectivity_value_type threshold,
+                                const std::string& path,
+                                const KeyValues& keyvals)
+      {
+        Writer writer (path, matrix.size(), keyvals);
+        ProgressBar progress ("Normalising and writing fixel-fixel connectivity matrix to directory \"" + path + "\"", matrix.size());
+        for (size_t fixel_index = 0; fixel_index != matrix.size(); ++fixel_index) {
+          writer.add (matrix[fixel_index], matrix[fixel_index].count(), threshold);
+          // Force deallocation of memory used for this fixel in the generated matrix
+          InitFixel().swap (matrix[fixel_index]);
+          ++progress;
+        }
+        writer.finalise();
+      }
 
 
 
@@ -451,6 +709,82 @@ namespace MR
 
 
 
+      CSR::CSR (const Reader& matrix, const connectivity_value_type C) :
+          index_image (Image<index_image_type>::open (Path::join (matrix.directory, "index.mif")).with_direct_io ({2,3,4,1})),
+          fixel_image (Image<fixel_index_type>::open (Path::join (matrix.directory, "fixels.mif")).with_direct_io ({1,2,3})),
+          value_image (Image<connectivity_value_type>::open (Path::join (matrix.directory, "values.mif")).with_direct_io ({1,2,3})),
+          mask (matrix.size(), true),
+          norm_multipliers (matrix.size(), connectivity_value_type (0))
+      {
+        index_image.reset();
+        fixel_image.reset();
+        value_image.reset();
+        index_data = index_image.address();
+        index_stride = index_image.stride (0);
+        offset_stride = index_image.stride (3);
+        fixel_data = fixel_image.address();
+        value_data = value_image.address();
+        assert (fixel_image.stride (0) == 1 && value_image.stride (0) == 1);
+
+        if (matrix.mask_image.valid()) {
+          Image<bool> mask_image (matrix.mask_image);
+          for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+            mask_image.index (0) = fixel;
+            mask[fixel] = mask_image.value();
+          }
+        }
+
+        // Connectivity values need to be exponentiated only once; these are
+        //   written to a temporary file rather than held in memory
+        const size_t num_connections = fixel_image.size (0);
+        connectivity_value_type* exponentiated = nullptr;
+        if (C != connectivity_value_type (1) && num_connections) {
+          const std::string path = File::create_tempfile (num_connections * sizeof (connectivity_value_type), "dat");
+          // Ensure removal of the file even if construction fails
+          SignalHandler::mark_file_for_deletion (path);
+          exponentiated_values.reset (new File::MMap (File::Entry (path), true, false));
+          exponentiated = reinterpret_cast<connectivity_value_type*> (exponentiated_values->address());
+        }
+
+        ProgressBar progress ("Pre-processing fixel-fixel connectivity matrix", matrix.size());
+        for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+          if (mask[fixel]) {
+            const size_t count = size (fixel);
+            const fixel_index_type* const connected_fixels = fixels (fixel);
+            const connectivity_value_type* const connectivity = values (fixel);
+            connectivity_value_type* const out = exponentiated ? exponentiated + offset (fixel) : nullptr;
+            default_type sum = 0.0;
+            for (size_t i = 0; i != count; ++i) {
+              const connectivity_value_type value = out ? (out[i] = std::pow (connectivity[i], C)) : connectivity[i];
+              if (mask[connected_fixels[i]])
+                sum += value;
+            }
+            norm_multipliers[fixel] = sum ? connectivity_value_type (1.0 / sum) : connectivity_value_type (0);
+          }
+          ++progress;
+        }
+        if (exponentiated)
+          value_data = exponentiated;
+      }
+
+
+
+      CSR::~CSR()
+      {
+        if (exponentiated_values) {
+          const std::string path = exponentiated_values->name();
+          exponentiated_values.reset();
+          File::remove (path);
+          SignalHandler::unmark_file_for_deletion (path);
+        }
+      }
+
+
+
+
+
+
+
 
     }
   }
@@ -20,6 +20,7 @@
 
 #include "image.h"
 #include "types.h"
+#include "file/mmap.h"
 #include "file/ofstream.h"
 #include "fixel/index_remapper.h"
 
@@ -158,6 +159,25 @@ namespace MR
 
 
 
+      // Generate a fixel-fixel connectivity matrix, normalising and writing it
+      //   directly to the filesystem (see normalise_and_write() below)
+      // The matrix is built in memory as for generate(); however whenever its size
+      //   exceeds the FixelMatrixMemoryLimit config file option, the partial matrix
+      //   is written to a temporary file as a sorted run and cleared. Once all
+      //   streamlines have been processed, these runs are merged one fixel at a time
+      //   as the output is written, such that the full matrix is never held in memory.
+      void generate_and_write (
+          const std::string& track_filename,
+          Image<fixel_index_type>& index_image,
+          Image<bool>& fixel_mask,
+          const float angular_threshold,
+          const connectivity_value_type connectivity_threshold,
+          const std::string& path,
+          const KeyValues& keyvals = KeyValues());
+
+
+
+
 
 
       // New code for handling load/save of fixel-fixel connectivity matrix
@@ -219,6 +239,7 @@ namespace MR
           size_t size (const size_t) const;
 
         protected:
+          friend class CSR;
           const std::string directory;
           // Not to be manipulated directly; need to copy in order to ensure thread-safety
           Image<index_image_type> index_image;
@@ -231,6 +252,49 @@ namespace MR
 
 
 
+      // Compressed sparse row view of the normalised connectivity matrix, for
+      //   repeated traversal (e.g. during statistical enhancement)
+      // The connected fixel indices and connectivity values of each fixel are
+      //   accessed directly from the memory-mapped images of the matrix directory,
+      //   such that the matrix is paged in by the operating system as required
+      //   rather than loaded into memory. Where a processing mask was provided to
+      //   the Reader, connections to fixels outside the mask remain present, and
+      //   must be skipped by the caller using in_mask().
+      class CSR
+      { MEMALIGN(CSR)
+        public:
+          // If C is not 1.0, each connectivity value is raised to the power C, and the
+          //   normalisation multiplier of each fixel computed accordingly; the
+          //   exponentiated values are stored in a memory-mapped temporary file
+          CSR (const Reader& matrix, const connectivity_value_type C = connectivity_value_type (1));
+          CSR (const CSR&) = delete;
+          ~CSR();
+
+          size_t size() const { return norm_multipliers.size(); }
+          FORCE_INLINE size_t size (const size_t fixel) const { return mask[fixel] ? index_data[fixel*index_stride] : 0; }
+
+          FORCE_INLINE bool in_mask (const size_t fixel) const { return mask[fixel]; }
+          FORCE_INLINE const fixel_index_type* fixels (const size_t fixel) const { return fixel_data + offset (fixel); }
+          FORCE_INLINE const connectivity_value_type* values (const size_t fixel) const { return value_data + offset (fixel); }
+          FORCE_INLINE connectivity_value_type norm_multiplier (const size_t fixel) const { return norm_multipliers[fixel]; }
+
+        protected:
+          Image<index_image_type> index_image;
+          Image<fixel_index_type> fixel_image;
+          Image<connectivity_value_type> value_image;
+          const index_image_type* index_data;
+          ssize_t index_stride, offset_stride;
+          const fixel_index_type* fixel_data;
+          const connectivity_value_type* value_data;
+          std::unique_ptr<File::MMap> exponentiated_values;
+          vector<bool> mask;
+          vector<connectivity_value_type> norm_multipliers;
+
+          FORCE_INLINE index_image_type offset (const size_t fixel) const { return index_data[fixel*index_stride + offset_stride]; }
+      };
+
+
+
     }
   }
 }
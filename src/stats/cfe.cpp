@@ -29,7 +29,7 @@ namespace MR
               const value_type H,
               const value_type C,
               const bool norm) :
-        matrix (connectivity_matrix),
+        matrix (connectivity_matrix, C),
         dh (dh),
         E (E),
         H (H),
@@ -41,44 +41,47 @@ namespace MR
     void CFE::operator() (in_column_type stats, out_column_type enhanced_stats) const
     {
       enhanced_stats.setZero();
-      vector<default_type> connected_stats;
-      for (size_t fixel = 0; fixel < matrix.size(); ++fixel) {
-        if (stats[fixel] < dh)
-          continue;
-        auto connections = matrix[fixel];
-        // Need to re-normalise based on the value of the power C
-        if (C != 1.0) {
-          default_type sum = 0.0;
-          for (auto& c : connections) {
-            c.exponentiate (C);
-            sum += c.value();
-          }
-          connections.normalise (Fixel::Matrix::connectivity_value_type (sum));
-        }
-        // Rather than allocating data for the stats and then looping over dh,
-        //   divide statistic by dh to determine the number of cluster sizes that should
-        //   be incremented, and dynamically increment all cluster sizes for that
-        //   particular connected fixel
-        vector<Fixel::Matrix::connectivity_value_type> extents (std::floor (stats[fixel]/dh), Fixel::Matrix::connectivity_value_type(0));
-        for (const auto& connection : connections) {
-          const default_type connection_stat = stats[connection.index()];
-          if (connection_stat > dh) {
-            const size_t cluster_count = std::min (extents.size(), size_t(std::floor (connection_stat / dh)));
-            for (size_t cluster_index = 0; cluster_index != cluster_count; ++cluster_index)
-              extents[cluster_index] += connection.value();
-          }
+
+      // Determine up-front the number of cluster sizes to which each fixel
+      //   contributes as a connected fixel, i.e. the number of thresholds it exceeds;
+      //   fixels outside of the processing mask contribute to none
+      vector<uint32_t> steps (matrix.size());
+      size_t max_steps = 0;
+      for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+        if (matrix.in_mask (fixel) && stats[fixel] >= dh) {
+          const size_t count = std::floor (stats[fixel]/dh);
+          max_steps = std::max (max_steps, count);
+          steps[fixel] = stats[fixel] > dh ? count : 0;
         }
-        // Pre-calculate h^H
-        if (h_pow_H.size() < extents.size()) {
-          const size_t old_size = h_pow_H.size();
-          h_pow_H.resize (extents.size());
-          for (size_t ih = old_size; ih != h_pow_H.size(); ++ih)
-            h_pow_H[ih] = std::pow (dh*(ih+1), H);
+      }
+
+      // Pre-calculate h^H
+      vector<default_type> h_pow_H (max_steps + 1);
+      for (size_t ih = 1; ih <= max_steps; ++ih)
+        h_pow_H[ih] = std::pow (dh*ih, H);
+
+      vector<default_type> extents (max_steps + 1);
+      for (size_t fixel = 0; fixel != matrix.size(); ++fixel) {
+        if (!matrix.in_mask (fixel) || stats[fixel] < dh)
+          continue;
+        const size_t cluster_count = std::floor (stats[fixel]/dh);
+        // Rather than incrementing the cluster sizes for all thresholds exceeded
+        //   by each connected fixel, accumulate each connection only at the highest
+        //   threshold (capped at that of this fixel) in a single pass over the
+        //   connections; the cluster sizes for all thresholds are then given by the
+        //   cumulative sum from the highest threshold down
+        std::fill (extents.begin(), extents.begin() + cluster_count + 1, default_type(0));
+        const Fixel::Matrix::fixel_index_type* const connected_fixels = matrix.fixels (fixel);
+        const Fixel::Matrix::connectivity_value_type* const connectivity = matrix.values (fixel);
+        const size_t num_connections = matrix.size (fixel);
+        for (size_t i = 0; i != num_connections; ++i)
+          extents[std::min<size_t> (cluster_count, steps[connected_fixels[i]])] += connectivity[i];
+        default_type extent = 0.0, enhanced = 0.0;
+        for (size_t cluster_index = cluster_count; cluster_index != 0; --cluster_index) {
+          extent += extents[cluster_index];
+          enhanced += std::pow (extent, E) * h_pow_H[cluster_index];
         }
-        for (size_t cluster_index = 0; cluster_index != extents.size(); ++cluster_index)
-          enhanced_stats[fixel] += std::pow (extents[cluster_index], E) * h_pow_H[cluster_index];
-        if (normalise)
-          enhanced_stats[fixel] *= connections.norm_multiplier;
+        enhanced_stats[fixel] = normalise ? enhanced * matrix.norm_multiplier (fixel) : enhanced;
       }
     }
 
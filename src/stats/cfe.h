@@ -42,12 +42,11 @@ namespace MR
         virtual ~CFE() { }
 
       protected:
-        Fixel::Matrix::Reader matrix;
+        // Connectivity values are pre-exponentiated by C
+        const Fixel::Matrix::CSR matrix;
         const value_type dh, E, H, C;
         const bool normalise;
 
-        mutable vector<value_type> h_pow_H;
-
         void operator() (in_column_type, out_column_type) const override;
     };
 
@@ -25,6 +25,33 @@ namespace MR
 
 
 
+      namespace
+      {
+        void stack (const vector<Math::Stats::Shuffle>& shuffles, matrix_type& shuffling_matrices)
+        {
+          assert (shuffles.size());
+          const ssize_t rows = shuffles[0].data.rows();
+          shuffling_matrices.resize (shuffles.size() * rows, rows);
+          for (size_t i = 0; i != shuffles.size(); ++i)
+            shuffling_matrices.middleRows (i * rows, rows) = shuffles[i].data;
+        }
+      }
+
+
+
+      bool ShuffleBatcher::operator() (vector<Math::Stats::Shuffle>& output)
+      {
+        output.resize (batch_size);
+        size_t count = 0;
+        while (count != batch_size && shuffler (output[count]))
+          ++count;
+        output.resize (count);
+        return count;
+      }
+
+
+
+
       PreProcessor::PreProcessor (const std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator,
                                   const std::shared_ptr<EnhancerBase> enhancer,
                                   const default_type skew,
@@ -61,7 +88,28 @@ namespace MR
         if (!shuffle.data.rows())
           return false;
         (*stats_calculator) (shuffle.data, stats);
-        (*enhancer) (stats, enhanced_stats);
+        process (stats);
+        return true;
+      }
+
+
+
+      bool PreProcessor::operator() (const vector<Math::Stats::Shuffle>& shuffles)
+      {
+        if (shuffles.empty())
+          return false;
+        stack (shuffles, shuffling_matrices);
+        stats_calculator->batch (shuffling_matrices, batch_stats);
+        for (const auto& statistics : batch_stats)
+          process (statistics);
+        return true;
+      }
+
+
+
+      void PreProcessor::process (const matrix_type& statistics)
+      {
+        (*enhancer) (statistics, enhanced_stats);
         for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
           for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
             if (enhanced_stats(ie, ih) > 0.0) {
@@ -70,7 +118,6 @@ namespace MR
             }
           }
         }
-        return true;
       }
 
 
@@ -116,22 +163,41 @@ namespace MR
       bool Processor::operator() (const Math::Stats::Shuffle& shuffle)
       {
         (*stats_calculator) (shuffle.data, statistics);
+        process (shuffle.index, statistics);
+        return true;
+      }
+
+
+
+      bool Processor::operator() (const vector<Math::Stats::Shuffle>& shuffles)
+      {
+        stack (shuffles, shuffling_matrices);
+        stats_calculator->batch (shuffling_matrices, batch_statistics);
+        for (size_t i = 0; i != shuffles.size(); ++i)
+          process (shuffles[i].index, batch_statistics[i]);
+        return true;
+      }
+
+
+
+      void Processor::process (const size_t index, const matrix_type& stats)
+      {
         if (enhancer)
-          (*enhancer) (statistics, enhanced_statistics);
+          (*enhancer) (stats, enhanced_statistics);
         else
-          enhanced_statistics = statistics;
+          enhanced_statistics = stats;
 
         if (empirical_enhanced_statistics.size())
           enhanced_statistics.array() /= empirical_enhanced_statistics.array();
 
         if (null_dist.cols() == 1) { // strong fwe control
           ssize_t max_element, max_hypothesis;
-          null_dist(shuffle.index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
+          null_dist(index, 0) = enhanced_statistics.maxCoeff (&max_element, &max_hypothesis);
           null_dist_contribution_counter(max_element, max_hypothesis)++;
         } else { // weak fwe control
           ssize_t max_index;
           for (ssize_t ih = 0; ih != enhanced_statistics.cols(); ++ih) {
-            null_dist(shuffle.index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
+            null_dist(index, ih) = enhanced_statistics.col (ih).maxCoeff (&max_index);
             null_dist_contribution_counter(max_index, ih)++;
           }
         }
@@ -142,8 +208,6 @@ namespace MR
               uncorrected_pvalue_counter(ie, ih)++;
           }
         }
-
-        return true;
       }
 
 
@@ -162,8 +226,9 @@ namespace MR
         count_matrix_type global_enhanced_count (count_matrix_type::Zero (stats_calculator->num_elements(), stats_calculator->num_hypotheses()));
         {
           Math::Stats::Shuffler shuffler (stats_calculator->num_inputs(), true, "Pre-computing empirical statistic for non-stationarity correction");
+          ShuffleBatcher batcher (shuffler);
           PreProcessor preprocessor (stats_calculator, enhancer, skew, empirical_statistic, global_enhanced_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (preprocessor));
+          Thread::run_queue (batcher, vector<Math::Stats::Shuffle>(), Thread::multi (preprocessor));
         }
         for (size_t contrast = 0; contrast != stats_calculator->num_hypotheses(); ++contrast) {
           for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
@@ -231,7 +296,8 @@ namespace MR
                                null_dist,
                                null_dist_contributions,
                                global_uncorrected_pvalue_count);
-          Thread::run_queue (shuffler, Math::Stats::Shuffle(), Thread::multi (processor));
+          ShuffleBatcher batcher (shuffler);
+          Thread::run_queue (batcher, vector<Math::Stats::Shuffle>(), Thread::multi (processor));
         }
         uncorrected_pvalues = global_uncorrected_pvalue_count.cast<default_type>() / default_type(shuffler.size());
       }
@@ -36,6 +36,9 @@
 #define DEFAULT_NUMBER_PERMUTATIONS 5000
 #define DEFAULT_NUMBER_PERMUTATIONS_NONSTATIONARITY 5000
 
+// Number of shuffles passed to the GLM at once in each worker thread
+#define DEFAULT_SHUFFLE_BATCH_SIZE 8
+
 
 namespace MR
 {
@@ -53,6 +56,24 @@ namespace MR
 
 
 
+      /*! A class to group the shuffles generated by a Math::Stats::Shuffler into batches,
+       * such that the GLM can be evaluated for multiple shuffles at once */
+      class ShuffleBatcher { NOMEMALIGN
+        public:
+          ShuffleBatcher (Math::Stats::Shuffler& shuffler, const size_t batch_size = DEFAULT_SHUFFLE_BATCH_SIZE) :
+              shuffler (shuffler),
+              batch_size (batch_size) { }
+
+          bool operator() (vector<Math::Stats::Shuffle>& output);
+
+        protected:
+          Math::Stats::Shuffler& shuffler;
+          const size_t batch_size;
+      };
+
+
+
+
       /*! A class to pre-compute the empirical enhanced statistic image for non-stationarity correction */
       class PreProcessor { MEMALIGN (PreProcessor)
         public:
@@ -65,6 +86,7 @@ namespace MR
           ~PreProcessor();
 
           bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const vector<Math::Stats::Shuffle>&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
@@ -76,7 +98,11 @@ namespace MR
           count_matrix_type enhanced_count;
           matrix_type stats;
           matrix_type enhanced_stats;
+          matrix_type shuffling_matrices;
+          vector<matrix_type> batch_stats;
           std::shared_ptr<std::mutex> mutex;
+
+          void process (const matrix_type& statistics);
       };
 
 
@@ -96,6 +122,7 @@ namespace MR
           ~Processor();
 
           bool operator() (const Math::Stats::Shuffle&);
+          bool operator() (const vector<Math::Stats::Shuffle>&);
 
         protected:
           std::shared_ptr<Math::Stats::GLM::TestBase> stats_calculator;
@@ -109,7 +136,11 @@ namespace MR
           count_matrix_type null_dist_contribution_counter;
           count_matrix_type& global_uncorrected_pvalue_counter;
           count_matrix_type uncorrected_pvalue_counter;
+          matrix_type shuffling_matrices;
+          vector<matrix_type> batch_statistics;
           std::shared_ptr<std::mutex> mutex;
+
+          void process (const size_t index, const matrix_type& stats);
       };
 
 
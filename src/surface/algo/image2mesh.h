@@ -18,9 +18,11 @@
 #define __surface_algo_image2mesh_h__
 
 #include <array>
+#include <atomic>
 #include <map>
 
 #include "image_helpers.h"
+#include "thread.h"
 #include "transform.h"
 #include "types.h"
 
@@ -144,9 +146,81 @@ namespace MR
 
 
 
+    // Minimal open-addressing hash table, used by image2mesh_mc() to map each
+    //   image grid edge (packed into a single integer) to the index of the mesh
+    //   vertex generated along it
+    class EdgeVertexTable
+    { NOMEMALIGN
+      public:
+        EdgeVertexTable() :
+            keys (16, empty_key),
+            values (16),
+            count (0) { }
+
+        // Returns the vertex index already associated with this edge if present;
+        //   otherwise stores & returns the provided index
+        std::pair<uint32_t, bool> insert (const uint64_t key, const uint32_t value)
+        {
+          if (2 * (count + 1) > keys.size())
+            grow();
+          size_t i = slot (key);
+          while (keys[i] != empty_key) {
+            if (keys[i] == key)
+              return std::make_pair (values[i], false);
+            i = (i + 1) & (keys.size() - 1);
+          }
+          keys[i] = key;
+          values[i] = value;
+          ++count;
+          return std::make_pair (value, true);
+        }
+
+        bool find (const uint64_t key, uint32_t& value) const
+        {
+          for (size_t i = slot (key); keys[i] != empty_key; i = (i + 1) & (keys.size() - 1)) {
+            if (keys[i] == key) {
+              value = values[i];
+              return true;
+            }
+          }
+          return false;
+        }
+
+      private:
+        static constexpr uint64_t empty_key = std::numeric_limits<uint64_t>::max();
+        vector<uint64_t> keys;
+        vector<uint32_t> values;
+        size_t count;
+
+        size_t slot (const uint64_t key) const
+        {
+          // Fibonacci hashing: adjacent edges are otherwise clustered
+          return size_t ((key * 0x9E3779B97F4A7C15ull) >> 32) & (keys.size() - 1);
+        }
+
+        void grow()
+        {
+          vector<uint64_t> old_keys (2 * keys.size(), empty_key);
+          vector<uint32_t> old_values (2 * values.size());
+          std::swap (keys, old_keys);
+          std::swap (values, old_values);
+          count = 0;
+          for (size_t i = 0; i != old_keys.size(); ++i) {
+            if (old_keys[i] != empty_key)
+              insert (old_keys[i], old_values[i]);
+          }
+        }
+    };
+
+
+
     // Image-to-mesh conversion function using the Marching Cubes algorithm
+    // The image is divided into slabs along the third axis, which are processed
+    //   concurrently; each slab generates its own vertices & triangles, and these
+    //   are then concatenated, with vertices on the boundary planes between slabs
+    //   de-duplicated, such that the output is identical to that of a single pass
     template <class ImageType>
-    void image2mesh_mc (const ImageType& input_image, Mesh& out, const default_type threshold)
+    void image2mesh_mc (const ImageType& input_image, Mesh& out, const default_type threshold, const size_t num_threads = Thread::threads_to_execute())
     {
       static const Vox neighbour_offsets[] = { Vox (0, 0, 0),
                                                Vox (1, 0, 0),
@@ -438,89 +512,156 @@ namespace MR
         {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1} };
 
-      VertexList vertices;
-      TriangleList triangles;
+      // Each grid edge is identified by the grid point at its lower end (with a
+      //   margin of one voxel on each side of the image) and its axis
+      const uint64_t grid_size[2] = { uint64_t(input_image.size(0)) + 2, uint64_t(input_image.size(1)) + 2 };
+      auto edge_key = [&] (const Vox& lower, const size_t axis) -> uint64_t {
+        return ((uint64_t(lower[2]+1) * grid_size[1] + uint64_t(lower[1]+1)) * grid_size[0] + uint64_t(lower[0]+1)) * 3 + axis;
+      };
+      auto key_plane = [&] (const uint64_t key) -> int { return int (key / (3 * grid_size[0] * grid_size[1])) - 1; };
+
+      class Slab
+      { NOMEMALIGN
+        public:
+          int begin, end;
+          VertexList vertices;
+          vector<uint64_t> keys;
+          TriangleList triangles;
+          EdgeVertexTable table;
+      };
+
+      // Cube lower corners span [-1, size(2)-1] along the third axis
+      const int num_layers = input_image.size(2) + 1;
+      const int num_slabs = std::max (1, std::min (num_layers, int (4 * std::max (num_threads, size_t(1)))));
+      vector<Slab> slabs (num_slabs);
+      for (int s = 0; s != num_slabs; ++s) {
+        slabs[s].begin = -1 + (s * num_layers) / num_slabs;
+        slabs[s].end   = -1 + ((s+1) * num_layers) / num_slabs;
+      }
+
+      const Transform transform (input_image);
+
+      struct Shared { NOMEMALIGN
+        const ImageType& input_image;
+        vector<Slab>& slabs;
+        std::atomic<size_t> next;
+      } shared = { input_image, slabs, { 0 } };
+
+      auto process_slab = [&] (ImageType& voxel, Slab& slab)
+      {
+        float in_vertex_values[8];
+        Vox lower_corner;
+        for (lower_corner[2] = slab.begin; lower_corner[2] != slab.end; ++lower_corner[2]) {
+          for (lower_corner[1] = -1; lower_corner[1] != voxel.size(1); ++lower_corner[1]) {
+            for (lower_corner[0] = -1; lower_corner[0] != voxel.size(0); ++lower_corner[0]) {
+
+              // This is our lower corner for our region of 8 voxels
+              uint8_t code = 0x00;
+              for (size_t neighbour_index = 0; neighbour_index != 8; ++neighbour_index) {
+                assign_pos_of (lower_corner + neighbour_offsets[neighbour_index]).to (voxel);
+                in_vertex_values[neighbour_index] = 0.0f;
+                if (!is_out_of_bounds (voxel))
+                  in_vertex_values[neighbour_index] = voxel.value();
+                if (in_vertex_values[neighbour_index] > threshold)
+                  code |= (1 << neighbour_index);
+              }
+              // Our code here acts as a lookup index to the table cube_edge_flags
+              const uint32_t edge_flags = cube_edge_flags[code];
+              if (!edge_flags)
+                continue;
+              // Now we find out which edges are intersected, based on this flag
+              // For all relevant output vertices, we need to store the output index
+              //   of that vertex
+              std::array<uint32_t, 12> edge_to_output_vertex;
+              edge_to_output_vertex.fill (0);
+              for (size_t edge_index = 0; edge_index != 12; ++edge_index) {
+                if (edge_flags & (1 << edge_index)) {
+
+                  // OK, so now we have two vertices corresponding to this edge
+                  // However, we don't want to duplicate vertices
+                  // Therefore, need to do a lookup, based on the lower of the two
+                  //   vertex positions and the axis along which the edge lies
+                  std::array<uint8_t, 2> vertex_indices;
+                  std::array<Vox,     2> vertex_positions;
+                  for (size_t i = 0; i != 2; ++i) {
+                    const uint8_t vertex_index = edge_vertices[edge_index][i];
+                    vertex_indices[i] = vertex_index;
+                    vertex_positions[i] = lower_corner + neighbour_offsets[vertex_index];
+                  }
+                  size_t axis = 0;
+                  while (vertex_positions[0][axis] == vertex_positions[1][axis])
+                    ++axis;
+                  const uint64_t key = edge_key (vertex_positions[vertex_positions[0][axis] < vertex_positions[1][axis] ? 0 : 1], axis);
+
+                  // Has a vertex already been generated somewhere along this edge?
+                  const auto existing = slab.table.insert (key, slab.vertices.size());
+                  edge_to_output_vertex[edge_index] = existing.first;
+                  if (existing.second) {
+                    // Calculate the precise position of this vertex, based on the
+                    //   image intensities in the two relevant voxels
+                    const default_type alpha = (threshold - in_vertex_values[vertex_indices[0]]) / (in_vertex_values[vertex_indices[1]] - in_vertex_values[vertex_indices[0]]);
+                    const Vertex pos_voxelspace = vertex_positions[0].cast<default_type>() + (alpha * (vertex_positions[1] - vertex_positions[0]).cast<default_type>());
+                    slab.vertices.push_back (transform.voxel2scanner * pos_voxelspace);
+                    slab.keys.push_back (key);
+                  }
 
-      Transform transform (input_image);
-
-      ImageType voxel (input_image);
-      float in_vertex_values[8];
-      std::map< Vox, std::map<Vox, size_t> > input_vertex_pair_to_output_vertex_index_map;
-      Vox lower_corner;
-      for (lower_corner[2] = -1; lower_corner[2] != voxel.size(2); ++lower_corner[2]) {
-        for (lower_corner[1] = -1; lower_corner[1] != voxel.size(1); ++lower_corner[1]) {
-          for (lower_corner[0] = -1; lower_corner[0] != voxel.size(0); ++lower_corner[0]) {
-
-            // This is our lower corner for our region of 8 voxels
-            uint8_t code = 0x00;
-            for (size_t neighbour_index = 0; neighbour_index != 8; ++neighbour_index) {
-              assign_pos_of (lower_corner + neighbour_offsets[neighbour_index]).to (voxel);
-              in_vertex_values[neighbour_index] = 0.0f;
-              if (!is_out_of_bounds (voxel))
-                in_vertex_values[neighbour_index] = voxel.value();
-              if (in_vertex_values[neighbour_index] > threshold)
-                code |= (1 << neighbour_index);
-            }
-            // Our code here acts as a lookup index to the table cube_edge_flags
-            const uint32_t edge_flags = cube_edge_flags[code];
-            // Now we find out which edges are intersected, based on this flag
-            // For all relevant output vertices, we need to store the output index
-            //   of that vertex
-            std::array<uint32_t, 12> edge_to_output_vertex;
-            edge_to_output_vertex.fill (0);
-            for (size_t edge_index = 0; edge_index != 12; ++edge_index) {
-              if (edge_flags & (1 << edge_index)) {
-
-                // OK, so now we have two vertices corresponding to this edge
-                // However, we don't want to duplicate vertices
-                // Therefore, need to do a lookup
-                // Remember: we have the lower corner position, and 8 offsets from that
-                std::array<uint8_t, 2> vertex_indices;
-                std::array<Vox,     2> vertex_positions;
-
-                for (size_t i = 0; i != 2; ++i) {
-                  const uint8_t vertex_index = edge_vertices[edge_index][i];
-                  vertex_indices[i] = vertex_index;
-                  vertex_positions[i] = lower_corner + neighbour_offsets[vertex_index];
-                }
-                // Has a vertex already been generated somewhere along this edge?
-                auto lookup_zero_it = input_vertex_pair_to_output_vertex_index_map.find (vertex_positions[0]);
-                if (lookup_zero_it == input_vertex_pair_to_output_vertex_index_map.end())
-                  lookup_zero_it = input_vertex_pair_to_output_vertex_index_map.insert (std::make_pair (vertex_positions[0], std::map<Vox, size_t>())).first;
-                auto lookup_one_it = input_vertex_pair_to_output_vertex_index_map.find (vertex_positions[1]);
-                if (lookup_one_it == input_vertex_pair_to_output_vertex_index_map.end())
-                  lookup_one_it = input_vertex_pair_to_output_vertex_index_map.insert (std::make_pair (vertex_positions[1], std::map<Vox, size_t>())).first;
-                auto& lookup_zero = lookup_zero_it->second;
-                auto& lookup_one  = lookup_one_it ->second;
-                auto existing_zero = lookup_zero.find (vertex_positions[1]);
-                if (existing_zero == lookup_zero.end()) {
-                  lookup_zero.insert (std::make_pair (vertex_positions[1], vertices.size()));
-                  lookup_one .insert (std::make_pair (vertex_positions[0], vertices.size()));
-                  edge_to_output_vertex[edge_index] = vertices.size();
-                  // Calculate the precise position of this vertex, based on the
-                  //   image intensities in the two relevant voxels
-                  const default_type alpha = (threshold - in_vertex_values[vertex_indices[0]]) / (in_vertex_values[vertex_indices[1]] - in_vertex_values[vertex_indices[0]]);
-                  const Vertex pos_voxelspace = vertex_positions[0].cast<default_type>() + (alpha * (vertex_positions[1] - vertex_positions[0]).cast<default_type>());
-                  vertices.push_back (transform.voxel2scanner * pos_voxelspace);
-                } else {
-                  edge_to_output_vertex[edge_index] = existing_zero->second;
                 }
-
               }
-            }
 
-            // OK, so now the relevant edges have an output vertex index associated with them
-            // Based on the code for this voxel, now we use the table cube_triangle_table to see
-            //   which edges need to have triangles constructed from the relevant generated vertices
-            // Note that flipping the last two vertex indices is deliberate; the provided
-            //   lookup table does not use a right-hand rule axis convention, so this is necessary
-            //   to calculate the correct surface normals
-            for (const int8_t* first_edge = cube_triangle_table[code]; *first_edge >= 0; first_edge += 3) {
-              const uint32_t indices[3] { edge_to_output_vertex[*first_edge], edge_to_output_vertex[*(first_edge+2)], edge_to_output_vertex[*(first_edge+1)] };
-              triangles.push_back (Triangle (indices));
-            }
+              // OK, so now the relevant edges have an output vertex index associated with them
+              // Based on the code for this voxel, now we use the table cube_triangle_table to see
+              //   which edges need to have triangles constructed from the relevant generated vertices
+              // Note that flipping the last two vertex indices is deliberate; the provided
+              //   lookup table does not use a right-hand rule axis convention, so this is necessary
+              //   to calculate the correct surface normals
+              for (const int8_t* first_edge = cube_triangle_table[code]; *first_edge >= 0; first_edge += 3) {
+                const uint32_t indices[3] { edge_to_output_vertex[*first_edge], edge_to_output_vertex[*(first_edge+2)], edge_to_output_vertex[*(first_edge+1)] };
+                slab.triangles.push_back (Triangle (indices));
+              }
 
-      } } } // Finished looping over all voxels in the input image
+        } } } // Finished looping over all voxels in this slab
+      };
+
+      struct Worker { NOMEMALIGN
+        Shared& shared;
+        decltype(process_slab)& func;
+        void execute () {
+          ImageType voxel (shared.input_image);
+          size_t n;
+          while ((n = shared.next++) < shared.slabs.size())
+            func (voxel, shared.slabs[n]);
+        }
+      } worker = { shared, process_slab };
+
+      if (std::min (num_threads, slabs.size()) < 2)
+        worker.execute();
+      else
+        Thread::run (Thread::multi (worker, std::min (num_threads, slabs.size())), "marching cubes threads").wait();
+
+      // Concatenate the slabs; vertices generated along edges lying within the
+      //   lower boundary plane of a slab were also generated by the preceding slab
+      VertexList vertices;
+      TriangleList triangles;
+      vector<uint32_t> previous_remap, remap;
+      for (int s = 0; s != num_slabs; ++s) {
+        const Slab& slab (slabs[s]);
+        remap.resize (slab.vertices.size());
+        for (size_t i = 0; i != slab.vertices.size(); ++i) {
+          uint32_t previous_index;
+          if (s && slab.keys[i] % 3 != 2 && key_plane (slab.keys[i]) == slab.begin
+              && slabs[s-1].table.find (slab.keys[i], previous_index)) {
+            remap[i] = previous_remap[previous_index];
+          } else {
+            remap[i] = vertices.size();
+            vertices.push_back (slab.vertices[i]);
+          }
+        }
+        for (const auto& t : slab.triangles)
+          triangles.push_back (Triangle (std::array<uint32_t, 3> { remap[t[0]], remap[t[1]], remap[t[2]] }));
+        std::swap (remap, previous_remap);
+        if (s)
+          slabs[s-1] = Slab();
+      }
 
       // Write the result to the output class
       out.load (vertices, triangles);
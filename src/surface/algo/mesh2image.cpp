@@ -16,13 +16,12 @@
 
 #include "surface/algo/mesh2image.h"
 
-#include <map>
-
 #include "header.h"
 #include "progressbar.h"
 #include "thread_queue.h"
 #include "types.h"
 
+#include "surface/polygon_grid.h"
 #include "surface/types.h"
 #include "surface/utils.h"
 #include "surface/filter/vertex_transform.h"
@@ -53,8 +52,9 @@ namespace MR
         vector<Eigen::Vector3d> polygon_normals;
 
         // For every edge voxel, stores those polygons that may intersect the voxel
-        using Vox2Poly = std::map< Vox, vector<size_t> >;
-        Vox2Poly voxel2poly;
+        std::unique_ptr<PolygonGrid> voxel2poly;
+        // Those voxels intersected by the mesh that lie within the image
+        vector<size_t> edge_voxels;
 
         {
           ProgressBar progress ("Performing voxel-based segmentation of surface", 8);
@@ -93,126 +93,13 @@ namespace MR
             init_seg.value() = vox_mesh_t::UNDEFINED;
 
           // Map each polygon to the underlying voxels
-          for (size_t poly_index = 0; poly_index != mesh.num_polygons(); ++poly_index) {
-
-            const size_t num_vertices = (poly_index < mesh.num_triangles()) ? 3 : 4;
-
-            // Figure out the voxel extent of this polygon in three dimensions
-            Vox lower_bound (H.size(0)-1, H.size(1)-1, H.size(2)-1), upper_bound (0, 0, 0);
-            VertexList this_poly_verts;
-            if (num_vertices == 3)
-              mesh.load_triangle_vertices (this_poly_verts, poly_index);
-            else
-              mesh.load_quad_vertices (this_poly_verts, poly_index - mesh.num_triangles());
-            for (VertexList::const_iterator v = this_poly_verts.begin(); v != this_poly_verts.end(); ++v) {
-              for (size_t axis = 0; axis != 3; ++axis) {
-                const int this_axis_voxel = std::round((*v)[axis]);
-                lower_bound[axis] = std::min (lower_bound[axis], this_axis_voxel);
-                upper_bound[axis] = std::max (upper_bound[axis], this_axis_voxel);
-              }
-            }
-
-            // Constrain to lie within the dimensions of the image
-            for (size_t axis = 0; axis != 3; ++axis) {
-              lower_bound[axis] = std::max(0,                   lower_bound[axis]);
-              upper_bound[axis] = std::min(int(H.size(axis)-1), upper_bound[axis]);
+          voxel2poly.reset (new PolygonGrid (mesh));
+          for (size_t i = 0; i != voxel2poly->num_cells(); ++i) {
+            assign_pos_of (voxel2poly->cell (i)).to (init_seg);
+            if (!is_out_of_bounds (init_seg)) {
+              init_seg.value() = vox_mesh_t::ON_MESH;
+              edge_voxels.push_back (i);
             }
-
-            // For all voxels within this rectangular region, assign this polygon to the map
-            // Use the Separating Axis Theorem to be more stringent as to which voxels this
-            //   polygon will be processed in
-            auto overlap = [&] (const Vox& vox, const size_t poly_index) -> bool {
-
-              VertexList vertices;
-              if (num_vertices == 3)
-                mesh.load_triangle_vertices (vertices, poly_index);
-              else
-                mesh.load_quad_vertices (vertices, poly_index - mesh.num_triangles());
-
-              // Test whether or not the two objects can be separated via projection onto an axis
-              auto separating_axis = [&] (const Eigen::Vector3d& axis) -> bool {
-                default_type voxel_low  =  std::numeric_limits<default_type>::infinity();
-                default_type voxel_high = -std::numeric_limits<default_type>::infinity();
-                default_type poly_low   =  std::numeric_limits<default_type>::infinity();
-                default_type poly_high  = -std::numeric_limits<default_type>::infinity();
-
-                static const Eigen::Vector3d voxel_offsets[8] = { { -0.5, -0.5, -0.5 },
-                                                                 { -0.5, -0.5,  0.5 },
-                                                                 { -0.5,  0.5, -0.5 },
-                                                                 { -0.5,  0.5,  0.5 },
-                                                                 {  0.5, -0.5, -0.5 },
-                                                                 {  0.5, -0.5,  0.5 },
-                                                                 {  0.5,  0.5, -0.5 },
-                                                                 {  0.5,  0.5,  0.5 } };
-
-                for (size_t i = 0; i != 8; ++i) {
-                  const Eigen::Vector3d v (vox.matrix().cast<default_type>() + voxel_offsets[i]);
-                  const default_type projection = axis.dot (v);
-                  voxel_low  = std::min (voxel_low,  projection);
-                  voxel_high = std::max (voxel_high, projection);
-                }
-
-                for (const auto& v : vertices) {
-                  const default_type projection = axis.dot (v);
-                  poly_low  = std::min (poly_low,  projection);
-                  poly_high = std::max (poly_high, projection);
-                }
-
-                // Is this a separating axis?
-                return (poly_low > voxel_high || voxel_low > poly_high);
-              };
-
-              // The following axes need to be tested as potential separating axes:
-              //   x, y, z
-              //   All cross-products between voxel and polygon edges
-              //   Polygon normal
-              for (size_t i = 0; i != 3; ++i) {
-                Eigen::Vector3d axis (0.0, 0.0, 0.0);
-                axis[i] = 1.0;
-                if (separating_axis (axis))
-                  return false;
-                for (size_t j = 0; j != num_vertices-1; ++j) {
-                  if (separating_axis (axis.cross (vertices[j+1] - vertices[j])))
-                    return false;
-                }
-                if (separating_axis (axis.cross (vertices[num_vertices-1] - vertices[0])))
-                  return false;
-              }
-              if (separating_axis (polygon_normals[poly_index]))
-                return false;
-
-              // No axis has been found that separates the two objects
-              // Therefore, the two objects overlap
-              return true;
-            };
-
-            Vox voxel;
-            for (voxel[2] = lower_bound[2]; voxel[2] <= upper_bound[2]; ++voxel[2]) {
-              for (voxel[1] = lower_bound[1]; voxel[1] <= upper_bound[1]; ++voxel[1]) {
-                for (voxel[0] = lower_bound[0]; voxel[0] <= upper_bound[0]; ++voxel[0]) {
-                  // Rather than adding this polygon to the list of polygons to test for
-                  //   every single voxel within this 3D bounding box, only test it within
-                  //   those voxels that the polygon actually intersects
-                  if (overlap (voxel, poly_index)) {
-                    vector<size_t> this_voxel_polys;
-                    // Has this voxel already been intersected by at least one polygon?
-                    // If it has, we need to concatenate this polygon to the list
-                    //   (which involves deleting the existing entry then re-writing the concatenated list);
-                    // If it has not, we're adding a new entry to the list of voxels to be tested,
-                    //   with only one entry in the list for that voxel
-                    Vox2Poly::const_iterator existing = voxel2poly.find (voxel);
-                    if (existing != voxel2poly.end()) {
-                      this_voxel_polys = existing->second;
-                      voxel2poly.erase (existing);
-                    } else {
-                      // Only call this once each voxel, regardless of the number of intersecting polygons
-                      assign_pos_of (voxel).to (init_seg);
-                      init_seg.value() = vox_mesh_t::ON_MESH;
-                    }
-                    this_voxel_polys.push_back (poly_index);
-                    voxel2poly.insert (std::make_pair (voxel, this_voxel_polys));
-                  } } } }
-
           }
           ++progress;
 
@@ -357,31 +244,32 @@ namespace MR
         // Construct class functors necessary to calculate, for each voxel intersected by the
         //   surface, the partial volume fraction
         class Source
-        { MEMALIGN(Source)
+        { NOMEMALIGN
           public:
-            Source (const Vox2Poly& data) :
+            Source (const vector<size_t>& data) :
                 data (data),
                 i (data.begin()) { }
 
-            bool operator() (std::pair<Vox, vector<size_t>>& out)
+            bool operator() (size_t& out)
             {
               if (i == data.end())
                 return false;
-              out = std::make_pair (i->first, i->second);
+              out = *i;
               ++i;
               return true;
             }
 
           private:
-            const Vox2Poly& data;
-            Vox2Poly::const_iterator i;
+            const vector<size_t>& data;
+            vector<size_t>::const_iterator i;
         };
 
         class Pipe
         { NOMEMALIGN
           public:
-            Pipe (const Mesh& mesh, const vector<Eigen::Vector3d>& polygon_normals) :
+            Pipe (const Mesh& mesh, const PolygonGrid& grid, const vector<Eigen::Vector3d>& polygon_normals) :
                 mesh (mesh),
+                grid (grid),
                 polygon_normals (polygon_normals)
 
             {
@@ -400,9 +288,30 @@ namespace MR
               }
             }
 
-            bool operator() (const std::pair<Vox, vector<size_t>>& in, std::pair<Vox, float>& out) const
+            bool operator() (const size_t& in, std::pair<Vox, float>& out) const
             {
-              const Vox& voxel (in.first);
+              const Vox& voxel (grid.cell (in));
+
+              // Only test against those polygons that are near this voxel
+              // Those properties of each polygon that do not depend on the point
+              //   being tested are computed once for all points in the voxel
+              const size_t num_polygons = grid.size (in);
+              const uint32_t* const polygon_indices = grid.polygons (in);
+              vector<Geometry> polygons (num_polygons);
+              for (size_t i = 0; i != num_polygons; ++i) {
+                Geometry& g (polygons[i]);
+                g.n = polygon_normals[polygon_indices[i]];
+                if (polygon_indices[i] < mesh.num_triangles()) {
+                  mesh.load_triangle_vertices (g.v, polygon_indices[i]);
+                  g.centre = (g.v[0] + g.v[1] + g.v[2]) * (1.0/3.0);
+                  g.edge_normals[0] = (g.v[1]-g.v[2]).cross (g.n); g.edge_normals[0].normalize();
+                  g.edge_normals[1] = (g.v[2]-g.v[0]).cross (g.n); g.edge_normals[1].normalize();
+                  g.edge_normals[2] = (g.v[0]-g.v[1]).cross (g.n); g.edge_normals[2].normalize();
+                } else {
+                  mesh.load_quad_vertices (g.v, polygon_indices[i] - mesh.num_triangles());
+                  g.centre = (g.v[0] + g.v[1] + g.v[2] + g.v[3]) * 0.25;
+                }
+              }
 
               // Count the number of these points that lie inside the mesh
               size_t inside_mesh_count = 0;
@@ -414,12 +323,9 @@ namespace MR
                 bool best_result_inside = false;
                 default_type best_min_distance_from_interior_projection = std::numeric_limits<default_type>::infinity();
 
-                // Only test against those polygons that are near this voxel
-                for (vector<size_t>::const_iterator polygon_index = in.second.begin(); polygon_index != in.second.end(); ++polygon_index) {
-                  const Eigen::Vector3d& n (polygon_normals[*polygon_index]);
-
-                  const size_t polygon_num_vertices = (*polygon_index < mesh.num_triangles()) ? 3 : 4;
-                  VertexList v;
+                for (const auto& g : polygons) {
+                  const Eigen::Vector3d& n (g.n);
+                  const VertexList& v (g.v);
 
                   bool is_inside = false;
                   default_type min_edge_distance_on_plane = std::numeric_limits<default_type>::infinity();
@@ -432,44 +338,26 @@ namespace MR
                   // If point does lie within projection of polygon (potentially more than one), then the
                   //   polygon to which the distance from the plane is minimal classifies the point
 
-                  if (polygon_num_vertices == 3) {
-
-                    mesh.load_triangle_vertices (v, *polygon_index);
+                  // First: is it aligned with the normal?
+                  const Vertex diff (p - g.centre);
+                  distance_from_plane = diff.dot (n);
+                  is_inside = (distance_from_plane <= 0.0);
 
-                    // First: is it aligned with the normal?
-                    const Vertex poly_centre ((v[0] + v[1] + v[2]) * (1.0/3.0));
-                    const Vertex diff (p - poly_centre);
-                    distance_from_plane = diff.dot (n);
-                    is_inside = (distance_from_plane <= 0.0);
+                  // Second: how well does it project onto this polygon?
+                  const Vertex p_on_plane (p - (n * (diff.dot (n))));
 
-                    // Second: how well does it project onto this polygon?
-                    const Vertex p_on_plane (p - (n * (diff.dot (n))));
+                  if (v.size() == 3) {
 
                     std::array<default_type, 3> edge_distances;
-                    Vertex zero = (v[1]-v[2]).cross (n); zero.normalize();
-                    Vertex one  = (v[2]-v[0]).cross (n); one .normalize();
-                    Vertex two  = (v[0]-v[1]).cross (n); two .normalize();
-                    edge_distances[0] = (p_on_plane-v[2]).dot (zero);
-                    edge_distances[1] = (p_on_plane-v[0]).dot (one);
-                    edge_distances[2] = (p_on_plane-v[1]).dot (two);
+                    edge_distances[0] = (p_on_plane-v[2]).dot (g.edge_normals[0]);
+                    edge_distances[1] = (p_on_plane-v[0]).dot (g.edge_normals[1]);
+                    edge_distances[2] = (p_on_plane-v[1]).dot (g.edge_normals[2]);
                     min_edge_distance_on_plane = std::min ( { edge_distances[0], edge_distances[1], edge_distances[2] } );
 
                   } else {
 
-                    mesh.load_quad_vertices (v, *polygon_index);
-
                     // This may be slightly ill-posed with a quad; no guarantee of fixed normal
                     // Proceed regardless
-
-                    // First: is it aligned with the normal?
-                    const Vertex poly_centre ((v[0] + v[1] + v[2] + v[3]) * 0.25);
-                    const Vertex diff (p - poly_centre);
-                    distance_from_plane = diff.dot (n);
-                    is_inside = (distance_from_plane <= 0.0);
-
-                    // Second: how well does it project onto this polygon?
-                    const Vertex p_on_plane (p - (n * (diff.dot (n))));
-
                     for (int edge = 0; edge != 4; ++edge) {
                       // Want an appropriate vector emanating from this edge from which to test the 'on-plane' distance
                       //   (bearing in mind that there may not be a uniform normal)
@@ -520,10 +408,20 @@ namespace MR
 
           private:
             const Mesh& mesh;
+            const PolygonGrid& grid;
             const vector<Eigen::Vector3d>& polygon_normals;
 
             std::shared_ptr<vector<Eigen::Vector3d>> offsets_to_test;
 
+            class Geometry
+            { MEMALIGN(Geometry)
+              public:
+                Eigen::Vector3d n, centre;
+                VertexList v;
+                // Only used for triangles
+                std::array<Eigen::Vector3d, 3> edge_normals;
+            };
+
         };
 
         class Sink
@@ -548,12 +446,12 @@ namespace MR
 
         };
 
-        Source source (voxel2poly);
-        Pipe pipe (mesh, polygon_normals);
-        Sink sink (image, voxel2poly.size());
+        Source source (edge_voxels);
+        Pipe pipe (mesh, *voxel2poly, polygon_normals);
+        Sink sink (image, edge_voxels.size());
 
         Thread::run_queue (source,
-                           std::pair<Vox, vector<size_t>>(),
+                           size_t(),
                            Thread::multi (pipe),
                            std::pair<Vox, float>(),
                            sink);
@@ -0,0 +1,341 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "surface/gifti.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "app.h"
+#include "raw.h"
+#include "file/mmap.h"
+#include "file/ofstream.h"
+#include "file/path.h"
+
+namespace MR
+{
+  namespace Surface
+  {
+    namespace GIfTI
+    {
+
+
+
+      namespace
+      {
+
+        const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        // Locate a string within a memory region; returns end if not found
+        const char* find (const char* begin, const char* end, const char* token)
+        {
+          return std::search (begin, end, token, token + strlen (token));
+        }
+
+        // Get the value of an attribute from within the text of an XML start-tag
+        std::string attribute (const char* begin, const char* end, const std::string& name)
+        {
+          const std::string key (name + "=\"");
+          for (const char* p = find (begin, end, key.c_str()); p != end; p = find (p + 1, end, key.c_str())) {
+            if (p == begin || !isspace (*(p-1)))
+              continue;
+            const char* value = p + key.size();
+            const char* value_end = std::find (value, end, '"');
+            if (value_end == end)
+              break;
+            return std::string (value, value_end);
+          }
+          return std::string();
+        }
+
+
+
+        // Decode the contents of a <DataArray> element into a row-major matrix
+        //   of values, returned alongside its dimensions
+        vector<default_type> decode (const char* tag_begin, const char* tag_end, const char* data_begin, const char* data_end, size_t& rows, size_t& columns)
+        {
+          const std::string dimensionality = attribute (tag_begin, tag_end, "Dimensionality");
+          const std::string data_type = attribute (tag_begin, tag_end, "DataType");
+          const std::string encoding = attribute (tag_begin, tag_end, "Encoding");
+          const std::string endian = attribute (tag_begin, tag_end, "Endian");
+          const std::string order = attribute (tag_begin, tag_end, "ArrayIndexingOrder");
+
+          const size_t ndim = dimensionality.size() ? to<size_t> (dimensionality) : 1;
+          if (ndim < 1 || ndim > 2)
+            throw Exception ("unsupported dimensionality (" + str(ndim) + ") of data array");
+          rows = to<size_t> (attribute (tag_begin, tag_end, "Dim0"));
+          columns = ndim == 2 ? to<size_t> (attribute (tag_begin, tag_end, "Dim1")) : 1;
+          const size_t count = rows * columns;
+
+          vector<default_type> values;
+          values.reserve (count);
+
+          if (encoding == "ASCII") {
+            const std::string text (data_begin, data_end);
+            const char* p = text.c_str();
+            char* next;
+            for (size_t i = 0; i != count; ++i) {
+              values.push_back (std::strtod (p, &next));
+              if (next == p)
+                throw Exception ("insufficient ASCII data in data array (" + str(i) + " of " + str(count) + " values)");
+              p = next;
+            }
+          } else if (encoding == "Base64Binary" || encoding == "GZipBase64Binary") {
+            size_t bytes_per_value = 0;
+            if (data_type == "NIFTI_TYPE_UINT8")
+              bytes_per_value = 1;
+            else if (data_type == "NIFTI_TYPE_INT32" || data_type == "NIFTI_TYPE_FLOAT32")
+              bytes_per_value = 4;
+            else if (data_type == "NIFTI_TYPE_FLOAT64")
+              bytes_per_value = 8;
+            else
+              throw Exception ("unsupported data type \"" + data_type + "\"");
+
+            vector<uint8_t> bytes = base64_decode (data_begin, data_end - data_begin);
+            if (encoding == "GZipBase64Binary") {
+              vector<uint8_t> uncompressed (count * bytes_per_value);
+              uLongf size = uncompressed.size();
+              if (uncompress (uncompressed.data(), &size, bytes.data(), bytes.size()) != Z_OK || size != uncompressed.size())
+                throw Exception ("error uncompressing data array");
+              std::swap (bytes, uncompressed);
+            }
+            if (bytes.size() < count * bytes_per_value)
+              throw Exception ("insufficient binary data in data array (" + str(bytes.size()) + " bytes for " + str(count) + " values)");
+
+            const bool is_BE = (endian == "BigEndian");
+            const uint8_t* data = bytes.data();
+            if (data_type == "NIFTI_TYPE_UINT8") {
+              for (size_t i = 0; i != count; ++i)
+                values.push_back (data[i]);
+            } else if (data_type == "NIFTI_TYPE_INT32") {
+              for (size_t i = 0; i != count; ++i)
+                values.push_back (is_BE ? Raw::fetch_BE<int32_t> (data, i) : Raw::fetch_LE<int32_t> (data, i));
+            } else if (data_type == "NIFTI_TYPE_FLOAT32") {
+              for (size_t i = 0; i != count; ++i)
+                values.push_back (is_BE ? Raw::fetch_BE<float> (data, i) : Raw::fetch_LE<float> (data, i));
+            } else {
+              for (size_t i = 0; i != count; ++i)
+                values.push_back (is_BE ? Raw::fetch_BE<double> (data, i) : Raw::fetch_LE<double> (data, i));
+            }
+          } else {
+            throw Exception ("unsupported encoding \"" + encoding + "\"");
+          }
+
+          if (order == "ColumnMajorOrder" && columns > 1) {
+            vector<default_type> transposed (count);
+            for (size_t r = 0; r != rows; ++r)
+              for (size_t c = 0; c != columns; ++c)
+                transposed[r*columns + c] = values[c*rows + r];
+            std::swap (values, transposed);
+          }
+          return values;
+        }
+
+
+
+        void write_array (File::OFStream& out, const std::string& intent, const std::string& data_type,
+                          const size_t rows, const size_t columns, const uint8_t* data, const size_t size, const bool compress)
+        {
+          out << "  <DataArray Intent=\"" << intent << "\"\n"
+              << "             DataType=\"" << data_type << "\"\n"
+              << "             ArrayIndexingOrder=\"RowMajorOrder\"\n"
+              << "             Dimensionality=\"2\"\n"
+              << "             Dim0=\"" << rows << "\"\n"
+              << "             Dim1=\"" << columns << "\"\n"
+              << "             Encoding=\"" << (compress ? "GZipBase64Binary" : "Base64Binary") << "\"\n"
+              << "             Endian=\"LittleEndian\"\n"
+              << "             ExternalFileName=\"\"\n"
+              << "             ExternalFileOffset=\"\">\n"
+              << "    <MetaData/>\n";
+          if (intent == "NIFTI_INTENT_POINTSET") {
+            out << "    <CoordinateSystemTransformMatrix>\n"
+                << "      <DataSpace><![CDATA[NIFTI_XFORM_UNKNOWN]]></DataSpace>\n"
+                << "      <TransformedSpace><![CDATA[NIFTI_XFORM_UNKNOWN]]></TransformedSpace>\n"
+                << "      <MatrixData>1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1</MatrixData>\n"
+                << "    </CoordinateSystemTransformMatrix>\n";
+          }
+          out << "    <Data>";
+          if (compress) {
+            vector<uint8_t> compressed (compressBound (size));
+            uLongf compressed_size = compressed.size();
+            if (compress2 (compressed.data(), &compressed_size, data, size, Z_DEFAULT_COMPRESSION) != Z_OK)
+              throw Exception ("error compressing GIfTI data array");
+            out << base64_encode (compressed.data(), compressed_size);
+          } else {
+            out << base64_encode (data, size);
+          }
+          out << "</Data>\n"
+              << "  </DataArray>\n";
+        }
+
+      }
+
+
+
+      std::string base64_encode (const uint8_t* data, const size_t size)
+      {
+        std::string result;
+        result.reserve (4 * ((size + 2) / 3));
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3) {
+          const uint32_t triple = (uint32_t(data[i]) << 16) | (uint32_t(data[i+1]) << 8) | uint32_t(data[i+2]);
+          result.push_back (base64_alphabet[(triple >> 18) & 0x3F]);
+          result.push_back (base64_alphabet[(triple >> 12) & 0x3F]);
+          result.push_back (base64_alphabet[(triple >>  6) & 0x3F]);
+          result.push_back (base64_alphabet[ triple        & 0x3F]);
+        }
+        if (i < size) {
+          const uint32_t triple = (uint32_t(data[i]) << 16) | (i + 1 < size ? uint32_t(data[i+1]) << 8 : 0);
+          result.push_back (base64_alphabet[(triple >> 18) & 0x3F]);
+          result.push_back (base64_alphabet[(triple >> 12) & 0x3F]);
+          result.push_back (i + 1 < size ? base64_alphabet[(triple >> 6) & 0x3F] : '=');
+          result.push_back ('=');
+        }
+        return result;
+      }
+
+
+
+      vector<uint8_t> base64_decode (const char* data, const size_t size)
+      {
+        // Lookup table from character to 6-bit value; characters outside of the
+        //   alphabet (i.e. whitespace & padding) are skipped
+        static const std::array<int8_t, 256> table = [] {
+          std::array<int8_t, 256> t;
+          t.fill (-1);
+          for (int8_t i = 0; i != 64; ++i)
+            t[uint8_t(base64_alphabet[i])] = i;
+          return t;
+        } ();
+
+        vector<uint8_t> result;
+        result.reserve (3 * (size / 4));
+        uint32_t buffer = 0;
+        int bits = 0;
+        for (size_t i = 0; i != size; ++i) {
+          const int8_t value = table[uint8_t(data[i])];
+          if (value < 0)
+            continue;
+          buffer = (buffer << 6) | uint32_t(value);
+          bits += 6;
+          if (bits >= 8) {
+            bits -= 8;
+            result.push_back (uint8_t (buffer >> bits));
+          }
+        }
+        return result;
+      }
+
+
+
+      void read_surface (const std::string& path, VertexList& vertices, TriangleList& triangles)
+      {
+        File::MMap mmap (File::Entry (path, 0));
+        const char* const begin = reinterpret_cast<const char*> (mmap.address());
+        const char* const end = begin + mmap.size();
+        if (find (begin, std::min (end, begin + 1024), "<GIFTI") == std::min (end, begin + 1024))
+          throw Exception ("File \"" + Path::basename (path) + "\" is not a GIfTI file");
+
+        bool have_vertices = false, have_triangles = false;
+        for (const char* tag_begin = find (begin, end, "<DataArray"); tag_begin != end; tag_begin = find (tag_begin + 1, end, "<DataArray")) {
+          const char* const tag_end = std::find (tag_begin, end, '>');
+          const char* const array_end = find (tag_end, end, "</DataArray>");
+          // An unterminated element would otherwise be read up to the end of the next one
+          if (tag_end == end || array_end == end || find (tag_end, array_end, "<DataArray") != array_end)
+            throw Exception ("Malformed data array in GIfTI file \"" + Path::basename (path) + "\"");
+
+          const std::string intent = attribute (tag_begin, tag_end, "Intent");
+          if (intent != "NIFTI_INTENT_POINTSET" && intent != "NIFTI_INTENT_TRIANGLE")
+            continue;
+          if (attribute (tag_begin, tag_end, "ExternalFileName").size())
+            throw Exception ("GIfTI file \"" + Path::basename (path) + "\" stores data in an external file; this is not supported");
+
+          const char* data_begin = find (tag_end, array_end, "<Data>");
+          if (data_begin == array_end)
+            throw Exception ("No data found for " + intent + " data array in GIfTI file \"" + Path::basename (path) + "\"");
+          data_begin += 6;
+          const char* const data_end = find (data_begin, array_end, "</Data>");
+          if (data_end == array_end)
+            throw Exception ("Malformed data element in " + intent + " data array of GIfTI file \"" + Path::basename (path) + "\"");
+
+          size_t rows, columns;
+          vector<default_type> values;
+          try {
+            values = decode (tag_begin, tag_end, data_begin, data_end, rows, columns);
+          } catch (Exception& e) {
+            throw Exception (e, "Error reading " + intent + " data array from GIfTI file \"" + Path::basename (path) + "\"");
+          }
+          if (columns != 3)
+            throw Exception ("GIfTI file \"" + Path::basename (path) + "\" " + intent + " data array has " + str(columns) + " columns; expected 3");
+
+          if (intent == "NIFTI_INTENT_POINTSET") {
+            if (have_vertices)
+              throw Exception ("GIfTI file \"" + Path::basename (path) + "\" contains more than one pointset");
+            vertices.reserve (rows);
+            for (size_t i = 0; i != rows; ++i)
+              vertices.push_back (Vertex (values[3*i], values[3*i+1], values[3*i+2]));
+            have_vertices = true;
+          } else {
+            if (have_triangles)
+              throw Exception ("GIfTI file \"" + Path::basename (path) + "\" contains more than one triangle array");
+            triangles.reserve (rows);
+            for (size_t i = 0; i != rows; ++i)
+              triangles.push_back (Triangle (std::array<uint32_t, 3> { uint32_t(values[3*i]), uint32_t(values[3*i+1]), uint32_t(values[3*i+2]) }));
+            have_triangles = true;
+          }
+        }
+
+        if (!have_vertices || !have_triangles)
+          throw Exception ("GIfTI file \"" + Path::basename (path) + "\" does not contain both a pointset and a triangle array");
+      }
+
+
+
+      void write_surface (const std::string& path, const VertexList& vertices, const TriangleList& triangles, const bool compress)
+      {
+        vector<float> vertex_data (3 * vertices.size());
+        for (size_t i = 0; i != vertices.size(); ++i)
+          for (size_t axis = 0; axis != 3; ++axis)
+            Raw::store_LE<float> (vertices[i][axis], vertex_data.data(), 3*i + axis);
+        vector<int32_t> triangle_data (3 * triangles.size());
+        for (size_t i = 0; i != triangles.size(); ++i)
+          for (size_t v = 0; v != 3; ++v)
+            Raw::store_LE<int32_t> (triangles[i][v], triangle_data.data(), 3*i + v);
+
+        File::OFStream out (path);
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<!DOCTYPE GIFTI SYSTEM \"http://www.nitrc.org/frs/download.php/115/gifti.dtd\">\n"
+            << "<GIFTI Version=\"1.0\" NumberOfDataArrays=\"2\">\n"
+            << "  <MetaData>\n"
+            << "    <MD>\n"
+            << "      <Name><![CDATA[mrtrix_version]]></Name>\n"
+            << "      <Value><![CDATA[" << App::mrtrix_version << "]]></Value>\n"
+            << "    </MD>\n"
+            << "  </MetaData>\n"
+            << "  <LabelTable/>\n";
+        write_array (out, "NIFTI_INTENT_POINTSET", "NIFTI_TYPE_FLOAT32", vertices.size(), 3,
+                     reinterpret_cast<const uint8_t*> (vertex_data.data()), vertex_data.size() * sizeof (float), compress);
+        write_array (out, "NIFTI_INTENT_TRIANGLE", "NIFTI_TYPE_INT32", triangles.size(), 3,
+                     reinterpret_cast<const uint8_t*> (triangle_data.data()), triangle_data.size() * sizeof (int32_t), compress);
+        out << "</GIFTI>\n";
+      }
+
+
+
+    }
+  }
+}
@@ -0,0 +1,56 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __surface_gifti_h__
+#define __surface_gifti_h__
+
+#include <stdint.h>
+
+#include "types.h"
+
+#include "surface/types.h"
+
+namespace MR
+{
+  namespace Surface
+  {
+    namespace GIfTI
+    {
+
+
+      // Encoding & decoding of the Base64 representation used for GIfTI data arrays
+      std::string base64_encode (const uint8_t* data, const size_t size);
+      vector<uint8_t> base64_decode (const char* data, const size_t size);
+
+
+      // Read the vertices (NIFTI_INTENT_POINTSET) and triangles (NIFTI_INTENT_TRIANGLE)
+      //   of a GIfTI surface file; data arrays with other intents are ignored
+      // Supported encodings are ASCII, Base64Binary and GZipBase64Binary; data
+      //   stored in external files are not supported. Any coordinate system
+      //   transformation in the file is not applied.
+      void read_surface (const std::string&, VertexList&, TriangleList&);
+
+      // Write a GIfTI surface file, using GZipBase64Binary encoding if compress
+      //   is set and Base64Binary encoding otherwise
+      void write_surface (const std::string&, const VertexList&, const TriangleList&, const bool compress);
+
+
+    }
+  }
+}
+
+#endif
+
@@ -20,9 +20,12 @@
 #include <iostream>
 #include <string>
 
+#include "raw.h"
 #include "types.h"
 
+#include "file/mmap.h"
 #include "surface/freesurfer.h"
+#include "surface/gifti.h"
 #include "surface/utils.h"
 
 
@@ -41,6 +44,10 @@ namespace MR
         load_stl (path);
       } else if (path.substr (path.size() - 4) == ".obj" || path.substr (path.size() - 4) == ".OBJ") {
         load_obj (path);
+      } else if (path.substr (path.size() - 4) == ".ply" || path.substr (path.size() - 4) == ".PLY") {
+        load_ply (path);
+      } else if (path.substr (path.size() - 4) == ".gii" || path.substr (path.size() - 4) == ".GII") {
+        load_gii (path);
       } else {
         try {
           load_fs (path);
@@ -64,6 +71,10 @@ namespace MR
         save_stl (path, binary);
       else if (path.substr (path.size() - 4) == ".obj")
         save_obj (path);
+      else if (path.substr (path.size() - 4) == ".ply")
+        save_ply (path, binary);
+      else if (path.substr (path.size() - 4) == ".gii")
+        save_gii (path, binary);
       else
         throw Exception ("Output mesh file format not supported");
     }
@@ -92,27 +103,15 @@ namespace MR
 
 
 
-    namespace {
-      template<typename T>
-      void load_vtk_points_binary (std::ifstream& in, const size_t num_vertices, vector<Eigen::Matrix<T, 3, 1>>& out)
-      {
-        out.reserve (num_vertices);
-        Eigen::Matrix<T, 3, 1> v;
-        for (size_t i = 0; i != num_vertices; ++i) {
-          in.read (reinterpret_cast<char*>(v.data()), 3 * sizeof (T));
-          out.push_back (v);
-        }
-      }
-    }
-
-
-
     void Mesh::load_vtk (const std::string& path)
     {
 
       std::ifstream in (path.c_str(), std::ios_base::binary);
       if (!in)
         throw Exception ("Error opening input file!");
+      in.seekg (0, std::ios_base::end);
+      const size_t file_size = in.tellg();
+      in.seekg (0, std::ios_base::beg);
 
       std::string line;
 
@@ -143,27 +142,51 @@ namespace MR
       if (line == "STRUCTURED_POINTS" || line == "STRUCTURED_GRID" || line == "UNSTRUCTURED_GRID" || line == "RECTILINEAR_GRID" || line == "FIELD")
         throw Exception ("Unsupported dataset type (" + line + ") in .vtk file");
 
+      // For binary data, map the remainder of the file into memory, so that
+      //   the point & polygon data can be copied in bulk
+      std::unique_ptr<File::MMap> mmap;
+      const uint8_t* data = nullptr;
+      const uint8_t* data_end = nullptr;
+      if (!is_ascii) {
+        const int64_t data_offset = in.tellg();
+        in.seekg (0, std::ios_base::end);
+        const int64_t file_size = in.tellg();
+        in.close();
+        if (file_size > data_offset) {
+          mmap.reset (new File::MMap (File::Entry (path, data_offset)));
+          data = mmap->address();
+          data_end = data + mmap->size();
+        }
+      }
+      auto read_binary = [&] (void* destination, const size_t bytes) {
+        if (size_t (data_end - data) < bytes)
+          throw Exception ("Unexpected end of binary .vtk file \"" + path + "\"");
+        memcpy (destination, data, bytes);
+        data += bytes;
+      };
+
       // Won't know endianness of file when the vertex positions are read,
       //   only when the polygon information is encountered;
       bool change_endianness = false;
 
       // If both float and big-endian, need to store natively as floats and swap endianness later
       vector<Eigen::Matrix<float, 3, 1>> vertices_float;
+      static_assert (sizeof (Vertex) == 3 * sizeof (double), "Vertex is not tightly packed");
+      static_assert (sizeof (Eigen::Matrix<float, 3, 1>) == 3 * sizeof (float), "Vertex is not tightly packed");
 
       // From here, don't necessarily know which parts of the data will come first
-      while (!in.eof()) {
+      while (is_ascii ? !in.eof() : data != data_end) {
 
         // Need to read line in either ASCII mode or in raw binary
         if (is_ascii) {
           MR::getline (in, line);
         } else {
           line.clear();
-          char c = 0;
-          do {
-            in.read (&c, sizeof (char));
-            if (isalnum (c) || c == ' ')
-              line.push_back (c);
-          } while (!in.eof() && (isalnum (c) || c == ' '));
+          while (data != data_end && (isalnum (*data) || *data == ' '))
+            line.push_back (*data++);
+          // Skip the terminating character
+          if (data != data_end)
+            ++data;
         }
 
         if (line.size()) {
@@ -172,30 +195,33 @@ namespace MR
             line = line.substr (7);
             const size_t ws = line.find (' ');
             const int num_vertices = to<int> (line.substr (0, ws));
+            if (num_vertices < 0)
+              throw Exception ("Negative number of vertices (" + str(num_vertices) + ") in .vtk file \"" + path + "\"");
             line = line.substr (ws + 1);
             bool is_double = false;
             if (line.substr (0, 6) == "double")
               is_double = true;
             else if (line.substr (0, 5) != "float")
               throw Exception ("Error in reading binary .vtk file: Unsupported datatype (\"" + line + "\"");
-
-            vertices.reserve (num_vertices);
-            if (!is_double)
-              vertices_float.reserve (num_vertices);
-
-            Vertex v;
-            Eigen::Matrix<float, 3, 1> v_float;
+            // Don't trust the header count for allocation: check it against the data available
+            if (!is_ascii && size_t (data_end - data) < size_t(num_vertices) * 3 * (is_double ? sizeof (double) : sizeof (float)))
+              throw Exception ("Unexpected end of binary .vtk file \"" + path + "\"");
 
             if (is_ascii) {
+              // Each vertex occupies at least 6 characters ("0 0 0\n")
+              vertices.reserve (std::min (size_t(num_vertices), file_size / 6));
+              Vertex v;
               for (int i = 0; i != num_vertices; ++i) {
                 MR::getline (in, line);
                 sscanf (line.c_str(), "%lf %lf %lf", &v[0], &v[1], &v[2]);
                 vertices.push_back (v);
               }
             } else if (is_double) {
-              load_vtk_points_binary<double> (in, num_vertices, vertices);
+              vertices.resize (num_vertices);
+              read_binary (vertices.data(), num_vertices * sizeof (Vertex));
             } else {
-              load_vtk_points_binary<float> (in, num_vertices, vertices_float);
+              vertices_float.resize (num_vertices);
+              read_binary (vertices_float.data(), num_vertices * sizeof (Eigen::Matrix<float, 3, 1>));
             }
 
           } else if (line.substr (0, 8) == "POLYGONS") {
@@ -214,10 +240,7 @@ namespace MR
                 MR::getline (in, line);
                 sscanf (line.c_str(), "%u", &vertex_count);
               } else {
-                in.read (reinterpret_cast<char*>(&vertex_count), sizeof (int));
-              }
-
-              if (!is_ascii) {
+                read_binary (&vertex_count, sizeof (int));
                 if (change_endianness) {
                   vertex_count = ByteOrder::swap (vertex_count);
                 } else if (vertex_count != 3 && vertex_count != 4) {
@@ -228,7 +251,7 @@ namespace MR
               if (vertex_count != 3 && vertex_count != 4)
                 throw Exception ("Could not parse file \"" + path + "\": only support 3- and 4-vertex polygons");
 
-              vector<unsigned int> t (vertex_count, 0);
+              std::array<unsigned int, 4> t;
 
               if (is_ascii) {
                 for (int index = 0; index != vertex_count; ++index) {
@@ -236,13 +259,12 @@ namespace MR
                   sscanf (line.c_str(), "%u", &t[index]);
                 }
               } else {
-                for (int index = 0; index != vertex_count; ++index)
-                  in.read (reinterpret_cast<char*>(&t[index]), sizeof (int));
+                read_binary (t.data(), vertex_count * sizeof (int));
               }
               if (vertex_count == 3)
-                triangles.push_back (Polygon<3>(t));
+                triangles.push_back (Triangle (t.data()));
               else
-                quads.push_back (Polygon<4>(t));
+                quads.push_back (Quad (t.data()));
               ++polygon_count;
               element_count += 1 + vertex_count;
 
@@ -295,6 +317,7 @@ namespace MR
 
       if (vertices_float.size()) {
         assert (!vertices.size());
+        vertices.reserve (vertices_float.size());
         for (const auto& v : vertices_float)
           vertices.emplace_back (Vertex (v.cast<double>()));
       }
@@ -322,35 +345,34 @@ namespace MR
 
       if (strncmp (init, "solid", 5)) {
 
-        // File is stored as binary
+        // File is stored as binary: map the whole file into memory, and parse
+        //   the fixed-size (50-byte) facet records directly
         in.close();
-        in.open (path.c_str(), std::ios_base::in | std::ios_base::binary);
-        char header[80];
-        in.read (header, 80);
+        File::MMap mmap (File::Entry (path, 0));
+        if (mmap.size() < 84)
+          throw Exception ("Error in parsing STL file " + Path::basename (path) + ": file too small");
+        const uint8_t* const data = mmap.address();
+        const uint32_t count = Raw::fetch_LE<uint32_t> (data + 80);
+        const size_t num_records = (mmap.size() - 84) / 50;
+        if ((mmap.size() - 84) % 50 >= 12)
+          throw Exception ("Error in parsing STL file");
 
-        uint32_t count;
-        in.read (reinterpret_cast<char*>(&count), sizeof(uint32_t));
-
-        uint16_t attribute_byte_count;
         bool warn_attribute = false;
-
-        Eigen::Vector3f vertex, normal;
-
-        while (in.read (reinterpret_cast<char*>(normal.data()), 3 * sizeof(float))) {
-          for (size_t index = 0; index != 3; ++index) {
-            if (!in.read (reinterpret_cast<char*>(vertex.data()), 3 * sizeof(float)))
-              throw Exception ("Error in parsing STL file");
-            vertices.push_back (vertex.cast<default_type>());
-          }
-          in.read (reinterpret_cast<char*>(&attribute_byte_count), sizeof(uint16_t));
-          if (attribute_byte_count)
+        vertices.reserve (3 * num_records);
+        triangles.reserve (num_records);
+        for (size_t i = 0; i != num_records; ++i) {
+          const uint8_t* const record = data + 84 + 50*i;
+          const Eigen::Vector3d normal (Raw::fetch_LE<float> (record, 0), Raw::fetch_LE<float> (record, 1), Raw::fetch_LE<float> (record, 2));
+          for (size_t index = 0; index != 3; ++index)
+            vertices.push_back (Vertex (Raw::fetch_LE<float> (record, 3*index+3), Raw::fetch_LE<float> (record, 3*index+4), Raw::fetch_LE<float> (record, 3*index+5)));
+          if (Raw::fetch_LE<uint16_t> (record + 48))
             warn_attribute = true;
 
-          triangles.push_back ( vector<uint32_t> { uint32_t(vertices.size()-3), uint32_t(vertices.size()-2), uint32_t(vertices.size()-1) } );
+          triangles.push_back (Triangle { uint32_t(vertices.size()-3), uint32_t(vertices.size()-2), uint32_t(vertices.size()-1) });
           const Eigen::Vector3d computed_normal = Surface::normal (*this, triangles.back());
-          if (computed_normal.dot (normal.cast<default_type>()) < 0.0)
+          if (computed_normal.dot (normal) < 0.0)
             warn_right_hand_rule = true;
-          if (abs (computed_normal.dot (normal.cast<default_type>())) < 0.99)
+          if (abs (computed_normal.dot (normal)) < 0.99)
             warn_nonstandard_normals = true;
         }
         if (triangles.size() != count)
@@ -568,31 +590,45 @@ namespace MR
     void Mesh::load_fs (const std::string& path)
     {
 
-      std::ifstream in (path.c_str(), std::ios_base::in | std::ios_base::binary);
-      if (!in)
-        throw Exception ("Error opening input file!");
+      // Map the whole file into memory, and convert the big-endian data in bulk
+      File::MMap mmap (File::Entry (path, 0));
+      const uint8_t* const begin = mmap.address();
+      const uint8_t* const end = begin + mmap.size();
+      if (mmap.size() < 3)
+        throw Exception ("File " + Path::basename (path) + " is not a FreeSurfer surface file");
 
-      const int32_t magic_number = FreeSurfer::get_int24_BE (in);
+      auto get_int24_BE = [] (const uint8_t* p) {
+        return (int32_t(p[0]) << 16) | (int32_t(p[1]) << 8) | int32_t(p[2]);
+      };
+      const int32_t magic_number = get_int24_BE (begin);
 
       if (magic_number == FreeSurfer::triangle_file_magic_number) {
 
-        std::string comment;
-        std::getline (in, comment);
-        const auto first_newline_offset = in.tellg();
+        const uint8_t* const first_newline = std::find (begin + 3, end, '\n');
+        if (first_newline == end)
+          throw Exception ("Error reading FreeSurfer file \"" + path + "\": no comment line found");
 
         // Some FreeSurfer files will have a second comment line; others will not
         // Need to make honest attempt at both possible scenarios
-        auto load_triangles = [&] () {
-          const int32_t num_vertices = FreeSurfer::get_BE<int32_t> (in);
+        auto load_triangles = [&] (const uint8_t* p) {
+          if (end - p < 8)
+            throw Exception ("Error reading FreeSurfer file: EOF reached before vertex & polygon counts");
+          const int32_t num_vertices = Raw::fetch_BE<int32_t> (p, 0);
           if (num_vertices <= 0)
             throw Exception ("Error reading FreeSurfer file: Non-positive vertex count (" + str(num_vertices) + ")");
-          const int32_t num_polygons = FreeSurfer::get_BE<int32_t> (in);
+          const int32_t num_polygons = Raw::fetch_BE<int32_t> (p, 1);
           if (num_polygons <= 0)
             throw Exception ("Error reading FreeSurfer file: Non-positive polygon count (" + str(num_polygons) + ")");
           if (num_polygons > 3*num_vertices)
             throw Exception ("Error reading FreeSurfer file: More polygons (" + str(num_polygons) + ") than triple the number of vertices (" + str(num_vertices) + ")");
           if (num_polygons < num_vertices / 3)
             throw Exception ("Error reading FreeSurfer file: Not enough polygons (" + str(num_polygons) + ") to use all vertices (" + str(num_vertices) + ")");
+          p += 8;
+          const size_t available = end - p;
+          if (available < size_t(num_vertices) * 3 * sizeof(float))
+            throw Exception ("Error reading FreeSurfer file: EOF reached after " + str(available / (3 * sizeof(float))) + " of " + str(num_vertices) + " vertices");
+          if (available - size_t(num_vertices) * 3 * sizeof(float) < size_t(num_polygons) * 3 * sizeof(int32_t))
+            throw Exception ("Error reading FreeSurfer file: EOF reached after " + str((available - size_t(num_vertices) * 3 * sizeof(float)) / (3 * sizeof(int32_t))) + " of " + str(num_polygons) + " triangles");
           try {
             vertices.reserve (num_vertices);
             triangles.reserve (num_polygons);
@@ -602,35 +638,25 @@ namespace MR
             throw Exception ("Error reading FreeSurfer file: Memory allocation ("
                              + str(num_vertices) + " vertices, " + str(num_polygons) + " polygons = erroneous?)");
           }
-          for (int32_t i = 0; i != num_vertices; ++i) {
-            std::array<float, 3> temp;
-            for (size_t axis = 0; axis != 3; ++axis)
-              temp[axis] = FreeSurfer::get_BE<float> (in);
-            if (!in.good())
-              throw Exception ("Error reading FreeSurfer file: EOF reached after " + str(vertices.size()) + " of " + str(num_vertices) + " vertices");
-            vertices.push_back (Vertex (temp[0], temp[1], temp[2]));
-          }
-          for (int32_t i = 0; i != num_polygons; ++i) {
-            std::array<int32_t, 3> temp;
-            for (size_t v = 0; v != 3; ++v)
-              temp[v] = FreeSurfer::get_BE<int32_t> (in);
-            if (!in.good())
-              throw Exception ("Error reading FreeSurfer file: EOF reached after " + str(triangles.size()) + " of " + str(num_polygons) + " triangles");
+          for (size_t i = 0; i != size_t(num_vertices); ++i)
+            vertices.push_back (Vertex (Raw::fetch_BE<float> (p, 3*i), Raw::fetch_BE<float> (p, 3*i+1), Raw::fetch_BE<float> (p, 3*i+2)));
+          p += size_t(num_vertices) * 3 * sizeof(float);
+          for (size_t i = 0; i != size_t(num_polygons); ++i) {
+            const std::array<int32_t, 3> temp { Raw::fetch_BE<int32_t> (p, 3*i), Raw::fetch_BE<int32_t> (p, 3*i+1), Raw::fetch_BE<int32_t> (p, 3*i+2) };
             triangles.push_back (Triangle (temp));
           }
         };
 
         try {
-          load_triangles();
+          load_triangles (first_newline + 1);
         } catch (Exception& e_onecomment) {
           vertices.clear();
           triangles.clear();
-          in.clear();
-          in.seekg (first_newline_offset, std::ios_base::beg);
-          std::string second_comment;
-          std::getline (in, second_comment);
           try {
-            load_triangles();
+            const uint8_t* const second_newline = std::find (first_newline + 1, end, '\n');
+            if (second_newline == end)
+              throw Exception ("Error reading FreeSurfer file: no second comment line found");
+            load_triangles (second_newline + 1);
           } catch (Exception& e_twocomments) {
             Exception e ("Unable to read FreeSurfer file \"" + path + "\"");
             e.push_back ("Error if file header is one-line comment:");
@@ -644,19 +670,20 @@ namespace MR
 
       } else if (magic_number == FreeSurfer::quad_file_magic_number) {
 
-        const int32_t num_vertices = FreeSurfer::get_int24_BE (in);
-        const int32_t num_polygons = FreeSurfer::get_int24_BE (in);
+        if (mmap.size() < 9)
+          throw Exception ("Error reading FreeSurfer file \"" + path + "\": EOF reached before vertex & polygon counts");
+        const int32_t num_vertices = get_int24_BE (begin + 3);
+        const int32_t num_polygons = get_int24_BE (begin + 6);
+        const uint8_t* p = begin + 9;
+        if (size_t(end - p) < size_t(num_vertices) * 3 * sizeof(int16_t) + size_t(num_polygons) * 4 * 3)
+          throw Exception ("Error reading FreeSurfer file \"" + path + "\": file too small for " + str(num_vertices) + " vertices and " + str(num_polygons) + " quads");
         vertices.reserve (num_vertices);
-        for (int32_t i = 0; i != num_vertices; ++i) {
-          int16_t temp[3];
-          for (size_t axis = 0; axis != 3; ++axis)
-            temp[axis] = FreeSurfer::get_BE<int16_t> (in);
-          vertices.push_back (Vertex (0.01 * temp[0], 0.01 * temp[1], 0.01 * temp[2]));
-        }
-        for (int32_t i = 0; i != num_polygons; ++i) {
-          std::array<int32_t, 4> temp;
-          for (size_t v = 0; v != 4; ++v)
-            temp[v] = FreeSurfer::get_int24_BE (in);
+        for (size_t i = 0; i != size_t(num_vertices); ++i)
+          vertices.push_back (Vertex (0.01 * Raw::fetch_BE<int16_t> (p, 3*i), 0.01 * Raw::fetch_BE<int16_t> (p, 3*i+1), 0.01 * Raw::fetch_BE<int16_t> (p, 3*i+2)));
+        p += size_t(num_vertices) * 3 * sizeof(int16_t);
+        quads.reserve (num_polygons);
+        for (int32_t i = 0; i != num_polygons; ++i, p += 12) {
+          const std::array<int32_t, 4> temp { get_int24_BE (p), get_int24_BE (p+3), get_int24_BE (p+6), get_int24_BE (p+9) };
           quads.push_back (Quad (temp));
         }
 
@@ -673,6 +700,276 @@ namespace MR
 
 
 
+    namespace {
+      namespace PLY {
+
+        enum class type_t { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+        type_t parse_type (const std::string& s)
+        {
+          if (s == "char"   || s == "int8")    return type_t::INT8;
+          if (s == "uchar"  || s == "uint8")   return type_t::UINT8;
+          if (s == "short"  || s == "int16")   return type_t::INT16;
+          if (s == "ushort" || s == "uint16")  return type_t::UINT16;
+          if (s == "int"    || s == "int32")   return type_t::INT32;
+          if (s == "uint"   || s == "uint32")  return type_t::UINT32;
+          if (s == "float"  || s == "float32") return type_t::FLOAT32;
+          if (s == "double" || s == "float64") return type_t::FLOAT64;
+          throw Exception ("unknown PLY data type \"" + s + "\"");
+        }
+
+        size_t bytes (const type_t type)
+        {
+          switch (type) {
+            case type_t::INT8: case type_t::UINT8: return 1;
+            case type_t::INT16: case type_t::UINT16: return 2;
+            case type_t::INT32: case type_t::UINT32: case type_t::FLOAT32: return 4;
+            case type_t::FLOAT64: return 8;
+          }
+          return 0;
+        }
+
+        struct Property { NOMEMALIGN
+          std::string name;
+          bool is_list;
+          type_t count_type, type;
+        };
+
+        struct Element { NOMEMALIGN
+          std::string name;
+          size_t count;
+          vector<Property> properties;
+        };
+
+        // Sequential access to the values in the body of a PLY file
+        class Reader { NOMEMALIGN
+          public:
+            Reader (const uint8_t* begin, const uint8_t* end, const std::string& format) :
+                p (begin),
+                end (end),
+                is_ascii (format == "ascii"),
+                is_BE (format == "binary_big_endian")
+            {
+              if (is_ascii) {
+                text.assign (reinterpret_cast<const char*> (begin), reinterpret_cast<const char*> (end));
+                text_p = text.c_str();
+              } else if (!is_BE && format != "binary_little_endian") {
+                throw Exception ("unsupported PLY format \"" + format + "\"");
+              }
+            }
+
+            // Bytes of body data remaining to be read
+            size_t remaining() const
+            {
+              return is_ascii ? text.size() - (text_p - text.c_str()) : size_t (end - p);
+            }
+
+            // Lower bound on the number of bytes occupied by one value
+            size_t min_bytes (const type_t type) const
+            {
+              return is_ascii ? 2 : bytes (type);
+            }
+
+            default_type operator() (const type_t type)
+            {
+              if (is_ascii) {
+                char* next;
+                const default_type value = std::strtod (text_p, &next);
+                if (next == text_p)
+                  throw Exception ("unexpected end of ASCII PLY data");
+                text_p = next;
+                return value;
+              }
+              if (size_t (end - p) < bytes (type))
+                throw Exception ("unexpected end of binary PLY data");
+              default_type value = 0.0;
+              switch (type) {
+                case type_t::INT8:    value = *reinterpret_cast<const int8_t*> (p); break;
+                case type_t::UINT8:   value = *p; break;
+                case type_t::INT16:   value = fetch<int16_t> (); break;
+                case type_t::UINT16:  value = fetch<uint16_t> (); break;
+                case type_t::INT32:   value = fetch<int32_t> (); break;
+                case type_t::UINT32:  value = fetch<uint32_t> (); break;
+                case type_t::FLOAT32: value = fetch<float> (); break;
+                case type_t::FLOAT64: value = fetch<double> (); break;
+              }
+              p += bytes (type);
+              return value;
+            }
+
+          private:
+            const uint8_t* p;
+            const uint8_t* const end;
+            const bool is_ascii, is_BE;
+            std::string text;
+            const char* text_p;
+
+            template <typename T>
+            T fetch() const { return is_BE ? Raw::fetch_BE<T> (p) : Raw::fetch_LE<T> (p); }
+        };
+
+      }
+    }
+
+
+
+    void Mesh::load_ply (const std::string& path)
+    {
+      File::MMap mmap (File::Entry (path, 0));
+      const uint8_t* const begin = mmap.address();
+      const uint8_t* const end = begin + mmap.size();
+
+      // Parse the header
+      const std::string end_header ("end_header");
+      const uint8_t* p = begin;
+      auto next_line = [&] () {
+        const uint8_t* const line_end = std::find (p, end, '\n');
+        std::string line (p, line_end);
+        if (line.size() && line.back() == '\r')
+          line.pop_back();
+        p = line_end == end ? end : line_end + 1;
+        return line;
+      };
+      if (next_line() != "ply")
+        throw Exception ("File \"" + path + "\" is not a PLY file");
+      std::string format;
+      vector<PLY::Element> elements;
+      std::string line;
+      do {
+        if (p == end)
+          throw Exception ("Error parsing PLY file \"" + path + "\": no end of header");
+        line = next_line();
+        const auto tokens = split (line, " \t", true);
+        if (!tokens.size())
+          continue;
+        if (tokens[0] == "format") {
+          if (tokens.size() < 2)
+            throw Exception ("Error parsing PLY file \"" + path + "\": malformed format line");
+          format = tokens[1];
+        } else if (tokens[0] == "element") {
+          if (tokens.size() != 3)
+            throw Exception ("Error parsing PLY file \"" + path + "\": malformed element line (\"" + line + "\")");
+          elements.push_back ({ tokens[1], to<size_t> (tokens[2]), {} });
+        } else if (tokens[0] == "property") {
+          if (!elements.size())
+            throw Exception ("Error parsing PLY file \"" + path + "\": property defined before any element");
+          if (tokens.size() == 5 && tokens[1] == "list")
+            elements.back().properties.push_back ({ tokens[4], true, PLY::parse_type (tokens[2]), PLY::parse_type (tokens[3]) });
+          else if (tokens.size() == 3)
+            elements.back().properties.push_back ({ tokens[2], false, PLY::type_t::UINT8, PLY::parse_type (tokens[1]) });
+          else
+            throw Exception ("Error parsing PLY file \"" + path + "\": malformed property line (\"" + line + "\")");
+        } else if (tokens[0] != "comment" && tokens[0] != "obj_info" && tokens[0] != end_header) {
+          throw Exception ("Error parsing PLY file \"" + path + "\": unknown header line (\"" + line + "\")");
+        }
+      } while (line != end_header);
+
+      PLY::Reader read (p, end, format);
+      vector<uint32_t> indices;
+      try {
+        for (const auto& element : elements) {
+          if (element.name == "vertex") {
+
+            // Location of the vertex position & normal properties within each record
+            ssize_t position[3] = { -1, -1, -1 }, normal[3] = { -1, -1, -1 };
+            for (size_t i = 0; i != element.properties.size(); ++i) {
+              const std::string& name (element.properties[i].name);
+              if (name.size() == 1 && name[0] >= 'x' && name[0] <= 'z')
+                position[name[0] - 'x'] = i;
+              else if (name.size() == 2 && name[0] == 'n' && name[1] >= 'x' && name[1] <= 'z')
+                normal[name[1] - 'x'] = i;
+            }
+            if (position[0] < 0 || position[1] < 0 || position[2] < 0)
+              throw Exception ("vertex element does not contain x, y and z properties");
+            const bool have_normals = normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;
+
+            // Don't trust the header count for allocation: bound it by the
+            //   number of records that could fit in the remainder of the file
+            size_t record_bytes = 0;
+            for (const auto& property : element.properties)
+              record_bytes += read.min_bytes (property.is_list ? property.count_type : property.type);
+            const size_t reserve_count = std::min (element.count, read.remaining() / record_bytes);
+            vertices.reserve (reserve_count);
+            if (have_normals)
+              normals.reserve (reserve_count);
+            vector<default_type> values (element.properties.size());
+            for (size_t n = 0; n != element.count; ++n) {
+              for (size_t i = 0; i != element.properties.size(); ++i) {
+                const auto& property (element.properties[i]);
+                if (property.is_list) {
+                  const size_t count = read (property.count_type);
+                  for (size_t j = 0; j != count; ++j)
+                    read (property.type);
+                } else {
+                  values[i] = read (property.type);
+                }
+              }
+              vertices.push_back (Vertex (values[position[0]], values[position[1]], values[position[2]]));
+              if (have_normals)
+                normals.push_back (Vertex (values[normal[0]], values[normal[1]], values[normal[2]]));
+            }
+
+          } else if (element.name == "face") {
+
+            for (size_t n = 0; n != element.count; ++n) {
+              for (const auto& property : element.properties) {
+                if (property.is_list) {
+                  const size_t count = read (property.count_type);
+                  const bool is_indices = (property.name == "vertex_indices" || property.name == "vertex_index");
+                  if (is_indices && count != 3 && count != 4)
+                    throw Exception ("only 3- and 4-vertex polygons are supported (face " + str(n) + " has " + str(count) + " vertices)");
+                  indices.clear();
+                  for (size_t j = 0; j != count; ++j)
+                    indices.push_back (read (property.type));
+                  if (is_indices) {
+                    if (count == 3)
+                      triangles.push_back (Triangle (indices.data()));
+                    else
+                      quads.push_back (Quad (indices.data()));
+                  }
+                } else {
+                  read (property.type);
+                }
+              }
+            }
+
+          } else {
+
+            for (size_t n = 0; n != element.count; ++n) {
+              for (const auto& property : element.properties) {
+                const size_t count = property.is_list ? read (property.count_type) : 1;
+                for (size_t j = 0; j != count; ++j)
+                  read (property.type);
+              }
+            }
+
+          }
+        }
+      } catch (Exception& e) {
+        throw Exception (e, "Error parsing PLY file \"" + path + "\"");
+      }
+
+      try {
+        verify_data();
+      } catch(Exception& e) {
+        throw Exception (e, "Error verifying surface data from PLY file \"" + path + "\"");
+      }
+    }
+
+
+
+    void Mesh::load_gii (const std::string& path)
+    {
+      GIfTI::read_surface (path, vertices, triangles);
+      try {
+        verify_data();
+      } catch(Exception& e) {
+        throw Exception (e, "Error verifying surface data from GIfTI file \"" + path + "\"");
+      }
+    }
+
+
+
 
     void Mesh::save_vtk (const std::string& path, const bool binary) const
     {
@@ -807,6 +1104,67 @@ namespace MR
 
 
 
+    void Mesh::save_ply (const std::string& path, const bool binary) const
+    {
+      File::OFStream out (path, std::ios_base::binary | std::ios_base::out);
+      out << "ply\n"
+          << "format " << (binary ? "binary_little_endian" : "ascii") << " 1.0\n"
+          << "comment mrtrix_version: " << App::mrtrix_version << "\n"
+          << "element vertex " << vertices.size() << "\n"
+          << "property float x\n"
+          << "property float y\n"
+          << "property float z\n"
+          << "element face " << (triangles.size() + quads.size()) << "\n"
+          << "property list uchar int vertex_indices\n"
+          << "end_header\n";
+
+      if (binary) {
+
+        // Assemble the body in memory, and write it in one go
+        vector<uint8_t> buffer (12 * vertices.size() + 13 * triangles.size() + 17 * quads.size());
+        uint8_t* p = buffer.data();
+        for (const auto& v : vertices) {
+          for (size_t axis = 0; axis != 3; ++axis)
+            Raw::store_LE<float> (v[axis], p, axis);
+          p += 12;
+        }
+        for (const auto& t : triangles) {
+          *p++ = 3;
+          for (size_t i = 0; i != 3; ++i)
+            Raw::store_LE<int32_t> (t[i], p, i);
+          p += 12;
+        }
+        for (const auto& q : quads) {
+          *p++ = 4;
+          for (size_t i = 0; i != 4; ++i)
+            Raw::store_LE<int32_t> (q[i], p, i);
+          p += 16;
+        }
+        out.write (reinterpret_cast<const char*> (buffer.data()), buffer.size());
+
+      } else {
+
+        for (const auto& v : vertices)
+          out << str<float>(v[0]) << " " << str<float>(v[1]) << " " << str<float>(v[2]) << "\n";
+        for (const auto& t : triangles)
+          out << "3 " << t[0] << " " << t[1] << " " << t[2] << "\n";
+        for (const auto& q : quads)
+          out << "4 " << q[0] << " " << q[1] << " " << q[2] << " " << q[3] << "\n";
+
+      }
+    }
+
+
+
+    void Mesh::save_gii (const std::string& path, const bool binary) const
+    {
+      if (quads.size())
+        throw Exception ("GIfTI file format does not support quads; only triangles");
+      GIfTI::write_surface (path, vertices, triangles, binary);
+    }
+
+
+
     void Mesh::load_triangle_vertices (VertexList& output, const size_t index) const
     {
       output.clear();
@@ -178,9 +178,13 @@ namespace MR
         void load_stl (const std::string&);
         void load_obj (const std::string&);
         void load_fs  (const std::string&);
+        void load_ply (const std::string&);
+        void load_gii (const std::string&);
         void save_vtk (const std::string&, const bool) const;
         void save_stl (const std::string&, const bool) const;
         void save_obj (const std::string&) const;
+        void save_ply (const std::string&, const bool) const;
+        void save_gii (const std::string&, const bool) const;
 
         void verify_data() const;
 
@@ -0,0 +1,236 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "surface/polygon_grid.h"
+
+#include <algorithm>
+
+#include "surface/utils.h"
+
+
+namespace MR
+{
+  namespace Surface
+  {
+
+
+
+    PolygonGrid::PolygonGrid (const Mesh& mesh, const default_type cell_size) :
+        mesh (mesh),
+        cell_size (cell_size),
+        lower (std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()),
+        upper (std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()),
+        offsets (1, 0)
+    {
+      if (!mesh.num_polygons())
+        return;
+
+      for (size_t i = 0; i != mesh.num_vertices(); ++i) {
+        const Vox c (to_cell (mesh.vert(i)));
+        lower = lower.min (c);
+        upper = upper.max (c);
+      }
+
+      const default_type half_size = 0.5 * cell_size;
+      const Eigen::Vector3d cell_offsets[8] = { { -half_size, -half_size, -half_size },
+                                                { -half_size, -half_size,  half_size },
+                                                { -half_size,  half_size, -half_size },
+                                                { -half_size,  half_size,  half_size },
+                                                {  half_size, -half_size, -half_size },
+                                                {  half_size, -half_size,  half_size },
+                                                {  half_size,  half_size, -half_size },
+                                                {  half_size,  half_size,  half_size } };
+
+      // Each (cell, polygon) pair, to be sorted by cell
+      vector<std::pair<uint64_t, uint32_t>> pairs;
+      VertexList vertices;
+      for (size_t poly_index = 0; poly_index != mesh.num_polygons(); ++poly_index) {
+
+        const size_t num_vertices = (poly_index < mesh.num_triangles()) ? 3 : 4;
+        Eigen::Vector3d poly_normal;
+        if (num_vertices == 3) {
+          mesh.load_triangle_vertices (vertices, poly_index);
+          poly_normal = normal (mesh, mesh.tri (poly_index));
+        } else {
+          mesh.load_quad_vertices (vertices, poly_index - mesh.num_triangles());
+          poly_normal = normal (mesh, mesh.quad (poly_index - mesh.num_triangles()));
+        }
+
+        // Figure out the cell extent of this polygon in three dimensions
+        Vox lower_bound (upper), upper_bound (lower);
+        for (const auto& v : vertices) {
+          const Vox c (to_cell (v));
+          lower_bound = lower_bound.min (c);
+          upper_bound = upper_bound.max (c);
+        }
+
+        // Use the Separating Axis Theorem to determine precisely which cells
+        //   within this bounding box are intersected by the polygon
+        auto overlap = [&] (const Vox& cell) -> bool {
+
+          const Eigen::Vector3d centre (cell.matrix().cast<default_type>() * cell_size);
+
+          // Test whether or not the two objects can be separated via projection onto an axis
+          auto separating_axis = [&] (const Eigen::Vector3d& axis) -> bool {
+            default_type cell_low  =  std::numeric_limits<default_type>::infinity();
+            default_type cell_high = -std::numeric_limits<default_type>::infinity();
+            default_type poly_low  =  std::numeric_limits<default_type>::infinity();
+            default_type poly_high = -std::numeric_limits<default_type>::infinity();
+
+            for (size_t i = 0; i != 8; ++i) {
+              const Eigen::Vector3d v (centre + cell_offsets[i]);
+              const default_type projection = axis.dot (v);
+              cell_low  = std::min (cell_low,  projection);
+              cell_high = std::max (cell_high, projection);
+            }
+
+            for (const auto& v : vertices) {
+              const default_type projection = axis.dot (v);
+              poly_low  = std::min (poly_low,  projection);
+              poly_high = std::max (poly_high, projection);
+            }
+
+            // Is this a separating axis?
+            return (poly_low > cell_high || cell_low > poly_high);
+          };
+
+          // The following axes need to be tested as potential separating axes:
+          //   x, y, z
+          //   All cross-products between cell and polygon edges
+          //   Polygon normal
+          for (size_t i = 0; i != 3; ++i) {
+            Eigen::Vector3d axis (0.0, 0.0, 0.0);
+            axis[i] = 1.0;
+            if (separating_axis (axis))
+              return false;
+            for (size_t j = 0; j != num_vertices-1; ++j) {
+              if (separating_axis (axis.cross (vertices[j+1] - vertices[j])))
+                return false;
+            }
+            if (separating_axis (axis.cross (vertices[num_vertices-1] - vertices[0])))
+              return false;
+          }
+          if (separating_axis (poly_normal))
+            return false;
+
+          // No axis has been found that separates the two objects
+          // Therefore, the two objects overlap
+          return true;
+        };
+
+        Vox cell;
+        for (cell[2] = lower_bound[2]; cell[2] <= upper_bound[2]; ++cell[2]) {
+          for (cell[1] = lower_bound[1]; cell[1] <= upper_bound[1]; ++cell[1]) {
+            for (cell[0] = lower_bound[0]; cell[0] <= upper_bound[0]; ++cell[0]) {
+              if (overlap (cell))
+                pairs.push_back (std::make_pair (key (cell), uint32_t(poly_index)));
+        } } }
+
+      }
+
+      // Sorting by cell retains the increasing order of polygon indices within each cell
+      std::sort (pairs.begin(), pairs.end());
+
+      polygon_indices.reserve (pairs.size());
+      const uint64_t size_x = upper[0] - lower[0] + 1, size_y = upper[1] - lower[1] + 1;
+      for (size_t i = 0; i != pairs.size(); ++i) {
+        if (!i || pairs[i].first != pairs[i-1].first) {
+          if (i)
+            offsets.push_back (polygon_indices.size());
+          const uint64_t k = pairs[i].first;
+          keys.push_back (k);
+          cells.push_back (Vox (lower[0] + int(k % size_x), lower[1] + int((k / size_x) % size_y), lower[2] + int(k / (size_x * size_y))));
+        }
+        polygon_indices.push_back (pairs[i].second);
+      }
+      if (pairs.size())
+        offsets.push_back (polygon_indices.size());
+    }
+
+
+
+    size_t PolygonGrid::find (const Vox& cell) const
+    {
+      if ((cell.array() < lower.array()).any() || (cell.array() > upper.array()).any())
+        return num_cells();
+      const uint64_t k = key (cell);
+      const auto it = std::lower_bound (keys.begin(), keys.end(), k);
+      return (it != keys.end() && *it == k) ? size_t (it - keys.begin()) : num_cells();
+    }
+
+
+
+    size_t PolygonGrid::nearest (const Vertex& p, default_type& distance) const
+    {
+      size_t result = mesh.num_polygons();
+      distance = std::numeric_limits<default_type>::infinity();
+      if (!num_cells())
+        return result;
+
+      // Search shells of cells of increasing Chebyshev distance from the cell
+      //   containing the point (or the nearest cell of the grid); no polygon within
+      //   a shell of radius r can lie closer to the point than (r-1) * cell_size
+      const Vox centre (to_cell (p).max (lower).min (upper));
+      const int max_radius = std::max ((centre - lower).maxCoeff(), (upper - centre).maxCoeff());
+      Vox cell;
+      for (int radius = 0; radius <= max_radius; ++radius) {
+        if ((radius - 1) * cell_size >= distance)
+          break;
+        const Vox from ((centre - radius).max (lower)), to ((centre + radius).min (upper));
+        for (cell[2] = from[2]; cell[2] <= to[2]; ++cell[2]) {
+          for (cell[1] = from[1]; cell[1] <= to[1]; ++cell[1]) {
+            const bool on_face = std::abs (cell[2] - centre[2]) == radius || std::abs (cell[1] - centre[1]) == radius;
+            for (cell[0] = from[0]; cell[0] <= to[0]; ++cell[0]) {
+              if (!on_face && std::abs (cell[0] - centre[0]) != radius) {
+                // Jump straight to the far side of the shell along this row
+                if (cell[0] < centre[0] + radius - 1)
+                  cell[0] = centre[0] + radius - 1;
+                continue;
+              }
+              const size_t index = find (cell);
+              if (index == num_cells())
+                continue;
+              for (const uint32_t* poly = polygons (index); poly != polygons (index) + size (index); ++poly) {
+                const default_type d = PolygonGrid::distance (p, *poly);
+                if (d < distance) {
+                  distance = d;
+                  result = *poly;
+                }
+              }
+            }
+          }
+        }
+      }
+      return result;
+    }
+
+
+
+    default_type PolygonGrid::distance (const Vertex& p, const size_t polygon) const
+    {
+      if (polygon < mesh.num_triangles()) {
+        const Triangle& t (mesh.tri (polygon));
+        return (p - closest_point (p, mesh.vert (t[0]), mesh.vert (t[1]), mesh.vert (t[2]))).norm();
+      }
+      const Quad& q (mesh.quad (polygon - mesh.num_triangles()));
+      return std::min ((p - closest_point (p, mesh.vert (q[0]), mesh.vert (q[1]), mesh.vert (q[2]))).norm(),
+                       (p - closest_point (p, mesh.vert (q[0]), mesh.vert (q[2]), mesh.vert (q[3]))).norm());
+    }
+
+
+
+  }
+}
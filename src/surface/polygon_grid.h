@@ -0,0 +1,89 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __surface_polygon_grid_h__
+#define __surface_polygon_grid_h__
+
+
+#include "types.h"
+
+#include "surface/mesh.h"
+#include "surface/types.h"
+
+
+
+namespace MR
+{
+  namespace Surface
+  {
+
+
+
+    // Uniform grid index of the polygons of a mesh, for spatial queries
+    // Cells are cubes of side length cell_size, centred on integer multiples
+    //   of cell_size in the space in which the mesh vertices are defined (e.g.
+    //   for a mesh in voxel space and a cell size of 1.0, cells coincide with
+    //   image voxels); the grid spans the bounding box of the mesh.
+    // Each polygon is assigned to those cells with which it truly overlaps
+    //   (using the Separating Axis Theorem), in increasing order of polygon
+    //   index; polygon indices beyond mesh.num_triangles() refer to quads.
+    // Only those cells intersected by the mesh are stored, in order of
+    //   increasing position along axis 2, then 1, then 0.
+    // The mesh must remain in scope for the lifetime of the grid.
+    class PolygonGrid
+    { MEMALIGN(PolygonGrid)
+      public:
+        PolygonGrid (const Mesh& mesh, const default_type cell_size = 1.0);
+
+        size_t num_cells() const { return cells.size(); }
+        const Vox& cell (const size_t index) const { return cells[index]; }
+        // Number of polygons overlapping a cell, and their indices
+        size_t size (const size_t index) const { return offsets[index+1] - offsets[index]; }
+        const uint32_t* polygons (const size_t index) const { return polygon_indices.data() + offsets[index]; }
+
+        // Returns num_cells() if this cell is not intersected by the mesh
+        size_t find (const Vox& cell) const;
+
+        // Find the polygon closest to a point; returns the index of the polygon,
+        //   or mesh.num_polygons() if the mesh is empty
+        size_t nearest (const Vertex& p, default_type& distance) const;
+        default_type distance (const Vertex& p) const { default_type result; nearest (p, result); return result; }
+
+        // Distance from a point to a particular polygon
+        default_type distance (const Vertex& p, const size_t polygon) const;
+
+      private:
+        const Mesh& mesh;
+        const default_type cell_size;
+        Vox lower, upper;
+        vector<uint64_t> keys;
+        vector<Vox> cells;
+        vector<size_t> offsets;
+        vector<uint32_t> polygon_indices;
+
+        uint64_t key (const Vox& cell) const {
+          return (uint64_t(cell[2] - lower[2]) * uint64_t(upper[1] - lower[1] + 1) + uint64_t(cell[1] - lower[1])) * uint64_t(upper[0] - lower[0] + 1) + uint64_t(cell[0] - lower[0]);
+        }
+        Vox to_cell (const Vertex& p) const { return Vox (Vertex (p * (1.0 / cell_size))); }
+    };
+
+
+
+  }
+}
+
+#endif
+
@@ -72,6 +72,36 @@ namespace MR
 
 
 
+    // Closest point to p on the triangle (a, b, c), including its edges & vertices
+    inline Vertex closest_point (const Vertex& p, const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+      const Vertex ab (b - a), ac (c - a), ap (p - a);
+      const default_type d1 = ab.dot (ap), d2 = ac.dot (ap);
+      if (d1 <= 0.0 && d2 <= 0.0)
+        return a;
+      const Vertex bp (p - b);
+      const default_type d3 = ab.dot (bp), d4 = ac.dot (bp);
+      if (d3 >= 0.0 && d4 <= d3)
+        return b;
+      const default_type vc = d1*d4 - d3*d2;
+      if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        return a + (d1 / (d1 - d3)) * ab;
+      const Vertex cp (p - c);
+      const default_type d5 = ab.dot (cp), d6 = ac.dot (cp);
+      if (d6 >= 0.0 && d5 <= d6)
+        return c;
+      const default_type vb = d5*d2 - d1*d6;
+      if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        return a + (d2 / (d2 - d6)) * ac;
+      const default_type va = d3*d6 - d5*d4;
+      if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+        return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+      const default_type denom = 1.0 / (va + vb + vc);
+      return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+
+
   }
 }
 
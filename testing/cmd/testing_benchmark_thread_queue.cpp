@@ -0,0 +1,128 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "thread_queue.h"
+#include "timer.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+#define DEFAULT_NUM_ITEMS 10000000
+#define DEFAULT_NUM_WRITERS 1
+#define DEFAULT_NUM_READERS 4
+
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Compare the throughput of the lock-free and locking Thread::Queue backends";
+  DESCRIPTION
+  + "Items consisting of a single integer are passed from a set of writer "
+    "threads to a set of reader threads, with no other processing. This "
+    "measures the overhead of the queue hand-off alone, and reports the time "
+    "taken and number of items passed per second for each backend.";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+
+  OPTIONS
+  + Option ("items", "the total number of items to pass through the queue (default: " + str(DEFAULT_NUM_ITEMS) + ")")
+    + Argument ("number").type_integer (1)
+
+  + Option ("writers", "the number of writer threads (default: " + str(DEFAULT_NUM_WRITERS) + ")")
+    + Argument ("number").type_integer (1)
+
+  + Option ("readers", "the number of reader threads (default: " + str(DEFAULT_NUM_READERS) + ")")
+    + Argument ("number").type_integer (1);
+}
+
+
+
+template <class QueueType>
+  struct Writer { NOMEMALIGN
+    Writer (QueueType& queue, std::atomic<ssize_t>& remaining) :
+      writer (queue), remaining (remaining) { }
+    void execute () {
+      typename QueueType::Writer::Item item (writer);
+      while (remaining-- > 0) {
+        *item = 1;
+        if (!item.write())
+          return;
+      }
+    }
+    typename QueueType::Writer writer;
+    std::atomic<ssize_t>& remaining;
+  };
+
+template <class QueueType>
+  struct Reader { NOMEMALIGN
+    Reader (QueueType& queue, std::atomic<size_t>& received) :
+      reader (queue), received (received) { }
+    void execute () {
+      typename QueueType::Reader::Item item (reader);
+      size_t count = 0;
+      while (item.read())
+        count += *item;
+      received += count;
+    }
+    typename QueueType::Reader reader;
+    std::atomic<size_t>& received;
+  };
+
+
+
+template <template <class> class Backend>
+  void benchmark (const std::string& backend_name, size_t num_items, size_t num_writers, size_t num_readers)
+  {
+    using QueueType = Thread::Queue<size_t, Backend>;
+    std::atomic<ssize_t> remaining (num_items);
+    std::atomic<size_t> received (0);
+
+    Timer timer;
+    {
+      QueueType queue (backend_name);
+      Writer<QueueType> writer (queue, remaining);
+      Reader<QueueType> reader (queue, received);
+      auto writers = Thread::run (Thread::multi (writer, num_writers), "writers");
+      auto readers = Thread::run (Thread::multi (reader, num_readers), "readers");
+      writers.wait();
+      readers.wait();
+    }
+    const double elapsed = timer.elapsed();
+
+    if (received != num_items)
+      throw Exception ("backend \"" + backend_name + "\": expected " + str(num_items) + " items, received " + str(received));
+    CONSOLE (backend_name + " backend: " + str(num_items) + " items in " + str(elapsed, 4)
+        + " seconds (" + str(num_items / elapsed, 4) + " items/second)");
+  }
+
+
+
+void run ()
+{
+  const size_t num_items = get_option_value<size_t> ("items", DEFAULT_NUM_ITEMS);
+  const size_t num_writers = get_option_value<size_t> ("writers", DEFAULT_NUM_WRITERS);
+  const size_t num_readers = get_option_value<size_t> ("readers", DEFAULT_NUM_READERS);
+
+  CONSOLE ("passing " + str(num_items) + " items from " + str(num_writers)
+      + " writer(s) to " + str(num_readers) + " reader(s)");
+
+  benchmark<Thread::QueueBackend::Locking> ("locking", num_items, num_writers, num_readers);
+  benchmark<Thread::QueueBackend::LockFree> ("lock-free", num_items, num_writers, num_readers);
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "math/rng.h"
+#include "math/SH.h"
+#include "dwi/directions/set.h"
+#include "dwi/tractography/tracking/amplitude_lookup.h"
+#include "dwi/tractography/tracking/types.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography::Tracking;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the FOD amplitudes obtained by interpolation within pre-computed direction sets against direct evaluation of the spherical harmonic series";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void run ()
+{
+  vector<std::string> failed_tests;
+  auto test = [&] (const bool result, const std::string msg) {
+    if (!result)
+      failed_tests.push_back (msg);
+  };
+
+  const int lmax = 8;
+  Math::RNG::Uniform<float> uniform;
+  Math::RNG::Normal<float> normal;
+  auto random_direction = [&] () {
+    return Eigen::Vector3f (normal(), normal(), normal()).normalized();
+  };
+
+  // FOD image with an oblique transform; every voxel contains up to three
+  //   fibre populations, each a delta function truncated at lmax (i.e. as
+  //   sharp as FODs of this lmax can be), with the exception of a number of
+  //   empty voxels and a single voxel with non-finite coefficients
+  Header H;
+  H.ndim() = 4;
+  H.size(0) = H.size(1) = H.size(2) = 7;
+  H.size(3) = Math::SH::NforL (lmax);
+  H.spacing(0) = H.spacing(1) = H.spacing(2) = 2.0;
+  H.spacing(3) = 1.0;
+  H.transform().setIdentity();
+  H.transform().linear() = Eigen::AngleAxisd (0.4, Eigen::Vector3d (1.0, 2.0, 3.0).normalized()).toRotationMatrix();
+  H.transform().translation() = Eigen::Vector3d (-7.0, 3.0, 12.0);
+  H.datatype() = DataType::Float32;
+  auto fod = Image<float>::scratch (H, "random FODs");
+  float max_amplitude = 0.0f;
+  Eigen::VectorXf coefs (H.size(3)), lobe (H.size(3));
+  for (auto l = Loop (fod, 0, 3) (fod); l; ++l) {
+    coefs.setZero();
+    if (uniform() > 0.15f) {
+      const size_t num_lobes = 1 + size_t (3.0f * uniform()) % 3;
+      for (size_t n = 0; n != num_lobes; ++n) {
+        const Eigen::Vector3f dir = random_direction();
+        const float volume = 0.2f + uniform();
+        coefs += volume * Math::SH::delta (lobe, dir, lmax);
+        max_amplitude = std::max (max_amplitude, volume * Math::SH::value (lobe, dir, lmax));
+      }
+    }
+    if (fod.index(0) == 3 && fod.index(1) == 3 && fod.index(2) == 3)
+      coefs[0] = NaN;
+    for (auto v = Loop (3) (fod); v; ++v)
+      fod.value() = coefs[fod.index(3)];
+  }
+
+  // Linear interpolation within a triangle of the direction set has an error
+  //   that scales with the square of the angle between neighbouring directions;
+  //   these are the tolerances for the maximal error in amplitude, relative to
+  //   the maximal FOD amplitude, stated in the documentation of the class
+  const vector<std::pair<size_t, float>> sets_and_tolerances = { { 300, 0.15f }, { 1281, 0.04f }, { 5000, 0.01f } };
+
+  Interpolator<Image<float>>::type interp (fod);
+  for (const auto& set_and_tolerance : sets_and_tolerances) {
+    const size_t num_directions = set_and_tolerance.first;
+    const float tolerance = set_and_tolerance.second * max_amplitude;
+    AmplitudeLookup lookup (fod, num_directions);
+    AmplitudeLookup::Sampler sampler (&lookup);
+
+    // Directions of the set itself are to yield the amplitudes of the
+    //   interpolated FOD to within floating-point precision
+    const DWI::Directions::Set dirs (num_directions);
+    float max_error_at_vertices = 0.0f, max_error = 0.0f;
+    size_t num_valid = 0;
+    for (size_t n = 0; n != 2000; ++n) {
+      // Positions within and around the image, including voxel centres
+      Eigen::Vector3d voxel (-1.0 + 8.0 * uniform(), -1.0 + 8.0 * uniform(), -1.0 + 8.0 * uniform());
+      if (!(n % 10))
+        voxel = voxel.array().round().matrix();
+      const Eigen::Vector3f position = (H.transform() * voxel.cwiseProduct (Eigen::Vector3d (2.0, 2.0, 2.0))).cast<float>();
+      const bool expected = interp.scanner (position) && [&] () {
+        for (auto v = Loop (3) (interp); v; ++v)
+          coefs[interp.index(3)] = interp.value();
+        return !std::isnan (coefs[0]);
+      }();
+      if (sampler.set_position (position) != expected) {
+        test (false, "incorrect validity of position [ " + str(voxel.transpose()) + " ] (voxel) for direction set of size "
+            + str(num_directions) + ": " + str(!expected) + "; expected " + str(expected));
+        break;
+      }
+      if (!expected)
+        continue;
+      ++num_valid;
+      for (size_t i = 0; i != 10; ++i) {
+        const Eigen::Vector3f dir = dirs[(n * 10 + i) % num_directions].cast<float>();
+        max_error_at_vertices = std::max (max_error_at_vertices, std::abs (sampler.value (dir) - Math::SH::value (coefs, dir, lmax)));
+      }
+      for (size_t i = 0; i != 100; ++i) {
+        const Eigen::Vector3f dir = random_direction();
+        max_error = std::max (max_error, std::abs (sampler.value (dir) - Math::SH::value (coefs, dir, lmax)));
+      }
+    }
+    test (num_valid > 500, "insufficient number of valid positions for direction set of size " + str(num_directions));
+    test (max_error_at_vertices < 1.0e-4f * max_amplitude, "maximal error in amplitude along directions of set of size "
+        + str(num_directions) + " is " + str(max_error_at_vertices / max_amplitude) + " relative to maximal FOD amplitude");
+    test (max_error < tolerance, "maximal error in amplitude for direction set of size " + str(num_directions) + " is "
+        + str(max_error / max_amplitude) + " relative to maximal FOD amplitude; tolerance is " + str(set_and_tolerance.second));
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of FOD amplitude lookup failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
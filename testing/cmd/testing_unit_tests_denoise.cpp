@@ -0,0 +1,316 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+#include "math/rng.h"
+#include "dwi/denoise.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the MP-PCA denoising of dwidenoise against a full eigendecomposition, and the sliding-window implementation against per-voxel processing";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+vector<std::string> failed_tests;
+
+void test (const bool result, const std::string msg)
+{
+  if (!result)
+    failed_tests.push_back (msg);
+}
+
+
+
+template <typename F> F random_value (Math::RNG::Normal<double>& normal) { return F (normal()); }
+template <> cdouble random_value<cdouble> (Math::RNG::Normal<double>& normal) { return cdouble (normal(), normal()); }
+
+
+
+// Access to the eigendecomposition and denoising of a single patch
+template <typename F>
+class Tester : public DWI::DenoisingFunctor<F> { MEMALIGN(Tester<F>)
+  public:
+    using typename DWI::DenoisingFunctor<F>::MatrixType;
+    using typename DWI::DenoisingFunctor<F>::VectorType;
+
+    Tester (const int ndwi, const vector<uint32_t>& extent, Image<bool>& mask, Image<float>& noise) :
+        DWI::DenoisingFunctor<F> (ndwi, extent, mask, noise, false) { }
+
+    ssize_t size () const { return this->r; }
+
+    // projection onto the eigenvectors of XtX for eigenvalues [from, to)
+    MatrixType projection (const MatrixType& XtX, const ssize_t from, const ssize_t to)
+    {
+      this->tridiagonalise (XtX);
+      this->tridiagonal_eigenvectors (from, to);
+      const MatrixType Q = this->tridiag.matrixQ();
+      const MatrixType V = Q * this->U.template cast<F>();
+      return V * V.adjoint();
+    }
+
+    // denoised central voxel of the patch X
+    VectorType denoised (const MatrixType& X, double& sigma)
+    {
+      this->X = X;
+      MatrixType XtX (this->r, this->r);
+      if (this->m <= this->n)
+        XtX.template triangularView<Eigen::Lower>() = X * X.adjoint();
+      else
+        XtX.template triangularView<Eigen::Lower>() = X.adjoint() * X;
+      this->denoise (XtX);
+      sigma = std::sqrt (this->sigma2);
+      return this->X.col (this->n/2);
+    }
+};
+
+
+
+// MP-PCA denoising of the central voxel of the patch X using the full
+//   eigendecomposition of the Gram matrix, as computed prior to the
+//   introduction of inverse iteration
+template <class MatrixType>
+MatrixType reference_denoised (const MatrixType& X, double& sigma, ssize_t& cutoff_p)
+{
+  const ssize_t m = X.rows(), n = X.cols(), r = std::min (m, n), q = std::max (m, n);
+  const MatrixType XtX = m <= n ? MatrixType (X * X.adjoint()) : MatrixType (X.adjoint() * X);
+  Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
+  Eigen::VectorXd s = eig.eigenvalues().template cast<double>();
+  const double lam_r = std::max (s[0], 0.0) / q;
+  double clam = 0.0, sigma2 = 0.0;
+  cutoff_p = 0;
+  for (ssize_t p = 0; p < r; ++p) {
+    const double lam = std::max (s[p], 0.0) / q;
+    clam += lam;
+    const double gam = double(p+1) / (q-(r-p-1));
+    const double sigsq1 = clam / double(p+1);
+    const double sigsq2 = (lam - lam_r) / (4.0 * std::sqrt (gam));
+    if (sigsq2 < sigsq1) {
+      sigma2 = sigsq1;
+      cutoff_p = p+1;
+    }
+  }
+  sigma = std::sqrt (sigma2);
+  if (!cutoff_p)
+    return X.col (n/2);
+  s.head (cutoff_p).setZero();
+  s.tail (r-cutoff_p).setOnes();
+  const MatrixType V = eig.eigenvectors();
+  if (m <= n)
+    return V * (s.cast<typename MatrixType::Scalar>().asDiagonal() * (V.adjoint() * X.col (n/2)));
+  return X * (V * (s.cast<typename MatrixType::Scalar>().asDiagonal() * V.adjoint().col (n/2)));
+}
+
+
+
+template <typename F>
+void test_projection (const std::string& type, const double tolerance)
+{
+  using MatrixType = typename Tester<F>::MatrixType;
+  Image<bool> mask;
+  Image<float> noise;
+  Tester<F> tester (12, { 3, 3, 3 }, mask, noise);
+  const ssize_t r = tester.size();
+
+  // Spectra with distinct, clustered and repeated eigenvalues (including a
+  //   repeated zero eigenvalue, as for a rank-deficient patch); the first 8
+  //   eigenvalues are taken as noise, the remainder as signal components,
+  //   such that no cluster is split between the two
+  vector<std::pair<std::string, Eigen::VectorXd>> spectra;
+  Eigen::VectorXd s (r);
+  for (ssize_t i = 0; i != r; ++i)
+    s[i] = std::pow (1.7, double(i));
+  spectra.push_back ({ "distinct eigenvalues", s });
+  for (ssize_t i = 0; i != r; ++i)
+    s[i] = i < 8 ? 1.0 + 1.0e-7 * i : 100.0 + 1.0e-6 * i;
+  spectra.push_back ({ "clustered eigenvalues", s });
+  for (ssize_t i = 0; i != r; ++i)
+    s[i] = i < 8 ? 1.0 : 50.0;
+  spectra.push_back ({ "repeated eigenvalues", s });
+  for (ssize_t i = 0; i != r; ++i)
+    s[i] = i < 8 ? 0.0 : 10.0 * (i-7);
+  spectra.push_back ({ "repeated zero eigenvalues", s });
+
+  for (const auto& spectrum : spectra) {
+    for (size_t trial = 0; trial != 200; ++trial) {
+      const MatrixType V = Eigen::HouseholderQR<MatrixType> (MatrixType::Random (r, r)).householderQ();
+      const MatrixType XtX = V * spectrum.second.cast<F>().asDiagonal() * V.adjoint();
+      Eigen::SelfAdjointEigenSolver<MatrixType> eig (XtX);
+      // the noise and signal sets, as used by the two branches of denoise()
+      for (const auto& range : { std::make_pair (ssize_t(0), ssize_t(8)), std::make_pair (ssize_t(8), r) }) {
+        const MatrixType expected = eig.eigenvectors().middleCols (range.first, range.second - range.first);
+        const double error = (tester.projection (XtX, range.first, range.second) - expected * expected.adjoint()).cwiseAbs().maxCoeff();
+        test (error < tolerance, type + " projection onto eigenvectors [" + str(range.first) + "," + str(range.second)
+            + ") for " + spectrum.first + ": maximal error is " + str(error));
+      }
+    }
+  }
+}
+
+
+
+template <typename F>
+void test_denoise (const std::string& type, const double tolerance)
+{
+  using MatrixType = typename Tester<F>::MatrixType;
+  Image<bool> mask;
+  Image<float> noise;
+
+  bool signal_branch = false, noise_branch = false;
+  // number of DWI volumes, and number of components of the signal; if m > n,
+  //   the Gram matrix is formed over the voxels of the patch
+  for (const auto& config : { std::make_pair (12, 2), std::make_pair (12, 9), std::make_pair (40, 3), std::make_pair (40, 20) }) {
+    Tester<F> tester (config.first, { 3, 3, 3 }, mask, noise);
+    const ssize_t m = config.first, n = 27;
+    for (size_t trial = 0; trial != 10; ++trial) {
+      const MatrixType X = 20.0 * MatrixType::Random (m, config.second) * MatrixType::Random (config.second, n) + MatrixType::Random (m, n);
+      double sigma, expected_sigma;
+      ssize_t cutoff_p;
+      const MatrixType expected = reference_denoised (X, expected_sigma, cutoff_p);
+      const double error = (tester.denoised (X, sigma) - expected).cwiseAbs().maxCoeff();
+      if (cutoff_p) {
+        const ssize_t r = std::min (m, n);
+        (r-cutoff_p <= cutoff_p ? signal_branch : noise_branch) = true;
+      }
+      const std::string description = type + " denoising of " + str(m) + "x" + str(n) + " patch with " + str(config.second) + " signal components";
+      test (error < tolerance * std::max (1.0, double (expected.cwiseAbs().maxCoeff())), description + ": maximal error is " + str(error));
+      test (std::abs (sigma - expected_sigma) < tolerance * expected_sigma, description + ": noise level is " + str(sigma) + "; expected " + str(expected_sigma));
+    }
+  }
+  test (signal_branch && noise_branch, type + " denoising: both projection onto signal and onto noise components required");
+}
+
+
+
+// The sliding-window implementation must yield the same output as the
+//   per-voxel implementation, including along rows in which the mask
+//   contains gaps that are shorter or longer than the window
+template <typename F>
+void test_sliding (const std::string& type, const vector<uint32_t>& extent, const double tolerance)
+{
+  Math::RNG::Normal<double> normal;
+  const int ndwi = 12;
+
+  Header H;
+  H.ndim() = 4;
+  H.size(0) = 13;
+  H.size(1) = 8;
+  H.size(2) = 7;
+  H.size(3) = ndwi;
+  H.spacing(0) = H.spacing(1) = H.spacing(2) = 2.0;
+  H.spacing(3) = 1.0;
+  H.transform().setIdentity();
+  H.datatype() = DataType::from<F>();
+  auto dwi = Image<F>::scratch (H, "DWI");
+  auto out = Image<F>::scratch (H, "per-voxel output");
+  auto sliding_out = Image<F>::scratch (H, "sliding-window output");
+
+  Header H3 (H);
+  H3.ndim() = 3;
+  H3.datatype() = DataType::Bit;
+  auto mask = Image<bool>::scratch (H3, "mask");
+  H3.datatype() = DataType::Float32;
+  auto noise = Image<float>::scratch (H3, "per-voxel noise");
+  auto sliding_noise = Image<float>::scratch (H3, "sliding-window noise");
+
+  // signal of low rank varying smoothly across the image, plus noise
+  vector<F> basis (4 * ndwi);
+  for (auto& b : basis)
+    b = random_value<F> (normal);
+  for (auto l = Loop (dwi, 0, 3) (dwi); l; ++l) {
+    for (auto v = Loop (3) (dwi); v; ++v) {
+      F value = random_value<F> (normal);
+      for (size_t c = 0; c != 4; ++c)
+        value += 10.0 * std::cos (0.3 * (c+1) * (dwi.index(0) + 2.0 * dwi.index(1) - dwi.index(2))) * basis[c*ndwi + dwi.index(3)];
+      dwi.value() = value;
+    }
+  }
+
+  // gaps longer than the window in even rows, a gap shorter than the window
+  //   in row 3, and a row entirely outside the mask
+  for (auto l = Loop (mask) (mask); l; ++l) {
+    const ssize_t x = mask.index(0), y = mask.index(1);
+    mask.value() = !((y % 2 == 0 && x >= 3 && x < 10) || (y == 3 && x == 6) || (y == 5 && mask.index(2) == 2));
+  }
+
+  DWI::DenoisingFunctor<F> func (ndwi, extent, mask, noise, false);
+  ThreadedLoop (dwi, 0, 3).run (func, dwi, out);
+
+  auto loop = ThreadedLoop (dwi, 0, 3);
+  DWI::SlidingDenoisingFunctor<F> sliding_func (ndwi, extent, loop.inner_axes[0], dwi, sliding_out, mask, sliding_noise, false);
+  loop.run_outer (sliding_func);
+
+  const std::string description = type + " sliding-window denoising with extent " + str(extent[0]) + "x" + str(extent[1]) + "x" + str(extent[2]);
+  double max_error = 0.0, max_noise_error = 0.0, max_value = 0.0;
+  size_t num_masked = 0, num_written = 0, num_unchanged = 0;
+  for (auto l = Loop (mask) (mask, noise, sliding_noise); l; ++l) {
+    max_noise_error = std::max (max_noise_error, double (std::abs (noise.value() - sliding_noise.value())));
+    assign_pos_of (mask, 0, 3).to (dwi, out, sliding_out);
+    bool unchanged = true, zero = true;
+    for (auto v = Loop (3) (dwi, out, sliding_out); v; ++v) {
+      max_error = std::max (max_error, double (std::abs (F (out.value()) - F (sliding_out.value()))));
+      max_value = std::max (max_value, double (std::abs (F (dwi.value()))));
+      if (F (out.value()) != F (dwi.value()))
+        unchanged = false;
+      if (F (sliding_out.value()) != F (0.0))
+        zero = false;
+    }
+    if (!mask.value()) {
+      ++num_masked;
+      if (!zero || sliding_noise.value() != 0.0f)
+        ++num_written;
+    }
+    else if (unchanged) {
+      ++num_unchanged;
+    }
+  }
+  test (num_written == 0, description + ": output written in " + str(num_written) + " voxels outside of mask");
+  test (num_masked > 0, description + ": no voxels outside of mask");
+  test (num_unchanged == 0, description + ": " + str(num_unchanged) + " voxels within mask not denoised");
+  test (max_error < tolerance * max_value, description + ": maximal difference in output is " + str(max_error));
+  test (max_noise_error < tolerance * max_value, description + ": maximal difference in noise level is " + str(max_noise_error));
+}
+
+
+
+void run ()
+{
+  test_projection<double> ("real", 1.0e-8);
+  test_projection<cdouble> ("complex", 1.0e-8);
+  test_denoise<double> ("real", 1.0e-8);
+  test_denoise<cdouble> ("complex", 1.0e-8);
+  for (const auto& extent : { vector<uint32_t> { 3, 3, 3 }, vector<uint32_t> { 5, 3, 3 } }) {
+    test_sliding<double> ("real", extent, 1.0e-8);
+    test_sliding<cdouble> ("complex", extent, 1.0e-8);
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of MP-PCA denoising failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
@@ -0,0 +1,215 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <unsupported/Eigen/FFT>
+
+#include "command.h"
+#include "exception.h"
+#include "math/fft.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the batched Fourier transforms of the Math::FFT class against line-by-line transforms using Eigen::FFT";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+vector<std::string> failed_tests;
+
+void test (const bool result, const std::string msg)
+{
+  if (!result)
+    failed_tests.push_back (msg);
+}
+
+
+
+template <typename ValueType>
+class Tester { MEMALIGN(Tester<ValueType>)
+  public:
+    using complex_type = std::complex<ValueType>;
+    using real_matrix_type = typename Math::FFT<ValueType>::real_matrix_type;
+    using complex_matrix_type = typename Math::FFT<ValueType>::complex_matrix_type;
+    using complex_vector_type = Eigen::Matrix<complex_type, Eigen::Dynamic, 1>;
+    using real_vector_type = Eigen::Matrix<ValueType, Eigen::Dynamic, 1>;
+
+    Tester (const std::string& type, const ValueType tolerance) :
+        type (type),
+        tolerance (tolerance) { }
+
+    void run ()
+    {
+      for (const ssize_t rows : { 1, 2, 3, 7, 8, 17, 32 }) {
+        for (const ssize_t cols : { 1, 4, 9 }) {
+          for (const size_t axis : { 0, 1 })
+            run (rows, cols, axis);
+        }
+      }
+      // The same instance is re-used for all sizes above; a copy must be
+      //   independently functional
+      Math::FFT<ValueType> copy (fft);
+      const complex_matrix_type in = complex_matrix_type::Random (12, 5);
+      complex_matrix_type out;
+      copy.forward (in, out, 0);
+      compare (out, reference_c2c (in, 0, false), "forward complex transform of copied instance");
+    }
+
+  private:
+    const std::string type;
+    const ValueType tolerance;
+    Math::FFT<ValueType> fft;
+
+    void run (const ssize_t rows, const ssize_t cols, const size_t axis)
+    {
+      const std::string size = " along axis " + str(axis) + " of " + str(rows) + "x" + str(cols) + " matrix";
+      const ssize_t n = axis ? cols : rows;
+
+      // Complex transforms, both into a separate matrix and in place
+      const complex_matrix_type in = complex_matrix_type::Random (rows, cols);
+      complex_matrix_type out, in_place;
+      fft.forward (in, out, axis);
+      compare (out, reference_c2c (in, axis, false), "forward complex transform" + size);
+      in_place = in;
+      fft.forward (in_place, in_place, axis);
+      compare (in_place, reference_c2c (in, axis, false), "in-place forward complex transform" + size);
+      fft.inverse (in, out, axis);
+      compare (out, reference_c2c (in, axis, true), "inverse complex transform" + size);
+      in_place = in;
+      fft.inverse (in_place, in_place, axis);
+      compare (in_place, reference_c2c (in, axis, true), "in-place inverse complex transform" + size);
+
+      // Real transforms; the input to the inverse is the spectrum of real
+      //   data, such that the reconstruction can also be verified
+      const real_matrix_type real_in = real_matrix_type::Random (rows, cols);
+      complex_matrix_type spectrum;
+      fft.forward (real_in, spectrum, axis);
+      compare (spectrum, reference_r2c (real_in, axis), "forward real transform" + size);
+      real_matrix_type real_out;
+      fft.inverse (spectrum, real_out, axis, n);
+      compare (real_out, reference_c2r (spectrum, axis, n), "inverse real transform" + size);
+      compare (real_out, real_in, "round trip of real transform" + size);
+
+      // Imaginary parts of the zero (and Nyquist) frequency terms are to be ignored
+      for (ssize_t m = 0; m != (axis ? rows : cols); ++m) {
+        (axis ? spectrum (m, 0) : spectrum (0, m)).imag (ValueType(1));
+        if (!(n % 2))
+          (axis ? spectrum (m, n/2) : spectrum (n/2, m)).imag (ValueType(-1));
+      }
+      fft.inverse (spectrum, real_out, axis, n);
+      compare (real_out, real_in, "inverse real transform" + size + " with non-zero imaginary terms");
+    }
+
+
+
+    // Line-by-line transforms using Eigen::FFT, which does not support
+    //   transforms of length 1 (the identity)
+    complex_matrix_type reference_c2c (const complex_matrix_type& in, const size_t axis, const bool inverse) const
+    {
+      Eigen::FFT<ValueType> eigen_fft;
+      complex_matrix_type out (in.rows(), in.cols());
+      complex_vector_type result;
+      for (ssize_t m = 0; m != (axis ? in.rows() : in.cols()); ++m) {
+        const complex_vector_type data = axis ? complex_vector_type (in.row(m).transpose()) : complex_vector_type (in.col(m));
+        if (data.size() == 1)
+          result = data;
+        else if (inverse)
+          eigen_fft.inv (result, data);
+        else
+          eigen_fft.fwd (result, data);
+        if (axis)
+          out.row(m) = result.transpose();
+        else
+          out.col(m) = result;
+      }
+      return out;
+    }
+
+    complex_matrix_type reference_r2c (const real_matrix_type& in, const size_t axis) const
+    {
+      Eigen::FFT<ValueType> eigen_fft;
+      eigen_fft.SetFlag (Eigen::FFT<ValueType>::HalfSpectrum);
+      const ssize_t n = axis ? in.cols() : in.rows();
+      complex_matrix_type out (axis ? in.rows() : n/2+1, axis ? n/2+1 : in.cols());
+      complex_vector_type result;
+      for (ssize_t m = 0; m != (axis ? in.rows() : in.cols()); ++m) {
+        const real_vector_type data = axis ? real_vector_type (in.row(m).transpose()) : real_vector_type (in.col(m));
+        if (n == 1)
+          result = data.template cast<complex_type>();
+        else
+          eigen_fft.fwd (result, data);
+        if (axis)
+          out.row(m) = result.transpose();
+        else
+          out.col(m) = result;
+      }
+      return out;
+    }
+
+    real_matrix_type reference_c2r (const complex_matrix_type& in, const size_t axis, const ssize_t n) const
+    {
+      Eigen::FFT<ValueType> eigen_fft;
+      eigen_fft.SetFlag (Eigen::FFT<ValueType>::HalfSpectrum);
+      real_matrix_type out (axis ? in.rows() : n, axis ? n : in.cols());
+      real_vector_type result;
+      for (ssize_t m = 0; m != (axis ? in.rows() : in.cols()); ++m) {
+        const complex_vector_type data = axis ? complex_vector_type (in.row(m).transpose()) : complex_vector_type (in.col(m));
+        if (n == 1)
+          result = data.real();
+        else
+          eigen_fft.inv (result, data, n);
+        if (axis)
+          out.row(m) = result.transpose();
+        else
+          out.col(m) = result;
+      }
+      return out;
+    }
+
+
+
+    template <class MatrixType>
+      void compare (const MatrixType& result, const MatrixType& expected, const std::string& label)
+      {
+        if (result.rows() != expected.rows() || result.cols() != expected.cols()) {
+          test (false, type + " " + label + ": result has size " + str(result.rows()) + "x" + str(result.cols())
+              + "; expected " + str(expected.rows()) + "x" + str(expected.cols()));
+          return;
+        }
+        const ValueType max_error = (result - expected).cwiseAbs().maxCoeff();
+        test (max_error <= tolerance * std::max (ValueType(1), expected.cwiseAbs().maxCoeff()),
+            type + " " + label + ": maximal error is " + str(max_error));
+      }
+};
+
+
+
+void run ()
+{
+  Tester<float> ("single precision", 1.0e-5f).run();
+  Tester<double> ("double precision", 1.0e-12).run();
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of batched Fourier transforms failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
@@ -0,0 +1,114 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "math/rng.h"
+#include "file/gz.h"
+#include "file/gz_block.h"
+#include "file/utils.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of the block-indexed GZip writer and reader";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+void run ()
+{
+  vector<std::string> failed_tests;
+  auto test = [&] (const bool result, const std::string msg) {
+    if (!result)
+      failed_tests.push_back (msg);
+  };
+
+  Math::RNG::Integer<int> rng (15);
+  const std::string filename = File::create_tempfile (0, "gz");
+
+  for (size_t block_size : { size_t(4096), size_t(MRTRIX_GZ_BLOCK_SIZE) }) {
+    for (size_t data_size : { size_t(0), size_t(1), block_size-1, block_size, 7*block_size/2, 20*block_size+17 }) {
+      for (bool bulk : { false, true }) {
+        const std::string label = "data size " + str(data_size) + ", block size " + str(block_size) + (bulk ? ", bulk write" : "");
+
+        // moderately compressible data:
+        vector<uint8_t> data (data_size);
+        for (auto& d : data)
+          d = rng();
+
+        {
+          File::GZBlockWriter writer (filename, block_size);
+          if (bulk) {
+            // short lead-in, then remaining data in one go (compressed concurrently):
+            const size_t lead_in = std::min (data_size, size_t(352));
+            writer.write (data.data(), lead_in);
+            writer.write (data.data() + lead_in, data_size - lead_in);
+          }
+          else {
+            // write in uneven pieces to exercise buffering across blocks:
+            for (size_t offset = 0; offset < data_size; offset += 1000)
+              writer.write (data.data() + offset, std::min (size_t(1000), data_size - offset));
+          }
+          writer.close();
+        }
+
+        // must be readable as a standard GZip stream:
+        vector<uint8_t> serial (data_size+1);
+        {
+          File::GZ zf (filename, "rb");
+          const size_t n = zf.read (reinterpret_cast<char*> (serial.data()), serial.size());
+          test (n == data_size, label + ": standard GZip read returned " + str(n) + " bytes");
+          serial.resize (data_size);
+          test (serial == data, label + ": data mismatch in standard GZip read");
+        }
+
+        File::GZBlockIndex index (filename);
+        test (index.valid(), label + ": block index not detected");
+        if (!index.valid())
+          continue;
+        test (index.size() == int64_t(data_size), label + ": index reports uncompressed size " + str(index.size()));
+
+        // full and partial reads, aligned and unaligned with member boundaries:
+        const size_t inner_start = std::min (data_size, size_t(123));
+        const size_t inner_size = data_size - inner_start > 457 ? data_size - inner_start - 457 : 0;
+        const vector<std::pair<size_t,size_t>> regions = {
+          { 0, data_size },
+          { inner_start, inner_size },
+          { data_size/2, data_size - data_size/2 }
+        };
+        for (const auto& region : regions) {
+          vector<uint8_t> parallel (region.second);
+          index.read (region.first, parallel.data(), region.second);
+          test (std::equal (parallel.begin(), parallel.end(), data.begin() + region.first),
+              label + ": data mismatch in block-indexed read of " + str(region.second) + " bytes from offset " + str(region.first));
+        }
+      }
+    }
+  }
+
+  std::remove (filename.c_str());
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of block-indexed GZip I/O failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
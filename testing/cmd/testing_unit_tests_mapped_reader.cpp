@@ -0,0 +1,128 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "math/rng.h"
+#include "file/utils.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/mapped_reader.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::DWI::Tractography;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of the memory-mapped track file reader";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+template <typename ValueType>
+void write_tracks (const std::string& filename, const vector<Streamline<float>>& tracks)
+{
+  std::remove (filename.c_str());
+  Properties properties;
+  Writer<ValueType> writer (filename, properties);
+  for (const auto& tck : tracks) {
+    Streamline<ValueType> out (tck.size());
+    for (size_t n = 0; n != tck.size(); ++n)
+      out[n] = tck[n].template cast<ValueType>();
+    writer (out);
+  }
+}
+
+
+void run ()
+{
+  vector<std::string> failed_tests;
+  auto test = [&] (const bool result, const std::string msg) {
+    if (!result)
+      failed_tests.push_back (msg);
+  };
+
+  Math::RNG::Uniform<float> rng;
+  Math::RNG::Integer<size_t> length (200);
+
+  // include empty streamlines and single vertices:
+  vector<Streamline<float>> tracks (1000);
+  for (size_t n = 0; n != tracks.size(); ++n) {
+    tracks[n].resize (n % 97 ? length() : n % 2);
+    for (auto& p : tracks[n])
+      p = { rng(), rng(), rng() };
+  }
+
+  const std::string filename = File::create_tempfile (0, "tck");
+
+  for (bool double_precision : { false, true }) {
+    const std::string label = double_precision ? "Float64" : "Float32";
+    if (double_precision)
+      write_tracks<double> (filename, tracks);
+    else
+      write_tracks<float> (filename, tracks);
+
+    Properties properties;
+    MappedReader<float> reader (filename, properties);
+    test (reader.size() == tracks.size(), label + ": index contains " + str(reader.size()) + " streamlines");
+    test (reader.zero_copy() == !double_precision, label + ": unexpected zero-copy capability");
+    if (reader.size() != tracks.size())
+      continue;
+
+    // sequential read must match the stream-based reader:
+    {
+      Properties p;
+      Reader<float> stream_reader (filename, p);
+      Streamline<float> a, b;
+      size_t count = 0;
+      while (stream_reader (a)) {
+        test (reader (b), label + ": mapped reader terminated early");
+        test (a.get_index() == b.get_index() && a.size() == b.size() && std::equal (a.begin(), a.end(), b.begin()),
+              label + ": mismatch in sequential read of streamline " + str(count));
+        ++count;
+      }
+      test (!reader (b), label + ": mapped reader returned excess streamlines");
+    }
+
+    // random access, in reverse order:
+    Streamline<float> tck;
+    for (size_t n = tracks.size(); n-- > 0;) {
+      reader.load (n, tck);
+      bool match = tck.get_index() == n && tck.size() == tracks[n].size() && reader.num_vertices (n) == tracks[n].size();
+      for (size_t i = 0; match && i != tck.size(); ++i)
+        match = tck[i].isApprox (tracks[n][i]);
+      test (match, label + ": mismatch in random access of streamline " + str(n));
+      if (reader.zero_copy()) {
+        const auto span = reader.span (n);
+        test (span.size() == tracks[n].size() && std::equal (span.begin(), span.end(), tracks[n].begin()),
+              label + ": mismatch in zero-copy access of streamline " + str(n));
+      }
+    }
+
+    reader.seek (tracks.size() - 3);
+    test (reader (tck) && tck.get_index() == tracks.size() - 3, label + ": seek failed");
+  }
+
+  std::remove (filename.c_str());
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of memory-mapped track reader failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
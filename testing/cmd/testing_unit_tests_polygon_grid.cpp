@@ -0,0 +1,145 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "math/rng.h"
+#include "surface/mesh.h"
+#include "surface/polygon_grid.h"
+#include "surface/utils.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::Surface;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of the closest point on triangle calculation, and of nearest polygon queries using the PolygonGrid class";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+void run ()
+{
+  vector<std::string> failed_tests;
+  auto test = [&] (const bool result, const std::string msg) {
+    if (!result)
+      failed_tests.push_back (msg);
+  };
+
+  Math::RNG::Uniform<default_type> uniform;
+  Math::RNG::Normal<default_type> normal;
+  auto random_point = [&] (const default_type low, const default_type high) {
+    return Vertex (low + (high-low) * uniform(), low + (high-low) * uniform(), low + (high-low) * uniform());
+  };
+
+  // Closest point on a triangle: q is the projection of p onto the triangle if
+  //   and only if q lies within the triangle, and (p-q).(v-q) <= 0 for all three
+  //   vertices v (and hence for every point of the triangle)
+  for (size_t n = 0; n != 100000; ++n) {
+    const Vertex a (random_point (-1.0, 1.0));
+    // Include elongated & obtuse triangles
+    const Vertex b (a + std::pow (10.0, 2.0*uniform()-1.0) * random_point (-1.0, 1.0));
+    const Vertex c (a + std::pow (10.0, 2.0*uniform()-1.0) * random_point (-1.0, 1.0));
+    const Vertex ab (b - a), ac (c - a);
+    if (ab.cross (ac).norm() < 1e-3 * ab.norm() * ac.norm())
+      continue;
+    // Points both within the plane of the triangle, and away from it
+    Vertex p (random_point (-3.0, 3.0));
+    if (n % 2)
+      p -= ab.cross (ac).normalized().dot (p - a) * ab.cross (ac).normalized();
+    const Vertex q (closest_point (p, a, b, c));
+
+    Eigen::Matrix<default_type, 3, 2> M;
+    M << ab, ac;
+    const Eigen::Vector2d uv = M.colPivHouseholderQr().solve (q - a);
+    const default_type scale = std::max ({ ab.norm(), ac.norm(), (p-a).norm() });
+    const default_type tolerance = 1e-9;
+    const bool inside = uv[0] > -tolerance && uv[1] > -tolerance && uv[0] + uv[1] < 1.0 + tolerance
+                        && (M * uv - (q - a)).norm() < tolerance * scale;
+    const bool optimal = (p-q).dot (a-q) < tolerance * scale * scale
+                         && (p-q).dot (b-q) < tolerance * scale * scale
+                         && (p-q).dot (c-q) < tolerance * scale * scale;
+    if (!inside || !optimal) {
+      test (false, "incorrect closest point on triangle [ " + str(a.transpose()) + " ], [ " + str(b.transpose()) + " ], [ "
+          + str(c.transpose()) + " ] to point [ " + str(p.transpose()) + " ]: [ " + str(q.transpose()) + " ]"
+          + (inside ? "" : " (outside triangle)") + (optimal ? "" : " (not optimal)"));
+      break;
+    }
+  }
+
+  // Nearest polygon: compare against a brute-force search over all polygons
+  //   of a mesh of random triangles and planar quads
+  VertexList vertices;
+  TriangleList triangles;
+  QuadList quads;
+  for (uint32_t n = 0; n != 300; ++n) {
+    const Vertex a (random_point (0.0, 20.0));
+    vertices.push_back (a);
+    vertices.push_back (a + random_point (-3.0, 3.0));
+    vertices.push_back (a + random_point (-3.0, 3.0));
+    triangles.push_back (Triangle ({ 3*n, 3*n+1, 3*n+2 }));
+  }
+  for (uint32_t n = 0; n != 100; ++n) {
+    const Vertex centre (random_point (0.0, 20.0));
+    const Vertex u (Vertex (normal(), normal(), normal()).normalized());
+    const Vertex v (u.cross (Vertex (normal(), normal(), normal())).normalized());
+    const default_type su = 0.1 + 2.0 * uniform(), sv = 0.1 + 2.0 * uniform();
+    const uint32_t first = vertices.size();
+    vertices.push_back (centre - su*u - sv*v);
+    vertices.push_back (centre + su*u - sv*v);
+    vertices.push_back (centre + su*u + sv*v);
+    vertices.push_back (centre - su*u + sv*v);
+    quads.push_back (Quad ({ first, first+1, first+2, first+3 }));
+  }
+  Mesh mesh;
+  mesh.load (vertices, triangles, quads);
+
+  for (const default_type cell_size : { 0.7, 1.0, 2.5 }) {
+    const PolygonGrid grid (mesh, cell_size);
+    for (size_t n = 0; n != 2000; ++n) {
+      // Points within and around the mesh, and some far beyond it
+      const Vertex p (n % 10 ? random_point (-5.0, 25.0) : random_point (-100.0, 120.0));
+      default_type distance;
+      const size_t nearest = grid.nearest (p, distance);
+      default_type brute_force_distance = std::numeric_limits<default_type>::infinity();
+      for (size_t i = 0; i != mesh.num_polygons(); ++i)
+        brute_force_distance = std::min (brute_force_distance, grid.distance (p, i));
+      if (nearest >= mesh.num_polygons() || distance != brute_force_distance || grid.distance (p, nearest) != distance) {
+        test (false, "incorrect nearest polygon to point [ " + str(p.transpose()) + " ] with cell size " + str(cell_size)
+            + ": polygon " + str(nearest) + " at distance " + str(distance) + "; brute-force distance " + str(brute_force_distance));
+        break;
+      }
+    }
+  }
+
+  {
+    const Mesh empty;
+    const PolygonGrid grid (empty);
+    default_type distance;
+    test (grid.nearest (Vertex (0.0, 0.0, 0.0), distance) == 0 && distance == std::numeric_limits<default_type>::infinity(),
+        "incorrect result of nearest polygon query on empty mesh");
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of nearest polygon queries failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
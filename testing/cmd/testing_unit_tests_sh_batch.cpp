@@ -0,0 +1,83 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "math/SH.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+
+  SYNOPSIS = "Test the batched evaluation of spherical harmonic series against per-direction evaluation";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+using value_type = float;
+using coefs_type = Eigen::Matrix<value_type,Eigen::Dynamic,1>;
+using dir_type = Eigen::Matrix<value_type,3,1>;
+
+
+
+void run ()
+{
+  using namespace Math::SH;
+
+  const int lmax = 8;
+  const ssize_t num_dirs = 1000;
+
+  PrecomputedAL<value_type> precomputer (lmax);
+  BatchEvaluator<value_type> exact (lmax), precomputed (lmax, &precomputer);
+
+  // include the poles, where the azimuth is undefined
+  Eigen::Matrix<value_type,3,Eigen::Dynamic> dirs (3, num_dirs);
+  for (ssize_t n = 0; n < num_dirs; ++n)
+    dirs.col(n) = dir_type::Random().normalized();
+  dirs.col(0) = dir_type (0.0, 0.0, 1.0);
+  dirs.col(1) = dir_type (0.0, 0.0, -1.0);
+  exact.set_directions (dirs);
+  precomputed.set_directions (dirs);
+
+  // shared coefficients, including higher harmonics that should be ignored
+  const coefs_type coefs = coefs_type::Random (NforL (lmax+2));
+  coefs_type amplitudes, amplitudes_precomputed;
+  exact.value (coefs, amplitudes);
+  precomputed.value (coefs, amplitudes_precomputed);
+  for (ssize_t n = 0; n < num_dirs; ++n) {
+    const dir_type dir = dirs.col(n);
+    if (std::abs (amplitudes[n] - value (coefs, dir, lmax)) > 1e-4)
+      throw Exception ("exact batched evaluation differs from value() for direction " + str(n));
+    if (std::abs (amplitudes_precomputed[n] - precomputer.value (coefs, dir)) > 1e-4)
+      throw Exception ("precomputed batched evaluation differs from PrecomputedAL::value() for direction " + str(n));
+  }
+
+  // one set of coefficients per direction
+  const Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic> paired_coefs =
+      Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic>::Random (num_dirs, NforL (lmax));
+  exact.paired_value (paired_coefs, amplitudes);
+  for (ssize_t n = 0; n < num_dirs; ++n) {
+    const dir_type dir = dirs.col(n);
+    const coefs_type c = paired_coefs.row(n).transpose();
+    if (std::abs (amplitudes[n] - value (c, dir, lmax)) > 1e-4)
+      throw Exception ("paired batched evaluation differs from value() for direction " + str(n));
+  }
+}
+
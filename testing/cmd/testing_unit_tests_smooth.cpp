@@ -0,0 +1,167 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "filter/smooth.h"
+#include "math/rng.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify the recursive implementation of Gaussian smoothing against explicit convolution";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+vector<std::string> failed_tests;
+
+void test (const bool result, const std::string msg)
+{
+  if (!result)
+    failed_tests.push_back (msg);
+}
+
+
+
+Image<float> smooth (Image<float>& input, const vector<default_type>& stdev, const bool recursive, const bool zero_boundary, const bool in_place)
+{
+  Filter::Smooth filter (input);
+  filter.set_stdev (stdev);
+  filter.set_recursive_threshold (recursive ? 1.0 : 0.0);
+  filter.set_zero_boundary (zero_boundary);
+  auto output = Image<float>::scratch (filter);
+  if (in_place) {
+    for (auto l = Loop (input) (input, output); l; ++l)
+      output.value() = input.value();
+    filter (output);
+  }
+  else {
+    filter (input, output);
+  }
+  return output;
+}
+
+
+
+// Compare the recursive against the explicit implementation: non-finite
+//   values must be located in the same voxels, and the remaining values
+//   must agree within a tolerance, and lie within the range of the input
+void compare (Image<float>& input, const vector<default_type>& stdev, const default_type tolerance, const std::string& label)
+{
+  default_type min = std::numeric_limits<default_type>::infinity(), max = -min;
+  for (auto l = Loop (input) (input); l; ++l) {
+    if (std::isfinite (input.value())) {
+      min = std::min (min, default_type (input.value()));
+      max = std::max (max, default_type (input.value()));
+    }
+  }
+  for (const bool zero_boundary : { false, true }) {
+    for (const bool in_place : { false, true }) {
+      const std::string description = label + " smoothed with standard deviations [ " + str(stdev[0]) + " " + str(stdev[1]) + " " + str(stdev[2]) + " ]"
+          + (zero_boundary ? " and zero boundary" : "") + (in_place ? " in place" : "");
+      auto expected = smooth (input, stdev, false, zero_boundary, in_place);
+      auto result = smooth (input, stdev, true, zero_boundary, in_place);
+      size_t non_finite = 0, mismatched = 0, out_of_range = 0;
+      default_type max_error = 0.0;
+      for (auto l = Loop (result) (result, expected); l; ++l) {
+        if (std::isfinite (expected.value()) != std::isfinite (result.value())) {
+          ++mismatched;
+        }
+        else if (std::isfinite (expected.value())) {
+          max_error = std::max (max_error, default_type (std::abs (result.value() - expected.value())));
+          // the recursive kernel has small negative lobes
+          if (result.value() != 0.0f && (result.value() < min - 0.01 * (max - min + 1.0) || result.value() > max + 0.01 * (max - min + 1.0)))
+            ++out_of_range;
+        }
+        else {
+          ++non_finite;
+        }
+      }
+      test (!mismatched, description + ": " + str(mismatched) + " voxels differ in whether they are finite");
+      test (!out_of_range, description + ": " + str(out_of_range) + " voxels outside of the range of input values");
+      test (max_error <= tolerance, description + ": maximal difference is " + str(max_error) + "; tolerance is " + str(tolerance));
+      if (label.find ("NaN-masked") != std::string::npos)
+        test (non_finite, description + ": no non-finite values");
+    }
+  }
+}
+
+
+
+void run ()
+{
+  Math::RNG::Uniform<float> uniform;
+
+  Header H;
+  H.ndim() = 3;
+  H.size(0) = 40;
+  H.size(1) = 33;
+  H.size(2) = 26;
+  H.spacing(0) = H.spacing(1) = H.spacing(2) = 1.5;
+  H.transform().setIdentity();
+  H.datatype() = DataType::Float32;
+  auto image = Image<float>::scratch (H, "test image");
+
+  // A constant image must remain constant, including at the image
+  //   boundaries, and around non-finite values
+  for (auto l = Loop (image) (image); l; ++l)
+    image.value() = 3.0f;
+  compare (image, { 6.0, 6.0, 6.0 }, 1.0e-5, "constant image");
+  for (auto l = Loop (image) (image); l; ++l)
+    if (uniform() < 0.2f)
+      image.value() = uniform() < 0.5f ? NaN : std::numeric_limits<float>::infinity();
+  compare (image, { 6.0, 6.0, 6.0 }, 1.0e-5, "constant image with scattered non-finite values");
+
+  // A smooth image; since the explicit kernel is truncated at 2 standard
+  //   deviations, results agree only approximately
+  for (auto l = Loop (image) (image); l; ++l)
+    image.value() = 10.0 + std::sin (0.05 * image.index(0)) + std::cos (0.07 * image.index(1) + 0.04 * image.index(2));
+  compare (image, { 6.0, 6.0, 6.0 }, 0.05, "smooth image");
+
+  // Lines that are NaN except for a few voxels (in the middle of the image
+  //   along the first axis, and at the start along the second): the output
+  //   must remain NaN beyond 2 standard deviations from the finite values,
+  //   even though the filtered mask never decays exactly to zero. Near the
+  //   edges of the finite region, the truncation of the explicit kernel
+  //   leads to differences of up to half the range of values (5).
+  for (auto l = Loop (image) (image); l; ++l) {
+    if (image.index(0) >= 18 && image.index(0) < 23)
+      image.value() = 28.0f + image.index(0) - 18 + uniform();
+    else if (image.index(1) < 3)
+      image.value() = 28.0f + 5.0f * uniform();
+    else
+      image.value() = NaN;
+  }
+  for (const default_type stdev : { 4.5, 6.0, 12.0 }) {
+    compare (image, { stdev, 0.0, 0.0 }, 2.5, "NaN-masked image");
+    compare (image, { stdev, stdev, stdev }, 2.5, "NaN-masked image");
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of recursive Gaussian smoothing failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
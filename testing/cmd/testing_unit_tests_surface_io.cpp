@@ -0,0 +1,268 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "raw.h"
+#include "math/rng.h"
+#include "file/ofstream.h"
+#include "file/utils.h"
+#include "surface/gifti.h"
+#include "surface/mesh.h"
+
+using namespace MR;
+using namespace App;
+using namespace MR::Surface;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify correct operation of the Base64 codec and the PLY & GIfTI surface mesh readers and writers";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+
+vector<std::string> failed_tests;
+
+void test (const bool result, const std::string msg)
+{
+  if (!result)
+    failed_tests.push_back (msg);
+}
+
+
+
+// Compare a mesh loaded from file against the original; vertex positions are
+//   stored in single precision by all writers
+void compare (const Mesh& original, const Mesh& loaded, const std::string& label)
+{
+  if (loaded.num_vertices() != original.num_vertices() ||
+      loaded.num_triangles() != original.num_triangles() ||
+      loaded.num_quads() != original.num_quads()) {
+    test (false, label + ": mesh has " + str(loaded.num_vertices()) + " vertices, " + str(loaded.num_triangles())
+        + " triangles and " + str(loaded.num_quads()) + " quads; expected " + str(original.num_vertices()) + ", "
+        + str(original.num_triangles()) + " and " + str(original.num_quads()));
+    return;
+  }
+  for (size_t i = 0; i != original.num_vertices(); ++i) {
+    if (!loaded.vert(i).isApprox (original.vert(i).cast<float>().cast<double>(), 1e-6)) {
+      test (false, label + ": mismatch in position of vertex " + str(i));
+      return;
+    }
+  }
+  for (size_t i = 0; i != original.num_triangles(); ++i) {
+    for (size_t v = 0; v != 3; ++v) {
+      if (loaded.tri(i)[v] != original.tri(i)[v]) {
+        test (false, label + ": mismatch in vertex indices of triangle " + str(i));
+        return;
+      }
+    }
+  }
+  for (size_t i = 0; i != original.num_quads(); ++i) {
+    for (size_t v = 0; v != 4; ++v) {
+      if (loaded.quad(i)[v] != original.quad(i)[v]) {
+        test (false, label + ": mismatch in vertex indices of quad " + str(i));
+        return;
+      }
+    }
+  }
+}
+
+
+
+// Load a mesh from file, recording a failure if this is not possible
+bool load (const std::string& path, Mesh& mesh, const std::string& label)
+{
+  try {
+    mesh = Mesh (path);
+    return true;
+  } catch (Exception& e) {
+    test (false, label + ": error loading mesh: " + e[0]);
+    return false;
+  }
+}
+
+
+
+// Verify that loading a mesh from file fails
+void expect_failure (const std::string& path, const std::string& label)
+{
+  try {
+    Mesh mesh (path);
+    test (false, label + ": no error reported");
+  } catch (Exception&) { }
+}
+
+
+
+void run ()
+{
+  Math::RNG::Integer<int> bytes_rng (255);
+  Math::RNG::Normal<default_type> normal_rng;
+
+  // Base64 codec
+  const std::string known_input ("Man is");
+  const std::string known_encodings[] = { "", "TQ==", "TWE=", "TWFu", "TWFuIA==", "TWFuIGk=", "TWFuIGlz" };
+  for (size_t size = 0; size <= known_input.size(); ++size) {
+    const std::string encoded = GIfTI::base64_encode (reinterpret_cast<const uint8_t*> (known_input.data()), size);
+    test (encoded == known_encodings[size], "Base64 encoding of \"" + known_input.substr (0, size) + "\" is \"" + encoded
+        + "\"; expected \"" + known_encodings[size] + "\"");
+  }
+  for (size_t size = 0; size != 100; ++size) {
+    vector<uint8_t> data (size);
+    for (auto& d : data)
+      d = bytes_rng();
+    std::string encoded = GIfTI::base64_encode (data.data(), data.size());
+    test (encoded.size() == 4 * ((size + 2) / 3), "Base64 encoding of " + str(size) + " bytes has length " + str(encoded.size()));
+    test (GIfTI::base64_decode (encoded.data(), encoded.size()) == data, "Base64 round trip of " + str(size) + " bytes");
+    // Whitespace within the encoded data (e.g. line breaks) is to be ignored
+    for (size_t i = encoded.size(); i > 0; i -= std::min (i, size_t(7)))
+      encoded.insert (i, i % 2 ? "\n  " : " ");
+    test (GIfTI::base64_decode (encoded.data(), encoded.size()) == data, "Base64 round trip of " + str(size) + " bytes with whitespace");
+  }
+
+  // Mesh with random vertex positions; the PLY format additionally supports quads
+  VertexList vertices;
+  for (size_t i = 0; i != 50; ++i)
+    vertices.push_back (Vertex (100.0 * normal_rng(), 100.0 * normal_rng(), 100.0 * normal_rng()));
+  Math::RNG::Integer<uint32_t> index_rng (vertices.size() - 1);
+  TriangleList triangles;
+  for (size_t i = 0; i != 80; ++i)
+    triangles.push_back (Triangle ({ index_rng(), index_rng(), index_rng() }));
+  QuadList quads;
+  for (size_t i = 0; i != 20; ++i)
+    quads.push_back (Quad ({ index_rng(), index_rng(), index_rng(), index_rng() }));
+  Mesh triangle_mesh, mixed_mesh;
+  triangle_mesh.load (vertices, triangles);
+  mixed_mesh.load (vertices, triangles, quads);
+
+  // Round trip through all written formats
+  {
+    const std::string ply_path = File::create_tempfile (0, "ply");
+    const std::string gii_path = File::create_tempfile (0, "gii");
+    Mesh loaded;
+    for (const bool binary : { false, true }) {
+      const std::string label (binary ? "PLY binary little-endian" : "PLY ASCII");
+      mixed_mesh.save (ply_path, binary);
+      if (load (ply_path, loaded, label))
+        compare (mixed_mesh, loaded, label);
+    }
+    for (const bool compress : { false, true }) {
+      const std::string label (compress ? "GIfTI GZipBase64Binary" : "GIfTI Base64Binary");
+      triangle_mesh.save (gii_path, compress);
+      if (load (gii_path, loaded, label))
+        compare (triangle_mesh, loaded, label);
+    }
+    std::remove (ply_path.c_str());
+    std::remove (gii_path.c_str());
+  }
+
+  // PLY big-endian is not written by MRtrix3, so a file is constructed directly;
+  //   this also uses double-precision positions, unsigned indices, and additional
+  //   per-vertex properties that are to be skipped
+  {
+    const std::string path = File::create_tempfile (0, "ply");
+    {
+      File::OFStream out (path, std::ios_base::binary | std::ios_base::out);
+      out << "ply\n"
+          << "format binary_big_endian 1.0\n"
+          << "element vertex " << vertices.size() << "\n"
+          << "property double x\n"
+          << "property double y\n"
+          << "property double z\n"
+          << "property uchar red\n"
+          << "property list uchar short extras\n"
+          << "element face " << (triangles.size() + quads.size()) << "\n"
+          << "property list uchar uint vertex_indices\n"
+          << "end_header\n";
+      uint8_t buffer[24];
+      for (size_t i = 0; i != vertices.size(); ++i) {
+        for (size_t axis = 0; axis != 3; ++axis)
+          Raw::store_BE<double> (vertices[i][axis], buffer, axis);
+        out.write (reinterpret_cast<const char*> (buffer), 24);
+        buffer[0] = uint8_t(i);
+        buffer[1] = uint8_t(i % 3);
+        for (size_t j = 0; j != i % 3; ++j)
+          Raw::store_BE<int16_t> (-int16_t(j), buffer+2, j);
+        out.write (reinterpret_cast<const char*> (buffer), 2 + 2 * (i % 3));
+      }
+      for (const auto& t : triangles) {
+        buffer[0] = 3;
+        for (size_t v = 0; v != 3; ++v)
+          Raw::store_BE<uint32_t> (t[v], buffer+1, v);
+        out.write (reinterpret_cast<const char*> (buffer), 13);
+      }
+      for (const auto& q : quads) {
+        buffer[0] = 4;
+        for (size_t v = 0; v != 4; ++v)
+          Raw::store_BE<uint32_t> (q[v], buffer+1, v);
+        out.write (reinterpret_cast<const char*> (buffer), 17);
+      }
+    }
+    Mesh loaded;
+    if (load (path, loaded, "PLY binary big-endian"))
+      compare (mixed_mesh, loaded, "PLY binary big-endian");
+    std::remove (path.c_str());
+  }
+
+  // GIfTI ASCII encoding is not written by MRtrix3 either; the pointset is
+  //   stored in column-major order to also verify the transposition
+  {
+    const std::string path = File::create_tempfile (0, "gii");
+    auto write = [&] (const std::string& vertex_data_end, const std::string& vertex_array_end) {
+      File::OFStream out (path);
+      out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          << "<GIFTI Version=\"1.0\" NumberOfDataArrays=\"2\">\n"
+          << "  <DataArray Intent=\"NIFTI_INTENT_POINTSET\" DataType=\"NIFTI_TYPE_FLOAT32\" ArrayIndexingOrder=\"ColumnMajorOrder\"\n"
+          << "             Dimensionality=\"2\" Dim0=\"" << vertices.size() << "\" Dim1=\"3\" Encoding=\"ASCII\" Endian=\"LittleEndian\"\n"
+          << "             ExternalFileName=\"\" ExternalFileOffset=\"\">\n"
+          << "    <Data>";
+      for (size_t axis = 0; axis != 3; ++axis)
+        for (const auto& v : vertices)
+          out << str<float> (v[axis]) << "\n";
+      out << vertex_data_end
+          << vertex_array_end
+          << "  <DataArray Intent=\"NIFTI_INTENT_TRIANGLE\" DataType=\"NIFTI_TYPE_INT32\" ArrayIndexingOrder=\"RowMajorOrder\"\n"
+          << "             Dimensionality=\"2\" Dim0=\"" << triangles.size() << "\" Dim1=\"3\" Encoding=\"ASCII\" Endian=\"LittleEndian\"\n"
+          << "             ExternalFileName=\"\" ExternalFileOffset=\"\">\n"
+          << "    <Data>";
+      for (const auto& t : triangles)
+        out << t[0] << " " << t[1] << " " << t[2] << "\n";
+      out << "</Data>\n"
+          << "  </DataArray>\n"
+          << "</GIFTI>\n";
+    };
+    Mesh loaded;
+    write ("</Data>\n", "  </DataArray>\n");
+    if (load (path, loaded, "GIfTI ASCII"))
+      compare (triangle_mesh, loaded, "GIfTI ASCII");
+    // Data element not terminated within its data array
+    write ("\n", "  </DataArray>\n");
+    expect_failure (path, "GIfTI with unterminated data element");
+    // Data array not terminated before the next one
+    write ("</Data>\n", "");
+    expect_failure (path, "GIfTI with unterminated data array");
+    std::remove (path.c_str());
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of surface mesh I/O failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}
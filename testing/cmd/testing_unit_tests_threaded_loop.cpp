@@ -0,0 +1,77 @@
+/* Copyright (c) 2008-2026 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "exception.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+
+using namespace MR;
+using namespace App;
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+  SYNOPSIS = "Verify that ThreadedLoop() visits every voxel exactly once";
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+
+void run ()
+{
+  vector<std::string> failed_tests;
+
+  const vector<vector<int>> dimensions = {
+    { 1, 1, 1 },
+    { 7, 3, 5 },
+    { 64, 64, 40 },
+    { 13, 17, 11, 9 },
+    { 2, 1, 97, 3 }
+  };
+
+  for (const auto& dim : dimensions) {
+    Header H;
+    H.ndim() = dim.size();
+    for (size_t n = 0; n < dim.size(); ++n) {
+      H.size(n) = dim[n];
+      H.spacing(n) = 1.0;
+    }
+    H.transform().setIdentity();
+    H.datatype() = DataType::UInt32;
+
+    for (size_t num_inner_axes = 1; num_inner_axes < dim.size(); ++num_inner_axes) {
+      auto counts = Image<uint32_t>::scratch (H, "voxel visit counts");
+      ThreadedLoop (counts, 0, dim.size(), num_inner_axes).run ([] (decltype(counts)& v) { v.value() = v.value() + 1; }, counts);
+
+      size_t errors = 0;
+      for (auto l = Loop (counts) (counts); l; ++l)
+        if (counts.value() != 1)
+          ++errors;
+      if (errors)
+        failed_tests.push_back ("image of size " + str(dim) + " with " + str(num_inner_axes)
+            + " inner axes: " + str(errors) + " voxels not visited exactly once");
+    }
+  }
+
+  if (failed_tests.size()) {
+    Exception e (str(failed_tests.size()) + " tests of ThreadedLoop failed:");
+    for (auto s : failed_tests)
+      e.push_back (s);
+    throw e;
+  }
+}